@@ -838,6 +838,10 @@ AnimationServer::AnimationServer(int &argc, char **argv) :
     connect(silentNodeTimer, SIGNAL(timeout()), nodeList, SLOT(removeSilentNodes()));
     silentNodeTimer->start(NODE_SILENCE_THRESHOLD_USECS / 1000);
     
+    QTimer* reliableResendTimer = new QTimer(this);
+    connect(reliableResendTimer, SIGNAL(timeout()), nodeList, SLOT(resendReliableMessages()));
+    reliableResendTimer->start(RELIABLE_RESEND_INTERVAL_USECS / 1000);
+    
     connect(&nodeList->getNodeSocket(), SIGNAL(readyRead()), SLOT(readPendingDatagrams()));
 }
 
@@ -855,13 +859,7 @@ void AnimationServer::readPendingDatagrams() {
                                                                    nodeSockAddr.getPortPointer())) &&
         packetVersionMatch(packetData)) {
         
-        if (packetData[0] == PACKET_TYPE_JURISDICTION) {
-            int headerBytes = numBytesForPacketHeader(packetData);
-            // PACKET_TYPE_JURISDICTION, first byte is the node type...
-            if (packetData[headerBytes] == NODE_TYPE_VOXEL_SERVER && ::jurisdictionListener) {
-                ::jurisdictionListener->queueReceivedPacket(nodeSockAddr, packetData, receivedBytes);
-            }
-        }
+        // jurisdictions arrive as reliable messages, which NodeList hands to the jurisdiction listener itself
         NodeList::getInstance()->processNodeData(nodeSockAddr, packetData, receivedBytes);
     }
 }
@@ -6,6 +6,8 @@
 //  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
 //
 
+#include <algorithm>
+
 #include <QtCore/QCoreApplication>
 #include <QtCore/QEventLoop>
 #include <QtCore/QTimer>
@@ -22,31 +24,128 @@
 #include "Agent.h"
 
 Agent::Agent(const unsigned char* dataBuffer, int numBytes) :
-    ThreadedAssignment(dataBuffer, numBytes)
+    ThreadedAssignment(dataBuffer, numBytes),
+    _scriptEngine(NULL),
+    _voxelScriptingInterface(NULL),
+    _particleScriptingInterface(NULL),
+    _framesPerSecond(AGENT_DEFAULT_FRAMES_PER_SECOND),
+    _shedsOverrunFrames(false),
+    _nextFrameUsecs(0),
+    _frameStats()
 {
 }
 
+Agent::~Agent() {
+    delete _scriptEngine;
+    delete _voxelScriptingInterface;
+    delete _particleScriptingInterface;
+}
+
+QUrl Agent::getScriptURL() const {
+    // figure out the URL for the script for this agent assignment
+    QString scriptURLString("http://%1:8080/assignment/%2");
+    scriptURLString = scriptURLString.arg(NodeList::getInstance()->getDomainIP().toString(),
+                                          uuidStringWithoutCurlyBraces(_uuid));
+    return QUrl(scriptURLString);
+}
+
 void Agent::processDatagram(const QByteArray& dataByteArray, const HifiSockAddr& senderSockAddr) {
-    if (dataByteArray[0] == PACKET_TYPE_JURISDICTION) {
-        int headerBytes = numBytesForPacketHeader((const unsigned char*) dataByteArray.constData());
-        // PACKET_TYPE_JURISDICTION, first byte is the node type...
-        switch (dataByteArray[headerBytes]) {
-            case NODE_TYPE_VOXEL_SERVER:
-                _voxelScriptingInterface.getJurisdictionListener()->queueReceivedPacket(senderSockAddr,
-                                                                                (unsigned char*) dataByteArray.data(),
-                                                                                dataByteArray.size());
-                break;
-            case NODE_TYPE_PARTICLE_SERVER:
-                _particleScriptingInterface.getJurisdictionListener()->queueReceivedPacket(senderSockAddr,
-                                                                                (unsigned char*) dataByteArray.data(),
-                                                                                dataByteArray.size());
-                break;
-        }
-    } else {
-        NodeList::getInstance()->processNodeData(senderSockAddr, (unsigned char*) dataByteArray.data(), dataByteArray.size());
+    // jurisdictions arrive as reliable messages, which NodeList hands to the jurisdiction listeners itself
+    NodeList::getInstance()->processNodeData(senderSockAddr, (unsigned char*) dataByteArray.data(), dataByteArray.size());
+}
+
+void Agent::evaluateScript(const QString& scriptContents) {
+    _scriptEngine = new QScriptEngine();
+    
+    // register meta-type for glm::vec3 conversions
+    registerMetaTypes(_scriptEngine);
+    
+    QScriptValue agentValue = _scriptEngine->newQObject(this);
+    _scriptEngine->globalObject().setProperty("Agent", agentValue);
+    
+    QScriptValue voxelScripterValue =  _scriptEngine->newQObject(_voxelScriptingInterface);
+    _scriptEngine->globalObject().setProperty("Voxels", voxelScripterValue);
+
+    QScriptValue particleScripterValue =  _scriptEngine->newQObject(_particleScriptingInterface);
+    _scriptEngine->globalObject().setProperty("Particles", particleScripterValue);
+    
+    QScriptValue treeScaleValue = _scriptEngine->newVariant(QVariant(TREE_SCALE));
+    _scriptEngine->globalObject().setProperty("TREE_SCALE", treeScaleValue);
+    
+    qDebug() << "Downloaded script:" << scriptContents << "\n";
+    QScriptValue result = _scriptEngine->evaluate(scriptContents);
+    qDebug() << "Evaluated script.\n";
+    
+    if (_scriptEngine->hasUncaughtException()) {
+        int line = _scriptEngine->uncaughtExceptionLineNumber();
+        qDebug() << "Uncaught exception at line" << line << ":" << result.toString() << "\n";
+        _scriptEngine->clearExceptions();
+    }
+}
+
+void Agent::reportUncaughtException() {
+    if (_scriptEngine->hasUncaughtException()) {
+        int line = _scriptEngine->uncaughtExceptionLineNumber();
+        qDebug() << "Uncaught exception at line" << line << ":" << _scriptEngine->uncaughtException().toString() << "\n";
+        _scriptEngine->clearExceptions();
+    }
+}
+
+void Agent::startHostedScript(const QString& scriptContents, VoxelEditPacketSender* voxelPacketSender,
+                              ParticleEditPacketSender* particlePacketSender) {
+    _voxelScriptingInterface = new VoxelScriptingInterface(voxelPacketSender);
+    _particleScriptingInterface = new ParticleScriptingInterface(particlePacketSender);
+    
+    evaluateScript(scriptContents);
+    
+    _nextFrameUsecs = usecTimestampNow();
+}
+
+void Agent::setFramesPerSecond(float framesPerSecond) {
+    _framesPerSecond = std::max(AGENT_MIN_FRAMES_PER_SECOND, std::min(framesPerSecond, AGENT_MAX_FRAMES_PER_SECOND));
+    
+    // don't make a script that asked to speed up wait out the rest of a long frame
+    _nextFrameUsecs = std::min(_nextFrameUsecs, usecTimestampNow() + getFrameUsecs());
+}
+
+uint64_t Agent::getFrameUsecs() const {
+    const float USECS_PER_SECOND = 1000.0f * 1000.0f;
+    return USECS_PER_SECOND / _framesPerSecond;
+}
+
+void Agent::sendVisualData() {
+    uint64_t startCallback = usecTimestampNow();
+    emit willSendVisualDataCallback();
+    _frameStats.addCallback(usecTimestampNow() - startCallback, getFrameUsecs());
+    
+    reportUncaughtException();
+}
+
+void Agent::advanceFrame(uint64_t now) {
+    uint64_t frameUsecs = getFrameUsecs();
+    _nextFrameUsecs += frameUsecs;
+    
+    if (_shedsOverrunFrames && _nextFrameUsecs + frameUsecs <= now) {
+        // rather than run the frames it has missed back to back, the script skips to the latest one, keeping its cadence
+        int numShedFrames = (now - _nextFrameUsecs) / frameUsecs;
+        _nextFrameUsecs += numShedFrames * frameUsecs;
+        _frameStats.addShedFrames(numShedFrames);
     }
 }
 
+void Agent::sendFrameStats() {
+    unsigned char statsPacket[MAX_PACKET_SIZE];
+    
+    int numBytesPacketHeader = populateTypeAndVersion(statsPacket, PACKET_TYPE_SCRIPT_FRAME_STATS);
+    int numBytesReport = ScriptFrameStats::packReport(statsPacket + numBytesPacketHeader, _uuid,
+                                                      _frameStats.getReport(_framesPerSecond, _shedsOverrunFrames));
+    
+    NodeList* nodeList = NodeList::getInstance();
+    const HifiSockAddr& domainSockAddr = nodeList->getDomainSockAddr();
+    nodeList->getNodeSocket().writeDatagram((char*) statsPacket, numBytesPacketHeader + numBytesReport,
+                                            domainSockAddr.getAddress(), domainSockAddr.getPort());
+}
+
 void Agent::run() {
     NodeList* nodeList = NodeList::getInstance();
     nodeList->setOwnerType(NODE_TYPE_AGENT);
@@ -58,15 +157,12 @@ void Agent::run() {
     
     nodeList->setNodeTypesOfInterest(AGENT_NODE_TYPES_OF_INTEREST, sizeof(AGENT_NODE_TYPES_OF_INTEREST));
     
-    // figure out the URL for the script for this agent assignment
-    QString scriptURLString("http://%1:8080/assignment/%2");
-    scriptURLString = scriptURLString.arg(NodeList::getInstance()->getDomainIP().toString(),
-                                          uuidStringWithoutCurlyBraces(_uuid));
+    QUrl scriptURL = getScriptURL();
     
     QNetworkAccessManager *networkManager = new QNetworkAccessManager(this);
-    QNetworkReply *reply = networkManager->get(QNetworkRequest(QUrl(scriptURLString)));
+    QNetworkReply *reply = networkManager->get(QNetworkRequest(scriptURL));
     
-    qDebug() << "Downloading script at" << scriptURLString << "\n";
+    qDebug() << "Downloading script at" << scriptURL.toString() << "\n";
     
     QEventLoop loop;
     QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
@@ -74,42 +170,18 @@ void Agent::run() {
     loop.exec();
     
     QString scriptContents(reply->readAll());
-    QScriptEngine engine;
-    
-    // register meta-type for glm::vec3 conversions
-    registerMetaTypes(&engine);
-    
-    QScriptValue agentValue = engine.newQObject(this);
-    engine.globalObject().setProperty("Agent", agentValue);
     
-    QScriptValue voxelScripterValue =  engine.newQObject(&_voxelScriptingInterface);
-    engine.globalObject().setProperty("Voxels", voxelScripterValue);
-
-    QScriptValue particleScripterValue =  engine.newQObject(&_particleScriptingInterface);
-    engine.globalObject().setProperty("Particles", particleScripterValue);
+    // running on its own, the agent has its own packet senders and jurisdiction listeners
+    _voxelScriptingInterface = new VoxelScriptingInterface();
+    _particleScriptingInterface = new ParticleScriptingInterface();
     
-    QScriptValue treeScaleValue = engine.newVariant(QVariant(TREE_SCALE));
-    engine.globalObject().setProperty("TREE_SCALE", treeScaleValue);
+    evaluateScript(scriptContents);
     
-    const unsigned int VISUAL_DATA_CALLBACK_USECS = (1.0 / 60.0) * 1000 * 1000;
+    // let the VoxelPacketSender know how frequently we plan to call it, now that the script has picked its frame rate
+    _voxelScriptingInterface->getVoxelPacketSender()->setProcessCallIntervalHint(getFrameUsecs());
+    _particleScriptingInterface->getParticlePacketSender()->setProcessCallIntervalHint(getFrameUsecs());
     
-    // let the VoxelPacketSender know how frequently we plan to call it
-    _voxelScriptingInterface.getVoxelPacketSender()->setProcessCallIntervalHint(VISUAL_DATA_CALLBACK_USECS);
-    _particleScriptingInterface.getParticlePacketSender()->setProcessCallIntervalHint(VISUAL_DATA_CALLBACK_USECS);
-    
-    qDebug() << "Downloaded script:" << scriptContents << "\n";
-    QScriptValue result = engine.evaluate(scriptContents);
-    qDebug() << "Evaluated script.\n";
-    
-    if (engine.hasUncaughtException()) {
-        int line = engine.uncaughtExceptionLineNumber();
-        qDebug() << "Uncaught exception at line" << line << ":" << result.toString() << "\n";
-    }
-    
-    timeval startTime;
-    gettimeofday(&startTime, NULL);
-    
-    int thisFrame = 0;
+    _nextFrameUsecs = usecTimestampNow();
     
     QTimer* domainServerTimer = new QTimer(this);
     connect(domainServerTimer, SIGNAL(timeout()), this, SLOT(checkInWithDomainServerOrExit()));
@@ -123,9 +195,17 @@ void Agent::run() {
     connect(pingNodesTimer, SIGNAL(timeout()), nodeList, SLOT(pingInactiveNodes()));
     pingNodesTimer->start(PING_INACTIVE_NODE_INTERVAL_USECS / 1000);
     
+    QTimer* reliableResendTimer = new QTimer(this);
+    connect(reliableResendTimer, SIGNAL(timeout()), nodeList, SLOT(resendReliableMessages()));
+    reliableResendTimer->start(RELIABLE_RESEND_INTERVAL_USECS / 1000);
+    
+    QTimer* frameStatsTimer = new QTimer(this);
+    connect(frameStatsTimer, SIGNAL(timeout()), this, SLOT(sendFrameStats()));
+    frameStatsTimer->start(SCRIPT_FRAME_STATS_REPORT_USECS / 1000);
+    
     while (!_isFinished) {
         
-        int usecToSleep = usecTimestamp(&startTime) + (thisFrame++ * VISUAL_DATA_CALLBACK_USECS) - usecTimestampNow();
+        int usecToSleep = _nextFrameUsecs - usecTimestampNow();
         if (usecToSleep > 0) {
             usleep(usecToSleep);
         }
@@ -134,38 +214,32 @@ void Agent::run() {
         
         bool willSendVisualDataCallBack = false;
         
-        if (_voxelScriptingInterface.getVoxelPacketSender()->voxelServersExist()) {            
+        if (_voxelScriptingInterface->getVoxelPacketSender()->voxelServersExist()) {            
             // allow the scripter's call back to setup visual data
             willSendVisualDataCallBack = true;
             
             // release the queue of edit voxel messages.
-            _voxelScriptingInterface.getVoxelPacketSender()->releaseQueuedMessages();
+            _voxelScriptingInterface->getVoxelPacketSender()->releaseQueuedMessages();
             
             // since we're in non-threaded mode, call process so that the packets are sent
-            _voxelScriptingInterface.getVoxelPacketSender()->process();
+            _voxelScriptingInterface->getVoxelPacketSender()->process();
         }
 
-        if (_particleScriptingInterface.getParticlePacketSender()->serversExist()) {
+        if (_particleScriptingInterface->getParticlePacketSender()->serversExist()) {
             // allow the scripter's call back to setup visual data
             willSendVisualDataCallBack = true;
             
             // release the queue of edit voxel messages.
-            _particleScriptingInterface.getParticlePacketSender()->releaseQueuedMessages();
+            _particleScriptingInterface->getParticlePacketSender()->releaseQueuedMessages();
             
             // since we're in non-threaded mode, call process so that the packets are sent
-            _particleScriptingInterface.getParticlePacketSender()->process();
+            _particleScriptingInterface->getParticlePacketSender()->process();
         }
         
         if (willSendVisualDataCallBack) {
-            emit willSendVisualDataCallback();
+            sendVisualData();
         }
-
-        
-        if (engine.hasUncaughtException()) {
-            int line = engine.uncaughtExceptionLineNumber();
-            qDebug() << "Uncaught exception at line" << line << ":" << engine.uncaughtException().toString() << "\n";
-        }
-        
         
+        advanceFrame(usecTimestampNow());
     }
 }
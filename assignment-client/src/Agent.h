@@ -15,26 +15,74 @@
 #include <QtCore/QObject>
 #include <QtCore/QUrl>
 
+#include <ScriptFrameStats.h>
 #include <ThreadedAssignment.h>
 
 #include <VoxelScriptingInterface.h>
 #include <ParticleScriptingInterface.h>
 
+const float AGENT_DEFAULT_FRAMES_PER_SECOND = 60.0f;
+const float AGENT_MIN_FRAMES_PER_SECOND = 1.0f;
+const float AGENT_MAX_FRAMES_PER_SECOND = 120.0f;
+
 class Agent : public ThreadedAssignment {
     Q_OBJECT
+    
+    /// how often the script wants its willSendVisualDataCallback, clamped to the min and max frame rates
+    Q_PROPERTY(float framesPerSecond READ getFramesPerSecond WRITE setFramesPerSecond)
+    
+    /// when set, frames the script falls behind on are skipped instead of run back to back to catch up
+    Q_PROPERTY(bool shedsOverrunFrames READ getShedsOverrunFrames WRITE setShedsOverrunFrames)
 public:
     Agent(const unsigned char* dataBuffer, int numBytes);
+    ~Agent();
+    
+    /// where the domain-server serves the script for this agent
+    QUrl getScriptURL() const;
+    
+    /// Evaluates the script in an engine of its own, queueing its edits with packet senders shared with other scripts.
+    /// Used when the agent is run by an AgentHost instead of run(), which then calls sendVisualData() from the same thread
+    /// on each of its frames that the script is due for. A hosted script runs at no more than the host's frame rate.
+    void startHostedScript(const QString& scriptContents, VoxelEditPacketSender* voxelPacketSender,
+                           ParticleEditPacketSender* particlePacketSender);
+    
+    float getFramesPerSecond() const { return _framesPerSecond; }
+    void setFramesPerSecond(float framesPerSecond);
+    
+    bool getShedsOverrunFrames() const { return _shedsOverrunFrames; }
+    void setShedsOverrunFrames(bool shedsOverrunFrames) { _shedsOverrunFrames = shedsOverrunFrames; }
+    
+    uint64_t getFrameUsecs() const;
+    bool isFrameDue(uint64_t now) const { return now >= _nextFrameUsecs; }
+    
+    /// gives the script its chance to set up visual data for this frame, timing how long it takes
+    void sendVisualData();
+    
+    /// schedules the script's next frame, skipping those it has fallen behind on if it sheds overrun frames
+    void advanceFrame(uint64_t now);
     
 public slots:
     void run();
     
+    /// reports the timing of the script's frames to the domain-server
+    void sendFrameStats();
+    
     void processDatagram(const QByteArray& dataByteArray, const HifiSockAddr& senderSockAddr);
 signals:
     void willSendAudioDataCallback();
     void willSendVisualDataCallback();
 private:
-    VoxelScriptingInterface _voxelScriptingInterface;
-    ParticleScriptingInterface _particleScriptingInterface;
+    void evaluateScript(const QString& scriptContents);
+    void reportUncaughtException();
+    
+    QScriptEngine* _scriptEngine;
+    VoxelScriptingInterface* _voxelScriptingInterface;
+    ParticleScriptingInterface* _particleScriptingInterface;
+    
+    float _framesPerSecond;
+    bool _shedsOverrunFrames;
+    uint64_t _nextFrameUsecs;
+    ScriptFrameStats _frameStats;
 };
 
 #endif /* defined(__hifi__Agent__) */
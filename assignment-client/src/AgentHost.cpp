@@ -0,0 +1,201 @@
+//
+//  AgentHost.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <algorithm>
+
+#include <QtNetwork/QNetworkRequest>
+
+#include <NodeList.h>
+
+#include "AgentHost.h"
+
+AgentHostWorker::AgentHostWorker(NodeToJurisdictionMap* voxelServerJurisdictions,
+                                 NodeToJurisdictionMap* particleServerJurisdictions) :
+    _voxelPacketSender(),
+    _particlePacketSender(),
+    _agents(),
+    _frameTimer(NULL),
+    _frameStatsTimer(NULL)
+{
+    _voxelPacketSender.setVoxelServerJurisdictions(voxelServerJurisdictions);
+    _particlePacketSender.setServerJurisdictions(particleServerJurisdictions);
+    
+    // let the packet senders know how frequently we plan to call them
+    _voxelPacketSender.setProcessCallIntervalHint(AGENT_HOST_FRAME_USECS);
+    _particlePacketSender.setProcessCallIntervalHint(AGENT_HOST_FRAME_USECS);
+}
+
+AgentHostWorker::~AgentHostWorker() {
+    for (int i = 0; i < _agents.size(); i++) {
+        delete _agents[i];
+    }
+}
+
+void AgentHostWorker::startAgent(QObject* agent, const QString& scriptContents) {
+    Agent* hostedAgent = static_cast<Agent*>(agent);
+    _agents.push_back(hostedAgent);
+    
+    // each script gets an engine of its own, but queues its edits with the packet senders of this worker
+    hostedAgent->startHostedScript(scriptContents, &_voxelPacketSender, &_particlePacketSender);
+    
+    if (!_frameTimer) {
+        // the timer is made here so that it belongs to the worker's thread
+        _frameTimer = new QTimer(this);
+        connect(_frameTimer, SIGNAL(timeout()), SLOT(runFrame()));
+        _frameTimer->start(AGENT_HOST_FRAME_USECS / 1000);
+        
+        _frameStatsTimer = new QTimer(this);
+        connect(_frameStatsTimer, SIGNAL(timeout()), SLOT(sendFrameStats()));
+        _frameStatsTimer->start(SCRIPT_FRAME_STATS_REPORT_USECS / 1000);
+    }
+}
+
+void AgentHostWorker::runFrame() {
+    bool voxelServersExist = _voxelPacketSender.voxelServersExist();
+    bool particleServersExist = _particlePacketSender.serversExist();
+    
+    uint64_t now = usecTimestampNow();
+    for (int i = 0; i < _agents.size(); i++) {
+        // scripts that asked for a lower frame rate sit out some of the host's frames
+        if (_agents[i]->isFrameDue(now)) {
+            if (voxelServersExist || particleServersExist) {
+                // allow the script's call back to setup visual data
+                _agents[i]->sendVisualData();
+            }
+            _agents[i]->advanceFrame(usecTimestampNow());
+        }
+    }
+    
+    if (voxelServersExist) {
+        // release the edits of all the scripts together, so they're packed into as few packets as possible
+        _voxelPacketSender.releaseQueuedMessages();
+        
+        // since we're in non-threaded mode, call process so that the packets are sent
+        _voxelPacketSender.process();
+    }
+    
+    if (particleServersExist) {
+        _particlePacketSender.releaseQueuedMessages();
+        _particlePacketSender.process();
+    }
+}
+
+void AgentHostWorker::sendFrameStats() {
+    for (int i = 0; i < _agents.size(); i++) {
+        _agents[i]->sendFrameStats();
+    }
+}
+
+AgentHost::AgentHost(int maxAgents, QObject* parent) :
+    QObject(parent),
+    _maxAgents(maxAgents),
+    _numAgents(0),
+    _voxelJurisdictionListener(NODE_TYPE_VOXEL_SERVER),
+    _particleJurisdictionListener(NODE_TYPE_PARTICLE_SERVER),
+    _networkManager(),
+    _downloadingAgents()
+{
+    NodeList* nodeList = NodeList::getInstance();
+    nodeList->setOwnerType(NODE_TYPE_AGENT);
+    
+    const NODE_TYPE AGENT_NODE_TYPES_OF_INTEREST[] = { NODE_TYPE_VOXEL_SERVER, NODE_TYPE_PARTICLE_SERVER };
+    nodeList->setNodeTypesOfInterest(AGENT_NODE_TYPES_OF_INTEREST, sizeof(AGENT_NODE_TYPES_OF_INTEREST));
+    
+    _voxelJurisdictionListener.initialize(true);
+    _particleJurisdictionListener.initialize(true);
+    
+    // no more workers than there are cores, or than there could be scripts
+    int numWorkers = std::max(1, std::min(QThread::idealThreadCount(), maxAgents));
+    
+    for (int i = 0; i < numWorkers; i++) {
+        QThread* workerThread = new QThread(this);
+        AgentHostWorker* worker = new AgentHostWorker(_voxelJurisdictionListener.getJurisdictions(),
+                                                      _particleJurisdictionListener.getJurisdictions());
+        worker->moveToThread(workerThread);
+        
+        // the worker, and the agents it runs, are deleted by their own thread as it finishes
+        connect(workerThread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+        
+        workerThread->start();
+        
+        _workerThreads.push_back(workerThread);
+        _workers.push_back(worker);
+        _numAgentsPerWorker.push_back(0);
+    }
+    
+    // the one set of timers for all of the agents
+    QTimer* domainServerTimer = new QTimer(this);
+    connect(domainServerTimer, SIGNAL(timeout()), this, SLOT(checkInWithDomainServerOrExit()));
+    domainServerTimer->start(DOMAIN_SERVER_CHECK_IN_USECS / 1000);
+    
+    QTimer* silentNodeTimer = new QTimer(this);
+    connect(silentNodeTimer, SIGNAL(timeout()), nodeList, SLOT(removeSilentNodes()));
+    silentNodeTimer->start(NODE_SILENCE_THRESHOLD_USECS / 1000);
+    
+    QTimer* pingNodesTimer = new QTimer(this);
+    connect(pingNodesTimer, SIGNAL(timeout()), nodeList, SLOT(pingInactiveNodes()));
+    pingNodesTimer->start(PING_INACTIVE_NODE_INTERVAL_USECS / 1000);
+    
+    QTimer* reliableResendTimer = new QTimer(this);
+    connect(reliableResendTimer, SIGNAL(timeout()), nodeList, SLOT(resendReliableMessages()));
+    reliableResendTimer->start(RELIABLE_RESEND_INTERVAL_USECS / 1000);
+}
+
+AgentHost::~AgentHost() {
+    for (int i = 0; i < _workerThreads.size(); i++) {
+        _workerThreads[i]->quit();
+        _workerThreads[i]->wait();
+    }
+    
+    // the agents whose scripts never arrived are still ours
+    for (QHash<QNetworkReply*, Agent*>::iterator agent = _downloadingAgents.begin();
+         agent != _downloadingAgents.end(); ++agent) {
+        delete agent.value();
+    }
+}
+
+void AgentHost::addAgent(Agent* agent) {
+    _numAgents++;
+    
+    qDebug() << "Downloading script at" << agent->getScriptURL().toString() << "\n";
+    
+    QNetworkReply* reply = _networkManager.get(QNetworkRequest(agent->getScriptURL()));
+    _downloadingAgents.insert(reply, agent);
+    connect(reply, SIGNAL(finished()), SLOT(scriptDownloaded()));
+}
+
+void AgentHost::scriptDownloaded() {
+    QNetworkReply* reply = static_cast<QNetworkReply*>(sender());
+    Agent* agent = _downloadingAgents.take(reply);
+    QString scriptContents(reply->readAll());
+    reply->deleteLater();
+    
+    int leastBusyWorker = 0;
+    for (int i = 1; i < _workers.size(); i++) {
+        if (_numAgentsPerWorker[i] < _numAgentsPerWorker[leastBusyWorker]) {
+            leastBusyWorker = i;
+        }
+    }
+    _numAgentsPerWorker[leastBusyWorker]++;
+    
+    // from now on the agent and its script engine are only touched by the worker's thread
+    agent->moveToThread(_workerThreads[leastBusyWorker]);
+    QMetaObject::invokeMethod(_workers[leastBusyWorker], "startAgent", Qt::QueuedConnection,
+                              Q_ARG(QObject*, agent), Q_ARG(QString, scriptContents));
+}
+
+void AgentHost::processDatagram(const QByteArray& dataByteArray, const HifiSockAddr& senderSockAddr) {
+    NodeList::getInstance()->processNodeData(senderSockAddr, (unsigned char*) dataByteArray.data(), dataByteArray.size());
+}
+
+void AgentHost::checkInWithDomainServerOrExit() {
+    if (NodeList::getInstance()->getNumNoReplyDomainCheckIns() == MAX_SILENT_DOMAIN_SERVER_CHECK_INS) {
+        emit finished();
+    } else {
+        NodeList::getInstance()->sendDomainServerCheckIn();
+    }
+}
@@ -0,0 +1,96 @@
+//
+//  AgentHost.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__AgentHost__
+#define __hifi__AgentHost__
+
+#include <vector>
+
+#include <QtCore/QHash>
+#include <QtCore/QObject>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+#include <QtNetwork/QNetworkAccessManager>
+#include <QtNetwork/QNetworkReply>
+
+#include <JurisdictionListener.h>
+#include <ParticleEditPacketSender.h>
+#include <VoxelEditPacketSender.h>
+
+#include "Agent.h"
+
+const unsigned int AGENT_HOST_FRAME_USECS = (1.0 / 60.0) * 1000 * 1000;
+
+/// Runs the scripts of some of an AgentHost's agents on one thread. Every frame it lets each script that is due set up its
+/// visual data and then releases the edits they all queued, so the edits of its scripts share packets.
+class AgentHostWorker : public QObject {
+    Q_OBJECT
+public:
+    AgentHostWorker(NodeToJurisdictionMap* voxelServerJurisdictions, NodeToJurisdictionMap* particleServerJurisdictions);
+    ~AgentHostWorker();
+
+public slots:
+    /// takes ownership of the agent, which must already have been moved to this worker's thread
+    void startAgent(QObject* agent, const QString& scriptContents);
+
+private slots:
+    void runFrame();
+    void sendFrameStats();
+
+private:
+    VoxelEditPacketSender _voxelPacketSender;
+    ParticleEditPacketSender _particlePacketSender;
+    std::vector<Agent*> _agents;
+    QTimer* _frameTimer;
+    QTimer* _frameStatsTimer;
+};
+
+/// Runs the scripts of up to maxAgents Agent assignments in one assignment-client, instead of each one needing a process,
+/// socket and domain-server check-in of its own. The scripts share the NodeList and one JurisdictionListener for each
+/// type of octree server, and are spread over a fixed pool of AgentHostWorker threads. Each script still has a script
+/// engine and Voxels and Particles objects of its own.
+class AgentHost : public QObject {
+    Q_OBJECT
+public:
+    AgentHost(int maxAgents, QObject* parent = NULL);
+    ~AgentHost();
+    
+    int getNumAgents() const { return _numAgents; }
+    bool isFull() const { return _numAgents >= _maxAgents; }
+    
+    /// takes ownership of the agent, downloads its script and starts it on the worker running the fewest scripts
+    void addAgent(Agent* agent);
+
+public slots:
+    /// handles a datagram for the hosted agents - they share the NodeList, and the jurisdiction listeners it passes the
+    /// octree servers' jurisdictions to, so it is processed once for all of them
+    void processDatagram(const QByteArray& dataByteArray, const HifiSockAddr& senderSockAddr);
+
+signals:
+    /// the domain-server stopped answering, so all of the agents are done
+    void finished();
+
+private slots:
+    void scriptDownloaded();
+    void checkInWithDomainServerOrExit();
+
+private:
+    int _maxAgents;
+    int _numAgents;
+    
+    JurisdictionListener _voxelJurisdictionListener;
+    JurisdictionListener _particleJurisdictionListener;
+    
+    QNetworkAccessManager _networkManager;
+    QHash<QNetworkReply*, Agent*> _downloadingAgents;
+    
+    std::vector<QThread*> _workerThreads;
+    std::vector<AgentHostWorker*> _workers;
+    std::vector<int> _numAgentsPerWorker;
+};
+
+#endif /* defined(__hifi__AgentHost__) */
@@ -25,10 +25,15 @@ const long long ASSIGNMENT_REQUEST_INTERVAL_MSECS = 1 * 1000;
 AssignmentClient::AssignmentClient(int &argc, char **argv,
                                    Assignment::Type requestAssignmentType,
                                    const HifiSockAddr& customAssignmentServerSocket,
-                                   const char* requestAssignmentPool) :
+                                   const char* requestAssignmentPool,
+                                   int maxHostedAgents) :
     QCoreApplication(argc, argv),
-    _requestAssignment(Assignment::RequestCommand, requestAssignmentType, requestAssignmentPool),
-    _currentAssignment(NULL)
+    _requestAssignment(Assignment::RequestCommand,
+                       maxHostedAgents > 1 ? Assignment::AgentType : requestAssignmentType,
+                       requestAssignmentPool),
+    _currentAssignment(NULL),
+    _maxHostedAgents(maxHostedAgents),
+    _agentHost(NULL)
 {
     // register meta type is required for queued invoke method on Assignment subclasses
     qRegisterMetaType<HifiSockAddr>("HifiSockAddr");
@@ -56,7 +61,7 @@ AssignmentClient::AssignmentClient(int &argc, char **argv,
 }
 
 void AssignmentClient::sendAssignmentRequest() {
-    if (!_currentAssignment) {
+    if (!_currentAssignment && (!_agentHost || !_agentHost->isFull())) {
         NodeList::getInstance()->sendAssignment(_requestAssignment);
     }
 }
@@ -64,64 +69,101 @@ void AssignmentClient::sendAssignmentRequest() {
 void AssignmentClient::readPendingDatagrams() {
     NodeList* nodeList = NodeList::getInstance();
     
-    static unsigned char packetData[1500];
-    static qint64 receivedBytes = 0;
-    static HifiSockAddr senderSockAddr;
+    BatchedUdpSocket& batchedNodeSocket = nodeList->getBatchedNodeSocket();
+    int numDatagrams = 0;
     
-    while (nodeList->getNodeSocket().hasPendingDatagrams()) {
+    do {
+        numDatagrams = batchedNodeSocket.readPendingDatagrams();
         
-        if ((receivedBytes = nodeList->getNodeSocket().readDatagram((char*) packetData, MAX_PACKET_SIZE,
-                                                                    senderSockAddr.getAddressPointer(),
-                                                                    senderSockAddr.getPortPointer()))
-            && packetVersionMatch(packetData)) {
+        for (int datagramIndex = 0; datagramIndex < numDatagrams; datagramIndex++) {
+            const ReceivedDatagram& datagram = batchedNodeSocket.getReceivedDatagram(datagramIndex);
             
-            if (_currentAssignment) {
-                // have the threaded current assignment handle this datagram
-                QMetaObject::invokeMethod(_currentAssignment, "processDatagram", Qt::QueuedConnection,
-                                          Q_ARG(QByteArray, QByteArray((char*) packetData, receivedBytes)),
-                                          Q_ARG(HifiSockAddr, senderSockAddr));
-            } else if (packetData[0] == PACKET_TYPE_DEPLOY_ASSIGNMENT || packetData[0] == PACKET_TYPE_CREATE_ASSIGNMENT) {
-                
+            unsigned char* packetData = datagram.data;
+            int receivedBytes = datagram.size;
+            const HifiSockAddr& senderSockAddr = datagram.senderSockAddr;
+            
+            if (packetVersionMatch(packetData)) {
                 if (_currentAssignment) {
-                    qDebug() << "Dropping received assignment since we are currently running one.\n";
-                } else {
-                    // construct the deployed assignment from the packet data
-                    _currentAssignment = AssignmentFactory::unpackAssignment(packetData, receivedBytes);
-                    
-                    qDebug() << "Received an assignment -" << *_currentAssignment << "\n";
+                    // have the threaded current assignment handle this datagram
+                    QMetaObject::invokeMethod(_currentAssignment, "processDatagram", Qt::QueuedConnection,
+                                              Q_ARG(QByteArray, QByteArray((char*) packetData, receivedBytes)),
+                                              Q_ARG(HifiSockAddr, senderSockAddr));
+                } else if (packetData[0] == PACKET_TYPE_DEPLOY_ASSIGNMENT || packetData[0] == PACKET_TYPE_CREATE_ASSIGNMENT) {
                     
-                    // switch our nodelist domain IP and port to whoever sent us the assignment
-                    if (packetData[0] == PACKET_TYPE_CREATE_ASSIGNMENT) {
-                        nodeList->setDomainSockAddr(senderSockAddr);
-                        nodeList->setOwnerUUID(_currentAssignment->getUUID());
-                        
-                        qDebug("Destination IP for assignment is %s\n",
-                               nodeList->getDomainIP().toString().toStdString().c_str());
-                        
-                        // start the deployed assignment
-                        QThread* workerThread = new QThread(this);
-                        
-                        connect(workerThread, SIGNAL(started()), _currentAssignment, SLOT(run()));
-                        
-                        connect(_currentAssignment, SIGNAL(finished()), this, SLOT(assignmentCompleted()));
-                        connect(_currentAssignment, SIGNAL(finished()), workerThread, SLOT(quit()));
-                        connect(_currentAssignment, SIGNAL(finished()), _currentAssignment, SLOT(deleteLater()));
-                        connect(workerThread, SIGNAL(finished()), workerThread, SLOT(deleteLater()));
+                    if (_currentAssignment) {
+                        qDebug() << "Dropping received assignment since we are currently running one.\n";
+                    } else {
+                        // construct the deployed assignment from the packet data
+                        ThreadedAssignment* receivedAssignment = AssignmentFactory::unpackAssignment(packetData,
+                                                                                                    receivedBytes);
                         
-                        _currentAssignment->moveToThread(workerThread);
+                        qDebug() << "Received an assignment -" << *receivedAssignment << "\n";
                         
-                        // Starts an event loop, and emits workerThread->started()
-                        workerThread->start();
-                    } else {
-                        qDebug("Received a bad destination socket for assignment.\n");
+                        // switch our nodelist domain IP and port to whoever sent us the assignment
+                        if (packetData[0] == PACKET_TYPE_CREATE_ASSIGNMENT) {
+                            nodeList->setDomainSockAddr(senderSockAddr);
+                            
+                            qDebug("Destination IP for assignment is %s\n",
+                                   nodeList->getDomainIP().toString().toStdString().c_str());
+                            
+                            if (_maxHostedAgents > 1 && receivedAssignment->getType() == Assignment::AgentType) {
+                                hostAgent(static_cast<Agent*>(receivedAssignment));
+                                continue;
+                            }
+                            
+                            _currentAssignment = receivedAssignment;
+                            nodeList->setOwnerUUID(_currentAssignment->getUUID());
+                            
+                            // start the deployed assignment
+                            QThread* workerThread = new QThread(this);
+                            
+                            connect(workerThread, SIGNAL(started()), _currentAssignment, SLOT(run()));
+                            
+                            connect(_currentAssignment, SIGNAL(finished()), this, SLOT(assignmentCompleted()));
+                            connect(_currentAssignment, SIGNAL(finished()), workerThread, SLOT(quit()));
+                            connect(_currentAssignment, SIGNAL(finished()), _currentAssignment, SLOT(deleteLater()));
+                            connect(workerThread, SIGNAL(finished()), workerThread, SLOT(deleteLater()));
+                            
+                            _currentAssignment->moveToThread(workerThread);
+                            
+                            // Starts an event loop, and emits workerThread->started()
+                            workerThread->start();
+                        } else {
+                            qDebug("Received a bad destination socket for assignment.\n");
+                            delete receivedAssignment;
+                        }
                     }
+                } else if (_agentHost) {
+                    // the host lives on this thread, so it can take the datagram without a copy
+                    _agentHost->processDatagram(QByteArray::fromRawData((char*) packetData, receivedBytes), senderSockAddr);
+                } else {
+                    // have the NodeList attempt to handle it
+                    nodeList->processNodeData(senderSockAddr, packetData, receivedBytes);
                 }
-            } else {
-                // have the NodeList attempt to handle it
-                nodeList->processNodeData(senderSockAddr, packetData, receivedBytes);
             }
         }
+    } while (numDatagrams == MAX_DATAGRAMS_PER_BATCH);
+}
+
+void AssignmentClient::hostAgent(Agent* agent) {
+    if (!_agentHost) {
+        // the process checks in with the domain-server as the first agent it hosts
+        NodeList::getInstance()->setOwnerUUID(agent->getUUID());
+        
+        _agentHost = new AgentHost(_maxHostedAgents, this);
+        connect(_agentHost, SIGNAL(finished()), this, SLOT(agentHostCompleted()));
     }
+    
+    _agentHost->addAgent(agent);
+    
+    qDebug("Hosting %d of at most %d agents\n", _agentHost->getNumAgents(), _maxHostedAgents);
+}
+
+void AssignmentClient::agentHostCompleted() {
+    _agentHost->deleteLater();
+    _agentHost = NULL;
+    
+    assignmentCompleted();
 }
 
 void AssignmentClient::assignmentCompleted() {
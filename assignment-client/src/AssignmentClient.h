@@ -11,6 +11,7 @@
 
 #include <QtCore/QCoreApplication>
 
+#include "AgentHost.h"
 #include "ThreadedAssignment.h"
 
 class AssignmentClient : public QCoreApplication {
@@ -19,14 +20,22 @@ public:
     AssignmentClient(int &argc, char **argv,
                      Assignment::Type requestAssignmentType = Assignment::AllTypes,
                      const HifiSockAddr& customAssignmentServerSocket = HifiSockAddr(),
-                     const char* requestAssignmentPool = NULL);
+                     const char* requestAssignmentPool = NULL,
+                     int maxHostedAgents = 1);
 private slots:
     void sendAssignmentRequest();
     void readPendingDatagrams();
     void assignmentCompleted();
+    void agentHostCompleted();
 private:
+    void hostAgent(Agent* agent);
+    
     Assignment _requestAssignment;
     ThreadedAssignment* _currentAssignment;
+    
+    // with more than one hosted agent allowed, agent assignments are run together by an AgentHost
+    int _maxHostedAgents;
+    AgentHost* _agentHost;
 };
 
 #endif /* defined(__hifi__AssignmentClient__) */
@@ -33,6 +33,7 @@
 #include <glm/gtx/vector_angle.hpp>
 
 #include <QtCore/QCoreApplication>
+#include <QtCore/QStringList>
 #include <QtCore/QTimer>
 
 #include <Logging.h>
@@ -51,9 +52,6 @@
 
 #include "AudioMixer.h"
 
-const short JITTER_BUFFER_MSECS = 12;
-const short JITTER_BUFFER_SAMPLES = JITTER_BUFFER_MSECS * (SAMPLE_RATE / 1000.0);
-
 const unsigned int BUFFER_SEND_INTERVAL_USECS = floorf((BUFFER_LENGTH_SAMPLES_PER_CHANNEL / (float) SAMPLE_RATE) * 1000 * 1000);
 
 const int MAX_SAMPLE_VALUE = std::numeric_limits<int16_t>::max();
@@ -61,6 +59,14 @@ const int MIN_SAMPLE_VALUE = std::numeric_limits<int16_t>::min();
 
 const char AUDIO_MIXER_LOGGING_TARGET_NAME[] = "audio-mixer";
 
+const int STREAM_STATS_INTERVAL_MSECS = 10 * 1000;
+
+const char AUDIO_REGION_OPTION[] = "--region";
+const int REGION_BROADCAST_INTERVAL_MSECS = 1000;
+
+// a far-field stream is never treated as a point source, since that would bring in off-axis attenuation
+const float MIN_FAR_FIELD_RADIUS = 0.01f;
+
 void attachNewBufferToNode(Node *newNode) {
     if (!newNode->getLinkedData()) {
         newNode->setLinkedData(new AudioMixerClientData());
@@ -68,9 +74,13 @@ void attachNewBufferToNode(Node *newNode) {
 }
 
 AudioMixer::AudioMixer(const unsigned char* dataBuffer, int numBytes) :
-    ThreadedAssignment(dataBuffer, numBytes)
+    ThreadedAssignment(dataBuffer, numBytes),
+    _region(),
+    _numFarFieldFramesSent(0)
 {
-    
+    for (int i = 0; i < NUM_AUDIO_REGION_OCTANTS; i++) {
+        _farFieldStreamIdentifiers[i] = QUuid::createUuid();
+    }
 }
 
 void AudioMixer::addBufferToMixForListeningNodeWithBuffer(PositionalAudioRingBuffer* bufferToAdd,
@@ -160,7 +170,8 @@ void AudioMixer::addBufferToMixForListeningNodeWithBuffer(PositionalAudioRingBuf
         }
     }
     
-    int16_t* sourceBuffer = bufferToAdd->getNextOutput();
+    // frames are written whole and the ring is a whole number of frames, so this frame is contiguous
+    const int16_t* sourceBuffer = bufferToAdd->getNextOutput();
     
     int16_t* goodChannel = (bearingRelativeAngleToSource > 0.0f)
         ? _clientSamples
@@ -169,9 +180,8 @@ void AudioMixer::addBufferToMixForListeningNodeWithBuffer(PositionalAudioRingBuf
         ? _clientSamples + BUFFER_LENGTH_SAMPLES_PER_CHANNEL
         : _clientSamples;
     
-    int16_t* delaySamplePointer = bufferToAdd->getNextOutput() == bufferToAdd->getBuffer()
-        ? bufferToAdd->getBuffer() + RING_BUFFER_LENGTH_SAMPLES - numSamplesDelay
-        : bufferToAdd->getNextOutput() - numSamplesDelay;
+    // the delayed samples come from the tail of the previous frame, which the ring buffer keeps as its guard frame
+    const int16_t* delaySamplePointer = bufferToAdd->getNextOutputWithOffset(-numSamplesDelay);
     
     for (int s = 0; s < BUFFER_LENGTH_SAMPLES_PER_CHANNEL; s++) {
         if (s < numSamplesDelay) {
@@ -193,7 +203,7 @@ void AudioMixer::addBufferToMixForListeningNodeWithBuffer(PositionalAudioRingBuf
     }
 }
 
-void AudioMixer::prepareMixForListeningNode(Node* node) {
+int AudioMixer::prepareMixForListeningNode(Node* node) {
 	NodeList* nodeList = NodeList::getInstance();
     
     AvatarAudioRingBuffer* nodeRingBuffer = ((AudioMixerClientData*) node->getLinkedData())->getAvatarAudioRingBuffer();
@@ -201,6 +211,8 @@ void AudioMixer::prepareMixForListeningNode(Node* node) {
     // zero out the client mix for this node
     memset(_clientSamples, 0, sizeof(_clientSamples));
     
+    int numBuffersMixed = 0;
+    
     // loop through all other nodes that have sufficient audio to mix
     for (NodeList::iterator otherNode = nodeList->begin(); otherNode != nodeList->end(); otherNode++) {
         if (otherNode->getLinkedData()) {
@@ -216,13 +228,146 @@ void AudioMixer::prepareMixForListeningNode(Node* node) {
                      || nodeRingBuffer->shouldLoopbackForNode())
                     && otherNodeBuffer->willBeAddedToMix()) {
                     addBufferToMixForListeningNodeWithBuffer(otherNodeBuffer, nodeRingBuffer);
+                    numBuffersMixed++;
                 }
             }
         }
     }
+    
+    return numBuffersMixed;
 }
 
 
+void AudioMixer::sendFarFieldStreams() {
+    NodeList* nodeList = NodeList::getInstance();
+    
+    float octantWeights[NUM_AUDIO_REGION_OCTANTS];
+    glm::vec3 octantPositionSums[NUM_AUDIO_REGION_OCTANTS];
+    glm::vec3 octantMinimums[NUM_AUDIO_REGION_OCTANTS];
+    glm::vec3 octantMaximums[NUM_AUDIO_REGION_OCTANTS];
+    int octantNumSources[NUM_AUDIO_REGION_OCTANTS];
+    
+    memset(_farFieldSamples, 0, sizeof(_farFieldSamples));
+    memset(octantNumSources, 0, sizeof(octantNumSources));
+    
+    for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
+        // far-field streams we got from our peers are never passed on, or the mixers would echo each other
+        if (node->getLinkedData() && node->getType() != NODE_TYPE_AUDIO_MIXER) {
+            AudioMixerClientData* clientData = (AudioMixerClientData*) node->getLinkedData();
+            
+            for (int i = 0; i < clientData->getRingBuffers().size(); i++) {
+                PositionalAudioRingBuffer* sourceBuffer = clientData->getRingBuffers()[i];
+                
+                if (!sourceBuffer->willBeAddedToMix()) {
+                    continue;
+                }
+                
+                float attenuationCoefficient = (sourceBuffer->getType() == PositionalAudioRingBuffer::Injector)
+                    ? ((InjectedAudioRingBuffer*) sourceBuffer)->getAttenuationRatio() : 1.0f;
+                
+                int octant = _region.octantForPoint(sourceBuffer->getPosition());
+                int16_t* farFieldSamples = _farFieldSamples[octant];
+                const int16_t* sourceSamples = sourceBuffer->getNextOutput();
+                
+                for (int s = 0; s < BUFFER_LENGTH_SAMPLES_PER_CHANNEL; s++) {
+                    int sumSample = farFieldSamples[s] + (int) (sourceSamples[s] * attenuationCoefficient);
+                    farFieldSamples[s] = glm::clamp(sumSample, MIN_SAMPLE_VALUE, MAX_SAMPLE_VALUE);
+                }
+                
+                // the stream sits at the loudness weighted centre of its sources, so the talker dominates placement
+                float weight = 1.0f + sourceBuffer->getNextOutputLoudness(BUFFER_LENGTH_SAMPLES_PER_CHANNEL)
+                    * attenuationCoefficient;
+                
+                if (octantNumSources[octant] == 0) {
+                    octantWeights[octant] = 0.0f;
+                    octantPositionSums[octant] = glm::vec3(0.0f, 0.0f, 0.0f);
+                    octantMinimums[octant] = octantMaximums[octant] = sourceBuffer->getPosition();
+                } else {
+                    octantMinimums[octant] = glm::min(octantMinimums[octant], sourceBuffer->getPosition());
+                    octantMaximums[octant] = glm::max(octantMaximums[octant], sourceBuffer->getPosition());
+                }
+                
+                octantWeights[octant] += weight;
+                octantPositionSums[octant] += sourceBuffer->getPosition() * weight;
+                octantNumSources[octant]++;
+            }
+        }
+    }
+    
+    static unsigned char farFieldPacket[MAX_PACKET_SIZE];
+    
+    unsigned char* streamIdentifierStart = farFieldPacket + populateTypeAndVersion(farFieldPacket, PACKET_TYPE_INJECT_AUDIO);
+    
+    // the far-field streams come from us, so peers file them under our node as injected streams
+    QByteArray rfcUUID = nodeList->getOwnerUUID().toRfc4122();
+    memcpy(streamIdentifierStart, rfcUUID.constData(), rfcUUID.size());
+    streamIdentifierStart += rfcUUID.size();
+    
+    const glm::quat FAR_FIELD_ORIENTATION = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    const unsigned char FAR_FIELD_ATTENUATION_BYTE = 255;
+    
+    for (int octant = 0; octant < NUM_AUDIO_REGION_OCTANTS; octant++) {
+        if (octantNumSources[octant] == 0) {
+            // nothing to say from this octant, the stream on our peers will starve and be removed
+            continue;
+        }
+        
+        unsigned char* currentPacketPtr = streamIdentifierStart;
+        
+        QByteArray rfcStreamIdentifier = _farFieldStreamIdentifiers[octant].toRfc4122();
+        memcpy(currentPacketPtr, rfcStreamIdentifier.constData(), rfcStreamIdentifier.size());
+        currentPacketPtr += rfcStreamIdentifier.size();
+        
+        glm::vec3 streamPosition = octantPositionSums[octant] / octantWeights[octant];
+        memcpy(currentPacketPtr, &streamPosition, sizeof(streamPosition));
+        currentPacketPtr += sizeof(streamPosition);
+        
+        memcpy(currentPacketPtr, &FAR_FIELD_ORIENTATION, sizeof(FAR_FIELD_ORIENTATION));
+        currentPacketPtr += sizeof(FAR_FIELD_ORIENTATION);
+        
+        // the radius covers the spread of the sources, so a listener outside it hears them attenuated as a group
+        float streamRadius = std::max(MIN_FAR_FIELD_RADIUS,
+                                      glm::distance(octantMinimums[octant], octantMaximums[octant]) / 2.0f);
+        memcpy(currentPacketPtr, &streamRadius, sizeof(streamRadius));
+        currentPacketPtr += sizeof(streamRadius);
+        
+        *currentPacketPtr++ = FAR_FIELD_ATTENUATION_BYTE;
+        
+        memcpy(currentPacketPtr, _farFieldSamples[octant], BUFFER_LENGTH_BYTES_PER_CHANNEL);
+        currentPacketPtr += BUFFER_LENGTH_BYTES_PER_CHANNEL;
+        
+        for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
+            if (node->getType() == NODE_TYPE_AUDIO_MIXER && node->getActiveSocket()) {
+                nodeList->getBatchedNodeSocket().queueDatagram((char*) farFieldPacket, currentPacketPtr - farFieldPacket,
+                                                               *node->getActiveSocket());
+            }
+        }
+        
+        _numFarFieldFramesSent++;
+    }
+}
+
+void AudioMixer::sendRegionToAgents() {
+    NodeList* nodeList = NodeList::getInstance();
+    
+    static unsigned char regionPacket[MAX_PACKET_SIZE];
+    unsigned char* currentPacketPtr = regionPacket + populateTypeAndVersion(regionPacket, PACKET_TYPE_AUDIO_MIXER_REGION);
+    
+    QByteArray rfcUUID = nodeList->getOwnerUUID().toRfc4122();
+    memcpy(currentPacketPtr, rfcUUID.constData(), rfcUUID.size());
+    currentPacketPtr += rfcUUID.size();
+    
+    currentPacketPtr += _region.packToBuffer(currentPacketPtr);
+    
+    // these go out with the next frame's flush
+    for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
+        if (node->getType() == NODE_TYPE_AGENT && node->getActiveSocket()) {
+            nodeList->getBatchedNodeSocket().queueDatagram((char*) regionPacket, currentPacketPtr - regionPacket,
+                                                           *node->getActiveSocket());
+        }
+    }
+}
+
 void AudioMixer::processDatagram(const QByteArray& dataByteArray, const HifiSockAddr& senderSockAddr) {
     // pull any new audio data from nodes off of the network stack
     if (dataByteArray[0] == PACKET_TYPE_MICROPHONE_AUDIO_NO_ECHO
@@ -250,6 +395,69 @@ void AudioMixer::processDatagram(const QByteArray& dataByteArray, const HifiSock
     }
 }
 
+void AudioMixer::sendStreamStats() {
+    NodeList* nodeList = NodeList::getInstance();
+    
+    for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
+        if (node->getLinkedData()) {
+            AudioMixerClientData* clientData = (AudioMixerClientData*) node->getLinkedData();
+            
+            for (int i = 0; i < clientData->getRingBuffers().size(); i++) {
+                PositionalAudioRingBuffer* ringBuffer = clientData->getRingBuffers()[i];
+                const AdaptiveJitterBuffer& jitterBuffer = ringBuffer->getJitterBuffer();
+                
+                QString streamName = node->getUUID().toString().mid(1, 36);
+                
+                if (ringBuffer->getType() == PositionalAudioRingBuffer::Injector) {
+                    streamName += "." + ((InjectedAudioRingBuffer*) ringBuffer)->getStreamIdentifier().toString().mid(1, 36);
+                }
+                
+                qDebug() << "Stream" << streamName << "- jitter" << jitterBuffer.getJitterMsecs()
+                    << "ms, target depth" << jitterBuffer.getTargetMsecs() << "ms, current depth"
+                    << ringBuffer->samplesAvailable() << "samples, starves" << jitterBuffer.getNumStarves()
+                    << ", dropped frames" << jitterBuffer.getNumFramesDropped()
+                    << ", concealed frames" << ringBuffer->getNumConcealedFrames() << "\n";
+                
+                if (Logging::shouldSendStats()) {
+                    QString statPrefix = QString("%1.%2.").arg(AUDIO_MIXER_LOGGING_TARGET_NAME, streamName);
+                    
+                    Logging::stashValue(STAT_TYPE_GAUGE, (statPrefix + "jitter-target-msecs").toLocal8Bit().constData(),
+                                        jitterBuffer.getTargetMsecs());
+                    Logging::stashValue(STAT_TYPE_GAUGE, (statPrefix + "depth-samples").toLocal8Bit().constData(),
+                                        ringBuffer->samplesAvailable());
+                    Logging::stashValue(STAT_TYPE_GAUGE, (statPrefix + "starves").toLocal8Bit().constData(),
+                                        jitterBuffer.getNumStarves());
+                }
+            }
+            
+            if (clientData->getAvatarAudioRingBuffer()) {
+                qDebug() << "Mix for" << node->getUUID() << "- codec" << clientData->getMixedAudioCodec()
+                    << ", average encode" << clientData->getAverageEncodeUsecs() << "usecs,"
+                    << clientData->getNumSilentFramesSent() << "silent frames\n";
+                
+                if (Logging::shouldSendStats()) {
+                    QString statKey = QString("%1.%2.encode-usecs").arg(AUDIO_MIXER_LOGGING_TARGET_NAME,
+                                                                        node->getUUID().toString().mid(1, 36));
+                    Logging::stashValue(STAT_TYPE_TIMER, statKey.toLocal8Bit().constData(),
+                                        clientData->getAverageEncodeUsecs());
+                }
+            }
+        }
+    }
+    
+    if (_region.isValid()) {
+        qDebug() << "Sent" << _numFarFieldFramesSent << "far-field frames to peer mixers\n";
+        
+        if (Logging::shouldSendStats()) {
+            Logging::stashValue(STAT_TYPE_COUNTER,
+                                QString("%1.far-field-frames").arg(AUDIO_MIXER_LOGGING_TARGET_NAME).toLocal8Bit().constData(),
+                                _numFarFieldFramesSent);
+        }
+        
+        _numFarFieldFramesSent = 0;
+    }
+}
+
 void AudioMixer::run() {
     
     NodeList* nodeList = NodeList::getInstance();
@@ -259,8 +467,36 @@ void AudioMixer::run() {
     
     nodeList->setOwnerType(NODE_TYPE_AUDIO_MIXER);
     
-    const char AUDIO_MIXER_NODE_TYPES_OF_INTEREST[2] = { NODE_TYPE_AGENT, NODE_TYPE_AUDIO_INJECTOR };
-    nodeList->setNodeTypesOfInterest(AUDIO_MIXER_NODE_TYPES_OF_INTEREST, sizeof(AUDIO_MIXER_NODE_TYPES_OF_INTEREST));
+    if (getNumPayloadBytes() > 0) {
+        // the domain-server gives each mixer in a split domain its region the way it gives voxel servers jurisdictions
+        QStringList payloadList = QString((const char*) _payload).split(" ");
+        int regionOptionIndex = payloadList.indexOf(AUDIO_REGION_OPTION);
+        
+        if (regionOptionIndex >= 0 && regionOptionIndex + 1 < payloadList.size()) {
+            _region = AudioRegion::fromString(payloadList.at(regionOptionIndex + 1).toLocal8Bit().constData());
+        }
+    }
+    
+    if (_region.isValid()) {
+        glm::vec3 regionMinimum = _region.getMinimum();
+        glm::vec3 regionMaximum = _region.getMaximum();
+        qDebug("Mixing audio for region (%f, %f, %f) to (%f, %f, %f)\n",
+               regionMinimum.x, regionMinimum.y, regionMinimum.z, regionMaximum.x, regionMaximum.y, regionMaximum.z);
+        
+        // we'll need to hear about the other mixers so we can swap far-field streams with them
+        const char REGIONAL_AUDIO_MIXER_NODE_TYPES_OF_INTEREST[3] = {
+            NODE_TYPE_AGENT, NODE_TYPE_AUDIO_INJECTOR, NODE_TYPE_AUDIO_MIXER
+        };
+        nodeList->setNodeTypesOfInterest(REGIONAL_AUDIO_MIXER_NODE_TYPES_OF_INTEREST,
+                                         sizeof(REGIONAL_AUDIO_MIXER_NODE_TYPES_OF_INTEREST));
+        
+        QTimer* regionBroadcastTimer = new QTimer(this);
+        connect(regionBroadcastTimer, SIGNAL(timeout()), this, SLOT(sendRegionToAgents()));
+        regionBroadcastTimer->start(REGION_BROADCAST_INTERVAL_MSECS);
+    } else {
+        const char AUDIO_MIXER_NODE_TYPES_OF_INTEREST[2] = { NODE_TYPE_AGENT, NODE_TYPE_AUDIO_INJECTOR };
+        nodeList->setNodeTypesOfInterest(AUDIO_MIXER_NODE_TYPES_OF_INTEREST, sizeof(AUDIO_MIXER_NODE_TYPES_OF_INTEREST));
+    }
     
     nodeList->linkedDataCreateCallback = attachNewBufferToNode;
     
@@ -276,13 +512,17 @@ void AudioMixer::run() {
     connect(pingNodesTimer, SIGNAL(timeout()), nodeList, SLOT(pingInactiveNodes()));
     pingNodesTimer->start(PING_INACTIVE_NODE_INTERVAL_USECS / 1000);
     
+    QTimer* streamStatsTimer = new QTimer(this);
+    connect(streamStatsTimer, SIGNAL(timeout()), this, SLOT(sendStreamStats()));
+    streamStatsTimer->start(STREAM_STATS_INTERVAL_MSECS);
+    
     int nextFrame = 0;
     timeval startTime;
     
     gettimeofday(&startTime, NULL);
     
     int numBytesPacketHeader = numBytesForPacketHeader((unsigned char*) &PACKET_TYPE_MIXED_AUDIO);
-    unsigned char clientPacket[BUFFER_LENGTH_BYTES_STEREO + numBytesPacketHeader];
+    unsigned char clientPacket[MAX_PACKET_SIZE];
     populateTypeAndVersion(clientPacket, PACKET_TYPE_MIXED_AUDIO);
     
     while (!_isFinished) {
@@ -295,22 +535,31 @@ void AudioMixer::run() {
 
         for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
             if (node->getLinkedData()) {
-                ((AudioMixerClientData*) node->getLinkedData())->checkBuffersBeforeFrameSend(JITTER_BUFFER_SAMPLES);
+                ((AudioMixerClientData*) node->getLinkedData())->checkBuffersBeforeFrameSend();
             }
         }
         
         for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
             if (node->getType() == NODE_TYPE_AGENT && node->getActiveSocket() && node->getLinkedData()
                 && ((AudioMixerClientData*) node->getLinkedData())->getAvatarAudioRingBuffer()) {
-                prepareMixForListeningNode(&(*node));
+                AudioMixerClientData* nodeClientData = (AudioMixerClientData*) node->getLinkedData();
                 
-                memcpy(clientPacket + numBytesPacketHeader, _clientSamples, sizeof(_clientSamples));
-                nodeList->getNodeSocket().writeDatagram((char*) clientPacket, sizeof(clientPacket),
-                                                        node->getActiveSocket()->getAddress(),
-                                                        node->getActiveSocket()->getPort());
+                // when nobody this node can hear is talking, send a header-only silent frame instead of a mix of zeroes
+                int numBytesEncoded = (prepareMixForListeningNode(&(*node)) > 0)
+                    ? nodeClientData->encodeMixedFrame(_clientSamples, clientPacket + numBytesPacketHeader)
+                    : nodeClientData->encodeSilentMixedFrame(clientPacket + numBytesPacketHeader);
+                nodeList->getBatchedNodeSocket().queueDatagram((char*) clientPacket, numBytesPacketHeader + numBytesEncoded,
+                                                               *node->getActiveSocket());
             }
         }
         
+        if (_region.isValid()) {
+            sendFarFieldStreams();
+        }
+        
+        // the frame's mixes and far field streams go out together
+        nodeList->getBatchedNodeSocket().flush();
+        
         // push forward the next output pointers for any audio buffers we used
         for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
             if (node->getLinkedData()) {
@@ -9,6 +9,7 @@
 #ifndef __hifi__AudioMixer__
 #define __hifi__AudioMixer__
 
+#include <AudioRegion.h>
 #include <AudioRingBuffer.h>
 
 #include <ThreadedAssignment.h>
@@ -26,16 +27,31 @@ public slots:
     void run();
     
     void processDatagram(const QByteArray& dataByteArray, const HifiSockAddr& senderSockAddr);
+private slots:
+    /// reports jitter buffer depth and starve counts for every stream being mixed
+    void sendStreamStats();
+    
+    /// tells the agents we can reach which region of the domain this mixer is handling
+    void sendRegionToAgents();
 private:
     /// adds one buffer to the mix for a listening node
     void addBufferToMixForListeningNodeWithBuffer(PositionalAudioRingBuffer* bufferToAdd,
                                                   AvatarAudioRingBuffer* listeningNodeBuffer);
     
     /// prepares and sends a mix to one Node
-    void prepareMixForListeningNode(Node* node);
+    /// \return the number of buffers that were added to the mix, 0 if there is only silence to send
+    int prepareMixForListeningNode(Node* node);
     
+    /// pre-mixes the local sources in each octant of our region into one far-field stream and sends those streams
+    /// to our peer mixers, which mix them like injected audio with a radius
+    void sendFarFieldStreams();
     
     int16_t _clientSamples[BUFFER_LENGTH_SAMPLES_PER_CHANNEL * 2];
+    
+    AudioRegion _region;
+    QUuid _farFieldStreamIdentifiers[NUM_AUDIO_REGION_OCTANTS];
+    int16_t _farFieldSamples[NUM_AUDIO_REGION_OCTANTS][BUFFER_LENGTH_SAMPLES_PER_CHANNEL];
+    int _numFarFieldFramesSent;
 };
 
 #endif /* defined(__hifi__AudioMixer__) */
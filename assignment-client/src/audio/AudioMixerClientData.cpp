@@ -7,12 +7,25 @@
 //
 
 #include <PacketHeaders.h>
+#include <SharedUtil.h>
 #include <UUID.h>
 
 #include "InjectedAudioRingBuffer.h"
 
 #include "AudioMixerClientData.h"
 
+// how long a quiet stream can go without even a silent frame before we let it go
+const uint64_t SILENT_STREAM_TIMEOUT_USECS = 1000 * 1000;
+
+AudioMixerClientData::AudioMixerClientData() :
+    _mixedAudioCodec(AUDIO_CODEC_PCM, 2),
+    _totalEncodeUsecs(0),
+    _numFramesEncoded(0),
+    _numSilentFramesSent(0)
+{
+    
+}
+
 AudioMixerClientData::~AudioMixerClientData() {
     for (int i = 0; i < _ringBuffers.size(); i++) {
         // delete this attached PositionalAudioRingBuffer
@@ -75,9 +88,9 @@ int AudioMixerClientData::parseData(unsigned char* packetData, int numBytes) {
     return 0;
 }
 
-void AudioMixerClientData::checkBuffersBeforeFrameSend(int jitterBufferLengthSamples) {
+void AudioMixerClientData::checkBuffersBeforeFrameSend() {
     for (int i = 0; i < _ringBuffers.size(); i++) {
-        if (_ringBuffers[i]->shouldBeAddedToMix(jitterBufferLengthSamples)) {
+        if (_ringBuffers[i]->shouldBeAddedToMix()) {
             // this is a ring buffer that is ready to go
             // set its flag so we know to push its buffer when all is said and done
             _ringBuffers[i]->setWillBeAddedToMix(true);
@@ -91,16 +104,38 @@ void AudioMixerClientData::pushBuffersAfterFrameSend() {
         PositionalAudioRingBuffer* audioBuffer = _ringBuffers[i];
         
         if (audioBuffer->willBeAddedToMix()) {            
-            audioBuffer->setNextOutput(audioBuffer->getNextOutput() + BUFFER_LENGTH_SAMPLES_PER_CHANNEL);
-            
-            if (audioBuffer->getNextOutput() >= audioBuffer->getBuffer() + RING_BUFFER_LENGTH_SAMPLES) {
-                audioBuffer->setNextOutput(audioBuffer->getBuffer());
-            }
-            
+            audioBuffer->shiftReadPosition(BUFFER_LENGTH_SAMPLES_PER_CHANNEL);
             audioBuffer->setWillBeAddedToMix(false);
-        } else if (audioBuffer->hasStarted() && audioBuffer->isStarved()) {
+        } else if (audioBuffer->hasStarted() && audioBuffer->isStarved()
+                   && (!audioBuffer->isSilent()
+                       || usecTimestampNow() - audioBuffer->getJitterBuffer().getLastReceiveTimestamp()
+                           > SILENT_STREAM_TIMEOUT_USECS)) {
+            // a starved buffer whose sender has gone quiet is kept around for when they start talking again,
+            // unless the sender has stopped sending silent frames too (it may have moved to another mixer)
             delete audioBuffer;
             _ringBuffers.erase(_ringBuffers.begin() + i);
         }
     }
 }
+
+int AudioMixerClientData::encodeMixedFrame(const int16_t* mixedSamples, unsigned char* destination) {
+    AvatarAudioRingBuffer* avatarRingBuffer = getAvatarAudioRingBuffer();
+    
+    if (avatarRingBuffer) {
+        // send back the codec this node is sending us, so we know it can decode it
+        _mixedAudioCodec.setType(avatarRingBuffer->getReceivedCodec());
+    }
+    
+    uint64_t encodeStart = usecTimestampNow();
+    int numBytesEncoded = _mixedAudioCodec.encodeFrame(mixedSamples, BUFFER_LENGTH_SAMPLES_PER_CHANNEL, destination);
+    
+    _totalEncodeUsecs += usecTimestampNow() - encodeStart;
+    _numFramesEncoded++;
+    
+    return numBytesEncoded;
+}
+
+int AudioMixerClientData::encodeSilentMixedFrame(unsigned char* destination) {
+    _numSilentFramesSent++;
+    return _mixedAudioCodec.encodeSilentFrame(destination);
+}
@@ -11,6 +11,7 @@
 
 #include <vector>
 
+#include <AudioCodec.h>
 #include <NodeData.h>
 #include <PositionalAudioRingBuffer.h>
 
@@ -18,16 +19,34 @@
 
 class AudioMixerClientData : public NodeData {
 public:
+    AudioMixerClientData();
     ~AudioMixerClientData();
     
     const std::vector<PositionalAudioRingBuffer*> getRingBuffers() const { return _ringBuffers; }
     AvatarAudioRingBuffer* getAvatarAudioRingBuffer() const;
     
     int parseData(unsigned char* packetData, int numBytes);
-    void checkBuffersBeforeFrameSend(int jitterBufferLengthSamples);
+    void checkBuffersBeforeFrameSend();
     void pushBuffersAfterFrameSend();
+    
+    /// encodes a stereo mix for this node with the codec it uses for its own microphone
+    /// \return the number of bytes written to destination
+    int encodeMixedFrame(const int16_t* mixedSamples, unsigned char* destination);
+    
+    /// writes a silent frame, which the node decodes to zeroes, in place of a mix with no sources in it
+    /// \return the number of bytes written to destination
+    int encodeSilentMixedFrame(unsigned char* destination);
+    
+    int getNumSilentFramesSent() const { return _numSilentFramesSent; }
+    
+    float getAverageEncodeUsecs() const { return _numFramesEncoded > 0 ? (float) _totalEncodeUsecs / _numFramesEncoded : 0.0f; }
+    AUDIO_CODEC getMixedAudioCodec() const { return _mixedAudioCodec.getType(); }
 private:
     std::vector<PositionalAudioRingBuffer*> _ringBuffers;
+    AudioCodec _mixedAudioCodec;
+    uint64_t _totalEncodeUsecs;
+    int _numFramesEncoded;
+    int _numSilentFramesSent;
 };
 
 #endif /* defined(__hifi__AudioMixerClientData__) */
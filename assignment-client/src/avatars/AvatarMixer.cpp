@@ -9,8 +9,17 @@
 //
 //  The avatar mixer receives head, hand and positional data from all connected
 //  nodes, and broadcasts that data back to them, every BROADCAST_INTERVAL ms.
+//  Each avatar is quantized once per frame and sent to each agent as a delta
+//  against the last state that agent acknowledged. The packets for each agent
+//  are assembled in parallel on a thread pool, then sent from the mixer thread.
+
+#include <algorithm>
+#include <vector>
 
 #include <QtCore/QCoreApplication>
+#include <QtCore/QRunnable>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
 #include <QtCore/QTimer>
 
 #include <Logging.h>
@@ -19,7 +28,7 @@
 #include <SharedUtil.h>
 #include <UUID.h>
 
-#include "AvatarData.h"
+#include "AvatarMixerClientData.h"
 
 #include "AvatarMixer.h"
 
@@ -27,95 +36,352 @@ const char AVATAR_MIXER_LOGGING_NAME[] = "avatar-mixer";
 
 const unsigned int AVATAR_DATA_SEND_INTERVAL_USECS = (1 / 60.0) * 1000 * 1000;
 
+// avatars closer than this are sent every frame, and the send interval grows by a frame per multiple of it beyond
+const float FULL_RATE_DISTANCE = 5.0f;
+
+// the slowest we'll update an avatar, however far away it is
+const int MAX_SEND_INTERVAL_FRAMES = 12;
+
+// avatars outside the receiver's view are treated as this much further away, since they only
+// need to be current for when it turns around
+const float OUT_OF_VIEW_DISTANCE_SCALE = 2.0f;
+const float VIEW_HALF_ANGLE_COSINE = 0.5f;
+
+// each agent's share of our upstream, which can be overridden with --maxKilobytesPerSecond in the payload (0 to disable)
+const char MAX_KILOBYTES_PER_SECOND_OPTION[] = "--maxKilobytesPerSecond";
+const int DEFAULT_MAX_KILOBYTES_PER_SECOND = 256;
+
+// threads the per-receiver broadcast packets are assembled on, which can be overridden with --broadcastThreads in the
+// payload - defaults to one per core
+const char BROADCAST_THREADS_OPTION[] = "--broadcastThreads";
+
+const int BROADCAST_STATS_INTERVAL_MSECS = 1000;
+
+// broadcast histories last sent before this belong to avatars that have left, or gone silent
+const int BROADCAST_FRAME_EXPIRY_FRAMES = 10 * 60;
+
 AvatarMixer::AvatarMixer(const unsigned char* dataBuffer, int numBytes) :
-    ThreadedAssignment(dataBuffer, numBytes)
+    ThreadedAssignment(dataBuffer, numBytes),
+    _numFramesBroadcast(0),
+    _maxBytesPerReceiverPerFrame(0),
+    _avatarNodes(),
+    _receiverNodes(),
+    _nextReceiverIndex(0),
+    _broadcastThreadPool(),
+    _numBroadcastThreads(1),
+    _broadcastUsecs(0),
+    _numFramesTimed(0)
 {
     
 }
 
-unsigned char* addNodeToBroadcastPacket(unsigned char *currentPosition, Node *nodeToAdd) {
-    QByteArray rfcUUID = nodeToAdd->getUUID().toRfc4122();
-    memcpy(currentPosition, rfcUUID.constData(), rfcUUID.size());
-    currentPosition += rfcUUID.size();
+void attachAvatarDataToNode(Node* newNode) {
+    if (newNode->getLinkedData() == NULL) {
+        newNode->setLinkedData(new AvatarMixerClientData(newNode));
+    }
+}
+
+struct AvatarBroadcastCandidate {
+    Node* node;
+    float priority;
+};
+
+bool hasHigherBroadcastPriority(const AvatarBroadcastCandidate& candidate, const AvatarBroadcastCandidate& otherCandidate) {
+    return candidate.priority > otherCandidate.priority;
+}
+
+int populateBroadcastPacketPreamble(unsigned char* packet, uint16_t sequence, uint16_t receiverLocalID) {
+    unsigned char* currentPosition = packet + populateTypeAndVersion(packet, PACKET_TYPE_BULK_AVATAR_DATA);
     
-    AvatarData *nodeData = (AvatarData *)nodeToAdd->getLinkedData();
-    currentPosition += nodeData->getBroadcastData(currentPosition);
+    memcpy(currentPosition, &sequence, sizeof(sequence));
+    currentPosition += sizeof(sequence);
     
-    return currentPosition;
+    memcpy(currentPosition, &receiverLocalID, sizeof(receiverLocalID));
+    currentPosition += sizeof(receiverLocalID);
+    
+    return currentPosition - packet;
 }
 
-void attachAvatarDataToNode(Node* newNode) {
-    if (newNode->getLinkedData() == NULL) {
-        newNode->setLinkedData(new AvatarData(newNode));
+// writes the session local ID, the age of the baseline the state is a delta against (0 for none, in which case the node
+// UUID follows so the receiver can map the ID) and then the delta itself - full states are the same for every receiver
+// and are copied from the record encoded at the start of the frame
+int encodeAvatarRecord(unsigned char* destinationBuffer, AvatarMixerClientData* avatarData,
+                       const AvatarBroadcastHistory& history, uint16_t sequence) {
+    uint16_t baselineAge = history.hasBaseline ? (uint16_t) (sequence - history.baselineSequence) : 0;
+    
+    if (baselineAge == 0 || baselineAge > MAX_BASELINE_AGE || history.numSentSinceBaseline >= NUM_RECEIVED_AVATAR_STATES) {
+        const QByteArray& fullStateRecord = avatarData->getFullStateRecord();
+        memcpy(destinationBuffer, fullStateRecord.constData(), fullStateRecord.size());
+        return fullStateRecord.size();
     }
+    
+    unsigned char* currentPosition = destinationBuffer;
+    
+    uint16_t sessionLocalID = avatarData->getSessionLocalID();
+    memcpy(currentPosition, &sessionLocalID, sizeof(sessionLocalID));
+    currentPosition += sizeof(sessionLocalID);
+    
+    *currentPosition++ = baselineAge;
+    
+    currentPosition += avatarData->getCurrentState().encodeDelta(currentPosition, &history.baseline);
+    
+    return currentPosition - destinationBuffer;
 }
 
-// NOTE: some additional optimizations to consider.
-//    1) use the view frustum to cull those avatars that are out of view. Since avatar data doesn't need to be present
-//       if the avatar is not in view or in the keyhole.
-//    2) after culling for view frustum, sort order the avatars by distance, send the closest ones first.
-//    3) if we need to rate limit the amount of data we send, we can use a distance weighted "semi-random" function to
-//       determine which avatars are included in the packet stream
-//    4) we should optimize the avatar data format to be more compact (100 bytes is pretty wasteful).
-void broadcastAvatarData() {
-    static unsigned char broadcastPacket[MAX_PACKET_SIZE];
-    static unsigned char avatarDataBuffer[MAX_PACKET_SIZE];
-    int numHeaderBytes = populateTypeAndVersion(broadcastPacket, PACKET_TYPE_BULK_AVATAR_DATA);
-    unsigned char* currentBufferPosition = broadcastPacket + numHeaderBytes;
-    int packetLength = currentBufferPosition - broadcastPacket;
-    int packetsSent = 0;
+/// assembles broadcast packets on one thread of the broadcast thread pool
+class BroadcastAssemblyTask : public QRunnable {
+public:
+    BroadcastAssemblyTask(AvatarMixer* avatarMixer) : _avatarMixer(avatarMixer) {}
+    
+    void run() { _avatarMixer->assembleBroadcastPackets(); }
+private:
+    AvatarMixer* _avatarMixer;
+};
+
+void AvatarMixer::prepareBroadcast() {
+    static unsigned char fullStateBuffer[MAX_PACKET_SIZE];
     
     NodeList* nodeList = NodeList::getInstance();
     
+    _avatarNodes.clear();
+    _receiverNodes.clear();
+    
+    // quantize every avatar once, and encode its full state once - each receiver then only encodes the difference from
+    // what it already has, or copies the full state in
     for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
-        if (node->getLinkedData() && node->getType() == NODE_TYPE_AGENT && node->getActiveSocket()) {
-            
-            // reset packet pointers for this node
-            currentBufferPosition = broadcastPacket + numHeaderBytes;
-            packetLength = currentBufferPosition - broadcastPacket;
-            
-            // this is an AGENT we have received head data from
-            // send back a packet with other active node data to this node
-            for (NodeList::iterator otherNode = nodeList->begin(); otherNode != nodeList->end(); otherNode++) {
-                if (otherNode->getLinkedData() && otherNode->getUUID() != node->getUUID()) {
-                    
-                    unsigned char* avatarDataEndpoint = addNodeToBroadcastPacket((unsigned char*)&avatarDataBuffer[0],
-                                                                                 &*otherNode);
-                    int avatarDataLength = avatarDataEndpoint - (unsigned char*)&avatarDataBuffer;
-                    
-                    if (avatarDataLength + packetLength <= MAX_PACKET_SIZE) {
-                        memcpy(currentBufferPosition, &avatarDataBuffer[0], avatarDataLength);
-                        packetLength += avatarDataLength;
-                        currentBufferPosition += avatarDataLength;
-                    } else {
-                        packetsSent++;
-                        //printf("packetsSent=%d packetLength=%d\n", packetsSent, packetLength);
-                        nodeList->getNodeSocket().writeDatagram((char*) broadcastPacket,
-                                                                currentBufferPosition - broadcastPacket,
-                                                                node->getActiveSocket()->getAddress(),
-                                                                node->getActiveSocket()->getPort());
-                        
-                        // reset the packet
-                        currentBufferPosition = broadcastPacket + numHeaderBytes;
-                        packetLength = currentBufferPosition - broadcastPacket;
-                        
-                        // copy the avatar that didn't fit into the next packet
-                        memcpy(currentBufferPosition, &avatarDataBuffer[0], avatarDataLength);
-                        packetLength += avatarDataLength;
-                        currentBufferPosition += avatarDataLength;
-                    }
+        if (node->getLinkedData() && node->getType() == NODE_TYPE_AGENT) {
+            AvatarMixerClientData* nodeData = (AvatarMixerClientData*) node->getLinkedData();
+            QuantizedAvatarState& currentState = nodeData->getCurrentState();
+            
+            nodeData->getQuantizedState(currentState);
+            
+            Node* leaderNode = nodeData->getLeaderUUID().isNull() ? NULL : nodeList->nodeWithUUID(nodeData->getLeaderUUID());
+            currentState.leaderID = (leaderNode && leaderNode->getLinkedData())
+                ? ((AvatarMixerClientData*) leaderNode->getLinkedData())->getSessionLocalID()
+                : 0;
+            
+            unsigned char* currentPosition = fullStateBuffer;
+            
+            uint16_t sessionLocalID = nodeData->getSessionLocalID();
+            memcpy(currentPosition, &sessionLocalID, sizeof(sessionLocalID));
+            currentPosition += sizeof(sessionLocalID);
+            
+            // a baseline age of 0 marks a full state, with the node UUID so the receiver can map the ID
+            *currentPosition++ = 0;
+            
+            QByteArray rfcUUID = node->getUUID().toRfc4122();
+            memcpy(currentPosition, rfcUUID.constData(), rfcUUID.size());
+            currentPosition += rfcUUID.size();
+            
+            currentPosition += currentState.encodeDelta(currentPosition, NULL);
+            
+            nodeData->setFullStateRecord(QByteArray((char*) fullStateBuffer, currentPosition - fullStateBuffer));
+            
+            // an agent that joined when every ID was taken can still be sent the others, but can't be sent itself
+            if (sessionLocalID != 0) {
+                _avatarNodes.push_back(&*node);
+            }
+            
+            if (node->getActiveSocket()) {
+                _receiverNodes.push_back(&*node);
+            }
+        }
+    }
+}
+
+void AvatarMixer::assembleBroadcastPackets() {
+    unsigned char broadcastPacket[MAX_PACKET_SIZE];
+    unsigned char avatarDataBuffer[MAX_PACKET_SIZE];
+    std::vector<AvatarBroadcastCandidate> candidates;
+    
+    // take receivers one at a time until there are none left, so a thread that gets crowded receivers doesn't hold
+    // everyone else up
+    int receiverIndex;
+    while ((receiverIndex = _nextReceiverIndex.fetchAndAddOrdered(1)) < (int) _receiverNodes.size()) {
+        Node* node = _receiverNodes[receiverIndex];
+        AvatarMixerClientData* nodeData = (AvatarMixerClientData*) node->getLinkedData();
+        QList<QByteArray>& pendingPackets = nodeData->getPendingBroadcastPackets();
+        
+        glm::vec3 viewPosition = nodeData->getPosition();
+        glm::vec3 viewDirection = nodeData->getViewDirection();
+        
+        // find the avatars that are due to be sent to this node this frame
+        candidates.clear();
+        
+        for (std::vector<Node*>::const_iterator otherNode = _avatarNodes.begin(); otherNode != _avatarNodes.end(); otherNode++) {
+            if (*otherNode != node) {
+                AvatarMixerClientData* otherNodeData = (AvatarMixerClientData*) (*otherNode)->getLinkedData();
+                
+                glm::vec3 offset = otherNodeData->getPosition() - viewPosition;
+                float distance = glm::length(offset);
+                
+                if (distance > EPSILON && glm::dot(offset / distance, viewDirection) < VIEW_HALF_ANGLE_COSINE) {
+                    distance *= OUT_OF_VIEW_DISTANCE_SCALE;
+                }
+                
+                int sendIntervalFrames = std::max(1, std::min(MAX_SEND_INTERVAL_FRAMES, (int) (distance / FULL_RATE_DISTANCE)));
+                
+                int lastBroadcastFrame = nodeData->getLastBroadcastFrame(otherNodeData->getSessionLocalID());
+                int framesSinceBroadcast = (lastBroadcastFrame < 0)
+                    ? MAX_SEND_INTERVAL_FRAMES
+                    : _numFramesBroadcast - lastBroadcastFrame;
+                
+                if (framesSinceBroadcast >= sendIntervalFrames) {
+                    // the closer and the longer it has waited, the sooner it goes in
+                    AvatarBroadcastCandidate candidate;
+                    candidate.node = *otherNode;
+                    candidate.priority = framesSinceBroadcast / std::max(distance, FULL_RATE_DISTANCE);
+                    candidates.push_back(candidate);
                 }
             }
+        }
+        
+        std::sort(candidates.begin(), candidates.end(), hasHigherBroadcastPriority);
+        
+        uint16_t sequence = nodeData->getNextBroadcastSequence();
+        int packetLength = populateBroadcastPacketPreamble(broadcastPacket, sequence, nodeData->getSessionLocalID());
+        int numPreambleBytes = packetLength;
+        
+        int numBytesAssembled = 0;
+        int numCandidatesSent = 0;
+        
+        for (; numCandidatesSent < (int) candidates.size(); numCandidatesSent++) {
+            AvatarMixerClientData* otherNodeData = (AvatarMixerClientData*) candidates[numCandidatesSent].node->getLinkedData();
+            AvatarBroadcastHistory& history = nodeData->getBroadcastHistory(otherNodeData->getSessionLocalID());
+            
+            int avatarDataLength = encodeAvatarRecord(avatarDataBuffer, otherNodeData, history, sequence);
             
-            packetsSent++;
-            //printf("packetsSent=%d packetLength=%d\n", packetsSent, packetLength);
-            NodeList::getInstance()->getNodeSocket().writeDatagram((char*) broadcastPacket, currentBufferPosition - broadcastPacket,
-                                                                   node->getActiveSocket()->getAddress(),
-                                                                   node->getActiveSocket()->getPort());
+            // the most overdue avatar always goes in, so a budget smaller than one full state still lets avatars through
+            if (_maxBytesPerReceiverPerFrame > 0 && numCandidatesSent > 0
+                && numBytesAssembled + packetLength + avatarDataLength > _maxBytesPerReceiverPerFrame) {
+                // this node's budget is spent - what's left stays due and will have a higher priority next frame
+                break;
+            }
+            
+            if (avatarDataLength + packetLength > MAX_PACKET_SIZE) {
+                pendingPackets.append(QByteArray((char*) broadcastPacket, packetLength));
+                numBytesAssembled += packetLength;
+                
+                // start the next packet, and encode the avatar that didn't fit again since its baseline age
+                // is relative to the sequence number of the packet it is in
+                sequence = nodeData->getNextBroadcastSequence();
+                packetLength = populateBroadcastPacketPreamble(broadcastPacket, sequence, nodeData->getSessionLocalID());
+                avatarDataLength = encodeAvatarRecord(avatarDataBuffer, otherNodeData, history, sequence);
+            }
+            
+            memcpy(broadcastPacket + packetLength, avatarDataBuffer, avatarDataLength);
+            packetLength += avatarDataLength;
+            
+            // keep what we sent until the agent acknowledges it and it can become the baseline
+            history.lastBroadcastFrame = _numFramesBroadcast;
+            history.numSentSinceBaseline++;
+            
+            if (history.unacknowledgedStates.size() >= NUM_ACKNOWLEDGED_SEQUENCES) {
+                history.unacknowledgedStates.removeFirst();
+            }
+            
+            SentAvatarState sentState;
+            sentState.sequence = sequence;
+            sentState.state = otherNodeData->getCurrentState();
+            history.unacknowledgedStates.append(sentState);
+        }
+        
+        if (packetLength > numPreambleBytes || pendingPackets.isEmpty()) {
+            // an empty packet still tells the agent the mixer is alive and gives it a sequence number to acknowledge
+            pendingPackets.append(QByteArray((char*) broadcastPacket, packetLength));
+            numBytesAssembled += packetLength;
+        }
+        
+        nodeData->recordBroadcast(numBytesAssembled, (int) candidates.size() - numCandidatesSent);
+    }
+}
+
+void AvatarMixer::broadcastAvatarData() {
+    quint64 startTime = usecTimestampNow();
+    
+    prepareBroadcast();
+    
+    // each receiver's packets only depend on its own data and the states prepared above, none of which change until
+    // the pool is done, so the receivers can be split across threads without any locking
+    _nextReceiverIndex.storeRelease(0);
+    
+    int numTasks = std::min(_numBroadcastThreads, (int) _receiverNodes.size());
+    
+    if (numTasks > 1) {
+        for (int i = 0; i < numTasks; i++) {
+            _broadcastThreadPool.start(new BroadcastAssemblyTask(this));
+        }
+        _broadcastThreadPool.waitForDone();
+    } else {
+        assembleBroadcastPackets();
+    }
+    
+    // the socket belongs to this thread, so the sends stay here
+    BatchedUdpSocket& batchedNodeSocket = NodeList::getInstance()->getBatchedNodeSocket();
+    
+    for (std::vector<Node*>::const_iterator node = _receiverNodes.begin(); node != _receiverNodes.end(); node++) {
+        QList<QByteArray>& pendingPackets = ((AvatarMixerClientData*) (*node)->getLinkedData())->getPendingBroadcastPackets();
+        
+        for (int i = 0; i < pendingPackets.size(); i++) {
+            batchedNodeSocket.queueDatagram(pendingPackets[i], *(*node)->getActiveSocket());
         }
+        
+        pendingPackets.clear();
     }
     
+    batchedNodeSocket.flush();
     
+    _numFramesBroadcast++;
+    
+    _broadcastUsecs += usecTimestampNow() - startTime;
+    _numFramesTimed++;
+}
+
+void AvatarMixer::sendBroadcastStats() {
+    NodeList* nodeList = NodeList::getInstance();
+    
+    int numReceivers = 0;
+    int totalBytesSent = 0;
+    int totalAvatarsSkipped = 0;
+    
+    for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
+        if (node->getLinkedData() && node->getType() == NODE_TYPE_AGENT) {
+            AvatarMixerClientData* nodeData = (AvatarMixerClientData*) node->getLinkedData();
+            
+            numReceivers++;
+            totalBytesSent += nodeData->getNumBytesSent();
+            totalAvatarsSkipped += nodeData->getNumAvatarsSkipped();
+            
+            if (Logging::shouldSendStats()) {
+                QString statPrefix = QString("%1.%2.").arg(AVATAR_MIXER_LOGGING_NAME, node->getUUID().toString().mid(1, 36));
+                
+                Logging::stashValue(STAT_TYPE_GAUGE, (statPrefix + "bytes-per-second").toLocal8Bit().constData(),
+                                    nodeData->getNumBytesSent() * 1000.0f / BROADCAST_STATS_INTERVAL_MSECS);
+                Logging::stashValue(STAT_TYPE_COUNTER, (statPrefix + "avatars-skipped").toLocal8Bit().constData(),
+                                    nodeData->getNumAvatarsSkipped());
+            }
+            
+            nodeData->resetBroadcastStats();
+            nodeData->removeBroadcastHistoriesBefore(_numFramesBroadcast - BROADCAST_FRAME_EXPIRY_FRAMES);
+        }
+    }
+    
+    if (numReceivers > 0) {
+        int averageBroadcastUsecs = _numFramesTimed > 0 ? _broadcastUsecs / _numFramesTimed : 0;
+        
+        qDebug() << "Sent an average of" << totalBytesSent * 1000 / (numReceivers * BROADCAST_STATS_INTERVAL_MSECS)
+            << "bytes per second to each of" << numReceivers << "agents," << totalAvatarsSkipped
+            << "avatars held back by the budget," << averageBroadcastUsecs << "usecs per frame on"
+            << _numBroadcastThreads << "threads\n";
+        
+        if (Logging::shouldSendStats()) {
+            Logging::stashValue(STAT_TYPE_TIMER, QString("%1.broadcast-usecs").arg(AVATAR_MIXER_LOGGING_NAME).toLocal8Bit().constData(),
+                                averageBroadcastUsecs);
+        }
+    }
+    
+    _broadcastUsecs = 0;
+    _numFramesTimed = 0;
 }
 
 void AvatarMixer::processDatagram(const QByteArray& dataByteArray, const HifiSockAddr& senderSockAddr) {
@@ -172,6 +438,31 @@ void AvatarMixer::run() {
     
     nodeList->linkedDataCreateCallback = attachAvatarDataToNode;
     
+    int maxKilobytesPerSecond = DEFAULT_MAX_KILOBYTES_PER_SECOND;
+    _numBroadcastThreads = QThread::idealThreadCount();
+    
+    if (getNumPayloadBytes() > 0) {
+        QStringList payloadList = QString((const char*) _payload).split(" ");
+        int budgetOptionIndex = payloadList.indexOf(MAX_KILOBYTES_PER_SECOND_OPTION);
+        
+        if (budgetOptionIndex >= 0 && budgetOptionIndex + 1 < payloadList.size()) {
+            maxKilobytesPerSecond = payloadList.at(budgetOptionIndex + 1).toInt();
+        }
+        
+        int threadsOptionIndex = payloadList.indexOf(BROADCAST_THREADS_OPTION);
+        
+        if (threadsOptionIndex >= 0 && threadsOptionIndex + 1 < payloadList.size()) {
+            _numBroadcastThreads = payloadList.at(threadsOptionIndex + 1).toInt();
+        }
+    }
+    
+    _numBroadcastThreads = std::max(1, _numBroadcastThreads);
+    _broadcastThreadPool.setMaxThreadCount(_numBroadcastThreads);
+    qDebug("Assembling avatar broadcasts on %d threads\n", _numBroadcastThreads);
+    
+    _maxBytesPerReceiverPerFrame = (maxKilobytesPerSecond * 1024.0f) * AVATAR_DATA_SEND_INTERVAL_USECS / (1000 * 1000);
+    qDebug("Sending each agent at most %d KB/s of avatar data\n", maxKilobytesPerSecond);
+    
     QTimer* domainServerTimer = new QTimer(this);
     connect(domainServerTimer, SIGNAL(timeout()), this, SLOT(checkInWithDomainServerOrExit()));
     domainServerTimer->start(DOMAIN_SERVER_CHECK_IN_USECS / 1000);
@@ -184,6 +475,10 @@ void AvatarMixer::run() {
     connect(silentNodeTimer, SIGNAL(timeout()), nodeList, SLOT(removeSilentNodes()));
     silentNodeTimer->start(NODE_SILENCE_THRESHOLD_USECS / 1000);
     
+    QTimer* broadcastStatsTimer = new QTimer(this);
+    connect(broadcastStatsTimer, SIGNAL(timeout()), this, SLOT(sendBroadcastStats()));
+    broadcastStatsTimer->start(BROADCAST_STATS_INTERVAL_MSECS);
+    
     int nextFrame = 0;
     timeval startTime;
     
@@ -9,10 +9,18 @@
 #ifndef __hifi__AvatarMixer__
 #define __hifi__AvatarMixer__
 
+#include <vector>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QThreadPool>
+
 #include <ThreadedAssignment.h>
 
+class Node;
+
 /// Handles assignments of type AvatarMixer - distribution of avatar data to various clients
 class AvatarMixer : public ThreadedAssignment {
+    Q_OBJECT
 public:
     AvatarMixer(const unsigned char* dataBuffer, int numBytes);
     
@@ -21,6 +29,34 @@ public slots:
     void run();
     
     void processDatagram(const QByteArray& dataByteArray, const HifiSockAddr& senderSockAddr);
+private slots:
+    /// reports the bytes sent to and avatars held back from each agent since the last report
+    void sendBroadcastStats();
+private:
+    friend class BroadcastAssemblyTask;
+    
+    /// sends each agent the avatars around it, nearest and most overdue first, within its per-frame byte budget
+    void broadcastAvatarData();
+    
+    /// quantizes and encodes the full state of every avatar once, and gathers the avatars and receivers for this frame
+    void prepareBroadcast();
+    
+    /// assembles the packets for the receivers taken from _nextReceiverIndex until there are none left - runs on the
+    /// broadcast thread pool, and only changes the data of the receivers it takes
+    void assembleBroadcastPackets();
+    
+    int _numFramesBroadcast;
+    int _maxBytesPerReceiverPerFrame;
+    
+    std::vector<Node*> _avatarNodes;
+    std::vector<Node*> _receiverNodes;
+    QAtomicInt _nextReceiverIndex;
+    
+    QThreadPool _broadcastThreadPool;
+    int _numBroadcastThreads;
+    
+    quint64 _broadcastUsecs;
+    int _numFramesTimed;
 };
 
 #endif /* defined(__hifi__AvatarMixer__) */
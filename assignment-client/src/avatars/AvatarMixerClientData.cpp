@@ -0,0 +1,213 @@
+//
+//  AvatarMixerClientData.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <cstring>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+
+#include <PacketHeaders.h>
+#include <SharedUtil.h>
+
+#include "AvatarMixerClientData.h"
+
+// well past the ten seconds the mixer keeps the broadcast history of an avatar that has left, so an agent is never sent
+// a delta of a new avatar against the baseline of the one that had its ID before
+const quint64 SESSION_LOCAL_ID_REUSE_USECS = 30 * 1000 * 1000;
+
+// 0 is kept to mean no node
+const int NUM_SESSION_LOCAL_IDS = 65535;
+
+// agents are added and their data released on different threads
+QMutex sessionLocalIDMutex;
+QSet<uint16_t> liveSessionLocalIDs;
+QHash<uint16_t, quint64> releasedSessionLocalIDs;
+uint16_t nextSessionLocalID = 1;
+
+uint16_t acquireSessionLocalID() {
+    QMutexLocker locker(&sessionLocalIDMutex);
+    
+    quint64 now = usecTimestampNow();
+    
+    for (int i = 0; i < NUM_SESSION_LOCAL_IDS; i++) {
+        uint16_t sessionLocalID = nextSessionLocalID++;
+        
+        if (nextSessionLocalID == 0) {
+            nextSessionLocalID = 1;
+        }
+        
+        if (liveSessionLocalIDs.contains(sessionLocalID)) {
+            continue;
+        }
+        
+        QHash<uint16_t, quint64>::iterator releaseTime = releasedSessionLocalIDs.find(sessionLocalID);
+        if (releaseTime != releasedSessionLocalIDs.end()) {
+            if (now - releaseTime.value() < SESSION_LOCAL_ID_REUSE_USECS) {
+                continue;
+            }
+            releasedSessionLocalIDs.erase(releaseTime);
+        }
+        
+        liveSessionLocalIDs.insert(sessionLocalID);
+        return sessionLocalID;
+    }
+    
+    qDebug("Out of avatar session local IDs, the new agent won't be broadcast.\n");
+    return 0;
+}
+
+void releaseSessionLocalID(uint16_t sessionLocalID) {
+    if (sessionLocalID != 0) {
+        QMutexLocker locker(&sessionLocalIDMutex);
+        
+        liveSessionLocalIDs.remove(sessionLocalID);
+        releasedSessionLocalIDs.insert(sessionLocalID, usecTimestampNow());
+    }
+}
+
+AvatarBroadcastHistory::AvatarBroadcastHistory() :
+    lastBroadcastFrame(-1),
+    hasBaseline(false),
+    baselineSequence(0),
+    baseline(),
+    numSentSinceBaseline(0),
+    unacknowledgedStates()
+{
+    
+}
+
+AvatarMixerClientData::AvatarMixerClientData(Node* owningNode) :
+    AvatarData(owningNode),
+    _sessionLocalID(acquireSessionLocalID()),
+    _currentState(),
+    _fullStateRecord(),
+    _nextBroadcastSequence(0),
+    _broadcastHistories(),
+    _pendingBroadcastPackets(),
+    _numBytesSent(0),
+    _numAvatarsSkipped(0)
+{
+    
+}
+
+AvatarMixerClientData::~AvatarMixerClientData() {
+    releaseSessionLocalID(_sessionLocalID);
+}
+
+int AvatarMixerClientData::parseData(unsigned char* packetData, int numBytes) {
+    int numBytesRead = AvatarData::parseData(packetData, numBytes);
+    
+    // the acknowledgement follows the avatar data - latest sequence, mask of the ones before it, then the avatars the
+    // agent couldn't decode a delta for and needs a full state of
+    unsigned char* acknowledgementPosition = packetData + numBytesForPacketHeader(packetData) + numBytesRead;
+    int numAcknowledgementBytes = numBytes - (acknowledgementPosition - packetData);
+    
+    const int NUM_FIXED_ACKNOWLEDGEMENT_BYTES = 2 * sizeof(uint16_t) + sizeof(uint8_t);
+    
+    if (numAcknowledgementBytes >= NUM_FIXED_ACKNOWLEDGEMENT_BYTES) {
+        uint16_t latestSequence, receivedMask;
+        memcpy(&latestSequence, acknowledgementPosition, sizeof(latestSequence));
+        acknowledgementPosition += sizeof(latestSequence);
+        memcpy(&receivedMask, acknowledgementPosition, sizeof(receivedMask));
+        acknowledgementPosition += sizeof(receivedMask);
+        
+        int numResyncs = std::min((int) *acknowledgementPosition++,
+                                  (numAcknowledgementBytes - NUM_FIXED_ACKNOWLEDGEMENT_BYTES) / (int) sizeof(uint16_t));
+        
+        processAcknowledgement(latestSequence, receivedMask);
+        
+        for (int i = 0; i < numResyncs; i++) {
+            uint16_t resyncLocalID;
+            memcpy(&resyncLocalID, acknowledgementPosition, sizeof(resyncLocalID));
+            acknowledgementPosition += sizeof(resyncLocalID);
+            
+            QHash<uint16_t, AvatarBroadcastHistory>::iterator history = _broadcastHistories.find(resyncLocalID);
+            if (history != _broadcastHistories.end()) {
+                history.value().hasBaseline = false;
+                history.value().unacknowledgedStates.clear();
+            }
+        }
+        
+        numBytesRead = acknowledgementPosition - (packetData + numBytesForPacketHeader(packetData));
+    }
+    
+    return numBytesRead;
+}
+
+void AvatarMixerClientData::processAcknowledgement(uint16_t latestSequence, uint16_t receivedMask) {
+    for (QHash<uint16_t, AvatarBroadcastHistory>::iterator history = _broadcastHistories.begin();
+         history != _broadcastHistories.end();
+         ++history) {
+        QList<SentAvatarState>& sentStates = history.value().unacknowledgedStates;
+        
+        // sent states are in the order they were sent, so the newest acknowledged one is the last that matches
+        int newestAcknowledgedIndex = -1;
+        for (int i = 0; i < sentStates.size(); i++) {
+            uint16_t packetsBeforeLatest = latestSequence - sentStates[i].sequence;
+            
+            if (packetsBeforeLatest == 0
+                || (packetsBeforeLatest <= NUM_ACKNOWLEDGED_SEQUENCES && (receivedMask & (1 << (packetsBeforeLatest - 1))))) {
+                newestAcknowledgedIndex = i;
+            }
+        }
+        
+        if (newestAcknowledgedIndex >= 0) {
+            history.value().hasBaseline = true;
+            history.value().baselineSequence = sentStates[newestAcknowledgedIndex].sequence;
+            history.value().baseline = sentStates[newestAcknowledgedIndex].state;
+            
+            // anything sent before the new baseline is of no more use
+            sentStates.erase(sentStates.begin(), sentStates.begin() + newestAcknowledgedIndex + 1);
+            history.value().numSentSinceBaseline = sentStates.size();
+        }
+        
+        // and anything that has fallen out of the acknowledgement window was lost
+        while (!sentStates.isEmpty() && (int16_t) (latestSequence - sentStates.first().sequence) > NUM_ACKNOWLEDGED_SEQUENCES) {
+            sentStates.removeFirst();
+        }
+    }
+}
+
+glm::vec3 AvatarMixerClientData::getViewDirection() const {
+    glm::quat orientation = glm::quat(glm::radians(glm::vec3(_bodyPitch, _bodyYaw, _bodyRoll)));
+    
+    if (_headData) {
+        // the head angles are relative to the body
+        orientation = orientation * glm::quat(glm::radians(glm::vec3(_headData->getPitch(), _headData->getYaw(), 0.0f)));
+    }
+    
+    return orientation * glm::vec3(0.0f, 0.0f, -1.0f);
+}
+
+int AvatarMixerClientData::getLastBroadcastFrame(uint16_t sessionLocalID) const {
+    QHash<uint16_t, AvatarBroadcastHistory>::const_iterator history = _broadcastHistories.constFind(sessionLocalID);
+    return (history == _broadcastHistories.constEnd()) ? -1 : history.value().lastBroadcastFrame;
+}
+
+void AvatarMixerClientData::removeBroadcastHistoriesBefore(int oldestFrame) {
+    QHash<uint16_t, AvatarBroadcastHistory>::iterator history = _broadcastHistories.begin();
+    
+    while (history != _broadcastHistories.end()) {
+        if (history.value().lastBroadcastFrame < oldestFrame) {
+            history = _broadcastHistories.erase(history);
+        } else {
+            ++history;
+        }
+    }
+}
+
+void AvatarMixerClientData::recordBroadcast(int numBytesSent, int numAvatarsSkipped) {
+    _numBytesSent += numBytesSent;
+    _numAvatarsSkipped += numAvatarsSkipped;
+}
+
+void AvatarMixerClientData::resetBroadcastStats() {
+    _numBytesSent = 0;
+    _numAvatarsSkipped = 0;
+}
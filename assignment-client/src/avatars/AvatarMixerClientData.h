@@ -0,0 +1,97 @@
+//
+//  AvatarMixerClientData.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__AvatarMixerClientData__
+#define __hifi__AvatarMixerClientData__
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+
+#include <AvatarData.h>
+#include <QuantizedAvatarState.h>
+
+/// a state sent to an agent that it has not acknowledged yet
+class SentAvatarState {
+public:
+    uint16_t sequence;
+    QuantizedAvatarState state;
+};
+
+/// what we have sent one agent of one other avatar
+class AvatarBroadcastHistory {
+public:
+    AvatarBroadcastHistory();
+    
+    int lastBroadcastFrame;
+    
+    bool hasBaseline;
+    uint16_t baselineSequence;
+    QuantizedAvatarState baseline;
+    int numSentSinceBaseline;
+    
+    QList<SentAvatarState> unacknowledgedStates;
+};
+
+/// The avatar mixer's view of one agent - its avatar data, plus what the mixer has been sending it
+class AvatarMixerClientData : public AvatarData {
+public:
+    AvatarMixerClientData(Node* owningNode);
+    ~AvatarMixerClientData();
+    
+    /// parses the head data and the acknowledgement of our broadcasts the agent appends to it
+    int parseData(unsigned char* packetData, int numBytes);
+    
+    /// short ID that stands in for this agent's UUID in broadcasts - no other live agent has it, and once this one leaves
+    /// it isn't handed out again until every agent's broadcast history of it has expired
+    uint16_t getSessionLocalID() const { return _sessionLocalID; }
+    
+    /// our avatar as of this frame, quantized once for every agent it is sent to
+    QuantizedAvatarState& getCurrentState() { return _currentState; }
+    
+    /// our avatar as of this frame as a full state broadcast record, encoded once and copied in for every agent that
+    /// has no baseline for it - not changed while the broadcast packets are being assembled
+    const QByteArray& getFullStateRecord() const { return _fullStateRecord; }
+    void setFullStateRecord(const QByteArray& fullStateRecord) { _fullStateRecord = fullStateRecord; }
+    
+    /// direction the agent is looking in, from its body and head angles
+    glm::vec3 getViewDirection() const;
+    
+    uint16_t getNextBroadcastSequence() { return _nextBroadcastSequence++; }
+    
+    /// \return the frame in which the avatar with sessionLocalID was last sent to this agent, -1 if it never was
+    int getLastBroadcastFrame(uint16_t sessionLocalID) const;
+    
+    AvatarBroadcastHistory& getBroadcastHistory(uint16_t sessionLocalID) { return _broadcastHistories[sessionLocalID]; }
+    
+    /// forgets the avatars that haven't been sent since oldestFrame, so entries for departed nodes don't pile up
+    void removeBroadcastHistoriesBefore(int oldestFrame);
+    
+    /// packets assembled for this agent this frame, waiting to be sent
+    QList<QByteArray>& getPendingBroadcastPackets() { return _pendingBroadcastPackets; }
+    
+    void recordBroadcast(int numBytesSent, int numAvatarsSkipped);
+    
+    int getNumBytesSent() const { return _numBytesSent; }
+    int getNumAvatarsSkipped() const { return _numAvatarsSkipped; }
+    void resetBroadcastStats();
+private:
+    /// promotes the newest acknowledged state of each avatar to its baseline
+    void processAcknowledgement(uint16_t latestSequence, uint16_t receivedMask);
+    
+    uint16_t _sessionLocalID;
+    QuantizedAvatarState _currentState;
+    QByteArray _fullStateRecord;
+    
+    uint16_t _nextBroadcastSequence;
+    QHash<uint16_t, AvatarBroadcastHistory> _broadcastHistories;
+    QList<QByteArray> _pendingBroadcastPackets;
+    
+    int _numBytesSent;
+    int _numAvatarsSkipped;
+};
+
+#endif /* defined(__hifi__AvatarMixerClientData__) */
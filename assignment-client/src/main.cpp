@@ -12,6 +12,8 @@
 #include <sys/time.h>
 #include <sys/wait.h>
 
+#include <algorithm>
+
 #include <Logging.h>
 #include <NodeList.h>
 #include <PacketHeaders.h>
@@ -31,12 +33,14 @@ HifiSockAddr customAssignmentSocket;
 int numForks = 0;
 Assignment::Type overiddenAssignmentType = Assignment::AllTypes;
 const char* assignmentPool = NULL;
+int maxHostedAgents = 1;
 
 int argc = 0;
 char** argv = NULL;
 
 int childClient() {
-    AssignmentClient client(::argc, ::argv, ::overiddenAssignmentType, customAssignmentSocket, ::assignmentPool);
+    AssignmentClient client(::argc, ::argv, ::overiddenAssignmentType, customAssignmentSocket, ::assignmentPool,
+                            ::maxHostedAgents);
     return client.exec();
 }
 
@@ -143,6 +147,14 @@ int main(int argc, char* argv[]) {
     
     const char ASSIGNMENT_POOL_OPTION[] = "--pool";
     ::assignmentPool = getCmdOption(argc, (const char**) argv, ASSIGNMENT_POOL_OPTION);
+    
+    // with this option each assignment client only takes agent assignments, and runs up to this many of them at once
+    const char MAX_HOSTED_AGENTS_OPTION[] = "--agents";
+    const char* maxHostedAgentsString = getCmdOption(argc, (const char**) argv, MAX_HOSTED_AGENTS_OPTION);
+    
+    if (maxHostedAgentsString) {
+        ::maxHostedAgents = std::max(1, atoi(maxHostedAgentsString));
+    }
 
     const char* NUM_FORKS_PARAMETER = "-n";
     const char* numForksString = getCmdOption(argc, (const char**)argv, NUM_FORKS_PARAMETER);
@@ -0,0 +1,101 @@
+//
+//  AssignmentQueue.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include "AssignmentQueue.h"
+
+AssignmentQueue::AssignmentQueue() :
+    _buckets(),
+    _entriesByUUID(),
+    _nextSequence(0)
+{
+}
+
+void AssignmentQueue::push(Assignment* assignment) {
+    // an assignment is only ever queued once
+    remove(assignment->getUUID());
+    
+    Bucket& bucket = _buckets[BucketKey(assignment->getType(), QByteArray(assignment->getPool()))];
+    
+    Entry newEntry = { assignment, _nextSequence++ };
+    bucket.push_back(newEntry);
+    
+    EntryLocation location = { &bucket, --bucket.end() };
+    _entriesByUUID.insert(assignment->getUUID(), location);
+}
+
+Assignment* AssignmentQueue::find(const QUuid& uuid) const {
+    QHash<QUuid, EntryLocation>::const_iterator location = _entriesByUUID.find(uuid);
+    return (location != _entriesByUUID.end()) ? location->entry->assignment : NULL;
+}
+
+void AssignmentQueue::remove(const QUuid& uuid) {
+    QHash<QUuid, EntryLocation>::iterator location = _entriesByUUID.find(uuid);
+    if (location != _entriesByUUID.end()) {
+        removeEntry(*location);
+    }
+}
+
+void AssignmentQueue::removeEntry(const EntryLocation& location) {
+    // copy what's needed out of the location first, since it lives in the hash it's being removed from
+    Bucket* bucket = location.bucket;
+    Bucket::iterator entry = location.entry;
+    
+    _entriesByUUID.remove(entry->assignment->getUUID());
+    bucket->erase(entry);
+}
+
+AssignmentQueue::Bucket* AssignmentQueue::findNonEmptyBucket(int type, const char* pool) {
+    std::map<BucketKey, Bucket>::iterator bucket = _buckets.find(BucketKey(type, QByteArray(pool)));
+    return (bucket != _buckets.end() && !bucket->second.empty()) ? &bucket->second : NULL;
+}
+
+Assignment* AssignmentQueue::deployableAssignmentForRequest(const Assignment& requestAssignment) {
+    Bucket* oldestBucket = NULL;
+    
+    if (requestAssignment.getType() == Assignment::AllTypes) {
+        // the requestor will take any type, so it gets the longest waiting of the first assignments of each type
+        for (int type = 0; type < Assignment::AllTypes; type++) {
+            Bucket* bucket = findNonEmptyBucket(type, requestAssignment.getPool());
+            
+            if (bucket && (!oldestBucket || bucket->front().sequence < oldestBucket->front().sequence)) {
+                oldestBucket = bucket;
+            }
+        }
+    } else {
+        oldestBucket = findNonEmptyBucket(requestAssignment.getType(), requestAssignment.getPool());
+    }
+    
+    if (!oldestBucket) {
+        return NULL;
+    }
+    
+    Assignment* deployableAssignment = oldestBucket->front().assignment;
+    
+    if (deployableAssignment->getType() == Assignment::AgentType) {
+        // if there is more than one instance to send out, simply decrease the number of instances
+        if (deployableAssignment->getNumberOfInstances() == 1) {
+            remove(deployableAssignment->getUUID());
+        }
+        
+        deployableAssignment->decrementNumberOfInstances();
+    } else {
+        // until we get a check-in from that GUID
+        // put assignment back in queue but stick it at the back so the others have a chance to go out
+        oldestBucket->front().sequence = _nextSequence++;
+        oldestBucket->splice(oldestBucket->end(), *oldestBucket, oldestBucket->begin());
+    }
+    
+    return deployableAssignment;
+}
+
+void AssignmentQueue::getAssignments(std::vector<Assignment*>& assignments) const {
+    for (std::map<BucketKey, Bucket>::const_iterator bucket = _buckets.begin(); bucket != _buckets.end(); ++bucket) {
+        for (Bucket::const_iterator entry = bucket->second.begin(); entry != bucket->second.end(); ++entry) {
+            assignments.push_back(entry->assignment);
+        }
+    }
+}
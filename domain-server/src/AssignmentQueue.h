@@ -0,0 +1,71 @@
+//
+//  AssignmentQueue.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__AssignmentQueue__
+#define __hifi__AssignmentQueue__
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+
+#include <Assignment.h>
+
+/// The assignments waiting to be handed out by the domain-server. They are kept in one FIFO for each type and pool, so a
+/// request is matched without looking at the assignments it can't take, and indexed by UUID so that check-ins find and
+/// remove theirs directly. Every assignment is also stamped with when it was queued, so that a request for all types still
+/// gets the one that has waited the longest.
+/// The queue isn't thread-safe, the domain-server guards it with a mutex.
+class AssignmentQueue {
+public:
+    AssignmentQueue();
+    
+    /// queues the assignment behind the others of its type and pool
+    void push(Assignment* assignment);
+    
+    /// \return the queued assignment with this UUID, or NULL if there isn't one
+    Assignment* find(const QUuid& uuid) const;
+    
+    void remove(const QUuid& uuid);
+    
+    /// Picks the assignment that has waited longest of those with the pool and type (or any type) of the request. An agent
+    /// assignment with instances left stays where it is, any other goes to the back of its queue until the
+    /// assignment-client that took it checks in.
+    /// \return the assignment to deploy, or NULL if none match the request
+    Assignment* deployableAssignmentForRequest(const Assignment& requestAssignment);
+    
+    int size() const { return _entriesByUUID.size(); }
+    
+    /// adds every queued assignment to the vector, in no particular order
+    void getAssignments(std::vector<Assignment*>& assignments) const;
+
+private:
+    struct Entry {
+        Assignment* assignment;
+        uint64_t sequence;
+    };
+    
+    typedef std::list<Entry> Bucket;
+    typedef std::pair<int, QByteArray> BucketKey;
+    
+    struct EntryLocation {
+        Bucket* bucket;
+        Bucket::iterator entry;
+    };
+    
+    Bucket* findNonEmptyBucket(int type, const char* pool);
+    void removeEntry(const EntryLocation& location);
+    
+    // buckets are never erased, so the pointers to them stay good
+    std::map<BucketKey, Bucket> _buckets;
+    QHash<QUuid, EntryLocation> _entriesByUUID;
+    uint64_t _nextSequence;
+};
+
+#endif /* defined(__hifi__AssignmentQueue__) */
@@ -0,0 +1,85 @@
+//
+//  DomainListPacker.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <string.h>
+
+#include <NodeList.h>
+#include <PacketHeaders.h>
+#include <UUID.h>
+
+#include "DomainListPacker.h"
+
+DomainListPacker::DomainListPacker(BatchedUdpSocket& socket, const HifiSockAddr& destinationSockAddr,
+                                   bool isFullList, uint32_t fromVersion, uint32_t toVersion) :
+    _socket(socket),
+    _destinationSockAddr(destinationSockAddr),
+    _isFullList(isFullList),
+    _fromVersion(fromVersion),
+    _toVersion(toVersion),
+    _packetPosition(_packet),
+    _packetIndex(0)
+{
+    startPacket();
+}
+
+void DomainListPacker::startPacket() {
+    _packetPosition = _packet + populateTypeAndVersion(_packet, PACKET_TYPE_DOMAIN);
+    
+    // the flags are filled in once we know whether this is the last packet
+    *_packetPosition++ = 0;
+    
+    memcpy(_packetPosition, &_fromVersion, sizeof(_fromVersion));
+    _packetPosition += sizeof(_fromVersion);
+    memcpy(_packetPosition, &_toVersion, sizeof(_toVersion));
+    _packetPosition += sizeof(_toVersion);
+    memcpy(_packetPosition, &_packetIndex, sizeof(_packetIndex));
+    _packetPosition += sizeof(_packetIndex);
+}
+
+void DomainListPacker::queuePacket(bool isLastPacket) {
+    unsigned char* flags = _packet + numBytesForPacketHeader(_packet);
+    *flags = (_isFullList ? DOMAIN_LIST_FULL_FLAG : 0) | (isLastPacket ? DOMAIN_LIST_LAST_PACKET_FLAG : 0);
+    
+    _socket.queueDatagram((char*) _packet, _packetPosition - _packet, _destinationSockAddr);
+    _packetIndex++;
+}
+
+void DomainListPacker::makeRoomForNode() {
+    if (_packetPosition + DOMAIN_LIST_NODE_BYTES > _packet + MAX_PACKET_SIZE) {
+        queuePacket(false);
+        startPacket();
+    }
+}
+
+void DomainListPacker::addNode(Node* node) {
+    makeRoomForNode();
+    
+    *_packetPosition++ = DOMAIN_LIST_NODE_ADDED_OR_CHANGED;
+    *_packetPosition++ = node->getType();
+    
+    QByteArray rfcUUID = node->getUUID().toRfc4122();
+    memcpy(_packetPosition, rfcUUID.constData(), rfcUUID.size());
+    _packetPosition += rfcUUID.size();
+    
+    _packetPosition += HifiSockAddr::packSockAddr(_packetPosition, node->getPublicSocket());
+    _packetPosition += HifiSockAddr::packSockAddr(_packetPosition, node->getLocalSocket());
+}
+
+void DomainListPacker::addRemovedNode(NODE_TYPE nodeType, const QUuid& nodeUUID) {
+    makeRoomForNode();
+    
+    *_packetPosition++ = DOMAIN_LIST_NODE_REMOVED;
+    *_packetPosition++ = nodeType;
+    
+    QByteArray rfcUUID = nodeUUID.toRfc4122();
+    memcpy(_packetPosition, rfcUUID.constData(), rfcUUID.size());
+    _packetPosition += rfcUUID.size();
+}
+
+void DomainListPacker::finish() {
+    queuePacket(true);
+}
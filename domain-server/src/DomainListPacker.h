@@ -0,0 +1,51 @@
+//
+//  DomainListPacker.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__DomainListPacker__
+#define __hifi__DomainListPacker__
+
+#include <stdint.h>
+
+#include <BatchedUdpSocket.h>
+#include <Node.h>
+#include <NodeTypes.h>
+
+/// Packs the domain-server's reply to a check-in - either the full list of nodes or the changes between two versions of
+/// it - into as many PACKET_TYPE_DOMAIN packets as it takes, queueing each one on the socket as it fills.
+class DomainListPacker {
+public:
+    DomainListPacker(BatchedUdpSocket& socket, const HifiSockAddr& destinationSockAddr,
+                     bool isFullList, uint32_t fromVersion, uint32_t toVersion);
+    
+    /// adds a node that was added or whose sockets changed, or any node for a full list
+    void addNode(Node* node);
+    
+    void addRemovedNode(NODE_TYPE nodeType, const QUuid& nodeUUID);
+    
+    /// queues the last packet of the reply, which goes out even with no nodes in it since it's how the node knows
+    /// the domain-server heard its check-in
+    void finish();
+
+private:
+    void startPacket();
+    void queuePacket(bool isLastPacket);
+    
+    /// queues the packet and starts the next one if a node wouldn't fit in what's left of it
+    void makeRoomForNode();
+    
+    BatchedUdpSocket& _socket;
+    HifiSockAddr _destinationSockAddr;
+    bool _isFullList;
+    uint32_t _fromVersion;
+    uint32_t _toVersion;
+    
+    unsigned char _packet[MAX_PACKET_SIZE];
+    unsigned char* _packetPosition;
+    uint16_t _packetIndex;
+};
+
+#endif /* defined(__hifi__DomainListPacker__) */
@@ -11,6 +11,7 @@
 
 #include <QtCore/QJsonDocument>
 #include <QtCore/QJsonObject>
+#include <QtCore/QSet>
 #include <QtCore/QStringList>
 #include <QtCore/QTimer>
 
@@ -18,6 +19,7 @@
 #include <SharedUtil.h>
 #include <UUID.h>
 
+#include "DomainListPacker.h"
 #include "DomainServer.h"
 
 const int RESTART_HOLD_TIME_MSECS = 5 * 1000;
@@ -34,13 +36,29 @@ DomainServer::DomainServer(int argc, char* argv[]) :
     QCoreApplication(argc, argv),
     _assignmentQueueMutex(),
     _assignmentQueue(),
+    _nodeListChangesMutex(),
+    _nodeListChanges(),
+    _nodeListVersion(NO_DOMAIN_LIST_VERSION),
+    _oldestDeltaVersion(NO_DOMAIN_LIST_VERSION),
+    _scriptFrameReportsMutex(),
+    _scriptFrameReports(),
     _staticAssignmentFile(QString("%1/config.ds").arg(QCoreApplication::applicationDirPath())),
     _staticAssignmentFileData(NULL),
+    _staticAssignments(NULL),
+    _numStaticAssignments(0),
+    _staticAssignmentsByUUID(),
+    _audioMixerConfig(NULL),
+    _avatarMixerConfig(NULL),
     _voxelServerConfig(NULL),
     _hasCompletedRestartHold(false)
 {
     DomainServer::setDomainServerInstance(this);
     
+    // start the versions of the node list somewhere random, so a version a node kept from before a restart isn't
+    // mistaken for one of ours
+    _nodeListVersion = QUuid::createUuid().data1;
+    _oldestDeltaVersion = _nodeListVersion;
+    
     signal(SIGINT, signalhandler);
     
     const char CUSTOM_PORT_OPTION[] = "-p";
@@ -49,6 +67,12 @@ DomainServer::DomainServer(int argc, char* argv[]) :
     
     NodeList* nodeList = NodeList::createInstance(NODE_TYPE_DOMAIN, domainServerPort);
     
+    const char AUDIO_CONFIG_OPTION[] = "--audioMixerConfig";
+    _audioMixerConfig = getCmdOption(argc, (const char**) argv, AUDIO_CONFIG_OPTION);
+    
+    const char AVATAR_CONFIG_OPTION[] = "--avatarMixerConfig";
+    _avatarMixerConfig = getCmdOption(argc, (const char**) argv, AVATAR_CONFIG_OPTION);
+    
     const char VOXEL_CONFIG_OPTION[] = "--voxelServerConfig";
     _voxelServerConfig = getCmdOption(argc, (const char**) argv, VOXEL_CONFIG_OPTION);
 
@@ -75,10 +99,10 @@ DomainServer::DomainServer(int argc, char* argv[]) :
     
     nodeList->addHook(this);
     
-    if (!_staticAssignmentFile.exists() || _voxelServerConfig) {
+    if (!_staticAssignmentFile.exists() || _voxelServerConfig || _audioMixerConfig || _avatarMixerConfig) {
         
-        if (_voxelServerConfig) {
-            // we have a new VS config, clear the existing file to start fresh
+        if (_voxelServerConfig || _audioMixerConfig || _avatarMixerConfig) {
+            // we have a new VS or mixer config, clear the existing file to start fresh
             _staticAssignmentFile.remove();
         }
         
@@ -90,6 +114,17 @@ DomainServer::DomainServer(int argc, char* argv[]) :
     _staticAssignmentFileData = _staticAssignmentFile.map(0, _staticAssignmentFile.size());
     
     _staticAssignments = (Assignment*) _staticAssignmentFileData;
+    _numStaticAssignments = _staticAssignmentFile.size() / sizeof(Assignment);
+    
+    for (int i = 0; i < _numStaticAssignments; i++) {
+        if (_staticAssignments[i].getUUID().isNull()) {
+            // files written before the static assignments were unlimited are padded with blank ones, stop at those
+            _numStaticAssignments = i;
+            break;
+        }
+        
+        _staticAssignmentsByUUID.insert(_staticAssignments[i].getUUID(), &_staticAssignments[i]);
+    }
     
     QTimer* silentNodeTimer = new QTimer(this);
     connect(silentNodeTimer, SIGNAL(timeout()), nodeList, SLOT(removeSilentNodes()));
@@ -108,145 +143,179 @@ void DomainServer::readAvailableDatagrams() {
     
     HifiSockAddr senderSockAddr, nodePublicAddress, nodeLocalAddress;
     
-    static unsigned char packetData[MAX_PACKET_SIZE];
-    
     static unsigned char broadcastPacket[MAX_PACKET_SIZE];
     
-    static unsigned char* currentBufferPos;
-    static unsigned char* startPointer;
+    BatchedUdpSocket& batchedNodeSocket = nodeList->getBatchedNodeSocket();
+    int numDatagrams = 0;
     
-    int receivedBytes = 0;
-    
-    while (nodeList->getNodeSocket().hasPendingDatagrams()) {
-        if ((receivedBytes = nodeList->getNodeSocket().readDatagram((char*) packetData, MAX_PACKET_SIZE,
-                                                   senderSockAddr.getAddressPointer(),
-                                                   senderSockAddr.getPortPointer()))
-            && packetVersionMatch((unsigned char*) packetData)) {
-            if (packetData[0] == PACKET_TYPE_DOMAIN_REPORT_FOR_DUTY || packetData[0] == PACKET_TYPE_DOMAIN_LIST_REQUEST) {
-                // this is an RFD or domain list request packet, and there is a version match
-                
-                int numBytesSenderHeader = numBytesForPacketHeader((unsigned char*) packetData);
-                
-                NODE_TYPE nodeType = *(packetData + numBytesSenderHeader);
-                
-                int packetIndex = numBytesSenderHeader + sizeof(NODE_TYPE);
-                QUuid nodeUUID = QUuid::fromRfc4122(QByteArray(((char*) packetData + packetIndex), NUM_BYTES_RFC4122_UUID));
-                packetIndex += NUM_BYTES_RFC4122_UUID;
-                
-                int numBytesPrivateSocket = HifiSockAddr::unpackSockAddr(packetData + packetIndex, nodePublicAddress);
-                packetIndex += numBytesPrivateSocket;
-                
-                if (nodePublicAddress.getAddress().isNull()) {
-                    // this node wants to use us its STUN server
-                    // so set the node public address to whatever we perceive the public address to be
+    do {
+        numDatagrams = batchedNodeSocket.readPendingDatagrams();
+        
+        for (int datagramIndex = 0; datagramIndex < numDatagrams; datagramIndex++) {
+            const ReceivedDatagram& datagram = batchedNodeSocket.getReceivedDatagram(datagramIndex);
+            
+            unsigned char* packetData = datagram.data;
+            int receivedBytes = datagram.size;
+            senderSockAddr = datagram.senderSockAddr;
+            
+            if (packetVersionMatch(packetData)) {
+                if (packetData[0] == PACKET_TYPE_DOMAIN_REPORT_FOR_DUTY || packetData[0] == PACKET_TYPE_DOMAIN_LIST_REQUEST) {
+                    // this is an RFD or domain list request packet, and there is a version match
                     
-                    // if the sender is on our box then leave its public address to 0 so that
-                    // other users attempt to reach it on the same address they have for the domain-server
-                    if (senderSockAddr.getAddress().isLoopback()) {
-                        nodePublicAddress.setAddress(QHostAddress());
-                    } else {
-                        nodePublicAddress.setAddress(senderSockAddr.getAddress());
-                    }
-                }
-                
-                int numBytesPublicSocket = HifiSockAddr::unpackSockAddr(packetData + packetIndex, nodeLocalAddress);
-                packetIndex += numBytesPublicSocket;
-                
-                const char STATICALLY_ASSIGNED_NODES[3] = {
-                    NODE_TYPE_AUDIO_MIXER,
-                    NODE_TYPE_AVATAR_MIXER,
-                    NODE_TYPE_VOXEL_SERVER
-                };
-                
-                Assignment* matchingStaticAssignment = NULL;
-                
-                if (memchr(STATICALLY_ASSIGNED_NODES, nodeType, sizeof(STATICALLY_ASSIGNED_NODES)) == NULL
-                    || ((matchingStaticAssignment = matchingStaticAssignmentForCheckIn(nodeUUID, nodeType))
-                        || checkInWithUUIDMatchesExistingNode(nodePublicAddress,
-                                                              nodeLocalAddress,
-                                                              nodeUUID)))
-                {
-                    Node* checkInNode = nodeList->addOrUpdateNode(nodeUUID,
-                                                                  nodeType,
-                                                                  nodePublicAddress,
-                                                                  nodeLocalAddress);
+                    int numBytesSenderHeader = numBytesForPacketHeader((unsigned char*) packetData);
+                    
+                    NODE_TYPE nodeType = *(packetData + numBytesSenderHeader);
                     
-                    if (matchingStaticAssignment) {
-                        // this was a newly added node with a matching static assignment
+                    int packetIndex = numBytesSenderHeader + sizeof(NODE_TYPE);
+                    QUuid nodeUUID = QUuid::fromRfc4122(QByteArray(((char*) packetData + packetIndex), NUM_BYTES_RFC4122_UUID));
+                    packetIndex += NUM_BYTES_RFC4122_UUID;
+                    
+                    int numBytesPrivateSocket = HifiSockAddr::unpackSockAddr(packetData + packetIndex, nodePublicAddress);
+                    packetIndex += numBytesPrivateSocket;
+                    
+                    if (nodePublicAddress.getAddress().isNull()) {
+                        // this node wants to use us its STUN server
+                        // so set the node public address to whatever we perceive the public address to be
                         
-                        if (_hasCompletedRestartHold) {
-                            // remove the matching assignment from the assignment queue so we don't take the next check in
-                            removeAssignmentFromQueue(matchingStaticAssignment);
+                        // if the sender is on our box then leave its public address to 0 so that
+                        // other users attempt to reach it on the same address they have for the domain-server
+                        if (senderSockAddr.getAddress().isLoopback()) {
+                            nodePublicAddress.setAddress(QHostAddress());
+                        } else {
+                            nodePublicAddress.setAddress(senderSockAddr.getAddress());
                         }
-                        
-                        // set the linked data for this node to a copy of the matching assignment
-                        // so we can re-queue it should the node die
-                        Assignment* nodeCopyOfMatchingAssignment = new Assignment(*matchingStaticAssignment);
-                        
-                        checkInNode->setLinkedData(nodeCopyOfMatchingAssignment);
                     }
                     
-                    int numHeaderBytes = populateTypeAndVersion(broadcastPacket, PACKET_TYPE_DOMAIN);
+                    int numBytesPublicSocket = HifiSockAddr::unpackSockAddr(packetData + packetIndex, nodeLocalAddress);
+                    packetIndex += numBytesPublicSocket;
                     
-                    currentBufferPos = broadcastPacket + numHeaderBytes;
-                    startPointer = currentBufferPos;
+                    const char STATICALLY_ASSIGNED_NODES[3] = {
+                        NODE_TYPE_AUDIO_MIXER,
+                        NODE_TYPE_AVATAR_MIXER,
+                        NODE_TYPE_VOXEL_SERVER
+                    };
                     
-                    unsigned char* nodeTypesOfInterest = packetData + packetIndex + sizeof(unsigned char);
-                    int numInterestTypes = *(nodeTypesOfInterest - 1);
+                    Assignment* matchingStaticAssignment = NULL;
                     
-                    if (numInterestTypes > 0) {
-                        // if the node has sent no types of interest, assume they want nothing but their own ID back
-                        for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
-                            if (node->getUUID() != nodeUUID &&
-                                memchr(nodeTypesOfInterest, node->getType(), numInterestTypes)) {
-                                
-                                // don't send avatar nodes to other avatars, that will come from avatar mixer
-                                if (nodeType != NODE_TYPE_AGENT || node->getType() != NODE_TYPE_AGENT) {
-                                    currentBufferPos = addNodeToBroadcastPacket(currentBufferPos, &(*node));
-                                }
-                                
+                    if (memchr(STATICALLY_ASSIGNED_NODES, nodeType, sizeof(STATICALLY_ASSIGNED_NODES)) == NULL
+                        || ((matchingStaticAssignment = matchingStaticAssignmentForCheckIn(nodeUUID, nodeType))
+                            || checkInWithUUIDMatchesExistingNode(nodePublicAddress,
+                                                                  nodeLocalAddress,
+                                                                  nodeUUID)))
+                    {
+                        Node* existingNode = nodeList->nodeWithUUID(nodeUUID);
+                        bool socketsChanged = existingNode
+                            && (nodePublicAddress != existingNode->getPublicSocket()
+                                || nodeLocalAddress != existingNode->getLocalSocket());
+                        
+                        Node* checkInNode = nodeList->addOrUpdateNode(nodeUUID,
+                                                                      nodeType,
+                                                                      nodePublicAddress,
+                                                                      nodeLocalAddress);
+                        
+                        if (socketsChanged) {
+                            // the nodes that know this one need its new sockets, new nodes were recorded by nodeAdded
+                            recordNodeListChange(checkInNode, false);
+                        }
+                        
+                        if (matchingStaticAssignment) {
+                            // this was a newly added node with a matching static assignment
+                            
+                            if (_hasCompletedRestartHold) {
+                                // remove the matching assignment from the assignment queue so we don't take the next check in
+                                removeAssignmentFromQueue(matchingStaticAssignment);
                             }
+                            
+                            // set the linked data for this node to a copy of the matching assignment
+                            // so we can re-queue it should the node die
+                            Assignment* nodeCopyOfMatchingAssignment = new Assignment(*matchingStaticAssignment);
+                            
+                            checkInNode->setLinkedData(nodeCopyOfMatchingAssignment);
+                        }
+                        
+                        unsigned char* nodeTypesOfInterest = packetData + packetIndex + sizeof(unsigned char);
+                        int numInterestTypes = *(nodeTypesOfInterest - 1);
+                        
+                        // the version of the node list the node has, if it has sent one
+                        uint32_t knownListVersion = NO_DOMAIN_LIST_VERSION;
+                        unsigned char* knownListVersionPosition = nodeTypesOfInterest + numInterestTypes;
+                        
+                        if (knownListVersionPosition + sizeof(knownListVersion) <= packetData + receivedBytes) {
+                            memcpy(&knownListVersion, knownListVersionPosition, sizeof(knownListVersion));
                         }
+                        
+                        // update last receive to now
+                        uint64_t timeNow = usecTimestampNow();
+                        checkInNode->setLastHeardMicrostamp(timeNow);
+                        
+                        // send the list, or what changed in it, back to this node
+                        sendDomainList(checkInNode, nodeTypesOfInterest, numInterestTypes, knownListVersion,
+                                       senderSockAddr);
                     }
+                } else if (packetData[0] == PACKET_TYPE_REQUEST_ASSIGNMENT) {
                     
-                    // update last receive to now
-                    uint64_t timeNow = usecTimestampNow();
-                    checkInNode->setLastHeardMicrostamp(timeNow);
+                    qDebug("Received a request for assignment.\n");
                     
-                    // send the constructed list back to this node
-                    nodeList->getNodeSocket().writeDatagram((char*) broadcastPacket,
-                                                            (currentBufferPos - startPointer) + numHeaderBytes,
-                                                            senderSockAddr.getAddress(), senderSockAddr.getPort());
-                }
-            } else if (packetData[0] == PACKET_TYPE_REQUEST_ASSIGNMENT) {
-                
-                qDebug("Received a request for assignment.\n");
-                
-                if (_assignmentQueue.size() > 0) {
-                    // construct the requested assignment from the packet data
-                    Assignment requestAssignment(packetData, receivedBytes);
-                    
-                    Assignment* assignmentToDeploy = deployableAssignmentForRequest(requestAssignment);
-                    
-                    if (assignmentToDeploy) {
-                        
-                        // give this assignment out, either the type matches or the requestor said they will take any
-                        int numHeaderBytes = populateTypeAndVersion(broadcastPacket, PACKET_TYPE_CREATE_ASSIGNMENT);
-                        int numAssignmentBytes = assignmentToDeploy->packToBuffer(broadcastPacket + numHeaderBytes);
+                    if (_assignmentQueue.size() > 0) {
+                        // construct the requested assignment from the packet data
+                        Assignment requestAssignment(packetData, receivedBytes);
                         
-                        nodeList->getNodeSocket().writeDatagram((char*) broadcastPacket, numHeaderBytes + numAssignmentBytes,
-                                                                senderSockAddr.getAddress(), senderSockAddr.getPort());
+                        Assignment* assignmentToDeploy = deployableAssignmentForRequest(requestAssignment);
                         
-                        if (assignmentToDeploy->getNumberOfInstances() == 0) {
-                            // there are no more instances of this script to send out, delete it
-                            delete assignmentToDeploy;
+                        if (assignmentToDeploy) {
+                            
+                            // give this assignment out, either the type matches or the requestor said they will take any
+                            int numHeaderBytes = populateTypeAndVersion(broadcastPacket, PACKET_TYPE_CREATE_ASSIGNMENT);
+                            int numAssignmentBytes = assignmentToDeploy->packToBuffer(broadcastPacket + numHeaderBytes);
+                            
+                            batchedNodeSocket.queueDatagram((char*) broadcastPacket, numHeaderBytes + numAssignmentBytes,
+                                                            senderSockAddr);
+                            
+                            if (assignmentToDeploy->getNumberOfInstances() == 0) {
+                                // there are no more instances of this script to send out, delete it
+                                delete assignmentToDeploy;
+                            }
                         }
+                        
                     }
-                    
+                } else if (packetData[0] == PACKET_TYPE_SCRIPT_FRAME_STATS) {
+                    processScriptFrameStats(packetData, receivedBytes);
                 }
             }
         }
+        
+        // the replies to this batch go out together
+        batchedNodeSocket.flush();
+    } while (numDatagrams == MAX_DATAGRAMS_PER_BATCH);
+}
+
+void DomainServer::processScriptFrameStats(unsigned char* packetData, int numBytes) {
+    int numBytesPacketHeader = numBytesForPacketHeader(packetData);
+    
+    QUuid assignmentUUID;
+    ReceivedScriptFrameReport receivedReport;
+    
+    if (ScriptFrameStats::unpackReport(packetData + numBytesPacketHeader, numBytes - numBytesPacketHeader,
+                                       assignmentUUID, receivedReport.report) == 0) {
+        return;
     }
+    receivedReport.receivedAt = usecTimestampNow();
+    
+    _scriptFrameReportsMutex.lock();
+    
+    // say so when a script has overrun more of its frames since it last reported
+    QHash<QUuid, ReceivedScriptFrameReport>::iterator previousReport = _scriptFrameReports.find(assignmentUUID);
+    uint32_t previousOverruns = (previousReport != _scriptFrameReports.end()) ? previousReport->report.numOverruns : 0;
+    
+    if (receivedReport.report.numOverruns > previousOverruns) {
+        qDebug() << "Script for assignment" << uuidStringWithoutCurlyBraces(assignmentUUID) << "overran"
+            << receivedReport.report.numOverruns - previousOverruns << "more frames, p99 callback"
+            << receivedReport.report.p99CallbackUsecs << "usecs at" << receivedReport.report.framesPerSecond << "FPS\n";
+    }
+    
+    _scriptFrameReports.insert(assignmentUUID, receivedReport);
+    
+    _scriptFrameReportsMutex.unlock();
 }
 
 void DomainServer::setDomainServerInstance(DomainServer* domainServer) {
@@ -326,9 +395,13 @@ int DomainServer::civetwebRequestHandler(struct mg_connection *connection) {
             QJsonObject queuedAssignmentsJSON;
             
             // add the queued but unfilled assignments to the json
-            std::deque<Assignment*>::iterator assignment = domainServerInstance->_assignmentQueue.begin();
+            std::vector<Assignment*> queuedAssignments;
+            
+            domainServerInstance->_assignmentQueueMutex.lock();
+            domainServerInstance->_assignmentQueue.getAssignments(queuedAssignments);
             
-            while (assignment != domainServerInstance->_assignmentQueue.end()) {
+            for (std::vector<Assignment*>::iterator assignment = queuedAssignments.begin();
+                 assignment != queuedAssignments.end(); assignment++) {
                 QJsonObject queuedAssignmentJSON;
                 
                 QString uuidString = uuidStringWithoutCurlyBraces((*assignment)->getUUID());
@@ -341,11 +414,11 @@ int DomainServer::civetwebRequestHandler(struct mg_connection *connection) {
                 
                 // add this queued assignment to the JSON
                 queuedAssignmentsJSON[uuidString] = queuedAssignmentJSON;
-                
-                // push forward the iterator to check the next assignment
-                assignment++;
             }
             
+            // the main thread deletes agent assignments once they're all handed out, so hold the lock until we're done
+            domainServerInstance->_assignmentQueueMutex.unlock();
+            
             assignmentJSON["queued"] = queuedAssignmentsJSON;
             
             // print out the created JSON
@@ -377,6 +450,59 @@ int DomainServer::civetwebRequestHandler(struct mg_connection *connection) {
             QJsonDocument nodesDocument(rootJSON);
             mg_printf(connection, "%s", nodesDocument.toJson().constData());
             
+            // we've processed this request
+            return 1;
+        } else if (strcmp(ri->uri, "/scripts.json") == 0) {
+            // start with a 200 response
+            mg_printf(connection, "%s", RESPONSE_200);
+            
+            // setup the JSON
+            QJsonObject rootJSON;
+            QJsonObject scriptsJSON;
+            
+            uint64_t now = usecTimestampNow();
+            
+            domainServerInstance->_scriptFrameReportsMutex.lock();
+            
+            QHash<QUuid, ReceivedScriptFrameReport>::iterator receivedReport =
+                domainServerInstance->_scriptFrameReports.begin();
+            
+            while (receivedReport != domainServerInstance->_scriptFrameReports.end()) {
+                if (now - receivedReport->receivedAt > SCRIPT_FRAME_REPORT_EXPIRY_USECS) {
+                    // this script's agent has gone away, forget it
+                    receivedReport = domainServerInstance->_scriptFrameReports.erase(receivedReport);
+                    continue;
+                }
+                
+                const ScriptFrameReport& report = receivedReport->report;
+                QJsonObject scriptJSON;
+                
+                scriptJSON["fps"] = report.framesPerSecond;
+                scriptJSON["shedsOverrunFrames"] = report.shedsOverrunFrames;
+                scriptJSON["medianCallbackUsecs"] = (double) report.medianCallbackUsecs;
+                scriptJSON["p99CallbackUsecs"] = (double) report.p99CallbackUsecs;
+                scriptJSON["maxCallbackUsecs"] = (double) report.maxCallbackUsecs;
+                scriptJSON["frames"] = (double) report.numFrames;
+                scriptJSON["overruns"] = (double) report.numOverruns;
+                scriptJSON["shedFrames"] = (double) report.numShedFrames;
+                
+                // a script is running away when even its typical slow frames take longer than the frames it asked for
+                const float USECS_PER_SECOND = 1000.0f * 1000.0f;
+                scriptJSON["overrunning"] = report.p99CallbackUsecs > USECS_PER_SECOND / report.framesPerSecond;
+                
+                scriptsJSON[uuidStringWithoutCurlyBraces(receivedReport.key())] = scriptJSON;
+                
+                ++receivedReport;
+            }
+            
+            domainServerInstance->_scriptFrameReportsMutex.unlock();
+            
+            rootJSON["scripts"] = scriptsJSON;
+            
+            // print out the created JSON
+            QJsonDocument scriptsDocument(rootJSON);
+            mg_printf(connection, "%s", scriptsDocument.toJson().constData());
+            
             // we've processed this request
             return 1;
         }
@@ -462,7 +588,7 @@ void DomainServer::civetwebUploadHandler(struct mg_connection *connection, const
     // add the script assigment to the assignment queue
     // lock the assignment queue mutex since we're operating on a different thread than DS main
     domainServerInstance->_assignmentQueueMutex.lock();
-    domainServerInstance->_assignmentQueue.push_back(scriptAssignment);
+    domainServerInstance->_assignmentQueue.push(scriptAssignment);
     domainServerInstance->_assignmentQueueMutex.unlock();
 }
 
@@ -470,28 +596,32 @@ void DomainServer::addReleasedAssignmentBackToQueue(Assignment* releasedAssignme
     qDebug() << "Adding assignment" << *releasedAssignment << " back to queue.\n";
     
     // find this assignment in the static file
-    for (int i = 0; i < MAX_STATIC_ASSIGNMENT_FILE_ASSIGNMENTS; i++) {
-        if (_staticAssignments[i].getUUID() == releasedAssignment->getUUID()) {
-            // reset the UUID on the static assignment
-            _staticAssignments[i].resetUUID();
-            
-            // put this assignment back in the queue so it goes out
-            _assignmentQueueMutex.lock();
-            _assignmentQueue.push_back(&_staticAssignments[i]);
-            _assignmentQueueMutex.unlock();
-            
-        } else if (_staticAssignments[i].getUUID().isNull()) {
-            // we are at the blank part of the static assignments - break out
-            break;
-        }
+    Assignment* staticAssignment = _staticAssignmentsByUUID.value(releasedAssignment->getUUID());
+    
+    if (staticAssignment) {
+        // put this assignment back in the queue so it goes out
+        requeueStaticAssignment(staticAssignment);
     }
 }
 
-void DomainServer::nodeAdded(Node* node) {
+void DomainServer::requeueStaticAssignment(Assignment* staticAssignment) {
+    // the assignment goes back out with a fresh UUID, which it has to be found by from now on
+    _staticAssignmentsByUUID.remove(staticAssignment->getUUID());
+    staticAssignment->resetUUID();
+    _staticAssignmentsByUUID.insert(staticAssignment->getUUID(), staticAssignment);
     
+    _assignmentQueueMutex.lock();
+    _assignmentQueue.push(staticAssignment);
+    _assignmentQueueMutex.unlock();
+}
+
+void DomainServer::nodeAdded(Node* node) {
+    recordNodeListChange(node, false);
 }
 
 void DomainServer::nodeKilled(Node* node) {
+    recordNodeListChange(node, true);
+    
     // if this node has linked data it was from an assignment
     if (node->getLinkedData()) {
         Assignment* nodeAssignment =  (Assignment*) node->getLinkedData();
@@ -500,31 +630,146 @@ void DomainServer::nodeKilled(Node* node) {
     }
 }
 
-unsigned char* DomainServer::addNodeToBroadcastPacket(unsigned char* currentPosition, Node* nodeToAdd) {
-    *currentPosition++ = nodeToAdd->getType();
+// whether a node checking in with these types of interest is sent the other node
+bool nodeIsOfInterest(Node* checkInNode, const unsigned char* nodeTypesOfInterest, int numInterestTypes,
+                      NODE_TYPE otherNodeType, const QUuid& otherNodeUUID) {
+    return otherNodeUUID != checkInNode->getUUID()
+        && memchr(nodeTypesOfInterest, otherNodeType, numInterestTypes)
+        // don't send avatar nodes to other avatars, that will come from avatar mixer
+        && (checkInNode->getType() != NODE_TYPE_AGENT || otherNodeType != NODE_TYPE_AGENT);
+}
+
+void DomainServer::sendDomainList(Node* checkInNode, const unsigned char* nodeTypesOfInterest, int numInterestTypes,
+                                  uint32_t knownListVersion, const HifiSockAddr& destinationSockAddr) {
+    NodeList* nodeList = NodeList::getInstance();
     
+    _nodeListChangesMutex.lock();
     
-    QByteArray rfcUUID = nodeToAdd->getUUID().toRfc4122();
-    memcpy(currentPosition, rfcUUID.constData(), rfcUUID.size());
-    currentPosition += rfcUUID.size();
+    // only a version we've handed out and still have the changes since can be brought up to date with changes
+    // the differences are unsigned so that this holds when the versions wrap
+    bool canSendChanges = knownListVersion != NO_DOMAIN_LIST_VERSION
+        && knownListVersion - _oldestDeltaVersion <= _nodeListVersion - _oldestDeltaVersion;
     
-    currentPosition += HifiSockAddr::packSockAddr(currentPosition, nodeToAdd->getPublicSocket());
-    currentPosition += HifiSockAddr::packSockAddr(currentPosition, nodeToAdd->getLocalSocket());
+    DomainListPacker listPacker(nodeList->getBatchedNodeSocket(), destinationSockAddr, !canSendChanges,
+                                canSendChanges ? knownListVersion : NO_DOMAIN_LIST_VERSION, _nodeListVersion);
     
-    // return the new unsigned char * for broadcast packet
-    return currentPosition;
+    if (canSendChanges) {
+        // walk back from the latest change to the first the node hasn't seen, so each node is sent only its latest change
+        QSet<QUuid> changedUUIDs;
+        std::deque<NodeListChange>::reverse_iterator firstSeenChange = _nodeListChanges.rbegin()
+            + (_nodeListVersion - knownListVersion);
+        
+        for (std::deque<NodeListChange>::reverse_iterator change = _nodeListChanges.rbegin();
+             change != firstSeenChange;
+             change++) {
+            
+            if (changedUUIDs.contains(change->uuid)
+                || !nodeIsOfInterest(checkInNode, nodeTypesOfInterest, numInterestTypes, change->type, change->uuid)) {
+                continue;
+            }
+            
+            changedUUIDs.insert(change->uuid);
+            
+            if (change->isRemoval) {
+                listPacker.addRemovedNode(change->type, change->uuid);
+            } else {
+                Node* changedNode = nodeList->nodeWithUUID(change->uuid);
+                if (changedNode) {
+                    listPacker.addNode(changedNode);
+                }
+            }
+        }
+    } else if (numInterestTypes > 0) {
+        // if the node has sent no types of interest, assume they want nothing but their own ID back
+        for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
+            if (nodeIsOfInterest(checkInNode, nodeTypesOfInterest, numInterestTypes, node->getType(), node->getUUID())) {
+                listPacker.addNode(&(*node));
+            }
+        }
+    }
+    
+    _nodeListChangesMutex.unlock();
+    
+    listPacker.finish();
 }
 
-void DomainServer::prepopulateStaticAssignmentFile() {
-    int numFreshStaticAssignments = 0;
+void DomainServer::recordNodeListChange(Node* node, bool isRemoval) {
+    _nodeListChangesMutex.lock();
+    
+    NodeListChange change = { ++_nodeListVersion, node->getUUID(), node->getType(), isRemoval };
+    _nodeListChanges.push_back(change);
     
-    // write a fresh static assignment array to file
+    if (_nodeListChanges.size() > MAX_NODE_LIST_CHANGES) {
+        // nodes that last checked in before this change will be sent the full list
+        _oldestDeltaVersion = _nodeListChanges.front().version;
+        _nodeListChanges.pop_front();
+    }
     
-    Assignment freshStaticAssignments[MAX_STATIC_ASSIGNMENT_FILE_ASSIGNMENTS];
+    _nodeListChangesMutex.unlock();
+}
+
+void DomainServer::prepopulateStaticAssignmentFile() {
+    // write a fresh static assignment array to file, as many as the configs call for
+    
+    std::vector<Assignment> freshStaticAssignments;
     
     // pre-populate the first static assignment list with assignments for root AuM, AvM, VS
-    freshStaticAssignments[numFreshStaticAssignments++] = Assignment(Assignment::CreateCommand, Assignment::AudioMixerType);
-    freshStaticAssignments[numFreshStaticAssignments++] = Assignment(Assignment::CreateCommand, Assignment::AvatarMixerType);
+    
+    // Handle Domain/Audio Mixer configuration command line arguments
+    // each config is given its region with "--region minX,minY,minZ,maxX,maxY,maxZ"
+    if (_audioMixerConfig) {
+        qDebug("Reading Audio Mixer Configuration.\n");
+        qDebug() << "config: " << _audioMixerConfig << "\n";
+        
+        QString multiConfig((const char*) _audioMixerConfig);
+        QStringList multiConfigList = multiConfig.split(";");
+        
+        // read each config to a payload for an AuM assignment
+        for (int i = 0; i < multiConfigList.size(); i++) {
+            QString config = multiConfigList.at(i);
+            
+            qDebug("config[%d]=%s\n", i, config.toLocal8Bit().constData());
+            
+            // Now, parse the config to check for a pool
+            const char ASSIGNMENT_CONFIG_POOL_OPTION[] = "--pool";
+            QString assignmentPool;
+            
+            int poolIndex = config.indexOf(ASSIGNMENT_CONFIG_POOL_OPTION);
+            
+            if (poolIndex >= 0) {
+                int spaceBeforePoolIndex = config.indexOf(' ', poolIndex);
+                int spaceAfterPoolIndex = config.indexOf(' ', spaceBeforePoolIndex + 1);
+                
+                // the pool name runs to the next space, or to the end of the config if it is the last option
+                assignmentPool = config.mid(spaceBeforePoolIndex + 1,
+                                            spaceAfterPoolIndex >= 0 ? spaceAfterPoolIndex - spaceBeforePoolIndex - 1 : -1);
+                qDebug() << "The pool for this audio-mixer-assignment is" << assignmentPool << "\n";
+            }
+            
+            Assignment audioMixerAssignment(Assignment::CreateCommand,
+                                            Assignment::AudioMixerType,
+                                            (assignmentPool.isEmpty() ? NULL : assignmentPool.toLocal8Bit().constData()));
+            
+            int payloadLength = config.length() + sizeof(char);
+            audioMixerAssignment.setPayload((uchar*)config.toLocal8Bit().constData(), payloadLength);
+            
+            freshStaticAssignments.push_back(audioMixerAssignment);
+        }
+    } else {
+        freshStaticAssignments.push_back(Assignment(Assignment::CreateCommand, Assignment::AudioMixerType));
+    }
+    
+    Assignment avatarMixerAssignment(Assignment::CreateCommand, Assignment::AvatarMixerType);
+    
+    if (_avatarMixerConfig) {
+        // there is only ever one avatar mixer, so its config is the payload as is (e.g. "--maxKilobytesPerSecond 128")
+        qDebug() << "Avatar Mixer config: " << _avatarMixerConfig << "\n";
+        
+        int payloadLength = strlen(_avatarMixerConfig) + sizeof(char);
+        avatarMixerAssignment.setPayload((const uchar*) _avatarMixerConfig, payloadLength);
+    }
+    
+    freshStaticAssignments.push_back(avatarMixerAssignment);
     
     // Handle Domain/Voxel Server configuration command line arguments
     if (_voxelServerConfig) {
@@ -548,9 +793,11 @@ void DomainServer::prepopulateStaticAssignmentFile() {
             
             if (poolIndex >= 0) {
                 int spaceBeforePoolIndex = config.indexOf(' ', poolIndex);
-                int spaceAfterPoolIndex = config.indexOf(' ', spaceBeforePoolIndex);
+                int spaceAfterPoolIndex = config.indexOf(' ', spaceBeforePoolIndex + 1);
                 
-                assignmentPool = config.mid(spaceBeforePoolIndex + 1, spaceAfterPoolIndex);
+                // the pool name runs to the next space, or to the end of the config if it is the last option
+                assignmentPool = config.mid(spaceBeforePoolIndex + 1,
+                                            spaceAfterPoolIndex >= 0 ? spaceAfterPoolIndex - spaceBeforePoolIndex - 1 : -1);
                 qDebug() << "The pool for this voxel-assignment is" << assignmentPool << "\n";
             }
             
@@ -561,11 +808,11 @@ void DomainServer::prepopulateStaticAssignmentFile() {
             int payloadLength = config.length() + sizeof(char);
             voxelServerAssignment.setPayload((uchar*)config.toLocal8Bit().constData(), payloadLength);
             
-            freshStaticAssignments[numFreshStaticAssignments++] = voxelServerAssignment;
+            freshStaticAssignments.push_back(voxelServerAssignment);
         }
     } else {
         Assignment rootVoxelServerAssignment(Assignment::CreateCommand, Assignment::VoxelServerType);
-        freshStaticAssignments[numFreshStaticAssignments++] = rootVoxelServerAssignment;
+        freshStaticAssignments.push_back(rootVoxelServerAssignment);
     }
 
     // Handle Domain/Particle Server configuration command line arguments
@@ -590,9 +837,11 @@ void DomainServer::prepopulateStaticAssignmentFile() {
             
             if (poolIndex >= 0) {
                 int spaceBeforePoolIndex = config.indexOf(' ', poolIndex);
-                int spaceAfterPoolIndex = config.indexOf(' ', spaceBeforePoolIndex);
+                int spaceAfterPoolIndex = config.indexOf(' ', spaceBeforePoolIndex + 1);
                 
-                assignmentPool = config.mid(spaceBeforePoolIndex + 1, spaceAfterPoolIndex);
+                // the pool name runs to the next space, or to the end of the config if it is the last option
+                assignmentPool = config.mid(spaceBeforePoolIndex + 1,
+                                            spaceAfterPoolIndex >= 0 ? spaceAfterPoolIndex - spaceBeforePoolIndex - 1 : -1);
                 qDebug() << "The pool for this particle-assignment is" << assignmentPool << "\n";
             }
             
@@ -603,18 +852,17 @@ void DomainServer::prepopulateStaticAssignmentFile() {
             int payloadLength = config.length() + sizeof(char);
             particleServerAssignment.setPayload((uchar*)config.toLocal8Bit().constData(), payloadLength);
             
-            freshStaticAssignments[numFreshStaticAssignments++] = particleServerAssignment;
+            freshStaticAssignments.push_back(particleServerAssignment);
         }
     } else {
         Assignment rootParticleServerAssignment(Assignment::CreateCommand, Assignment::ParticleServerType);
-        freshStaticAssignments[numFreshStaticAssignments++] = rootParticleServerAssignment;
+        freshStaticAssignments.push_back(rootParticleServerAssignment);
     }
     
-    qDebug() << "Adding" << numFreshStaticAssignments << "static assignments to fresh file.\n";
+    qDebug() << "Adding" << freshStaticAssignments.size() << "static assignments to fresh file.\n";
     
     _staticAssignmentFile.open(QIODevice::WriteOnly);
-    _staticAssignmentFile.write((char*) &freshStaticAssignments, sizeof(freshStaticAssignments));
-    _staticAssignmentFile.resize(MAX_STATIC_ASSIGNMENT_FILE_ASSIGNMENTS * sizeof(Assignment));
+    _staticAssignmentFile.write((char*) &freshStaticAssignments[0], freshStaticAssignments.size() * sizeof(Assignment));
     _staticAssignmentFile.close();
 }
 
@@ -622,122 +870,44 @@ Assignment* DomainServer::matchingStaticAssignmentForCheckIn(const QUuid& checkI
     // pull the UUID passed with the check in
     
     if (_hasCompletedRestartHold) {
+        // check the assignment queue for a match
         _assignmentQueueMutex.lock();
-        
-        // iterate the assignment queue to check for a match
-        std::deque<Assignment*>::iterator assignment = _assignmentQueue.begin();
-        while (assignment != _assignmentQueue.end()) {
-            if ((*assignment)->getUUID() == checkInUUID) {
-                // return the matched assignment
-                _assignmentQueueMutex.unlock();
-                return *assignment;
-            } else {
-                // no match, push deque iterator forwards
-                assignment++;
-            }
-        }
-        
+        Assignment* matchingAssignment = _assignmentQueue.find(checkInUUID);
         _assignmentQueueMutex.unlock();
+        
+        return matchingAssignment;
     } else {
-        for (int i = 0; i < MAX_STATIC_ASSIGNMENT_FILE_ASSIGNMENTS; i++) {
-            if (_staticAssignments[i].getUUID() == checkInUUID) {
-                // return matched assignment
-                return &_staticAssignments[i];
-            } else if (_staticAssignments[i].getUUID().isNull()) {
-                // end of static assignments, no match - return NULL
-                return NULL;
-            }
-        }
+        return _staticAssignmentsByUUID.value(checkInUUID);
     }
-    
-    return NULL;
 }
 
 Assignment* DomainServer::deployableAssignmentForRequest(Assignment& requestAssignment) {
     _assignmentQueueMutex.lock();
     
     // this is an unassigned client talking to us directly for an assignment
-    // go through our queue and see if there are any assignments to give out
-    std::deque<Assignment*>::iterator assignment = _assignmentQueue.begin();
-    
-    while (assignment != _assignmentQueue.end()) {
-        bool requestIsAllTypes = requestAssignment.getType() == Assignment::AllTypes;
-        bool assignmentTypesMatch = (*assignment)->getType() == requestAssignment.getType();
-        bool nietherHasPool = !(*assignment)->hasPool() && !requestAssignment.hasPool();
-        bool assignmentPoolsMatch = memcmp((*assignment)->getPool(),
-                                           requestAssignment.getPool(),
-                                           MAX_ASSIGNMENT_POOL_BYTES) == 0;
-        
-        if ((requestIsAllTypes || assignmentTypesMatch) && (nietherHasPool || assignmentPoolsMatch)) {
-            
-            Assignment* deployableAssignment = *assignment;
-            
-            if ((*assignment)->getType() == Assignment::AgentType) {
-                // if there is more than one instance to send out, simply decrease the number of instances
-                
-                if ((*assignment)->getNumberOfInstances() == 1) {
-                    _assignmentQueue.erase(assignment);
-                }
-                
-                deployableAssignment->decrementNumberOfInstances();
-                
-            } else {
-                // remove the assignment from the queue
-                _assignmentQueue.erase(assignment);
-                
-                // until we get a check-in from that GUID
-                // put assignment back in queue but stick it at the back so the others have a chance to go out
-                _assignmentQueue.push_back(deployableAssignment);
-            }
-            
-            // stop looping, we've handed out an assignment
-            _assignmentQueueMutex.unlock();
-            return deployableAssignment;
-        } else {
-            // push forward the iterator to check the next assignment
-            assignment++;
-        }
-    }
+    // see if there are any assignments of the type and pool it wants to give out
+    Assignment* deployableAssignment = _assignmentQueue.deployableAssignmentForRequest(requestAssignment);
     
     _assignmentQueueMutex.unlock();
-    return NULL;
+    return deployableAssignment;
 }
 
 void DomainServer::removeAssignmentFromQueue(Assignment* removableAssignment) {
-    
     _assignmentQueueMutex.lock();
-    
-    std::deque<Assignment*>::iterator assignment = _assignmentQueue.begin();
-    
-    while (assignment != _assignmentQueue.end()) {
-        if ((*assignment)->getUUID() == removableAssignment->getUUID()) {
-            _assignmentQueue.erase(assignment);
-            break;
-        } else {
-            // push forward the iterator to check the next assignment
-            assignment++;
-        }
-    }
-    
+    _assignmentQueue.remove(removableAssignment->getUUID());
     _assignmentQueueMutex.unlock();
 }
 
 bool DomainServer::checkInWithUUIDMatchesExistingNode(const HifiSockAddr& nodePublicSocket,
                                                       const HifiSockAddr& nodeLocalSocket,
                                                       const QUuid& checkInUUID) {
-    NodeList* nodeList = NodeList::getInstance();
+    Node* node = NodeList::getInstance()->nodeWithUUID(checkInUUID);
     
-    for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
-        if (node->getLinkedData()
-            && nodePublicSocket == node->getPublicSocket()
-            && nodeLocalSocket == node->getLocalSocket()
-            && node->getUUID() == checkInUUID) {
-            // this is a matching existing node if the public socket, local socket, and UUID match
-            return true;
-        }
-    }
-    
-    return false;
+    // this is a matching existing node if the public socket, local socket, and UUID match
+    return node
+        && node->getLinkedData()
+        && nodePublicSocket == node->getPublicSocket()
+        && nodeLocalSocket == node->getLocalSocket();
 }
 
 void DomainServer::addStaticAssignmentsBackToQueueAfterRestart() {
@@ -747,37 +917,24 @@ void DomainServer::addStaticAssignmentsBackToQueueAfterRestart() {
     // check if there are static assignments in the file that we need to
     // throw into the assignment queue
     
-    // pull anything in the static assignment file that isn't spoken for and add to the assignment queue
-    for (int i = 0; i < MAX_STATIC_ASSIGNMENT_FILE_ASSIGNMENTS; i++) {
-        if (_staticAssignments[i].getUUID().isNull()) {
-            // reached the end of static assignments, bail
-            break;
-        }
-        
-        bool foundMatchingAssignment = false;
-        
-        NodeList* nodeList = NodeList::getInstance();
-        
-        // enumerate the nodes and check if there is one with an attached assignment with matching UUID
-        for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
-            if (node->getLinkedData()) {
-                Assignment* linkedAssignment = (Assignment*) node->getLinkedData();
-                if (linkedAssignment->getUUID() == _staticAssignments[i].getUUID()) {
-                    foundMatchingAssignment = true;
-                    break;
-                }
-            }
+    // collect the UUIDs of the assignments the nodes we already have are fulfilling
+    QSet<QUuid> fulfilledUUIDs;
+    
+    NodeList* nodeList = NodeList::getInstance();
+    
+    for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
+        if (node->getLinkedData()) {
+            fulfilledUUIDs.insert(((Assignment*) node->getLinkedData())->getUUID());
         }
-        
-        if (!foundMatchingAssignment) {
+    }
+    
+    // pull anything in the static assignment file that isn't spoken for and add to the assignment queue
+    for (int i = 0; i < _numStaticAssignments; i++) {
+        if (!fulfilledUUIDs.contains(_staticAssignments[i].getUUID())) {
             // this assignment has not been fulfilled - reset the UUID and add it to the assignment queue
-            _staticAssignments[i].resetUUID();
+            requeueStaticAssignment(&_staticAssignments[i]);
             
             qDebug() << "Adding static assignment to queue -" << _staticAssignments[i] << "\n";
-            
-            _assignmentQueueMutex.lock();
-            _assignmentQueue.push_back(&_staticAssignments[i]);
-            _assignmentQueueMutex.unlock();
         }
     }
 }
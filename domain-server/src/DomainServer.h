@@ -13,14 +13,21 @@
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QFile>
+#include <QtCore/QHash>
 #include <QtCore/QMutex>
 
 #include <Assignment.h>
 #include <NodeList.h>
+#include <ScriptFrameStats.h>
 
+#include "AssignmentQueue.h"
 #include "civetweb.h"
 
-const int MAX_STATIC_ASSIGNMENT_FILE_ASSIGNMENTS = 1000;
+// the changes to the node list the domain-server remembers, nodes that check in with an older list get the full one
+const int MAX_NODE_LIST_CHANGES = 10000;
+
+// a script whose agent hasn't reported its frame timing for this long is dropped from /scripts.json
+const uint64_t SCRIPT_FRAME_REPORT_EXPIRY_USECS = 5 * SCRIPT_FRAME_STATS_REPORT_USECS;
 
 class DomainServer : public QCoreApplication, public NodeListHook {
     Q_OBJECT
@@ -49,17 +56,48 @@ private:
                                             const HifiSockAddr& nodeLocalSocket,
                                             const QUuid& checkInUUI);
     void addReleasedAssignmentBackToQueue(Assignment* releasedAssignment);
+    void requeueStaticAssignment(Assignment* staticAssignment);
     
-    unsigned char* addNodeToBroadcastPacket(unsigned char* currentPosition, Node* nodeToAdd);
+    void recordNodeListChange(Node* node, bool isRemoval);
+    void sendDomainList(Node* checkInNode, const unsigned char* nodeTypesOfInterest, int numInterestTypes,
+                        uint32_t knownListVersion, const HifiSockAddr& destinationSockAddr);
+    void processScriptFrameStats(unsigned char* packetData, int numBytes);
     
     QMutex _assignmentQueueMutex;
-    std::deque<Assignment*> _assignmentQueue;
+    AssignmentQueue _assignmentQueue;
+    
+    struct ReceivedScriptFrameReport {
+        ScriptFrameReport report;
+        uint64_t receivedAt;
+    };
+    
+    struct NodeListChange {
+        uint32_t version;
+        QUuid uuid;
+        NODE_TYPE type;
+        bool isRemoval;
+    };
+    
+    // each change to the node list makes a new version of it, the changes after _oldestDeltaVersion are kept so that
+    // nodes checking in with a version from then on are sent only what changed since
+    QMutex _nodeListChangesMutex;
+    std::deque<NodeListChange> _nodeListChanges;
+    uint32_t _nodeListVersion;
+    uint32_t _oldestDeltaVersion;
+    
+    // the latest frame timing of each script, by assignment UUID, read by the civetweb thread
+    QMutex _scriptFrameReportsMutex;
+    QHash<QUuid, ReceivedScriptFrameReport> _scriptFrameReports;
     
     QFile _staticAssignmentFile;
     uchar* _staticAssignmentFileData;
     
     Assignment* _staticAssignments;
+    int _numStaticAssignments;
+    QHash<QUuid, Assignment*> _staticAssignmentsByUUID;
     
+    const char* _audioMixerConfig;
+    const char* _avatarMixerConfig;
     const char* _voxelServerConfig;
     const char* _particleServerConfig;
     
@@ -75,6 +75,10 @@ const int STARTUP_JITTER_SAMPLES = PACKET_LENGTH_SAMPLES_PER_CHANNEL / 2;
                                                  //  Startup optimistically with small jitter buffer that 
                                                  //  will start playback on the second received audio packet.
 
+// packets the network receive thread queues for the main thread - beyond this many a frame behind they're dropped
+const int MAX_QUEUED_AVATAR_PACKETS = 1024;
+const int MAX_QUEUED_PARTICLE_PACKETS = 256;
+
 const int MIRROR_VIEW_TOP_PADDING = 5;
 const int MIRROR_VIEW_LEFT_PADDING = 10;
 const int MIRROR_VIEW_WIDTH = 265;
@@ -136,6 +140,10 @@ Application::Application(int& argc, char** argv, timeval &startup_time) :
         _packetsPerSecond(0),
         _bytesPerSecond(0),
         _bytesCount(0),
+        _avatarPackets(MAX_QUEUED_AVATAR_PACKETS),
+        _particlePackets(MAX_QUEUED_PARTICLE_PACKETS),
+        _networkReceiveIdleUsecs(0),
+        _networkReceiveIdlePercent(0.0f),
         _recentMaxPackets(0),
         _resetRecentMaxPacketsSoon(true),
         _swatch(NULL),
@@ -167,6 +175,7 @@ Application::Application(int& argc, char** argv, timeval &startup_time) :
     nodeList->addHook(this);
     nodeList->addDomainListener(this);
     nodeList->addDomainListener(&_voxels);
+    nodeList->addReliableMessageListener(this);
 
     // network receive thread and voxel parsing thread are both controlled by the --nonblocking command line
     _enableProcessVoxelsThread = _enableNetworkThread = !cmdOptionExists(argc, constArgv, "--nonblocking");
@@ -254,6 +263,7 @@ Application::~Application() {
     NodeList::getInstance()->removeHook(&_voxels);
     NodeList::getInstance()->removeHook(this);
     NodeList::getInstance()->removeDomainListener(this);
+    NodeList::getInstance()->removeReliableMessageListener(this);
 
     _sharedVoxelSystem.changeTree(new VoxelTree);
 
@@ -1296,9 +1306,11 @@ void Application::timer() {
     _fps = (float)_frameCount / ((float)diffclock(&_timerStart, &_timerEnd) / 1000.f);
     _packetsPerSecond = (float)_packetCount / ((float)diffclock(&_timerStart, &_timerEnd) / 1000.f);
     _bytesPerSecond = (float)_bytesCount / ((float)diffclock(&_timerStart, &_timerEnd) / 1000.f);
+    _networkReceiveIdlePercent = (float)_networkReceiveIdleUsecs / ((float)diffclock(&_timerStart, &_timerEnd) * 10.f);
     _frameCount = 0;
     _packetCount = 0;
     _bytesCount = 0;
+    _networkReceiveIdleUsecs = 0;
     
     gettimeofday(&_timerStart, NULL);
     
@@ -1849,7 +1861,8 @@ void Application::init() {
     _particles.init();
     _particles.setViewFrustum(getViewFrustum());
     
-    _particleCollisionSystem.init(&_particleEditSender, _particles.getTree(), _voxels.getTree(), &_audio);
+    // the particle server owns the simulation, so our collisions only shape our own extrapolation and aren't sent back
+    _particleCollisionSystem.init(NULL, _particles.getTree(), _voxels.getTree(), &_audio);
     
     _palette.init(_glWidget->width(), _glWidget->height());
     _palette.addAction(Menu::getInstance()->getActionForOption(MenuOption::VoxelAddMode), 0, 0);
@@ -1933,7 +1946,7 @@ Avatar* Application::findLookatTargetAvatar(const glm::vec3& mouseRayOrigin, con
                 
                 _lookatIndicatorScale = avatar->getHead().getScale();
                 _lookatOtherPosition = headPosition;
-                nodeUUID = avatar->getOwningNode()->getUUID();
+                nodeUUID = avatar->getOwningNodeUUID();
                 return avatar;
             }
         }
@@ -2066,7 +2079,7 @@ void Application::updateAvatars(float deltaTime, glm::vec3 mouseRayOrigin, glm::
         avatar->setNewScale(avatar->getNewScale() * SHRINK_RATE);
         const float MINIMUM_SCALE = 0.001f;
         if (avatar->getNewScale() < MINIMUM_SCALE) {
-            delete avatar;
+            avatar->release();
             _avatarFades.erase(fade--);
         
         } else {
@@ -2330,6 +2343,9 @@ void Application::updateThreads(float deltaTime) {
     if (!_enableNetworkThread) {
         networkReceive(0);
     }
+    
+    // handle the avatar and particle packets the network receive thread queued for us
+    processQueuedPackets();
 
     // parse voxel packets
     if (!_enableProcessVoxelsThread) {
@@ -2617,6 +2633,9 @@ void Application::updateAvatar(float deltaTime) {
     
     endOfBroadcastStringWrite += _myAvatar.getBroadcastData(endOfBroadcastStringWrite);
     
+    // let the avatar mixer know which of its broadcasts we got, so it can send the next ones as deltas against them
+    endOfBroadcastStringWrite += _avatarBroadcastReceiver.writeAcknowledgement(endOfBroadcastStringWrite);
+    
     const char nodeTypesOfInterest[] = { NODE_TYPE_AVATAR_MIXER };
     controlledBroadcastToNodes(broadcastString, endOfBroadcastStringWrite - broadcastString,
                                nodeTypesOfInterest, sizeof(nodeTypesOfInterest));
@@ -3582,8 +3601,42 @@ void Application::displayStats() {
     statsVerticalOffset += PELS_PER_LINE;
     drawtext(10, statsVerticalOffset, 0.10f, 0, 1.0, 0, (char*)voxelStats.str().c_str());
 
+    // how long incoming packets wait in each queue before they're handled, and how many were dropped
+    const float MEDIAN_LATENCY_PERCENTILE = 0.5f;
+    const float WORST_LATENCY_PERCENTILE = 0.99f;
+    const int NUM_RECEIVED_PACKET_QUEUES = 4;
+    const char* queueNames[NUM_RECEIVED_PACKET_QUEUES] = { "Voxels", "Audio", "Avatars", "Particles" };
+    PacketQueue* queues[NUM_RECEIVED_PACKET_QUEUES] = { &_voxelProcessor.getPacketQueue(),
+        &_audio.getReceivedPacketQueue(), &_avatarPackets, &_particlePackets };
+    int numDropped = 0;
+    
+    voxelStats.str("");
+    voxelStats << "Packet Wait usecs (median/99%):";
+    for (int i = 0; i < NUM_RECEIVED_PACKET_QUEUES; i++) {
+        voxelStats << " " << queueNames[i] << " " << queues[i]->getLatencyPercentile(MEDIAN_LATENCY_PERCENTILE)
+            << "/" << queues[i]->getLatencyPercentile(WORST_LATENCY_PERCENTILE);
+        numDropped += queues[i]->getNumDropped();
+    }
+    voxelStats << " Dropped: " << numDropped;
+    statsVerticalOffset += PELS_PER_LINE;
+    drawtext(10, statsVerticalOffset, 0.10f, 0, 1.0, 0, (char*)voxelStats.str().c_str());
+    
+    voxelStats.str("");
+    voxelStats << "Particle Collisions: " << _particleCollisionSystem.getNumParticlesChecked() << " particles, " <<
+        (int)_particleCollisionSystem.getCollisionsPerSecond() << "/sec, " <<
+        _particleCollisionSystem.getLastUpdateUsecs() << " usecs/update";
+    statsVerticalOffset += PELS_PER_LINE;
+    drawtext(10, statsVerticalOffset, 0.10f, 0, 1.0, 0, (char*)voxelStats.str().c_str());
+    
+    if (_enableNetworkThread) {
+        voxelStats.str("");
+        voxelStats << "Network Receive Thread Idle: " << (int) _networkReceiveIdlePercent << "%";
+        statsVerticalOffset += PELS_PER_LINE;
+        drawtext(10, statsVerticalOffset, 0.10f, 0, 1.0, 0, (char*)voxelStats.str().c_str());
+    }
+
 
-    // Leap data    
+    // Leap data
     statsVerticalOffset += PELS_PER_LINE;
     drawtext(10, statsVerticalOffset, 0.10f, 0, 1.0, 0, (char*)LeapManager::statusString().c_str());
     
@@ -4124,6 +4177,9 @@ void Application::domainChanged(QString domain) {
     _voxelServerJurisdictions.clear();
     _voxelServerSceneStats.clear();
     _particleServerJurisdictions.clear();
+    
+    // the new domain's avatar mixer will start over with full states
+    _avatarBroadcastReceiver.reset();
 }
 
 void Application::nodeAdded(Node* node) {
@@ -4193,6 +4249,9 @@ void Application::nodeKilled(Node* node) {
         }
         _voxelSceneStatsLock.unlock();
         
+    } else if (node->getType() == NODE_TYPE_AVATAR_MIXER) {
+        // a replacement mixer won't have any of the baselines we'd acknowledge
+        _avatarBroadcastReceiver.reset();
     } else if (node->getType() == NODE_TYPE_AGENT) {
         Avatar* avatar = static_cast<Avatar*>(node->getLinkedData());
         if (avatar == _lookatTargetAvatar) {
@@ -4200,6 +4259,7 @@ void Application::nodeKilled(Node* node) {
         }
         
         // take over the avatar in order to fade it out
+        avatar->retain();
         node->setLinkedData(NULL);
         
         _avatarFades.push_back(avatar);
@@ -4287,100 +4347,172 @@ int Application::parseOctreeStats(unsigned char* messageData, ssize_t messageLen
 void* Application::networkReceive(void* args) {
     PerformanceWarning warn(Menu::getInstance()->isOptionChecked(MenuOption::PipelineWarnings), 
         "Application::networkReceive()");
-
-    HifiSockAddr senderSockAddr;
-    ssize_t bytesReceived;
     
     Application* app = Application::getInstance();
+    BatchedUdpSocket& nodeSocket = NodeList::getInstance()->getBatchedNodeSocket();
+    
+    // datagrams are read straight into pooled buffers, so the subsystems they're queued for can take them without a copy
+    PacketBuffer* packets[MAX_DATAGRAMS_PER_BATCH];
+    for (int i = 0; i < MAX_DATAGRAMS_PER_BATCH; i++) {
+        packets[i] = PacketBufferPool::getInstance()->acquire();
+    }
+    
+    // the receive thread sleeps in the socket until something arrives, waking this often to see if it should stop
+    const int NETWORK_RECEIVE_WAIT_MSECS = 100;
+    
     while (!app->_stopNetworkReceiveThread) {
-        if (NodeList::getInstance()->getNodeSocket().hasPendingDatagrams() &&
-            (bytesReceived = NodeList::getInstance()->getNodeSocket().readDatagram((char*) app->_incomingPacket,
-                                                                                    MAX_PACKET_SIZE,
-                                                                                    senderSockAddr.getAddressPointer(),
-                                                                                    senderSockAddr.getPortPointer()))) {
+        bool hasDatagrams;
+        if (app->_enableNetworkThread) {
+            uint64_t waitStart = usecTimestampNow();
+            hasDatagrams = nodeSocket.waitForDatagrams(NETWORK_RECEIVE_WAIT_MSECS);
+            app->_networkReceiveIdleUsecs += usecTimestampNow() - waitStart;
+        } else {
+            // we're being called from the main loop, so only take what is already waiting
+            hasDatagrams = nodeSocket.waitForDatagrams(0);
+            if (!hasDatagrams) {
+                break;
+            }
+        }
         
-            app->_packetCount++;
-            app->_bytesCount += bytesReceived;
-            
-            if (packetVersionMatch(app->_incomingPacket)) {
-                // only process this packet if we have a match on the packet version
-                switch (app->_incomingPacket[0]) {
-                    case PACKET_TYPE_TRANSMITTER_DATA_V2:
-                        //  V2 = IOS transmitter app
-                        app->_myTransmitter.processIncomingData(app->_incomingPacket, bytesReceived);
-                        
-                        break;
-                    case PACKET_TYPE_MIXED_AUDIO:
-                        QMetaObject::invokeMethod(&app->_audio, "addReceivedAudioToBuffer", Qt::QueuedConnection,
-                                                  Q_ARG(QByteArray, QByteArray((char*) app->_incomingPacket, bytesReceived)));
-                        break;
-                        
-                    case PACKET_TYPE_PARTICLE_ADD_RESPONSE:
-                        // look up our ParticleEditHanders....
-                        ParticleEditHandle::handleAddResponse(app->_incomingPacket, bytesReceived);
-                        break;
-                        
-                    case PACKET_TYPE_PARTICLE_DATA:
-                    case PACKET_TYPE_VOXEL_DATA:
-                    case PACKET_TYPE_VOXEL_ERASE:
-                    case PACKET_TYPE_OCTREE_STATS:
-                    case PACKET_TYPE_ENVIRONMENT_DATA: {
-                        PerformanceWarning warn(Menu::getInstance()->isOptionChecked(MenuOption::PipelineWarnings), 
-                            "Application::networkReceive()... _voxelProcessor.queueReceivedPacket()");
-                            
-                        bool wantExtraDebugging = Menu::getInstance()->isOptionChecked(MenuOption::ExtraDebugging);
-                        if (wantExtraDebugging && app->_incomingPacket[0] == PACKET_TYPE_VOXEL_DATA) {
-                            int numBytesPacketHeader = numBytesForPacketHeader(app->_incomingPacket);
-                            unsigned char* dataAt = app->_incomingPacket + numBytesPacketHeader;
-                            dataAt += sizeof(VOXEL_PACKET_FLAGS);
-                            VOXEL_PACKET_SEQUENCE sequence = (*(VOXEL_PACKET_SEQUENCE*)dataAt);
-                            dataAt += sizeof(VOXEL_PACKET_SEQUENCE);
-                            VOXEL_PACKET_SENT_TIME sentAt = (*(VOXEL_PACKET_SENT_TIME*)dataAt);
-                            dataAt += sizeof(VOXEL_PACKET_SENT_TIME);
-                            VOXEL_PACKET_SENT_TIME arrivedAt = usecTimestampNow();
-                            int flightTime = arrivedAt - sentAt;
-                            
-                            printf("got PACKET_TYPE_VOXEL_DATA, sequence:%d flightTime:%d\n", sequence, flightTime);
-                        }   
-                    
-                        // add this packet to our list of voxel packets and process them on the voxel processing
-                        app->_voxelProcessor.queueReceivedPacket(senderSockAddr, app->_incomingPacket, bytesReceived);
-                        break;
+        if (hasDatagrams) {
+            int numPackets;
+            do {
+                numPackets = nodeSocket.readPendingPackets(packets);
+                for (int i = 0; i < numPackets; i++) {
+                    if (app->processReceivedPacket(packets[i])) {
+                        // whoever it was queued for holds on to that buffer now, so the next read goes into a fresh one
+                        packets[i]->release();
+                        packets[i] = PacketBufferPool::getInstance()->acquire();
                     }
-                    case PACKET_TYPE_BULK_AVATAR_DATA:
-                        NodeList::getInstance()->processBulkNodeData(senderSockAddr,
-                                                                     app->_incomingPacket,
-                                                                     bytesReceived);
-                        getInstance()->_bandwidthMeter.inputStream(BandwidthMeter::AVATARS).updateValue(bytesReceived);
-                        break;
-                    case PACKET_TYPE_AVATAR_URLS:
-                        processAvatarURLsMessage(app->_incomingPacket, bytesReceived);
-                        break;
-                    case PACKET_TYPE_AVATAR_FACE_VIDEO:
-                        processAvatarFaceVideoMessage(app->_incomingPacket, bytesReceived);
-                        break;
-                    case PACKET_TYPE_DATA_SERVER_GET:
-                    case PACKET_TYPE_DATA_SERVER_PUT:
-                    case PACKET_TYPE_DATA_SERVER_SEND:
-                    case PACKET_TYPE_DATA_SERVER_CONFIRM:
-                        DataServerClient::processMessageFromDataServer(app->_incomingPacket, bytesReceived);
-                        break;
-                    default:
-                        NodeList::getInstance()->processNodeData(senderSockAddr, app->_incomingPacket, bytesReceived);
-                        break;
                 }
-            }
-        } else if (!app->_enableNetworkThread) {
-            break;
+            } while (numPackets == MAX_DATAGRAMS_PER_BATCH);
         }
     }
     
+    for (int i = 0; i < MAX_DATAGRAMS_PER_BATCH; i++) {
+        packets[i]->release();
+    }
+    
     if (app->_enableNetworkThread) {
         pthread_exit(0); 
     }
     return NULL; 
 }
 
+bool Application::processReceivedPacket(PacketBuffer* packet) {
+    unsigned char* incomingPacket = packet->getData();
+    ssize_t bytesReceived = packet->getLength();
+    const HifiSockAddr& senderSockAddr = packet->getSockAddr();
+    
+    _packetCount++;
+    _bytesCount += bytesReceived;
+    
+    if (packetVersionMatch(incomingPacket)) {
+        // only process this packet if we have a match on the packet version
+        switch (incomingPacket[0]) {
+            case PACKET_TYPE_TRANSMITTER_DATA_V2:
+                //  V2 = IOS transmitter app
+                _myTransmitter.processIncomingData(incomingPacket, bytesReceived);
+                
+                break;
+            case PACKET_TYPE_MIXED_AUDIO:
+            case PACKET_TYPE_AUDIO_MIXER_REGION:
+                _audio.queueReceivedPacket(packet);
+                return true;
+                
+            case PACKET_TYPE_PARTICLE_ADD_RESPONSE:
+            case PACKET_TYPE_PARTICLE_SNAPSHOT:
+                // the particle edit handles and the particle simulation belong to the main thread
+                _particlePackets.push(packet);
+                return true;
+                
+            case PACKET_TYPE_PARTICLE_DATA:
+            case PACKET_TYPE_VOXEL_DATA:
+            case PACKET_TYPE_VOXEL_ERASE:
+            case PACKET_TYPE_OCTREE_STATS:
+            case PACKET_TYPE_ENVIRONMENT_DATA: {
+                PerformanceWarning warn(Menu::getInstance()->isOptionChecked(MenuOption::PipelineWarnings), 
+                    "Application::networkReceive()... _voxelProcessor.queueReceivedPacket()");
+                    
+                bool wantExtraDebugging = Menu::getInstance()->isOptionChecked(MenuOption::ExtraDebugging);
+                if (wantExtraDebugging && incomingPacket[0] == PACKET_TYPE_VOXEL_DATA) {
+                    int numBytesPacketHeader = numBytesForPacketHeader(incomingPacket);
+                    unsigned char* dataAt = incomingPacket + numBytesPacketHeader;
+                    dataAt += sizeof(VOXEL_PACKET_FLAGS);
+                    VOXEL_PACKET_SEQUENCE sequence = (*(VOXEL_PACKET_SEQUENCE*)dataAt);
+                    dataAt += sizeof(VOXEL_PACKET_SEQUENCE);
+                    VOXEL_PACKET_SENT_TIME sentAt = (*(VOXEL_PACKET_SENT_TIME*)dataAt);
+                    dataAt += sizeof(VOXEL_PACKET_SENT_TIME);
+                    VOXEL_PACKET_SENT_TIME arrivedAt = usecTimestampNow();
+                    int flightTime = arrivedAt - sentAt;
+                    
+                    printf("got PACKET_TYPE_VOXEL_DATA, sequence:%d flightTime:%d\n", sequence, flightTime);
+                }   
+            
+                // add this packet to our list of voxel packets and process them on the voxel processing
+                _voxelProcessor.queueReceivedPacket(packet);
+                return true;
+            }
+            case PACKET_TYPE_BULK_AVATAR_DATA:
+            case PACKET_TYPE_AVATAR_URLS:
+            case PACKET_TYPE_AVATAR_FACE_VIDEO:
+                // the avatars are updated and rendered on the main thread
+                _avatarPackets.push(packet);
+                return true;
+            case PACKET_TYPE_DATA_SERVER_GET:
+            case PACKET_TYPE_DATA_SERVER_PUT:
+            case PACKET_TYPE_DATA_SERVER_SEND:
+            case PACKET_TYPE_DATA_SERVER_CONFIRM:
+                DataServerClient::processMessageFromDataServer(incomingPacket, bytesReceived);
+                break;
+            default:
+                NodeList::getInstance()->processNodeData(senderSockAddr, incomingPacket, bytesReceived);
+                break;
+        }
+    }
+    
+    return false;
+}
+
+void Application::processReliableMessage(const HifiSockAddr& senderSockAddr, unsigned char* packetData, int packetLength) {
+    // we're on the receive thread here, and the queues hold on to pooled buffers rather than copying
+    PacketBuffer* packet = PacketBufferPool::getInstance()->acquire();
+    
+    if (packet->copyContents(senderSockAddr, packetData, packetLength)) {
+        processReceivedPacket(packet);
+    }
+    packet->release();
+}
+
+void Application::processQueuedPackets() {
+    PacketBuffer* packet;
+    while ((packet = _avatarPackets.pop())) {
+        switch (packet->getData()[0]) {
+            case PACKET_TYPE_BULK_AVATAR_DATA:
+                _avatarBroadcastReceiver.processBulkAvatarData(packet->getSockAddr(), packet->getData(), packet->getLength());
+                _bandwidthMeter.inputStream(BandwidthMeter::AVATARS).updateValue(packet->getLength());
+                break;
+            case PACKET_TYPE_AVATAR_URLS:
+                processAvatarURLsMessage(packet->getData(), packet->getLength());
+                break;
+            case PACKET_TYPE_AVATAR_FACE_VIDEO:
+                processAvatarFaceVideoMessage(packet->getData(), packet->getLength());
+                break;
+        }
+        packet->release();
+    }
+    
+    while ((packet = _particlePackets.pop())) {
+        if (packet->getData()[0] == PACKET_TYPE_PARTICLE_SNAPSHOT) {
+            _particles.processSnapshot(packet->getData(), packet->getLength());
+        } else {
+            // look up our ParticleEditHanders....
+            ParticleEditHandle::handleAddResponse(packet->getData(), packet->getLength());
+        }
+        packet->release();
+    }
+}
+
 void Application::packetSentNotification(ssize_t length) {
     _bandwidthMeter.outputStream(BandwidthMeter::VOXELS).updateValue(length); 
 }
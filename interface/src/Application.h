@@ -19,6 +19,7 @@
 #include <QTouchEvent>
 #include <QList>
 
+#include <AvatarBroadcastReceiver.h>
 #include <NetworkPacket.h>
 #include <NodeList.h>
 #include <PacketHeaders.h>
@@ -88,7 +89,8 @@ static const float NODE_KILLED_RED   = 1.0f;
 static const float NODE_KILLED_GREEN = 0.0f;
 static const float NODE_KILLED_BLUE  = 0.0f;
 
-class Application : public QApplication, public NodeListHook, public PacketSenderNotify, public DomainChangeListener {
+class Application : public QApplication, public NodeListHook, public PacketSenderNotify, public DomainChangeListener,
+                    public ReliableMessageListener {
     Q_OBJECT
 
     friend class VoxelPacketProcessor;
@@ -192,6 +194,9 @@ public:
     
     virtual void domainChanged(QString domain);
     
+    /// dispatches the messages servers send us reliably, such as particle add responses, like any other packet
+    virtual void processReliableMessage(const HifiSockAddr& senderSockAddr, unsigned char* packetData, int packetLength);
+    
     VoxelShader& getVoxelShader() { return _voxelShader; }
     PointShader& getPointShader() { return _pointShader; }
     
@@ -315,6 +320,13 @@ private:
     
     static void attachNewHeadToNode(Node *newNode);
     static void* networkReceive(void* args); // network receive thread
+    
+    /// handles a packet on the network receive thread, or queues it for the thread that owns what it's for
+    /// \return true if the packet was queued, in which case whoever it was queued for holds a reference to it
+    bool processReceivedPacket(PacketBuffer* packet);
+    
+    /// handles the packets networkReceive queued for the main thread
+    void processQueuedPackets();
 
     void findAxisAlignment();
 
@@ -465,12 +477,19 @@ private:
     VoxelEditPacketSender _voxelEditSender;
     ParticleEditPacketSender _particleEditSender;
     
-    unsigned char _incomingPacket[MAX_PACKET_SIZE];
+    AvatarBroadcastReceiver _avatarBroadcastReceiver;
+    
     int _packetCount;
     int _packetsPerSecond;
     int _bytesPerSecond;
     int _bytesCount;
     
+    PacketQueue _avatarPackets;
+    PacketQueue _particlePackets;
+    
+    uint64_t _networkReceiveIdleUsecs; // time the network receive thread spent waiting for packets since the last timer()
+    float _networkReceiveIdlePercent;
+    
     int _recentMaxPackets; // recent max incoming voxel packets to process
     bool _resetRecentMaxPacketsSoon;
     
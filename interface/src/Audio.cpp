@@ -22,7 +22,6 @@
 #include <NodeTypes.h>
 #include <PacketHeaders.h>
 #include <SharedUtil.h>
-#include <StdDev.h>
 #include <UUID.h>
 
 #include "Application.h"
@@ -33,6 +32,11 @@
 static const float JITTER_BUFFER_LENGTH_MSECS = 12;
 static const short JITTER_BUFFER_SAMPLES = JITTER_BUFFER_LENGTH_MSECS * NUM_AUDIO_CHANNELS * (SAMPLE_RATE / 1000.0);
 
+// playback restarts after a starve once the ring buffer holds a frame plus the jitter buffer, so the jitter buffer can't
+// outgrow what the ring has room for beside that frame and the next one to arrive
+static const int MAX_JITTER_BUFFER_SAMPLES = (RING_BUFFER_LENGTH_SAMPLES - RING_BUFFER_GUARD_SAMPLES
+                                              - 2 * PACKET_LENGTH_SAMPLES) / NUM_AUDIO_CHANNELS;
+
 static const float AUDIO_CALLBACK_MSECS = (float)BUFFER_LENGTH_SAMPLES_PER_CHANNEL / (float)SAMPLE_RATE * 1000.0;
 
 // Mute icon configration
@@ -40,6 +44,9 @@ static const int ICON_SIZE = 24;
 static const int ICON_LEFT = 20;
 static const int BOTTOM_PADDING = 110;
 
+// received audio beyond this many packets behind the audio thread is dropped
+const int MAX_QUEUED_AUDIO_PACKETS = 256;
+
 Audio::Audio(Oscilloscope* scope, int16_t initialJitterBufferSamples, QObject* parent) :
     QObject(parent),
     _audioInput(NULL),
@@ -50,6 +57,9 @@ Audio::Audio(Oscilloscope* scope, int16_t initialJitterBufferSamples, QObject* p
     _nextOutputSamples(NULL),
     _ringBuffer(true),
     _scope(scope),
+    _jitterBuffer(PACKET_LENGTH_SAMPLES_PER_CHANNEL, SAMPLE_RATE, MAX_JITTER_BUFFER_SAMPLES),
+    _microphoneCodec(AUDIO_CODEC_ADPCM, 1),
+    _voiceActivityDetector(BUFFER_LENGTH_SAMPLES_PER_CHANNEL, SAMPLE_RATE),
     _averagedLatency(0.0),
     _measuredJitter(0),
     _jitterBufferSamples(initialJitterBufferSamples),
@@ -63,7 +73,9 @@ Audio::Audio(Oscilloscope* scope, int16_t initialJitterBufferSamples, QObject* p
     _collisionSoundDuration(0.0f),
     _proceduralEffectSample(0),
     _numFramesDisplayStarve(0),
-    _muted(false)
+    _muted(false),
+    _receivedPackets(MAX_QUEUED_AUDIO_PACKETS),
+    _isProcessingScheduled(0)
 {
     
 }
@@ -76,6 +88,8 @@ void Audio::init(QGLWidget *parent) {
 
 void Audio::reset() {
     _ringBuffer.reset();
+    _jitterBuffer.reset();
+    _voiceActivityDetector.reset();
 }
 
 QAudioDeviceInfo defaultAudioDeviceForMode(QAudio::Mode mode) {
@@ -174,14 +188,91 @@ void Audio::start() {
     gettimeofday(&_lastReceiveTime, NULL);
 }
 
+void Audio::queueReceivedPacket(PacketBuffer* packet) {
+    // only the first packet into an empty queue needs to wake the audio thread, it takes everything queued after it too
+    if (_receivedPackets.push(packet) && _isProcessingScheduled.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "processReceivedPackets", Qt::QueuedConnection);
+    }
+}
+
+void Audio::processReceivedPackets() {
+    // clear this first, so that a packet queued while we drain schedules another call
+    _isProcessingScheduled.storeRelease(0);
+    
+    PacketBuffer* packet;
+    while ((packet = _receivedPackets.pop())) {
+        if (packet->getData()[0] == PACKET_TYPE_MIXED_AUDIO) {
+            addReceivedAudioToBuffer(packet->getData(), packet->getLength());
+        } else if (packet->getData()[0] == PACKET_TYPE_AUDIO_MIXER_REGION) {
+            parseAudioMixerRegion(packet->getData(), packet->getLength());
+        }
+        packet->release();
+    }
+}
+
+void Audio::parseAudioMixerRegion(unsigned char* packetData, int packetLength) {
+    int numBytesPacketHeader = numBytesForPacketHeader(packetData);
+    
+    if (packetLength < numBytesPacketHeader + NUM_BYTES_RFC4122_UUID) {
+        return;
+    }
+    
+    QUuid audioMixerUUID = QUuid::fromRfc4122(QByteArray((char*) packetData + numBytesPacketHeader,
+                                                         NUM_BYTES_RFC4122_UUID));
+    
+    AudioRegion region;
+    int numBytesRead = numBytesPacketHeader + NUM_BYTES_RFC4122_UUID;
+    
+    if (region.unpackFromBuffer(packetData + numBytesRead, packetLength - numBytesRead) > 0) {
+        _audioMixerRegions[audioMixerUUID] = region;
+    }
+}
+
+Node* Audio::audioMixerForPosition(const glm::vec3& position) {
+    NodeList* nodeList = NodeList::getInstance();
+    
+    Node* closestAudioMixer = NULL;
+    float closestDistance = 0.0f;
+    
+    for (QHash<QUuid, AudioRegion>::const_iterator region = _audioMixerRegions.constBegin();
+         region != _audioMixerRegions.constEnd();
+         region++) {
+        Node* audioMixer = nodeList->nodeWithUUID(region.key());
+        
+        if (audioMixer) {
+            float distance = region.value().distanceTo(position);
+            
+            // on a shared boundary stay with the mixer we have, so we don't flap between the two
+            if (!closestAudioMixer || distance < closestDistance
+                || (distance == closestDistance && region.key() == _audioMixerUUID)) {
+                closestAudioMixer = audioMixer;
+                closestDistance = distance;
+            }
+        }
+    }
+    
+    if (!closestAudioMixer) {
+        // the domain isn't split between mixers, or we haven't heard from them yet
+        closestAudioMixer = nodeList->soloNodeOfType(NODE_TYPE_AUDIO_MIXER);
+    }
+    
+    if (closestAudioMixer && closestAudioMixer->getUUID() != _audioMixerUUID) {
+        if (!_audioMixerUUID.isNull()) {
+            qDebug() << "Sending audio to mixer" << closestAudioMixer->getUUID() << "\n";
+        }
+        
+        _audioMixerUUID = closestAudioMixer->getUUID();
+    }
+    
+    return closestAudioMixer;
+}
+
 void Audio::handleAudioInput() {
     static int16_t stereoInputBuffer[CALLBACK_IO_BUFFER_SIZE * 2];
     static char monoAudioDataPacket[MAX_PACKET_SIZE];
     static int bufferSizeSamples = _audioInput->bufferSize() / sizeof(int16_t);
     
-    static int numBytesPacketHeader = numBytesForPacketHeader((unsigned char*) &PACKET_TYPE_MICROPHONE_AUDIO_NO_ECHO);
-    static int leadingBytes = numBytesPacketHeader + sizeof(glm::vec3) + sizeof(glm::quat) +  NUM_BYTES_RFC4122_UUID;
-    static int16_t* monoAudioSamples = (int16_t*) (monoAudioDataPacket + leadingBytes);
+    static int16_t monoAudioSamples[BUFFER_LENGTH_SAMPLES_PER_CHANNEL];
     
     QByteArray inputByteArray = _inputDevice->read(CALLBACK_IO_BUFFER_SIZE);
     
@@ -234,13 +325,17 @@ void Audio::handleAudioInput() {
     
     if (_isBufferSendCallback) {
         NodeList* nodeList = NodeList::getInstance();
-        Node* audioMixer = nodeList->soloNodeOfType(NODE_TYPE_AUDIO_MIXER);
+        
+        // this is the audio thread, so keep the mixer we pick from being deleted while we send to it
+        NodeListReadGuard readGuard;
+        
+        MyAvatar* interfaceAvatar = Application::getInstance()->getAvatar();
+        
+        glm::vec3 headPosition = interfaceAvatar->getHeadJointPosition();
+        Node* audioMixer = audioMixerForPosition(headPosition);
         
         if (audioMixer) {
             if (audioMixer->getActiveSocket()) {
-                MyAvatar* interfaceAvatar = Application::getInstance()->getAvatar();
-                
-                glm::vec3 headPosition = interfaceAvatar->getHeadJointPosition();
                 glm::quat headOrientation = interfaceAvatar->getHead().getOrientation();
                 
                 // we need the amount of bytes in the buffer + 1 for type
@@ -282,12 +377,39 @@ void Audio::handleAudioInput() {
                     }
                 }
                 
-                nodeList->getNodeSocket().writeDatagram(monoAudioDataPacket, BUFFER_LENGTH_BYTES_PER_CHANNEL + leadingBytes,
+                // the mixer answers with our mix in whichever codec we send it
+                _microphoneCodec.setType(Menu::getInstance()->isOptionChecked(MenuOption::CompressAudio)
+                                         ? AUDIO_CODEC_ADPCM : AUDIO_CODEC_PCM);
+                
+                bool hasVoice = false;
+                
+                if (_muted) {
+                    // a muted mic would teach the detector a floor of zero, and it would take the room for speech once
+                    // we unmute - so it sits this out, and only our procedural sounds can be in the frame
+                    for (int i = 0; i < BUFFER_LENGTH_SAMPLES_PER_CHANNEL && !hasVoice; i++) {
+                        hasVoice = monoAudioSamples[i] != 0;
+                    }
+                } else {
+                    // the detector sees every unmuted frame so its noise floor keeps tracking the room
+                    hasVoice = _voiceActivityDetector.processFrame(monoAudioSamples);
+                }
+                
+                if (!hasVoice && (_muted || Menu::getInstance()->isOptionChecked(MenuOption::SuppressSilentAudio))) {
+                    // nothing worth hearing, the position and orientation still go out so the mixer can keep mixing for us
+                    currentPacketPtr += _microphoneCodec.encodeSilentFrame((unsigned char*) currentPacketPtr);
+                } else {
+                    currentPacketPtr += _microphoneCodec.encodeFrame(monoAudioSamples, BUFFER_LENGTH_SAMPLES_PER_CHANNEL,
+                                                                     (unsigned char*) currentPacketPtr);
+                }
+                
+                int numPacketBytes = currentPacketPtr - monoAudioDataPacket;
+                
+                nodeList->getNodeSocket().writeDatagram(monoAudioDataPacket, numPacketBytes,
                                                         audioMixer->getActiveSocket()->getAddress(),
                                                         audioMixer->getActiveSocket()->getPort());
                 
                 Application::getInstance()->getBandwidthMeter()->outputStream(BandwidthMeter::AUDIO)
-                    .updateValue(BUFFER_LENGTH_BYTES_PER_CHANNEL + leadingBytes);
+                    .updateValue(numPacketBytes);
             } else {
                 nodeList->pingPublicAndLocalSocketsForInactiveNode(audioMixer);
             }
@@ -297,7 +419,14 @@ void Audio::handleAudioInput() {
     // if there is anything in the ring buffer, decide what to do
     
     if (!_nextOutputSamples) {
-        if (_ringBuffer.getEndOfLastWrite()) {
+        int adaptiveJitterBufferSamples = _jitterBuffer.updateTargetSamples();
+        
+        if (Menu::getInstance()->getAudioJitterBufferSamples() == 0) {
+            // no fixed jitter buffer was asked for, follow the adaptive target
+            setJitterBufferSamples(adaptiveJitterBufferSamples);
+        }
+        
+        if (_ringBuffer.samplesAvailable() > 0 || _ringBuffer.hasStarted()) {
             if (_ringBuffer.isStarved() && _ringBuffer.diffLastWriteNextOutput() <
                 (PACKET_LENGTH_SAMPLES + _jitterBufferSamples * (_ringBuffer.isStereo() ? 2 : 1))) {
                 //  If not enough audio has arrived to start playback, keep waiting
@@ -305,6 +434,7 @@ void Audio::handleAudioInput() {
                 //  If we have started and now have run out of audio to send to the audio device,
                 //  this means we've starved and should restart.
                 _ringBuffer.setIsStarved(true);
+                _jitterBuffer.bufferStarved();
                 
                 // show a starve in the GUI for 10 frames
                 _numFramesDisplayStarve = 10;
@@ -314,6 +444,13 @@ void Audio::handleAudioInput() {
                 if (_ringBuffer.isStarved()) {
                     _ringBuffer.setIsStarved(false);
                     _ringBuffer.setHasStarted(true);
+                } else if (_jitterBuffer.shouldDropFrame(_ringBuffer.samplesAvailable() / NUM_AUDIO_CHANNELS,
+                                                         _jitterBufferSamples,
+                                                         _ringBuffer.getNextOutputLoudness(PACKET_LENGTH_SAMPLES)
+                                                            < SILENT_FRAME_AVERAGE_LOUDNESS)) {
+                    // we have a frame more than we need for play out, discard the oldest one - the read position is
+                    // only ever moved here, by the thread that reads the ring buffer
+                    _ringBuffer.shiftReadPosition(PACKET_LENGTH_SAMPLES);
                 }
                 
                 _nextOutputSamples = _ringBuffer.getNextOutput();
@@ -338,12 +475,7 @@ void Audio::handleAudioInput() {
         }
         
         if (_isBufferSendCallback) {
-            _ringBuffer.setNextOutput(_ringBuffer.getNextOutput() + PACKET_LENGTH_SAMPLES);
-            
-            if (_ringBuffer.getNextOutput() == _ringBuffer.getBuffer() + RING_BUFFER_LENGTH_SAMPLES) {
-                _ringBuffer.setNextOutput(_ringBuffer.getBuffer());
-            }
-            
+            _ringBuffer.shiftReadPosition(PACKET_LENGTH_SAMPLES);
             _nextOutputSamples = NULL;
         } else {
             _nextOutputSamples += PACKET_LENGTH_SAMPLES_PER_CHANNEL / CALLBACK_ACCELERATOR_RATIO;
@@ -362,49 +494,23 @@ void Audio::handleAudioInput() {
     gettimeofday(&_lastCallbackTime, NULL);
 }
 
-void Audio::addReceivedAudioToBuffer(const QByteArray& audioByteArray) {
+void Audio::addReceivedAudioToBuffer(unsigned char* packetData, int packetLength) {
     const int NUM_INITIAL_PACKETS_DISCARD = 3;
-    const int STANDARD_DEVIATION_SAMPLE_COUNT = 500;
     
     timeval currentReceiveTime;
     gettimeofday(&currentReceiveTime, NULL);
     _totalPacketsReceived++;
     
-    double timeDiff = diffclock(&_lastReceiveTime, &currentReceiveTime);
-    
     //  Discard first few received packets for computing jitter (often they pile up on start)
     if (_totalPacketsReceived > NUM_INITIAL_PACKETS_DISCARD) {
-        _stdev.addValue(timeDiff);
+        _jitterBuffer.packetReceived(usecTimestamp(&currentReceiveTime));
     }
     
-    if (_stdev.getSamples() > STANDARD_DEVIATION_SAMPLE_COUNT) {
-        _measuredJitter = _stdev.getStDev();
-        _stdev.reset();
-        //  Set jitter buffer to be a multiple of the measured standard deviation
-        const int MAX_JITTER_BUFFER_SAMPLES = RING_BUFFER_LENGTH_SAMPLES / 2;
-        const float NUM_STANDARD_DEVIATIONS = 3.f;
-        if (Menu::getInstance()->getAudioJitterBufferSamples() == 0) {
-            float newJitterBufferSamples = (NUM_STANDARD_DEVIATIONS * _measuredJitter) / 1000.f * SAMPLE_RATE;
-            setJitterBufferSamples(glm::clamp((int)newJitterBufferSamples, 0, MAX_JITTER_BUFFER_SAMPLES));
-        }
-    }
-    
-    if (_ringBuffer.diffLastWriteNextOutput() + PACKET_LENGTH_SAMPLES >
-        PACKET_LENGTH_SAMPLES + (ceilf((float) (_jitterBufferSamples * 2) / PACKET_LENGTH_SAMPLES) * PACKET_LENGTH_SAMPLES)) {
-        // this packet would give us more than the required amount for play out
-        // discard the first packet in the buffer
-        
-        _ringBuffer.setNextOutput(_ringBuffer.getNextOutput() + PACKET_LENGTH_SAMPLES);
-        
-        if (_ringBuffer.getNextOutput() == _ringBuffer.getBuffer() + RING_BUFFER_LENGTH_SAMPLES) {
-            _ringBuffer.setNextOutput(_ringBuffer.getBuffer());
-        }
-    }
+    _measuredJitter = _jitterBuffer.getJitterMsecs();
     
-    _ringBuffer.parseData((unsigned char*) audioByteArray.data(), audioByteArray.size());
+    _ringBuffer.parseData(packetData, packetLength);
     
-    Application::getInstance()->getBandwidthMeter()->inputStream(BandwidthMeter::AUDIO).updateValue(PACKET_LENGTH_BYTES
-                                                                                                    + sizeof(PACKET_TYPE));
+    Application::getInstance()->getBandwidthMeter()->inputStream(BandwidthMeter::AUDIO).updateValue(packetLength);
     
     _lastReceiveTime = currentReceiveTime;
 }
@@ -454,7 +560,7 @@ void Audio::render(int screenWidth, int screenHeight) {
             timeLeftInCurrentBuffer = AUDIO_CALLBACK_MSECS - diffclock(&_lastCallbackTime, &currentTime);
         }
         
-        if (_ringBuffer.getEndOfLastWrite() != NULL)
+        if (_ringBuffer.samplesAvailable() > 0)
             remainingBuffer = _ringBuffer.diffLastWriteNextOutput() / PACKET_LENGTH_SAMPLES * AUDIO_CALLBACK_MSECS;
         
         if (_numFramesDisplayStarve == 0) {
@@ -496,7 +602,7 @@ void Audio::render(int screenWidth, int screenHeight) {
         int jitterBufferPels = (1.f + (float)getJitterBufferSamples() / (float) PACKET_LENGTH_SAMPLES_PER_CHANNEL) * frameWidth;
         sprintf(out, "%.0f\n", getJitterBufferSamples() / SAMPLE_RATE * 1000.f);
         drawtext(startX + jitterBufferPels - 5, topY - 9, 0.10, 0, 1, 0, out, 1, 0, 0);
-        sprintf(out, "j %.1f\n", _measuredJitter);
+        sprintf(out, "j %.1f s %d\n", _measuredJitter, _jitterBuffer.getNumStarves());
         if (Menu::getInstance()->getAudioJitterBufferSamples() == 0) {
             drawtext(startX + jitterBufferPels - 5, bottomY + 12, 0.10, 0, 1, 0, out, 1, 0, 0);
         } else {
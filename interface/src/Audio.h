@@ -14,11 +14,17 @@
 
 #include "InterfaceConfig.h"
 
+#include <QtCore/QHash>
 #include <QtCore/QObject>
+#include <QtCore/QUuid>
 
 #include <AbstractAudioInterface.h>
+#include <AdaptiveJitterBuffer.h>
+#include <AudioCodec.h>
+#include <AudioRegion.h>
 #include <AudioRingBuffer.h>
-#include <StdDev.h>
+#include <PacketQueue.h>
+#include <VoiceActivityDetector.h>
 
 #include "Oscilloscope.h"
 
@@ -34,6 +40,7 @@ static const int PACKET_LENGTH_SAMPLES_PER_CHANNEL = PACKET_LENGTH_SAMPLES / 2;
 class QAudioInput;
 class QAudioOutput;
 class QIODevice;
+class Node;
 
 class Audio : public QObject, public AbstractAudioInterface {
     Q_OBJECT
@@ -51,6 +58,8 @@ public:
     void setJitterBufferSamples(int samples) { _jitterBufferSamples = samples; }
     int getJitterBufferSamples() { return _jitterBufferSamples; }
     
+    const AdaptiveJitterBuffer& getAdaptiveJitterBuffer() const { return _jitterBuffer; }
+    
     void lowPassFilter(int16_t* inputBuffer);
     
     virtual void startCollisionSound(float magnitude, float frequency, float noise, float duration, bool flashScreen);
@@ -63,22 +72,43 @@ public:
     void init(QGLWidget *parent = 0);
     bool mousePressEvent(int x, int y);
     
+    /// queues a mixed audio or audio-mixer region packet for the audio thread, taking a reference to it - called from the
+    /// network receive thread
+    void queueReceivedPacket(PacketBuffer* packet);
+    
+    /// the queue of received packets waiting for the audio thread, for its drop and latency stats
+    PacketQueue& getReceivedPacketQueue() { return _receivedPackets; }
+    
 public slots:
     void start();
-    void addReceivedAudioToBuffer(const QByteArray& audioByteArray);
+    
+    /// handles everything queued by queueReceivedPacket - runs on the audio thread
+    void processReceivedPackets();
     void handleAudioInput();
     void reset();
     
 private:
+    void addReceivedAudioToBuffer(unsigned char* packetData, int packetLength);
+    
+    /// remembers the region of the domain an audio-mixer handles, so we can send our audio to the right one
+    void parseAudioMixerRegion(unsigned char* packetData, int packetLength);
+    
+    /// \return the audio-mixer whose region is closest to position, or the only audio-mixer if none have told us a region
+    Node* audioMixerForPosition(const glm::vec3& position);
+    
     QAudioInput* _audioInput;
     QIODevice* _inputDevice;
     QAudioOutput* _audioOutput;
     QIODevice* _outputDevice;
     bool _isBufferSendCallback;
-    int16_t* _nextOutputSamples;
+    const int16_t* _nextOutputSamples;
     AudioRingBuffer _ringBuffer;
     Oscilloscope* _scope;
-    StDev _stdev;
+    AdaptiveJitterBuffer _jitterBuffer;
+    AudioCodec _microphoneCodec;
+    VoiceActivityDetector _voiceActivityDetector;
+    QHash<QUuid, AudioRegion> _audioMixerRegions;
+    QUuid _audioMixerUUID;
     timeval _lastCallbackTime;
     timeval _lastReceiveTime;
     float _averagedLatency;
@@ -110,6 +140,9 @@ private:
     GLuint _muteTextureId;
     QRect _iconBounds;
     
+    PacketQueue _receivedPackets;
+    QAtomicInt _isProcessingScheduled;
+    
     // Audio callback in class context.
     inline void performIO(int16_t* inputLeft, int16_t* outputLeft, int16_t* outputRight);
     
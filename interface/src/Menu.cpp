@@ -480,6 +480,8 @@ Menu::Menu() :
     QMenu* audioDebugMenu = developerMenu->addMenu("Audio Debugging Tools");
     addCheckableActionToQMenuAndActionHash(audioDebugMenu, MenuOption::EchoServerAudio);
     addCheckableActionToQMenuAndActionHash(audioDebugMenu, MenuOption::EchoLocalAudio);
+    addCheckableActionToQMenuAndActionHash(audioDebugMenu, MenuOption::CompressAudio, 0, true);
+    addCheckableActionToQMenuAndActionHash(audioDebugMenu, MenuOption::SuppressSilentAudio, 0, true);
 
 
     addCheckableActionToQMenuAndActionHash(developerMenu, MenuOption::ExtraDebugging);
@@ -154,6 +154,8 @@ namespace MenuOption {
     const QString ChatCircling = "Chat Circling";
     const QString CollisionProxies = "Collision Proxies";
     const QString Collisions = "Collisions";
+    const QString CompressAudio = "Compress Audio";
+    const QString SuppressSilentAudio = "Suppress Silent Audio";
     const QString CopyVoxels = "Copy";
     const QString CoverageMap = "Render Coverage Map";
     const QString CoverageMapV2 = "Render Coverage Map V2";
@@ -27,23 +27,34 @@ void ParticleTreeRenderer::update() {
     }
 }
 
+void ParticleTreeRenderer::processSnapshot(const unsigned char* packetData, int packetLength) {
+    if (_tree) {
+        ParticleTree* tree = (ParticleTree*)_tree;
+        _tree->lockForWrite();
+        tree->processSnapshotPacket(packetData, packetLength);
+        _tree->unlock();
+    }
+}
+
 void ParticleTreeRenderer::renderElement(OctreeElement* element, RenderArgs* args) {
     // actually render it here...
     // we need to iterate the actual particles of the element
     ParticleTreeElement* particleTreeElement = (ParticleTreeElement*)element;
     
-    const std::vector<Particle>& particles = particleTreeElement->getParticles();
+    const ParticleStore& store = getTree()->getStore();
+    const std::vector<int>& particleIndexes = particleTreeElement->getParticleIndexes();
     
-    uint16_t numberOfParticles = particles.size();
+    uint16_t numberOfParticles = particleIndexes.size();
     
     bool drawAsSphere = true;
     
     for (uint16_t i = 0; i < numberOfParticles; i++) {
-        const Particle& particle = particles[i];
+        int index = particleIndexes[i];
         // render particle aspoints
-        glm::vec3 position = particle.getPosition() * (float)TREE_SCALE;
-        glColor3ub(particle.getColor()[RED_INDEX],particle.getColor()[GREEN_INDEX],particle.getColor()[BLUE_INDEX]);
-        float sphereRadius = particle.getRadius() * (float)TREE_SCALE;
+        glm::vec3 position = store.getPosition(index) * (float)TREE_SCALE;
+        const rgbColor& color = store.getColor(index);
+        glColor3ub(color[RED_INDEX], color[GREEN_INDEX], color[BLUE_INDEX]);
+        float sphereRadius = store.getRadius(index) * (float)TREE_SCALE;
 
         args->_renderedItems++;
         
@@ -34,6 +34,9 @@ public:
     virtual void renderElement(OctreeElement* element, RenderArgs* args);
 
     void update();
+    
+    /// corrects our extrapolation from a PACKET_TYPE_PARTICLE_SNAPSHOT
+    void processSnapshot(const unsigned char* packetData, int packetLength);
 
     ParticleTree* getTree() { return (ParticleTree*)_tree; }
 
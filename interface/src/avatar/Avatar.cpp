@@ -157,7 +157,7 @@ void Avatar::follow(Avatar* leadingAvatar) {
 
     _leadingAvatar = leadingAvatar;
     if (_leadingAvatar != NULL) {
-        _leaderUUID = leadingAvatar->getOwningNode()->getUUID();
+        _leaderUUID = leadingAvatar->getOwningNodeUUID();
         _stringLength = glm::length(_position - _leadingAvatar->getPosition()) / _scale;
         if (_stringLength > MAX_STRING_LENGTH) {
             _stringLength = MAX_STRING_LENGTH;
@@ -169,7 +169,8 @@ void Avatar::follow(Avatar* leadingAvatar) {
 
 void Avatar::simulate(float deltaTime, Transmitter* transmitter) {
     
-    if (_leadingAvatar && !_leadingAvatar->getOwningNode()->isAlive()) {
+    // once the leader's node is killed its avatar data can be deleted, so we let go of it
+    if (_leadingAvatar && !NodeList::getInstance()->nodeWithUUID(_leaderUUID)) {
         follow(NULL);
     }
     
@@ -492,15 +493,23 @@ bool Avatar::findSpherePenetration(const glm::vec3& penetratorCenter, float pene
     return false;
 }
 
+const float MOVE_DISTANCE_THRESHOLD = 0.001f;
+
 int Avatar::parseData(unsigned char* sourceBuffer, int numBytes) {
     // change in position implies movement
     glm::vec3 oldPosition = _position;
     int bytesRead = AvatarData::parseData(sourceBuffer, numBytes);
-    const float MOVE_DISTANCE_THRESHOLD = 0.001f;
     _moving = glm::distance(oldPosition, _position) > MOVE_DISTANCE_THRESHOLD;
     return bytesRead;
 }
 
+void Avatar::setQuantizedState(const QuantizedAvatarState& state, const QUuid& leaderUUID) {
+    // change in position implies movement
+    glm::vec3 oldPosition = _position;
+    AvatarData::setQuantizedState(state, leaderUUID);
+    _moving = glm::distance(oldPosition, _position) > MOVE_DISTANCE_THRESHOLD;
+}
+
 // render a makeshift cone section that serves as a body part connecting joint spheres
 void Avatar::renderJointConnectingCone(glm::vec3 position1, glm::vec3 position2, float radius1, float radius2) {
     
@@ -171,6 +171,7 @@ public:
         glm::vec3& penetration, int skeletonSkipIndex = -1);
 
     virtual int parseData(unsigned char* sourceBuffer, int numBytes);
+    virtual void setQuantizedState(const QuantizedAvatarState& state, const QUuid& leaderUUID);
 
     static void renderJointConnectingCone(glm::vec3 position1, glm::vec3 position2, float radius1, float radius2);
     
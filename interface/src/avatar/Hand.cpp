@@ -50,7 +50,7 @@ Hand::Hand(Avatar* owningAvatar) :
 
 void Hand::init() {
     // Different colors for my hand and others' hands
-    if (_owningAvatar && _owningAvatar->getOwningNode() == NULL) {
+    if (_owningAvatar && _owningAvatar->getOwningNodeUUID().isNull()) {
         _ballColor = glm::vec3(0.0, 0.4, 0.0);
     }
     else {
@@ -65,14 +65,15 @@ void Hand::simulateToyBall(PalmData& palm, const glm::vec3& fingerTipPosition, f
 
     glm::vec3 targetPosition = fingerTipPosition / (float)TREE_SCALE;
     float targetRadius = (TOY_BALL_RADIUS * 2.0f) / (float)TREE_SCALE;
-    const Particle* closestParticle = Application::getInstance()->getParticles()
-                                                ->getTree()->findClosestParticle(targetPosition, targetRadius);
+    Particle closestParticle;
+    bool foundParticle = Application::getInstance()->getParticles()
+                                ->getTree()->findClosestParticle(targetPosition, targetRadius, closestParticle);
 
-    if (closestParticle) {
-        printf("potentially caught... particle ID:%d\n", closestParticle->getID());
+    if (foundParticle) {
+        printf("potentially caught... particle ID:%d\n", closestParticle.getID());
         
         // you can create a ParticleEditHandle by doing this...
-        ParticleEditHandle* caughtParticle = Application::getInstance()->newParticleEditHandle(closestParticle->getID());
+        ParticleEditHandle* caughtParticle = Application::getInstance()->newParticleEditHandle(closestParticle.getID());
         
         // but make sure you clean it up, when you're done
         delete caughtParticle;
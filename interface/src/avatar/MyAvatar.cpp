@@ -87,7 +87,8 @@ void MyAvatar::simulate(float deltaTime, Transmitter* transmitter) {
         _elapsedTimeMoving += deltaTime;
     }
 
-    if (_leadingAvatar && !_leadingAvatar->getOwningNode()->isAlive()) {
+    // once the leader's node is killed its avatar data can be deleted, so we let go of it
+    if (_leadingAvatar && !NodeList::getInstance()->nodeWithUUID(_leaderUUID)) {
         follow(NULL);
     }
 
@@ -0,0 +1,111 @@
+//
+//  AdaptiveJitterBuffer.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <algorithm>
+#include <math.h>
+
+#include <SharedUtil.h>
+
+#include "AdaptiveJitterBuffer.h"
+
+// weight given to each new deviation in the running jitter estimate, as in RFC 3550
+const float JITTER_ESTIMATE_GAIN = 1.0f / 16.0f;
+
+// how quickly the remembered peak deviation fades per received packet (about 8 seconds at 86 packets per second)
+const float PEAK_DEVIATION_DECAY = 0.9985f;
+
+// the target never shrinks until the stream has gone this long without starving
+const uint64_t SHRINK_HOLD_USECS = 10 * 1000 * 1000;
+
+// once we are allowed to shrink, give back this many samples per frame played
+const int SHRINK_SAMPLES_PER_FRAME = 1;
+
+// if the buffer is this many frames over its target, drop frames even if they are not silent
+const int MAX_EXCESS_FRAMES = 3;
+
+AdaptiveJitterBuffer::AdaptiveJitterBuffer(int frameSamples, int sampleRate, int maxTargetSamples) :
+    _frameSamples(frameSamples),
+    _sampleRate(sampleRate),
+    _expectedGapUsecs(frameSamples * 1000000.0f / sampleRate),
+    _minTargetSamples(0),
+    _maxTargetSamples(std::min(maxTargetSamples, MAX_JITTER_BUFFER_MSECS * sampleRate / 1000)),
+    _measuredTargetSamples(0)
+{
+    reset();
+}
+
+void AdaptiveJitterBuffer::reset() {
+    _lastReceiveTimestamp = 0;
+    _jitterUsecs = 0.0f;
+    _peakDeviationUsecs = 0.0f;
+    _measuredTargetSamples.storeRelease(_minTargetSamples);
+    
+    _lastStarveTimestamp = 0;
+    _targetSamples = DEFAULT_JITTER_BUFFER_MSECS * _sampleRate / 1000;
+    _numStarves = 0;
+    _numFramesDropped = 0;
+}
+
+void AdaptiveJitterBuffer::packetReceived() {
+    packetReceived(usecTimestampNow());
+}
+
+void AdaptiveJitterBuffer::packetReceived(uint64_t receiveTimestamp) {
+    if (_lastReceiveTimestamp == 0) {
+        // first packet, nothing to compare against yet
+        _lastReceiveTimestamp = receiveTimestamp;
+        return;
+    }
+    
+    float gapUsecs = receiveTimestamp - _lastReceiveTimestamp;
+    _lastReceiveTimestamp = receiveTimestamp;
+    
+    float deviationUsecs = fabsf(gapUsecs - _expectedGapUsecs);
+    
+    _jitterUsecs += (deviationUsecs - _jitterUsecs) * JITTER_ESTIMATE_GAIN;
+    _peakDeviationUsecs = std::max(deviationUsecs, _peakDeviationUsecs * PEAK_DEVIATION_DECAY);
+    
+    // we need enough buffered to ride out the worst gap we've seen lately
+    _measuredTargetSamples.storeRelease(glm::clamp(samplesForUsecs(_peakDeviationUsecs),
+                                                   _minTargetSamples, _maxTargetSamples));
+}
+
+int AdaptiveJitterBuffer::updateTargetSamples() {
+    int desiredSamples = _measuredTargetSamples.loadAcquire();
+    
+    if (desiredSamples > _targetSamples) {
+        // grow right away, a late packet now costs us a dropout
+        _targetSamples = desiredSamples;
+    } else if (desiredSamples < _targetSamples
+               && usecTimestampNow() - _lastStarveTimestamp > SHRINK_HOLD_USECS) {
+        // the link has been calm for a while, slowly give back latency
+        _targetSamples = std::max(desiredSamples, _targetSamples - SHRINK_SAMPLES_PER_FRAME);
+    }
+    
+    return _targetSamples;
+}
+
+void AdaptiveJitterBuffer::bufferStarved() {
+    _numStarves++;
+    _lastStarveTimestamp = usecTimestampNow();
+    
+    // whatever we measured wasn't enough, add half a frame on top
+    _targetSamples = std::min(_targetSamples + _frameSamples / 2, _maxTargetSamples);
+}
+
+bool AdaptiveJitterBuffer::shouldDropFrame(int numSamplesAvailable, int targetSamples, bool isNextFrameSilent) {
+    // we want one frame to play plus the jitter buffer, anything a whole frame past that is extra latency
+    int excessSamples = numSamplesAvailable - (_frameSamples + targetSamples);
+    
+    if (excessSamples >= _frameSamples * MAX_EXCESS_FRAMES
+        || (excessSamples >= _frameSamples && isNextFrameSilent)) {
+        _numFramesDropped++;
+        return true;
+    } else {
+        return false;
+    }
+}
@@ -0,0 +1,83 @@
+//
+//  AdaptiveJitterBuffer.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__AdaptiveJitterBuffer__
+#define __hifi__AdaptiveJitterBuffer__
+
+#include <limits.h>
+#include <stdint.h>
+
+#include <QtCore/QAtomicInt>
+
+const int DEFAULT_JITTER_BUFFER_MSECS = 12;
+const int MAX_JITTER_BUFFER_MSECS = 200;
+
+// a frame whose average absolute sample is below this is treated as silence and can be dropped to cut latency
+const float SILENT_FRAME_AVERAGE_LOUDNESS = 64.0f;
+
+/// Tracks the inter-arrival jitter of one audio stream and decides how many samples of jitter buffer that stream's
+/// ring buffer should hold beyond the frame being played. The target grows as soon as jitter rises or the stream
+/// starves, and shrinks slowly once the link has been calm for a while. All sample counts are per channel.
+/// The jitter is measured on the thread that writes the stream's ring buffer, the target is kept by the thread that reads it
+/// and picks up the latest measurement through an atomic.
+class AdaptiveJitterBuffer {
+public:
+    /// \param maxTargetSamples the most the target may grow to, lowered from MAX_JITTER_BUFFER_MSECS by a ring buffer
+    /// that couldn't hold that much on top of what it needs for play out
+    AdaptiveJitterBuffer(int frameSamples, int sampleRate, int maxTargetSamples = INT_MAX);
+    
+    void reset();
+    
+    /// call once for every audio packet that arrives for this stream, from the thread that writes the ring buffer
+    void packetReceived();
+    void packetReceived(uint64_t receiveTimestamp);
+    
+    /// call once per frame from the thread that reads the ring buffer, as are bufferStarved and shouldDropFrame
+    /// \return the jitter buffer length to converge to
+    int updateTargetSamples();
+    
+    /// call when the consumer ran out of samples to play
+    void bufferStarved();
+    
+    /// \param numSamplesAvailable the number of samples per channel currently in the ring buffer
+    /// \param targetSamples the jitter buffer length to converge to
+    /// \param isNextFrameSilent true if the oldest frame in the ring buffer is silence
+    /// \return true if the oldest frame should be discarded to bring the buffer depth back toward the target
+    bool shouldDropFrame(int numSamplesAvailable, int targetSamples, bool isNextFrameSilent);
+    
+    int getTargetSamples() const { return _targetSamples; }
+    float getTargetMsecs() const { return _targetSamples * 1000.0f / _sampleRate; }
+    float getJitterMsecs() const { return _jitterUsecs / 1000.0f; }
+    
+    /// \return the time the last packet for this stream arrived, 0 if none has
+    uint64_t getLastReceiveTimestamp() const { return _lastReceiveTimestamp; }
+    
+    int getNumStarves() const { return _numStarves; }
+    int getNumFramesDropped() const { return _numFramesDropped; }
+private:
+    int samplesForUsecs(float usecs) const { return usecs * _sampleRate / 1000000.0f; }
+    
+    int _frameSamples;
+    int _sampleRate;
+    float _expectedGapUsecs;
+    int _minTargetSamples;
+    int _maxTargetSamples;
+    
+    // written by the thread that writes the ring buffer
+    uint64_t _lastReceiveTimestamp;
+    float _jitterUsecs;
+    float _peakDeviationUsecs;
+    QAtomicInt _measuredTargetSamples;
+    
+    // written by the thread that reads the ring buffer
+    uint64_t _lastStarveTimestamp;
+    int _targetSamples;
+    int _numStarves;
+    int _numFramesDropped;
+};
+
+#endif /* defined(__hifi__AdaptiveJitterBuffer__) */
@@ -0,0 +1,200 @@
+//
+//  AudioCodec.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <cstring>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "AudioCodec.h"
+
+// each ADPCM channel block starts with its 16-bit predictor, its step index and a padding byte
+const int NUM_BYTES_ADPCM_BLOCK_HEADER = sizeof(int16_t) + 2;
+
+const int ADPCM_MAX_STEP_INDEX = 88;
+
+const int ADPCM_STEP_TABLE[ADPCM_MAX_STEP_INDEX + 1] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107,
+    118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876,
+    963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086,
+    29794, 32767
+};
+
+const int ADPCM_INDEX_TABLE[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+const int MIN_SAMPLE_VALUE = std::numeric_limits<int16_t>::min();
+const int MAX_SAMPLE_VALUE = std::numeric_limits<int16_t>::max();
+
+// applies one ADPCM code to the predictor and step index, exactly as both the encoder and decoder must
+static void applyADPCMCode(int code, int& predictor, int& stepIndex) {
+    int step = ADPCM_STEP_TABLE[stepIndex];
+    int predictionDelta = step >> 3;
+    
+    if (code & 4) {
+        predictionDelta += step;
+    }
+    if (code & 2) {
+        predictionDelta += step >> 1;
+    }
+    if (code & 1) {
+        predictionDelta += step >> 2;
+    }
+    
+    predictor += (code & 8) ? -predictionDelta : predictionDelta;
+    predictor = glm::clamp(predictor, MIN_SAMPLE_VALUE, MAX_SAMPLE_VALUE);
+    
+    stepIndex = glm::clamp(stepIndex + ADPCM_INDEX_TABLE[code], 0, ADPCM_MAX_STEP_INDEX);
+}
+
+AudioCodec::AudioCodec(AUDIO_CODEC type, int numChannels) :
+    _type(type),
+    _numChannels(numChannels),
+    _sequence(0)
+{
+    for (int i = 0; i < MAX_AUDIO_CODEC_CHANNELS; i++) {
+        _predictors[i] = 0;
+        _stepIndices[i] = 0;
+    }
+}
+
+int AudioCodec::numBytesForEncodedFrame(AUDIO_CODEC type, int numSamplesPerChannel, int numChannels) {
+    switch (type) {
+        case AUDIO_CODEC_PCM:
+            return NUM_BYTES_ENCODED_FRAME_HEADER + (numSamplesPerChannel * numChannels * sizeof(int16_t));
+        case AUDIO_CODEC_ADPCM:
+            // four bits per sample
+            return NUM_BYTES_ENCODED_FRAME_HEADER + (numChannels * (NUM_BYTES_ADPCM_BLOCK_HEADER + (numSamplesPerChannel / 2)));
+        case AUDIO_CODEC_SILENT:
+            return NUM_BYTES_ENCODED_FRAME_HEADER;
+        default:
+            return 0;
+    }
+}
+
+int AudioCodec::encodeFrame(const int16_t* samples, int numSamplesPerChannel, unsigned char* destination) {
+    unsigned char* currentPosition = destination;
+    
+    *(currentPosition++) = _type;
+    
+    memcpy(currentPosition, &_sequence, sizeof(_sequence));
+    currentPosition += sizeof(_sequence);
+    _sequence++;
+    
+    if (_type == AUDIO_CODEC_ADPCM) {
+        for (int channel = 0; channel < _numChannels; channel++) {
+            const int16_t* channelSamples = samples + (channel * numSamplesPerChannel);
+            int& predictor = _predictors[channel];
+            int& stepIndex = _stepIndices[channel];
+            
+            // write the state this block starts from so the decoder doesn't need any history
+            int16_t blockPredictor = predictor;
+            memcpy(currentPosition, &blockPredictor, sizeof(blockPredictor));
+            currentPosition += sizeof(blockPredictor);
+            *(currentPosition++) = stepIndex;
+            *(currentPosition++) = 0;
+            
+            for (int s = 0; s < numSamplesPerChannel; s++) {
+                int difference = channelSamples[s] - predictor;
+                int step = ADPCM_STEP_TABLE[stepIndex];
+                int code = 0;
+                
+                if (difference < 0) {
+                    code = 8;
+                    difference = -difference;
+                }
+                
+                if (difference >= step) {
+                    code |= 4;
+                    difference -= step;
+                }
+                step >>= 1;
+                if (difference >= step) {
+                    code |= 2;
+                    difference -= step;
+                }
+                step >>= 1;
+                if (difference >= step) {
+                    code |= 1;
+                }
+                
+                applyADPCMCode(code, predictor, stepIndex);
+                
+                // two codes per byte, the earlier sample in the low nibble
+                if (s % 2 == 0) {
+                    *currentPosition = code;
+                } else {
+                    *(currentPosition++) |= (code << 4);
+                }
+            }
+        }
+    } else {
+        int numBytesSamples = numSamplesPerChannel * _numChannels * sizeof(int16_t);
+        memcpy(currentPosition, samples, numBytesSamples);
+        currentPosition += numBytesSamples;
+    }
+    
+    return currentPosition - destination;
+}
+
+int AudioCodec::encodeSilentFrame(unsigned char* destination) {
+    *destination = AUDIO_CODEC_SILENT;
+    memcpy(destination + sizeof(AUDIO_CODEC), &_sequence, sizeof(_sequence));
+    _sequence++;
+    
+    return NUM_BYTES_ENCODED_FRAME_HEADER;
+}
+
+int AudioCodec::decodeFrame(const unsigned char* source, int numBytes,
+                            int16_t* samples, int numSamplesPerChannel, int numChannels, uint16_t& sequence) {
+    if (numBytes < NUM_BYTES_ENCODED_FRAME_HEADER) {
+        return 0;
+    }
+    
+    const unsigned char* currentPosition = source;
+    AUDIO_CODEC type = *(currentPosition++);
+    
+    int numBytesFrame = numBytesForEncodedFrame(type, numSamplesPerChannel, numChannels);
+    if (numBytesFrame == 0 || numBytes < numBytesFrame) {
+        // either a codec we don't know or a truncated frame
+        return 0;
+    }
+    
+    memcpy(&sequence, currentPosition, sizeof(sequence));
+    currentPosition += sizeof(sequence);
+    
+    if (type == AUDIO_CODEC_SILENT) {
+        memset(samples, 0, numSamplesPerChannel * numChannels * sizeof(int16_t));
+    } else if (type == AUDIO_CODEC_ADPCM) {
+        for (int channel = 0; channel < numChannels; channel++) {
+            int16_t* channelSamples = samples + (channel * numSamplesPerChannel);
+            
+            int16_t blockPredictor;
+            memcpy(&blockPredictor, currentPosition, sizeof(blockPredictor));
+            currentPosition += sizeof(blockPredictor);
+            
+            int predictor = blockPredictor;
+            int stepIndex = glm::clamp((int) *(currentPosition++), 0, ADPCM_MAX_STEP_INDEX);
+            currentPosition++;
+            
+            for (int s = 0; s < numSamplesPerChannel; s++) {
+                int code = (s % 2 == 0) ? (*currentPosition & 0x0F) : (*(currentPosition++) >> 4);
+                applyADPCMCode(code, predictor, stepIndex);
+                channelSamples[s] = predictor;
+            }
+        }
+    } else {
+        int numBytesSamples = numSamplesPerChannel * numChannels * sizeof(int16_t);
+        memcpy(samples, currentPosition, numBytesSamples);
+        currentPosition += numBytesSamples;
+    }
+    
+    return currentPosition - source;
+}
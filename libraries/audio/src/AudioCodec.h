@@ -0,0 +1,59 @@
+//
+//  AudioCodec.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__AudioCodec__
+#define __hifi__AudioCodec__
+
+#include <stdint.h>
+
+typedef unsigned char AUDIO_CODEC;
+const AUDIO_CODEC AUDIO_CODEC_PCM = 0;
+const AUDIO_CODEC AUDIO_CODEC_ADPCM = 1;
+
+// not a real codec - a frame of silence that carries no samples at all
+const AUDIO_CODEC AUDIO_CODEC_SILENT = 2;
+
+const int MAX_AUDIO_CODEC_CHANNELS = 2;
+
+// every encoded frame starts with the codec it was encoded with and a sequence number for loss detection
+const int NUM_BYTES_ENCODED_FRAME_HEADER = sizeof(AUDIO_CODEC) + sizeof(uint16_t);
+
+/// Encodes fixed-size frames of 16-bit audio for the wire. Multi-channel frames are planar (all of the left channel,
+/// then all of the right). PCM frames are sent as they are. IMA ADPCM frames are a quarter of the size, and each
+/// channel block carries the predictor state it starts from. That means every frame decodes on its own and a lost
+/// packet never corrupts the ones after it. ADPCM works sample by sample, so it adds no latency beyond the frame.
+class AudioCodec {
+public:
+    AudioCodec(AUDIO_CODEC type = AUDIO_CODEC_PCM, int numChannels = 1);
+    
+    AUDIO_CODEC getType() const { return _type; }
+    void setType(AUDIO_CODEC type) { _type = type; }
+    
+    /// \return the number of bytes an encoded frame with this many samples per channel takes, including its header
+    static int numBytesForEncodedFrame(AUDIO_CODEC type, int numSamplesPerChannel, int numChannels);
+    
+    /// encodes one frame, and its header, into destination
+    /// \return the number of bytes written
+    int encodeFrame(const int16_t* samples, int numSamplesPerChannel, unsigned char* destination);
+    
+    /// writes a header-only frame telling the receiver this frame is silence
+    /// \return the number of bytes written
+    int encodeSilentFrame(unsigned char* destination);
+    
+    /// decodes one frame, and its header, from source - a silent frame decodes to zeroed samples
+    /// \return the number of bytes read, or 0 if source did not hold a complete frame in a codec we understand
+    static int decodeFrame(const unsigned char* source, int numBytes,
+                           int16_t* samples, int numSamplesPerChannel, int numChannels, uint16_t& sequence);
+private:
+    AUDIO_CODEC _type;
+    int _numChannels;
+    uint16_t _sequence;
+    int _predictors[MAX_AUDIO_CODEC_CHANNELS];
+    int _stepIndices[MAX_AUDIO_CODEC_CHANNELS];
+};
+
+#endif /* defined(__hifi__AudioCodec__) */
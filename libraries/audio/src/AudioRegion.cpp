@@ -0,0 +1,74 @@
+//
+//  AudioRegion.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <cstdio>
+#include <cstring>
+
+#include "AudioRegion.h"
+
+AudioRegion::AudioRegion() :
+    _minimum(0.0f, 0.0f, 0.0f),
+    _maximum(0.0f, 0.0f, 0.0f),
+    _isValid(false)
+{
+    
+}
+
+AudioRegion::AudioRegion(const glm::vec3& minimum, const glm::vec3& maximum) :
+    _minimum(glm::min(minimum, maximum)),
+    _maximum(glm::max(minimum, maximum)),
+    _isValid(true)
+{
+    
+}
+
+AudioRegion AudioRegion::fromString(const char* regionString) {
+    glm::vec3 minimum, maximum;
+    
+    if (regionString && sscanf(regionString, "%f,%f,%f,%f,%f,%f",
+                               &minimum.x, &minimum.y, &minimum.z, &maximum.x, &maximum.y, &maximum.z) == 6) {
+        return AudioRegion(minimum, maximum);
+    } else {
+        return AudioRegion();
+    }
+}
+
+bool AudioRegion::contains(const glm::vec3& point) const {
+    return _isValid
+        && point.x >= _minimum.x && point.x < _maximum.x
+        && point.y >= _minimum.y && point.y < _maximum.y
+        && point.z >= _minimum.z && point.z < _maximum.z;
+}
+
+float AudioRegion::distanceTo(const glm::vec3& point) const {
+    return glm::distance(point, glm::clamp(point, _minimum, _maximum));
+}
+
+int AudioRegion::octantForPoint(const glm::vec3& point) const {
+    glm::vec3 center = getCenter();
+    
+    return (point.x >= center.x ? 1 : 0) | (point.y >= center.y ? 2 : 0) | (point.z >= center.z ? 4 : 0);
+}
+
+int AudioRegion::packToBuffer(unsigned char* buffer) const {
+    memcpy(buffer, &_minimum, sizeof(_minimum));
+    memcpy(buffer + sizeof(_minimum), &_maximum, sizeof(_maximum));
+    
+    return numBytesPacked();
+}
+
+int AudioRegion::unpackFromBuffer(const unsigned char* buffer, int numBytes) {
+    if (numBytes < numBytesPacked()) {
+        return 0;
+    }
+    
+    memcpy(&_minimum, buffer, sizeof(_minimum));
+    memcpy(&_maximum, buffer + sizeof(_minimum), sizeof(_maximum));
+    _isValid = true;
+    
+    return numBytesPacked();
+}
@@ -0,0 +1,51 @@
+//
+//  AudioRegion.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__AudioRegion__
+#define __hifi__AudioRegion__
+
+#include <glm/glm.hpp>
+
+const int NUM_AUDIO_REGION_OCTANTS = 8;
+
+/// The axis-aligned box of the domain that one audio-mixer is responsible for when audio is split across several
+/// mixers. Agents inside the box send their microphone audio to that mixer, and the mixer pre-mixes its sources
+/// per octant of the box into far-field streams for its peers.
+class AudioRegion {
+public:
+    /// constructs an invalid region, which means the mixer owns the whole domain
+    AudioRegion();
+    AudioRegion(const glm::vec3& minimum, const glm::vec3& maximum);
+    
+    /// \param regionString six comma separated floats - the minimum corner followed by the maximum corner
+    static AudioRegion fromString(const char* regionString);
+    
+    bool isValid() const { return _isValid; }
+    
+    const glm::vec3& getMinimum() const { return _minimum; }
+    const glm::vec3& getMaximum() const { return _maximum; }
+    glm::vec3 getCenter() const { return (_minimum + _maximum) * 0.5f; }
+    
+    bool contains(const glm::vec3& point) const;
+    
+    /// \return the distance from point to the closest point of the region, 0 if the point is inside
+    float distanceTo(const glm::vec3& point) const;
+    
+    /// \return which of the eight octants of the region point falls in, points outside go to the nearest octant
+    int octantForPoint(const glm::vec3& point) const;
+    
+    int packToBuffer(unsigned char* buffer) const;
+    int unpackFromBuffer(const unsigned char* buffer, int numBytes);
+    
+    static int numBytesPacked() { return 2 * sizeof(glm::vec3); }
+private:
+    glm::vec3 _minimum;
+    glm::vec3 _maximum;
+    bool _isValid;
+};
+
+#endif /* defined(__hifi__AudioRegion__) */
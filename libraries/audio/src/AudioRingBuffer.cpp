@@ -6,8 +6,11 @@
 //  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
 //
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
 #include <math.h>
+#include <stdlib.h>
 
 #include "PacketHeaders.h"
 
@@ -15,52 +18,52 @@
 
 AudioRingBuffer::AudioRingBuffer(bool isStereo) :
     NodeData(NULL),
-    _endOfLastWrite(NULL),
+    _nextOutputIndex(0),
+    _endOfLastWriteIndex(0),
     _isStarved(true),
     _hasStarted(false),
-    _isStereo(isStereo)
+    _isStereo(isStereo),
+    _overflowCount(0),
+    _hasReceivedSequence(false),
+    _expectedSequence(0),
+    _numConcealedFrames(0),
+    _receivedCodec(AUDIO_CODEC_PCM),
+    _isSilent(false),
+    _shouldSkipSilentFrames(false)
 {
     _buffer = new int16_t[RING_BUFFER_LENGTH_SAMPLES];
-    _nextOutput = _buffer;
+    _lastFrame = new int16_t[BUFFER_LENGTH_SAMPLES_PER_CHANNEL * (_isStereo ? 2 : 1)];
 };
 
 AudioRingBuffer::~AudioRingBuffer() {
     delete[] _buffer;
+    delete[] _lastFrame;
 }
 
 void AudioRingBuffer::reset() {
-    _endOfLastWrite = _buffer;
-    _nextOutput = _buffer;
+    _endOfLastWriteIndex.storeRelease(0);
+    _nextOutputIndex.storeRelease(0);
     _isStarved = true;
     _hasStarted = false;
+    _hasReceivedSequence = false;
+    _isSilent = false;
 }
 
 int AudioRingBuffer::parseData(unsigned char* sourceBuffer, int numBytes) {
     int numBytesPacketHeader = numBytesForPacketHeader(sourceBuffer);
-    return parseAudioSamples(sourceBuffer + numBytesPacketHeader, numBytes - numBytesPacketHeader);
+    return parseEncodedAudioSamples(sourceBuffer + numBytesPacketHeader, numBytes - numBytesPacketHeader);
 }
 
 int AudioRingBuffer::parseAudioSamples(unsigned char* sourceBuffer, int numBytes) {
     // make sure we have enough bytes left for this to be the right amount of audio
-    // otherwise we should not copy that data, and leave the buffer pointers where they are
+    // otherwise we should not copy that data, and leave the buffer indices where they are
     int samplesToCopy = BUFFER_LENGTH_SAMPLES_PER_CHANNEL * (_isStereo ? 2 : 1);
     
     if (numBytes == samplesToCopy * sizeof(int16_t)) {
-        
-        if (!_endOfLastWrite) {
-            _endOfLastWrite = _buffer;
-        } else if (diffLastWriteNextOutput() > RING_BUFFER_LENGTH_SAMPLES - samplesToCopy) {
-            _endOfLastWrite = _buffer;
-            _nextOutput = _buffer;
-            _isStarved = true;
-        }
-        
-        memcpy(_endOfLastWrite, sourceBuffer, numBytes);
-        
-        _endOfLastWrite += samplesToCopy;
-        
-        if (_endOfLastWrite >= _buffer + RING_BUFFER_LENGTH_SAMPLES) {
-            _endOfLastWrite = _buffer;
+        if (!writeSamples((int16_t*) sourceBuffer, samplesToCopy)) {
+            // the consumer is not keeping up - the read index belongs to it, so the only thing we can safely do
+            // is drop this frame and let the consumer's starve and jitter logic catch up
+            _overflowCount++;
         }
         
         return numBytes;
@@ -69,16 +72,160 @@ int AudioRingBuffer::parseAudioSamples(unsigned char* sourceBuffer, int numBytes
     }    
 }
 
-int AudioRingBuffer::diffLastWriteNextOutput() const {
-    if (!_endOfLastWrite) {
+int AudioRingBuffer::parseEncodedAudioSamples(unsigned char* sourceBuffer, int numBytes) {
+    const float CONCEALMENT_FADE_RATIO = 0.5f;
+    
+    int numChannels = _isStereo ? 2 : 1;
+    int samplesPerFrame = BUFFER_LENGTH_SAMPLES_PER_CHANNEL * numChannels;
+    
+    int16_t decodedFrame[BUFFER_LENGTH_SAMPLES_PER_CHANNEL * MAX_AUDIO_CODEC_CHANNELS];
+    uint16_t sequence = 0;
+    
+    int numBytesRead = AudioCodec::decodeFrame(sourceBuffer, numBytes, decodedFrame,
+                                               BUFFER_LENGTH_SAMPLES_PER_CHANNEL, numChannels, sequence);
+    
+    if (numBytesRead == 0) {
         return 0;
-    } else {
-        int sampleDifference = _endOfLastWrite - _nextOutput;
+    }
+    
+    AUDIO_CODEC codec = *sourceBuffer;
+    
+    if (codec != AUDIO_CODEC_SILENT) {
+        _receivedCodec = codec;
+    }
+    
+    if (_hasReceivedSequence) {
+        uint16_t numFramesLost = sequence - _expectedSequence;
+        
+        if (numFramesLost >= std::numeric_limits<uint16_t>::max() / 2) {
+            // this frame is older than one we already have - we've either concealed it or played past it
+            return numBytesRead;
+        }
         
-        if (sampleDifference < 0) {
-            sampleDifference += RING_BUFFER_LENGTH_SAMPLES;
+        // fill the gap with the last good frame, fading a little more for each missing frame
+        // there's nothing to conceal if the sender was silent before the gap
+        for (int i = 0; i < numFramesLost && i < MAX_CONCEALED_FRAMES && !_isSilent; i++) {
+            for (int s = 0; s < samplesPerFrame; s++) {
+                _lastFrame[s] *= CONCEALMENT_FADE_RATIO;
+            }
+            
+            if (!writeSamples(_lastFrame, samplesPerFrame)) {
+                _overflowCount++;
+            }
+            
+            _numConcealedFrames++;
         }
+    }
+    
+    _hasReceivedSequence = true;
+    _expectedSequence = sequence + 1;
+    
+    _isSilent = (codec == AUDIO_CODEC_SILENT);
+    
+    memcpy(_lastFrame, decodedFrame, samplesPerFrame * sizeof(int16_t));
+    
+    if (_isSilent && _shouldSkipSilentFrames) {
+        // our consumer would rather skip this stream than be handed a frame of zeroes
+        return numBytesRead;
+    }
+    
+    if (!writeSamples(decodedFrame, samplesPerFrame)) {
+        _overflowCount++;
+    }
+    
+    return numBytesRead;
+}
+
+int AudioRingBuffer::writeSamples(const int16_t* source, int numSamples) {
+    if (numSamples > samplesFree()) {
+        return 0;
+    }
+    
+    int writeIndex = _endOfLastWriteIndex.load();
+    int samplesToEnd = RING_BUFFER_LENGTH_SAMPLES - writeIndex;
+    
+    if (numSamples <= samplesToEnd) {
+        memcpy(_buffer + writeIndex, source, numSamples * sizeof(int16_t));
+    } else {
+        // this write straddles the end of the buffer, copy in two pieces
+        memcpy(_buffer + writeIndex, source, samplesToEnd * sizeof(int16_t));
+        memcpy(_buffer, source + samplesToEnd, (numSamples - samplesToEnd) * sizeof(int16_t));
+    }
+    
+    // publish the samples to the consumer only once they have been copied in
+    _endOfLastWriteIndex.storeRelease((writeIndex + numSamples) % RING_BUFFER_LENGTH_SAMPLES);
+    
+    return numSamples;
+}
+
+int AudioRingBuffer::readSamples(int16_t* destination, int numSamples) {
+    if (numSamples > samplesAvailable()) {
+        return 0;
+    }
+    
+    int readIndex = _nextOutputIndex.load();
+    int samplesToEnd = RING_BUFFER_LENGTH_SAMPLES - readIndex;
+    
+    if (numSamples <= samplesToEnd) {
+        memcpy(destination, _buffer + readIndex, numSamples * sizeof(int16_t));
+    } else {
+        // this read straddles the end of the buffer, copy in two pieces
+        memcpy(destination, _buffer + readIndex, samplesToEnd * sizeof(int16_t));
+        memcpy(destination + samplesToEnd, _buffer, (numSamples - samplesToEnd) * sizeof(int16_t));
+    }
+    
+    // hand the space back to the producer only once we are done copying out of it
+    _nextOutputIndex.storeRelease((readIndex + numSamples) % RING_BUFFER_LENGTH_SAMPLES);
+    
+    return numSamples;
+}
+
+void AudioRingBuffer::shiftReadPosition(int numSamples) {
+    numSamples = std::min(numSamples, samplesAvailable());
+    _nextOutputIndex.storeRelease((_nextOutputIndex.load() + numSamples) % RING_BUFFER_LENGTH_SAMPLES);
+}
+
+const int16_t* AudioRingBuffer::getNextOutputWithOffset(int numSamplesOffset) const {
+    int offsetIndex = (_nextOutputIndex.loadAcquire() + numSamplesOffset) % RING_BUFFER_LENGTH_SAMPLES;
+    
+    if (offsetIndex < 0) {
+        offsetIndex += RING_BUFFER_LENGTH_SAMPLES;
+    }
+    
+    return _buffer + offsetIndex;
+}
+
+float AudioRingBuffer::getNextOutputLoudness(int numSamples) const {
+    numSamples = std::min(numSamples, samplesAvailable());
+    
+    if (numSamples == 0) {
+        return 0.0f;
+    }
+    
+    float loudness = 0.0f;
+    int sampleIndex = _nextOutputIndex.loadAcquire();
+    
+    for (int i = 0; i < numSamples; i++) {
+        loudness += abs(_buffer[sampleIndex]);
         
-        return sampleDifference;
+        if (++sampleIndex == RING_BUFFER_LENGTH_SAMPLES) {
+            sampleIndex = 0;
+        }
     }
+    
+    return loudness / numSamples;
+}
+
+int AudioRingBuffer::contiguousSamplesAvailable() const {
+    return std::min(samplesAvailable(), RING_BUFFER_LENGTH_SAMPLES - _nextOutputIndex.loadAcquire());
+}
+
+int AudioRingBuffer::samplesAvailable() const {
+    int sampleDifference = _endOfLastWriteIndex.loadAcquire() - _nextOutputIndex.loadAcquire();
+    
+    if (sampleDifference < 0) {
+        sampleDifference += RING_BUFFER_LENGTH_SAMPLES;
+    }
+    
+    return sampleDifference;
 }
@@ -14,6 +14,9 @@
 
 #include <glm/glm.hpp>
 
+#include <QtCore/QAtomicInt>
+
+#include "AudioCodec.h"
 #include "NodeData.h"
 
 const int SAMPLE_RATE = 22050;
@@ -25,23 +28,53 @@ const int BUFFER_LENGTH_SAMPLES_PER_CHANNEL = BUFFER_LENGTH_BYTES_PER_CHANNEL /
 const short RING_BUFFER_LENGTH_FRAMES = 20;
 const short RING_BUFFER_LENGTH_SAMPLES = RING_BUFFER_LENGTH_FRAMES * BUFFER_LENGTH_SAMPLES_PER_CHANNEL;
 
+// how many missing frames in a row we fill in with a fading copy of the last good one before going silent
+const int MAX_CONCEALED_FRAMES = 3;
+
+// the writer never fills the frame directly behind the read index, so consumers can look back into it
+// (the mixer does this for its phase delay) and so a full buffer is never confused with an empty one
+const short RING_BUFFER_GUARD_SAMPLES = BUFFER_LENGTH_SAMPLES_PER_CHANNEL;
+
+/// Single-producer/single-consumer ring of audio samples. One thread (the network receive path) may call the
+/// write methods while another (the mixer or audio output callback) calls the read methods without any locking.
+/// The flags isStarved/hasStarted belong to the consumer.
 class AudioRingBuffer : public NodeData {
 public:
     AudioRingBuffer(bool isStereo);
     ~AudioRingBuffer();
-
+    
+    /// resets the buffer to empty - only call this when neither the producer nor the consumer is active
     void reset();
-
+    
     int parseData(unsigned char* sourceBuffer, int numBytes);
     int parseAudioSamples(unsigned char* sourceBuffer, int numBytes);
-
-    int16_t* getNextOutput() const { return _nextOutput; }
-    void setNextOutput(int16_t* nextOutput) { _nextOutput = nextOutput; }
     
-    int16_t* getEndOfLastWrite() const { return _endOfLastWrite; }
-    void setEndOfLastWrite(int16_t* endOfLastWrite) { _endOfLastWrite = endOfLastWrite; }
+    /// decodes one frame written by AudioCodec::encodeFrame, concealing any frames lost in between - producer only
+    int parseEncodedAudioSamples(unsigned char* sourceBuffer, int numBytes);
+    
+    /// copies numSamples from source into the buffer, wrapping as required - producer only
+    /// \return the number of samples written, which is 0 if there was not room for all of them
+    int writeSamples(const int16_t* source, int numSamples);
+    
+    /// copies numSamples from the buffer into destination, wrapping as required, and consumes them - consumer only
+    /// \return the number of samples read, which is 0 if fewer than numSamples were available
+    int readSamples(int16_t* destination, int numSamples);
+    
+    /// consumes numSamples without copying them out - consumer only
+    void shiftReadPosition(int numSamples);
     
-    int16_t* getBuffer() const { return _buffer; }
+    /// zero-copy access to the samples at the read index - consumer only
+    const int16_t* getNextOutput() const { return _buffer + _nextOutputIndex.loadAcquire(); }
+    
+    /// zero-copy access to the samples numSamplesOffset away from the read index, wrapped into the buffer
+    /// (a negative offset can look back into the guard frame) - consumer only
+    const int16_t* getNextOutputWithOffset(int numSamplesOffset) const;
+    
+    /// number of contiguous samples that can be read from getNextOutput() before the buffer wraps
+    int contiguousSamplesAvailable() const;
+    
+    /// average absolute value of the next numSamples samples at the read index - consumer only
+    float getNextOutputLoudness(int numSamples) const;
     
     bool isStarved() const { return _isStarved; }
     void setIsStarved(bool isStarved) { _isStarved = isStarved; }
@@ -49,21 +82,47 @@ public:
     bool hasStarted() const { return _hasStarted; }
     void setHasStarted(bool hasStarted) { _hasStarted = hasStarted; }
     
-    int diffLastWriteNextOutput() const;
+    /// number of samples written but not yet read - safe to call from either side
+    int samplesAvailable() const;
+    int diffLastWriteNextOutput() const { return samplesAvailable(); }
     
-    bool isStereo() const { return _isStereo; }
+    /// number of samples that can be written without overrunning the reader - safe to call from either side
+    int samplesFree() const { return RING_BUFFER_LENGTH_SAMPLES - RING_BUFFER_GUARD_SAMPLES - samplesAvailable(); }
+    
+    /// number of frames the producer had to drop because the consumer was not keeping up
+    int getOverflowCount() const { return _overflowCount; }
+    
+    /// number of frames that never arrived and were filled in by packet loss concealment
+    int getNumConcealedFrames() const { return _numConcealedFrames; }
     
+    /// the codec the sender last used for this stream
+    AUDIO_CODEC getReceivedCodec() const { return _receivedCodec; }
+    
+    /// true if the last frame the sender gave us was a silent frame - safe to call from either side
+    bool isSilent() const { return _isSilent; }
+    
+    bool isStereo() const { return _isStereo; }
+
 protected:
     // disallow copying of AudioRingBuffer objects
     AudioRingBuffer(const AudioRingBuffer&);
     AudioRingBuffer& operator= (const AudioRingBuffer&);
     
-    int16_t* _nextOutput;
-    int16_t* _endOfLastWrite;
+    QAtomicInt _nextOutputIndex;
+    QAtomicInt _endOfLastWriteIndex;
     int16_t* _buffer;
     bool _isStarved;
     bool _hasStarted;
     bool _isStereo;
+    int _overflowCount;
+    
+    int16_t* _lastFrame;
+    bool _hasReceivedSequence;
+    uint16_t _expectedSequence;
+    int _numConcealedFrames;
+    AUDIO_CODEC _receivedCodec;
+    bool _isSilent;
+    bool _shouldSkipSilentFrames;
 };
 
 #endif /* defined(__interface__AudioRingBuffer__) */
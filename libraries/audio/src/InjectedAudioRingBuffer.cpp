@@ -27,6 +27,8 @@ InjectedAudioRingBuffer::InjectedAudioRingBuffer(const QUuid& streamIdentifier)
 const uchar MAX_INJECTOR_VOLUME = 255;
 
 int InjectedAudioRingBuffer::parseData(unsigned char* sourceBuffer, int numBytes) {
+    _jitterBuffer.packetReceived();
+    
     unsigned char* currentBuffer =  sourceBuffer + numBytesForPacketHeader(sourceBuffer);
     
     // push past the UUID for this node and the stream identifier
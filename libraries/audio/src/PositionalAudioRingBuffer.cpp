@@ -19,19 +19,31 @@ PositionalAudioRingBuffer::PositionalAudioRingBuffer(PositionalAudioRingBuffer::
     _type(type),
     _position(0.0f, 0.0f, 0.0f),
     _orientation(0.0f, 0.0f, 0.0f, 0.0f),
-    _willBeAddedToMix(false)
+    _willBeAddedToMix(false),
+    _jitterBuffer(BUFFER_LENGTH_SAMPLES_PER_CHANNEL, SAMPLE_RATE)
 {
-    
+    // the mixer skips silent streams entirely, so there's no need to fill the buffer with their zeroes
+    _shouldSkipSilentFrames = true;
 }
 
 PositionalAudioRingBuffer::~PositionalAudioRingBuffer() {
 }
 
 int PositionalAudioRingBuffer::parseData(unsigned char* sourceBuffer, int numBytes) {
+    _jitterBuffer.packetReceived();
+    
     unsigned char* currentBuffer = sourceBuffer + numBytesForPacketHeader(sourceBuffer);
     currentBuffer += NUM_BYTES_RFC4122_UUID; // the source UUID
-    currentBuffer += parsePositionalData(currentBuffer, numBytes - (currentBuffer - sourceBuffer));
-    currentBuffer += parseAudioSamples(currentBuffer, numBytes - (currentBuffer - sourceBuffer));
+    
+    int numBytesPositionalData = parsePositionalData(currentBuffer, numBytes - (currentBuffer - sourceBuffer));
+    
+    if (numBytesPositionalData == 0) {
+        // bad positional data, don't try to pull audio from this packet
+        return numBytes;
+    }
+    
+    currentBuffer += numBytesPositionalData;
+    currentBuffer += parseEncodedAudioSamples(currentBuffer, numBytes - (currentBuffer - sourceBuffer));
     
     return currentBuffer - sourceBuffer;
 }
@@ -46,25 +58,46 @@ int PositionalAudioRingBuffer::parsePositionalData(unsigned char* sourceBuffer,
     currentBuffer += sizeof(_orientation);
     
     // if this node sent us a NaN for first float in orientation then don't consider this good audio and bail
+    // the read index belongs to the mixer, so we simply don't write these samples and let the buffer starve
     if (std::isnan(_orientation.x)) {
-        _endOfLastWrite = _nextOutput = _buffer;
-        _isStarved = true;
         return 0;
     }
     
     return currentBuffer - sourceBuffer;
 }
 
-bool PositionalAudioRingBuffer::shouldBeAddedToMix(int numJitterBufferSamples) {
-    if (_endOfLastWrite) {
-        if (_isStarved && diffLastWriteNextOutput() <= BUFFER_LENGTH_SAMPLES_PER_CHANNEL + numJitterBufferSamples) {
-            printf("Buffer held back\n");
+bool PositionalAudioRingBuffer::shouldBeAddedToMix() {
+    int numJitterBufferSamples = _jitterBuffer.updateTargetSamples();
+    
+    // take one snapshot of what the producer has written so both checks below agree
+    int numSamplesAvailable = samplesAvailable();
+    
+    if (numSamplesAvailable > 0 || _hasStarted) {
+        if (_isStarved && numSamplesAvailable <= BUFFER_LENGTH_SAMPLES_PER_CHANNEL + numJitterBufferSamples) {
+            if (!_isSilent) {
+                printf("Buffer held back\n");
+            }
             return false;
-        } else if (diffLastWriteNextOutput() < BUFFER_LENGTH_SAMPLES_PER_CHANNEL) {
-            printf("Buffer starved.\n");
+        } else if (numSamplesAvailable < BUFFER_LENGTH_SAMPLES_PER_CHANNEL) {
+            // running dry because the sender went quiet is not a starve, but either way we wait for the
+            // jitter buffer to fill again before this stream goes back in the mix
+            if (!_isSilent) {
+                printf("Buffer starved.\n");
+                _jitterBuffer.bufferStarved();
+            }
+            
             _isStarved = true;
             return false;
         } else {
+            // if the buffer has grown a frame past its jitter target, skip a silent frame to bring the latency back down
+            // (only pay for the loudness check when there is a frame we could drop)
+            if (numSamplesAvailable >= (2 * BUFFER_LENGTH_SAMPLES_PER_CHANNEL) + numJitterBufferSamples
+                && _jitterBuffer.shouldDropFrame(numSamplesAvailable, numJitterBufferSamples,
+                                              getNextOutputLoudness(BUFFER_LENGTH_SAMPLES_PER_CHANNEL)
+                                                < SILENT_FRAME_AVERAGE_LOUDNESS)) {
+                shiftReadPosition(BUFFER_LENGTH_SAMPLES_PER_CHANNEL);
+            }
+            
             // good buffer, add this to the mix
             _isStarved = false;
             _hasStarted = true;
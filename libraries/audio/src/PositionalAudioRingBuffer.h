@@ -12,6 +12,7 @@
 #include <vector>
 #include <glm/gtx/quaternion.hpp>
 
+#include "AdaptiveJitterBuffer.h"
 #include "AudioRingBuffer.h"
 
 class PositionalAudioRingBuffer : public AudioRingBuffer {
@@ -28,7 +29,7 @@ public:
     int parsePositionalData(unsigned char* sourceBuffer, int numBytes);
     int parseListenModeData(unsigned char* sourceBuffer, int numBytes);
     
-    bool shouldBeAddedToMix(int numJitterBufferSamples);
+    bool shouldBeAddedToMix();
     
     bool willBeAddedToMix() const { return _willBeAddedToMix; }
     void setWillBeAddedToMix(bool willBeAddedToMix) { _willBeAddedToMix = willBeAddedToMix; }
@@ -37,6 +38,8 @@ public:
     const glm::vec3& getPosition() const { return _position; }
     const glm::quat& getOrientation() const { return _orientation; }
     
+    const AdaptiveJitterBuffer& getJitterBuffer() const { return _jitterBuffer; }
+    
 protected:
     // disallow copying of PositionalAudioRingBuffer objects
     PositionalAudioRingBuffer(const PositionalAudioRingBuffer&);
@@ -46,6 +49,7 @@ protected:
     glm::vec3 _position;
     glm::quat _orientation;
     bool _willBeAddedToMix;
+    AdaptiveJitterBuffer _jitterBuffer;
 };
 
 #endif /* defined(__hifi__PositionalAudioRingBuffer__) */
@@ -0,0 +1,65 @@
+//
+//  VoiceActivityDetector.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <algorithm>
+#include <stdlib.h>
+
+#include "VoiceActivityDetector.h"
+
+// a frame has to be this many times louder than the noise floor to count as speech
+const float SPEECH_TO_NOISE_RATIO = 2.5f;
+
+// and never quieter than this average absolute sample, so a dead quiet mic doesn't open on every breath
+const float MIN_VOICE_LOUDNESS = 96.0f;
+
+// the floor drops quickly to meet a quieter frame but only creeps up under a louder one, so speech doesn't raise it
+const float NOISE_FLOOR_FALL_RATE = 0.1f;
+const float NOISE_FLOOR_RISE_RATE = 0.002f;
+
+VoiceActivityDetector::VoiceActivityDetector(int frameSamples, int sampleRate) :
+    _frameSamples(frameSamples),
+    _hangoverFrames(VOICE_HANGOVER_MSECS * sampleRate / (1000 * frameSamples))
+{
+    reset();
+}
+
+void VoiceActivityDetector::reset() {
+    _noiseFloor = 0.0f;
+    _hasNoiseFloor = false;
+    _hangoverFramesRemaining = 0;
+    _numSilentFrames = 0;
+}
+
+bool VoiceActivityDetector::processFrame(const int16_t* samples) {
+    float loudness = 0.0f;
+    
+    for (int i = 0; i < _frameSamples; i++) {
+        loudness += abs(samples[i]);
+    }
+    
+    loudness /= _frameSamples;
+    
+    if (!_hasNoiseFloor) {
+        _noiseFloor = loudness;
+        _hasNoiseFloor = true;
+    } else if (loudness < _noiseFloor) {
+        _noiseFloor += (loudness - _noiseFloor) * NOISE_FLOOR_FALL_RATE;
+    } else {
+        _noiseFloor += (loudness - _noiseFloor) * NOISE_FLOOR_RISE_RATE;
+    }
+    
+    if (loudness > std::max(MIN_VOICE_LOUDNESS, _noiseFloor * SPEECH_TO_NOISE_RATIO)) {
+        _hangoverFramesRemaining = _hangoverFrames;
+        return true;
+    } else if (_hangoverFramesRemaining > 0) {
+        _hangoverFramesRemaining--;
+        return true;
+    } else {
+        _numSilentFrames++;
+        return false;
+    }
+}
@@ -0,0 +1,42 @@
+//
+//  VoiceActivityDetector.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__VoiceActivityDetector__
+#define __hifi__VoiceActivityDetector__
+
+#include <stdint.h>
+
+// how long we keep sending after the last frame that sounded like speech, so trailing syllables aren't clipped
+const int VOICE_HANGOVER_MSECS = 500;
+
+/// Decides frame by frame whether a mono microphone signal holds something worth sending. It follows the
+/// background noise floor of the room and calls a frame voiced when it is clearly louder than that floor,
+/// then keeps the stream open for a short hangover after the last voiced frame.
+class VoiceActivityDetector {
+public:
+    VoiceActivityDetector(int frameSamples, int sampleRate);
+    
+    void reset();
+    
+    /// feeds the detector one frame of frameSamples samples
+    /// \return true if this frame should be sent, false if a silent frame can go in its place
+    bool processFrame(const int16_t* samples);
+    
+    float getNoiseFloor() const { return _noiseFloor; }
+    bool isVoiceActive() const { return _hangoverFramesRemaining > 0; }
+    
+    int getNumSilentFrames() const { return _numSilentFrames; }
+private:
+    int _frameSamples;
+    int _hangoverFrames;
+    float _noiseFloor;
+    bool _hasNoiseFloor;
+    int _hangoverFramesRemaining;
+    int _numSilentFrames;
+};
+
+#endif /* defined(__hifi__VoiceActivityDetector__) */
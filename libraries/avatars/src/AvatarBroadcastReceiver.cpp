@@ -0,0 +1,236 @@
+//
+//  AvatarBroadcastReceiver.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <cstring>
+
+#include <NodeList.h>
+#include <PacketHeaders.h>
+#include <SharedUtil.h>
+#include <UUID.h>
+
+#include "AvatarData.h"
+
+#include "AvatarBroadcastReceiver.h"
+
+// the most avatars we'll ask the mixer for a full state of in one acknowledgement, the rest wait for the next one
+const int MAX_RESYNCS_PER_ACKNOWLEDGEMENT = 32;
+
+AvatarBroadcastReceiver::ReceivedAvatarStates::ReceivedAvatarStates() :
+    numStates(0),
+    nextIndex(0)
+{
+    
+}
+
+const QuantizedAvatarState* AvatarBroadcastReceiver::ReceivedAvatarStates::stateForSequence(uint16_t sequence) const {
+    for (int i = 0; i < numStates; i++) {
+        if (sequences[i] == sequence) {
+            return &states[i];
+        }
+    }
+    return NULL;
+}
+
+void AvatarBroadcastReceiver::ReceivedAvatarStates::addState(uint16_t sequence, const QuantizedAvatarState& state) {
+    sequences[nextIndex] = sequence;
+    states[nextIndex] = state;
+    
+    nextIndex = (nextIndex + 1) % NUM_RECEIVED_AVATAR_STATES;
+    numStates = std::min(numStates + 1, NUM_RECEIVED_AVATAR_STATES);
+}
+
+AvatarBroadcastReceiver::AvatarBroadcastReceiver() :
+    _mutex(),
+    _hasReceivedSequence(false),
+    _latestSequence(0),
+    _receivedMask(0),
+    _resyncLocalIDs(),
+    _nodeUUIDs(),
+    _receivedStates()
+{
+    
+}
+
+void AvatarBroadcastReceiver::reset() {
+    QMutexLocker locker(&_mutex);
+    
+    _hasReceivedSequence = false;
+    _receivedMask = 0;
+    _resyncLocalIDs.clear();
+    _nodeUUIDs.clear();
+    _receivedStates.clear();
+}
+
+void AvatarBroadcastReceiver::recordReceivedSequence(uint16_t sequence) {
+    if (!_hasReceivedSequence) {
+        _latestSequence = sequence;
+        _receivedMask = 0;
+        _hasReceivedSequence = true;
+        return;
+    }
+    
+    int16_t packetsAfterLatest = sequence - _latestSequence;
+    
+    if (packetsAfterLatest > 0) {
+        // shift the mask along, the previous latest becomes the first bit
+        _receivedMask = (packetsAfterLatest > NUM_ACKNOWLEDGED_SEQUENCES)
+            ? 0
+            : ((_receivedMask << packetsAfterLatest) | (1 << (packetsAfterLatest - 1)));
+        _latestSequence = sequence;
+    } else if (packetsAfterLatest < 0 && -packetsAfterLatest <= NUM_ACKNOWLEDGED_SEQUENCES) {
+        // arrived out of order
+        _receivedMask |= 1 << (-packetsAfterLatest - 1);
+    }
+}
+
+void AvatarBroadcastReceiver::processBulkAvatarData(const HifiSockAddr& senderSockAddr,
+                                                    unsigned char* packetData, int numBytes) {
+    NodeList* nodeList = NodeList::getInstance();
+    
+    // find the avatar mixer in our node list and update the lastRecvTime from it
+    Node* bulkSendNode = nodeList->nodeWithAddress(senderSockAddr);
+    
+    if (!bulkSendNode) {
+        return;
+    }
+    
+    bulkSendNode->setLastHeardMicrostamp(usecTimestampNow());
+    bulkSendNode->recordBytesReceived(numBytes);
+    
+    unsigned char* endPosition = packetData + numBytes;
+    unsigned char* currentPosition = packetData + numBytesForPacketHeader(packetData);
+    
+    const int NUM_PREAMBLE_BYTES = 2 * sizeof(uint16_t);
+    if (endPosition - currentPosition < NUM_PREAMBLE_BYTES) {
+        return;
+    }
+    
+    uint16_t sequence, receiverLocalID;
+    
+    memcpy(&sequence, currentPosition, sizeof(sequence));
+    currentPosition += sizeof(sequence);
+    memcpy(&receiverLocalID, currentPosition, sizeof(receiverLocalID));
+    currentPosition += sizeof(receiverLocalID);
+    
+    QMutexLocker locker(&_mutex);
+    
+    recordReceivedSequence(sequence);
+    
+    const int NUM_RECORD_HEADER_BYTES = sizeof(uint16_t) + sizeof(uint8_t);
+    
+    while (endPosition - currentPosition >= NUM_RECORD_HEADER_BYTES) {
+        uint16_t localID;
+        memcpy(&localID, currentPosition, sizeof(localID));
+        currentPosition += sizeof(localID);
+        
+        uint8_t baselineAge = *currentPosition++;
+        
+        QuantizedAvatarState state;
+        bool canApply = true;
+        
+        if (baselineAge == 0) {
+            // a full state, which tells us which node this ID stands for
+            if (endPosition - currentPosition < NUM_BYTES_RFC4122_UUID) {
+                break;
+            }
+            _nodeUUIDs.insert(localID, QUuid::fromRfc4122(QByteArray((char*) currentPosition, NUM_BYTES_RFC4122_UUID)));
+            currentPosition += NUM_BYTES_RFC4122_UUID;
+            
+            _receivedStates[localID] = ReceivedAvatarStates();
+        } else {
+            const QuantizedAvatarState* baseline = NULL;
+            
+            QHash<uint16_t, ReceivedAvatarStates>::const_iterator receivedStates = _receivedStates.constFind(localID);
+            if (receivedStates != _receivedStates.constEnd()) {
+                baseline = receivedStates.value().stateForSequence(sequence - baselineAge);
+            }
+            
+            if (baseline) {
+                state = *baseline;
+            } else {
+                // we don't have what it is a delta against - read it over a default state to skip it, and ask for a full one
+                canApply = false;
+                _resyncLocalIDs.insert(localID);
+            }
+        }
+        
+        int numStateBytes = state.decodeDelta(currentPosition, endPosition - currentPosition);
+        if (numStateBytes == 0) {
+            // the rest of the packet can't be trusted
+            break;
+        }
+        currentPosition += numStateBytes;
+        
+        QUuid nodeUUID = _nodeUUIDs.value(localID);
+        
+        if (!canApply || nodeUUID.isNull()) {
+            continue;
+        }
+        
+        _receivedStates[localID].addState(sequence, state);
+        
+        QUuid leaderUUID;
+        if (state.leaderID == receiverLocalID) {
+            leaderUUID = nodeList->getOwnerUUID();
+        } else if (state.leaderID != 0) {
+            leaderUUID = _nodeUUIDs.value(state.leaderID);
+        }
+        
+        Node* matchingNode = nodeList->nodeWithUUID(nodeUUID);
+        
+        if (!matchingNode) {
+            // we're missing this node, we need to add it to the list
+            matchingNode = nodeList->addOrUpdateNode(nodeUUID, NODE_TYPE_AGENT, HifiSockAddr(), HifiSockAddr());
+        }
+        
+        matchingNode->lock();
+        
+        matchingNode->setLastHeardMicrostamp(usecTimestampNow());
+        matchingNode->recordBytesReceived(NUM_RECORD_HEADER_BYTES + numStateBytes);
+        
+        if (!matchingNode->getLinkedData() && nodeList->linkedDataCreateCallback) {
+            nodeList->linkedDataCreateCallback(matchingNode);
+        }
+        
+        if (matchingNode->getLinkedData()) {
+            ((AvatarData*) matchingNode->getLinkedData())->setQuantizedState(state, leaderUUID);
+        }
+        
+        matchingNode->unlock();
+    }
+}
+
+int AvatarBroadcastReceiver::writeAcknowledgement(unsigned char* destinationBuffer) {
+    QMutexLocker locker(&_mutex);
+    
+    if (!_hasReceivedSequence) {
+        return 0;
+    }
+    
+    unsigned char* currentPosition = destinationBuffer;
+    
+    memcpy(currentPosition, &_latestSequence, sizeof(_latestSequence));
+    currentPosition += sizeof(_latestSequence);
+    memcpy(currentPosition, &_receivedMask, sizeof(_receivedMask));
+    currentPosition += sizeof(_receivedMask);
+    
+    unsigned char* numResyncsPosition = currentPosition++;
+    int numResyncs = 0;
+    
+    QSet<uint16_t>::iterator localID = _resyncLocalIDs.begin();
+    while (localID != _resyncLocalIDs.end() && numResyncs < MAX_RESYNCS_PER_ACKNOWLEDGEMENT) {
+        uint16_t resyncLocalID = *localID;
+        memcpy(currentPosition, &resyncLocalID, sizeof(resyncLocalID));
+        currentPosition += sizeof(resyncLocalID);
+        
+        localID = _resyncLocalIDs.erase(localID);
+        numResyncs++;
+    }
+    *numResyncsPosition = numResyncs;
+    
+    return currentPosition - destinationBuffer;
+}
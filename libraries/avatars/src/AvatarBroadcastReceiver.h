@@ -0,0 +1,65 @@
+//
+//  AvatarBroadcastReceiver.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__AvatarBroadcastReceiver__
+#define __hifi__AvatarBroadcastReceiver__
+
+#include <stdint.h>
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QUuid>
+
+#include <HifiSockAddr.h>
+
+#include "QuantizedAvatarState.h"
+
+/// Applies the delta-compressed avatar broadcast from the avatar mixer to the avatars in the NodeList, and keeps track
+/// of what has been received so the mixer can be told which states it can send deltas against.
+class AvatarBroadcastReceiver {
+public:
+    AvatarBroadcastReceiver();
+    
+    /// forgets everything received, for when the avatar mixer changes - a new one will start over with full states
+    void reset();
+    
+    /// parses a PACKET_TYPE_BULK_AVATAR_DATA packet, updating (and adding if required) the node for each avatar in it
+    void processBulkAvatarData(const HifiSockAddr& senderSockAddr, unsigned char* packetData, int numBytes);
+    
+    /// appends the acknowledgement of what we've received to a PACKET_TYPE_HEAD_DATA packet
+    /// \return the number of bytes written, 0 if nothing has been received yet
+    int writeAcknowledgement(unsigned char* destinationBuffer);
+private:
+    /// the last few states received for one avatar, for deltas to be applied over
+    class ReceivedAvatarStates {
+    public:
+        ReceivedAvatarStates();
+        
+        const QuantizedAvatarState* stateForSequence(uint16_t sequence) const;
+        void addState(uint16_t sequence, const QuantizedAvatarState& state);
+        
+        uint16_t sequences[NUM_RECEIVED_AVATAR_STATES];
+        QuantizedAvatarState states[NUM_RECEIVED_AVATAR_STATES];
+        int numStates;
+        int nextIndex;
+    };
+    
+    void recordReceivedSequence(uint16_t sequence);
+    
+    QMutex _mutex;
+    
+    bool _hasReceivedSequence;
+    uint16_t _latestSequence;
+    uint16_t _receivedMask;
+    QSet<uint16_t> _resyncLocalIDs;
+    
+    QHash<uint16_t, QUuid> _nodeUUIDs;
+    QHash<uint16_t, ReceivedAvatarStates> _receivedStates;
+};
+
+#endif /* defined(__hifi__AvatarBroadcastReceiver__) */
@@ -295,3 +295,171 @@ int AvatarData::parseData(unsigned char* sourceBuffer, int numBytes) {
 
     return sourceBuffer - startPosition;
 }
+
+void AvatarData::getQuantizedState(QuantizedAvatarState& state) {
+    // lazily allocate memory for HeadData in case we're not an Avatar instance
+    if (!_headData) {
+        _headData = new HeadData(this);
+    }
+    // lazily allocate memory for HandData in case we're not an Avatar instance
+    if (!_handData) {
+        _handData = new HandData(this);
+    }
+    
+    for (int i = 0; i < 3; i++) {
+        state.position[i] = roundf(_position[i] * AVATAR_POSITION_GRID_SCALE);
+    }
+    
+    packOrientationQuatToSmallestThree((unsigned char*) &state.bodyRotation,
+                                       glm::quat(glm::radians(glm::vec3(_bodyPitch, _bodyYaw, _bodyRoll))));
+    packOrientationQuatToSmallestThree((unsigned char*) &state.headRotation,
+                                       glm::quat(glm::radians(glm::vec3(_headData->_pitch, _headData->_yaw, _headData->_roll))));
+    
+    packFloatRatioToTwoByte((unsigned char*) &state.scale, _newScale);
+    
+    state.lean[0] = quantizeToSignedTwoByteFixed(_headData->_leanSideways, AVATAR_LEAN_RADIX);
+    state.lean[1] = quantizeToSignedTwoByteFixed(_headData->_leanForward, AVATAR_LEAN_RADIX);
+    
+    // hand and look at positions are sent relative to the body, which keeps them small
+    glm::vec3 handOffset = _handPosition - _position;
+    glm::vec3 lookAtOffset = _headData->_lookAtPosition - _position;
+    for (int i = 0; i < 3; i++) {
+        state.handOffset[i] = quantizeToSignedTwoByteFixed(handOffset[i], AVATAR_HAND_OFFSET_RADIX);
+        state.lookAtOffset[i] = quantizeToSignedTwoByteFixed(lookAtOffset[i], AVATAR_LOOK_AT_OFFSET_RADIX);
+    }
+    
+    packFloatToByte(&state.audioLoudness, std::min(MAX_AUDIO_LOUDNESS, _headData->_audioLoudness), MAX_AUDIO_LOUDNESS);
+    
+    state.bitItems = 0;
+    setSemiNibbleAt(state.bitItems, KEY_STATE_START_BIT, _keyState);
+    setSemiNibbleAt(state.bitItems, HAND_STATE_START_BIT, _handState);
+    if (_headData->_isFaceshiftConnected) {
+        setAtBit(state.bitItems, IS_FACESHIFT_CONNECTED);
+    }
+    if (_isChatCirclingEnabled) {
+        setAtBit(state.bitItems, IS_CHAT_CIRCLING_ENABLED);
+    }
+    
+    packFloatToByte(&state.pupilDilation, _headData->_pupilDilation, 1.0f);
+    
+    state.userUUID = _uuid.toRfc4122();
+    state.chatMessage = QByteArray(_chatMessage.data(), _chatMessage.size());
+    
+    state.faceshiftData.clear();
+    if (_headData->_isFaceshiftConnected) {
+        // the face is sent a byte per value, which is plenty for animating it
+        state.faceshiftData.resize(5 + _headData->_blendshapeCoefficients.size());
+        unsigned char* faceshiftBuffer = (unsigned char*) state.faceshiftData.data();
+        
+        faceshiftBuffer += packFloatToByte(faceshiftBuffer, glm::clamp(_headData->_leftEyeBlink, 0.0f, 1.0f), 1.0f);
+        faceshiftBuffer += packFloatToByte(faceshiftBuffer, glm::clamp(_headData->_rightEyeBlink, 0.0f, 1.0f), 1.0f);
+        faceshiftBuffer += packFloatToByte(faceshiftBuffer, glm::clamp(_headData->_averageLoudness, 0.0f, MAX_AUDIO_LOUDNESS),
+                                           MAX_AUDIO_LOUDNESS);
+        faceshiftBuffer += packFloatToByte(faceshiftBuffer, glm::clamp(_headData->_browAudioLift, 0.0f, 1.0f), 1.0f);
+        
+        *faceshiftBuffer++ = _headData->_blendshapeCoefficients.size();
+        for (int i = 0; i < _headData->_blendshapeCoefficients.size(); i++) {
+            faceshiftBuffer += packFloatToByte(faceshiftBuffer, glm::clamp(_headData->_blendshapeCoefficients[i], 0.0f, 1.0f),
+                                               1.0f);
+        }
+    }
+    
+    unsigned char handDataBuffer[MAX_PACKET_SIZE];
+    state.handData = QByteArray((char*) handDataBuffer, _handData->encodeRemoteData(handDataBuffer));
+    
+    state.jointData.resize(1 + _joints.size() * (1 + sizeof(uint32_t)));
+    unsigned char* jointBuffer = (unsigned char*) state.jointData.data();
+    *jointBuffer++ = _joints.size();
+    for (vector<JointData>::iterator it = _joints.begin(); it != _joints.end(); it++) {
+        *jointBuffer++ = it->jointID;
+        jointBuffer += packOrientationQuatToSmallestThree(jointBuffer, it->rotation);
+    }
+}
+
+void AvatarData::setQuantizedState(const QuantizedAvatarState& state, const QUuid& leaderUUID) {
+    // lazily allocate memory for HeadData in case we're not an Avatar instance
+    if (!_headData) {
+        _headData = new HeadData(this);
+    }
+    // lazily allocate memory for HandData in case we're not an Avatar instance
+    if (!_handData) {
+        _handData = new HandData(this);
+    }
+    
+    for (int i = 0; i < 3; i++) {
+        _position[i] = state.position[i] / AVATAR_POSITION_GRID_SCALE;
+    }
+    
+    glm::quat rotation;
+    unpackOrientationQuatFromSmallestThree((unsigned char*) &state.bodyRotation, rotation);
+    glm::vec3 bodyAngles = safeEulerAngles(rotation);
+    _bodyPitch = bodyAngles.x;
+    _bodyYaw = bodyAngles.y;
+    _bodyRoll = bodyAngles.z;
+    
+    unpackOrientationQuatFromSmallestThree((unsigned char*) &state.headRotation, rotation);
+    glm::vec3 headAngles = safeEulerAngles(rotation);
+    _headData->setPitch(headAngles.x);
+    _headData->setYaw(headAngles.y);
+    _headData->setRoll(headAngles.z);
+    
+    unpackFloatRatioFromTwoByte((unsigned char*) &state.scale, _newScale);
+    
+    _leaderUUID = leaderUUID;
+    
+    _headData->_leanSideways = unquantizeFromSignedTwoByteFixed(state.lean[0], AVATAR_LEAN_RADIX);
+    _headData->_leanForward = unquantizeFromSignedTwoByteFixed(state.lean[1], AVATAR_LEAN_RADIX);
+    
+    for (int i = 0; i < 3; i++) {
+        _handPosition[i] = _position[i] + unquantizeFromSignedTwoByteFixed(state.handOffset[i], AVATAR_HAND_OFFSET_RADIX);
+        _headData->_lookAtPosition[i] = _position[i]
+            + unquantizeFromSignedTwoByteFixed(state.lookAtOffset[i], AVATAR_LOOK_AT_OFFSET_RADIX);
+    }
+    
+    unpackFloatFromByte((unsigned char*) &state.audioLoudness, _headData->_audioLoudness, MAX_AUDIO_LOUDNESS);
+    
+    unsigned char bitItems = state.bitItems;
+    _keyState = (KeyState) getSemiNibbleAt(bitItems, KEY_STATE_START_BIT);
+    _handState = getSemiNibbleAt(bitItems, HAND_STATE_START_BIT);
+    _headData->_isFaceshiftConnected = oneAtBit(bitItems, IS_FACESHIFT_CONNECTED);
+    _isChatCirclingEnabled = oneAtBit(bitItems, IS_CHAT_CIRCLING_ENABLED);
+    
+    unpackFloatFromByte((unsigned char*) &state.pupilDilation, _headData->_pupilDilation, 1.0f);
+    
+    if (state.userUUID.size() == NUM_BYTES_RFC4122_UUID) {
+        _uuid = QUuid::fromRfc4122(state.userUUID);
+    }
+    
+    _chatMessage = string(state.chatMessage.constData(), state.chatMessage.size());
+    
+    const int NUM_FACESHIFT_HEADER_BYTES = 5;
+    if (_headData->_isFaceshiftConnected && state.faceshiftData.size() >= NUM_FACESHIFT_HEADER_BYTES) {
+        unsigned char* faceshiftBuffer = (unsigned char*) state.faceshiftData.constData();
+        
+        faceshiftBuffer += unpackFloatFromByte(faceshiftBuffer, _headData->_leftEyeBlink, 1.0f);
+        faceshiftBuffer += unpackFloatFromByte(faceshiftBuffer, _headData->_rightEyeBlink, 1.0f);
+        faceshiftBuffer += unpackFloatFromByte(faceshiftBuffer, _headData->_averageLoudness, MAX_AUDIO_LOUDNESS);
+        faceshiftBuffer += unpackFloatFromByte(faceshiftBuffer, _headData->_browAudioLift, 1.0f);
+        
+        int numCoefficients = std::min((int) *faceshiftBuffer++, state.faceshiftData.size() - NUM_FACESHIFT_HEADER_BYTES);
+        _headData->_blendshapeCoefficients.resize(numCoefficients);
+        for (int i = 0; i < numCoefficients; i++) {
+            faceshiftBuffer += unpackFloatFromByte(faceshiftBuffer, _headData->_blendshapeCoefficients[i], 1.0f);
+        }
+    }
+    
+    if (!state.handData.isEmpty()) {
+        _handData->decodeRemoteData((unsigned char*) state.handData.constData());
+    }
+    
+    if (!state.jointData.isEmpty()) {
+        unsigned char* jointBuffer = (unsigned char*) state.jointData.constData();
+        int numJoints = std::min((int) *jointBuffer++, (state.jointData.size() - 1) / (int) (1 + sizeof(uint32_t)));
+        
+        _joints.resize(numJoints);
+        for (vector<JointData>::iterator it = _joints.begin(); it != _joints.end(); it++) {
+            it->jointID = *jointBuffer++;
+            jointBuffer += unpackOrientationQuatFromSmallestThree(jointBuffer, it->rotation);
+        }
+    }
+}
@@ -25,6 +25,7 @@
 #include <NodeData.h>
 #include "HeadData.h"
 #include "HandData.h"
+#include "QuantizedAvatarState.h"
 
 // First bitset
 const int KEY_STATE_START_BIT = 0; // 1st and 2nd bits
@@ -65,6 +66,13 @@ public:
     int getBroadcastData(unsigned char* destinationBuffer);
     int parseData(unsigned char* sourceBuffer, int numBytes);
     
+    /// quantizes our state for the delta-compressed avatar broadcast - the leader ID is left for the caller to fill in,
+    /// since it is only meaningful to the mixer that sends the state
+    void getQuantizedState(QuantizedAvatarState& state);
+    
+    /// takes on a state received in the delta-compressed avatar broadcast
+    virtual void setQuantizedState(const QuantizedAvatarState& state, const QUuid& leaderUUID);
+    
     QUuid& getUUID() { return _uuid; }
     void setUUID(const QUuid& uuid) { _uuid = uuid; }
     
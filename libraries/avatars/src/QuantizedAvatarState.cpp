@@ -0,0 +1,293 @@
+//
+//  QuantizedAvatarState.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <cstring>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "QuantizedAvatarState.h"
+
+// position differences are zig-zag encoded so that small moves either way take a byte or two
+static int packSignedVarint(unsigned char* buffer, int32_t value) {
+    uint32_t zigZagValue = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+    int numBytes = 0;
+    
+    while (zigZagValue >= 0x80) {
+        buffer[numBytes++] = (zigZagValue & 0x7f) | 0x80;
+        zigZagValue >>= 7;
+    }
+    buffer[numBytes++] = zigZagValue;
+    
+    return numBytes;
+}
+
+static int unpackSignedVarint(unsigned char* buffer, int maxBytes, int32_t& value) {
+    const int MAX_VARINT_BYTES = 5;
+    uint32_t zigZagValue = 0;
+    
+    for (int i = 0; i < maxBytes && i < MAX_VARINT_BYTES; i++) {
+        zigZagValue |= (uint32_t) (buffer[i] & 0x7f) << (7 * i);
+        
+        if (!(buffer[i] & 0x80)) {
+            value = (zigZagValue >> 1) ^ -(int32_t) (zigZagValue & 1);
+            return i + 1;
+        }
+    }
+    
+    // ran out of bytes before the end of the varint
+    return 0;
+}
+
+int16_t quantizeToSignedTwoByteFixed(float value, int radix) {
+    float scaledValue = value * (1 << radix);
+    return glm::clamp(scaledValue, (float) std::numeric_limits<int16_t>::min(), (float) std::numeric_limits<int16_t>::max());
+}
+
+float unquantizeFromSignedTwoByteFixed(int16_t value, int radix) {
+    return value / (float) (1 << radix);
+}
+
+QuantizedAvatarState::QuantizedAvatarState() :
+    bodyRotation(0),
+    headRotation(0),
+    scale(0),
+    leaderID(0),
+    audioLoudness(0),
+    bitItems(0),
+    pupilDilation(0)
+{
+    memset(position, 0, sizeof(position));
+    memset(lean, 0, sizeof(lean));
+    memset(handOffset, 0, sizeof(handOffset));
+    memset(lookAtOffset, 0, sizeof(lookAtOffset));
+}
+
+static int writeBytes(unsigned char* destinationBuffer, const void* source, int numBytes) {
+    memcpy(destinationBuffer, source, numBytes);
+    return numBytes;
+}
+
+static int writeLengthPrefixedBytes(unsigned char* destinationBuffer, const QByteArray& bytes) {
+    uint16_t length = bytes.size();
+    memcpy(destinationBuffer, &length, sizeof(length));
+    memcpy(destinationBuffer + sizeof(length), bytes.constData(), length);
+    return sizeof(length) + length;
+}
+
+int QuantizedAvatarState::encodeDelta(unsigned char* destinationBuffer, const QuantizedAvatarState* baseline) const {
+    static const QuantizedAvatarState defaultState;
+    const QuantizedAvatarState& reference = baseline ? *baseline : defaultState;
+    
+    uint16_t changedFields = 0;
+    
+    if (memcmp(position, reference.position, sizeof(position)) != 0) {
+        changedFields |= 1 << AVATAR_STATE_POSITION;
+    }
+    if (bodyRotation != reference.bodyRotation) {
+        changedFields |= 1 << AVATAR_STATE_BODY_ROTATION;
+    }
+    if (headRotation != reference.headRotation) {
+        changedFields |= 1 << AVATAR_STATE_HEAD_ROTATION;
+    }
+    if (scale != reference.scale) {
+        changedFields |= 1 << AVATAR_STATE_SCALE;
+    }
+    if (leaderID != reference.leaderID) {
+        changedFields |= 1 << AVATAR_STATE_LEADER;
+    }
+    if (memcmp(lean, reference.lean, sizeof(lean)) != 0) {
+        changedFields |= 1 << AVATAR_STATE_LEAN;
+    }
+    if (memcmp(handOffset, reference.handOffset, sizeof(handOffset)) != 0) {
+        changedFields |= 1 << AVATAR_STATE_HAND_OFFSET;
+    }
+    if (memcmp(lookAtOffset, reference.lookAtOffset, sizeof(lookAtOffset)) != 0) {
+        changedFields |= 1 << AVATAR_STATE_LOOK_AT_OFFSET;
+    }
+    if (audioLoudness != reference.audioLoudness) {
+        changedFields |= 1 << AVATAR_STATE_AUDIO_LOUDNESS;
+    }
+    if (bitItems != reference.bitItems) {
+        changedFields |= 1 << AVATAR_STATE_BIT_ITEMS;
+    }
+    if (pupilDilation != reference.pupilDilation) {
+        changedFields |= 1 << AVATAR_STATE_PUPIL_DILATION;
+    }
+    if (userUUID != reference.userUUID) {
+        changedFields |= 1 << AVATAR_STATE_USER_UUID;
+    }
+    if (chatMessage != reference.chatMessage) {
+        changedFields |= 1 << AVATAR_STATE_CHAT_MESSAGE;
+    }
+    if (faceshiftData != reference.faceshiftData) {
+        changedFields |= 1 << AVATAR_STATE_FACESHIFT;
+    }
+    if (handData != reference.handData) {
+        changedFields |= 1 << AVATAR_STATE_HAND_DATA;
+    }
+    if (jointData != reference.jointData) {
+        changedFields |= 1 << AVATAR_STATE_JOINTS;
+    }
+    
+    unsigned char* bufferStart = destinationBuffer;
+    destinationBuffer += writeBytes(destinationBuffer, &changedFields, sizeof(changedFields));
+    
+    if (changedFields & (1 << AVATAR_STATE_POSITION)) {
+        for (int i = 0; i < 3; i++) {
+            destinationBuffer += packSignedVarint(destinationBuffer, position[i] - reference.position[i]);
+        }
+    }
+    if (changedFields & (1 << AVATAR_STATE_BODY_ROTATION)) {
+        destinationBuffer += writeBytes(destinationBuffer, &bodyRotation, sizeof(bodyRotation));
+    }
+    if (changedFields & (1 << AVATAR_STATE_HEAD_ROTATION)) {
+        destinationBuffer += writeBytes(destinationBuffer, &headRotation, sizeof(headRotation));
+    }
+    if (changedFields & (1 << AVATAR_STATE_SCALE)) {
+        destinationBuffer += writeBytes(destinationBuffer, &scale, sizeof(scale));
+    }
+    if (changedFields & (1 << AVATAR_STATE_LEADER)) {
+        destinationBuffer += writeBytes(destinationBuffer, &leaderID, sizeof(leaderID));
+    }
+    if (changedFields & (1 << AVATAR_STATE_LEAN)) {
+        destinationBuffer += writeBytes(destinationBuffer, lean, sizeof(lean));
+    }
+    if (changedFields & (1 << AVATAR_STATE_HAND_OFFSET)) {
+        destinationBuffer += writeBytes(destinationBuffer, handOffset, sizeof(handOffset));
+    }
+    if (changedFields & (1 << AVATAR_STATE_LOOK_AT_OFFSET)) {
+        destinationBuffer += writeBytes(destinationBuffer, lookAtOffset, sizeof(lookAtOffset));
+    }
+    if (changedFields & (1 << AVATAR_STATE_AUDIO_LOUDNESS)) {
+        *destinationBuffer++ = audioLoudness;
+    }
+    if (changedFields & (1 << AVATAR_STATE_BIT_ITEMS)) {
+        *destinationBuffer++ = bitItems;
+    }
+    if (changedFields & (1 << AVATAR_STATE_PUPIL_DILATION)) {
+        *destinationBuffer++ = pupilDilation;
+    }
+    if (changedFields & (1 << AVATAR_STATE_USER_UUID)) {
+        destinationBuffer += writeLengthPrefixedBytes(destinationBuffer, userUUID);
+    }
+    if (changedFields & (1 << AVATAR_STATE_CHAT_MESSAGE)) {
+        destinationBuffer += writeLengthPrefixedBytes(destinationBuffer, chatMessage);
+    }
+    if (changedFields & (1 << AVATAR_STATE_FACESHIFT)) {
+        destinationBuffer += writeLengthPrefixedBytes(destinationBuffer, faceshiftData);
+    }
+    if (changedFields & (1 << AVATAR_STATE_HAND_DATA)) {
+        destinationBuffer += writeLengthPrefixedBytes(destinationBuffer, handData);
+    }
+    if (changedFields & (1 << AVATAR_STATE_JOINTS)) {
+        destinationBuffer += writeLengthPrefixedBytes(destinationBuffer, jointData);
+    }
+    
+    return destinationBuffer - bufferStart;
+}
+
+// readers for decodeDelta, which return false rather than read past the end of the packet
+static bool readBytes(unsigned char*& sourceBuffer, unsigned char* sourceEnd, void* destination, int numBytes) {
+    if (sourceEnd - sourceBuffer < numBytes) {
+        return false;
+    }
+    
+    memcpy(destination, sourceBuffer, numBytes);
+    sourceBuffer += numBytes;
+    return true;
+}
+
+static bool readLengthPrefixedBytes(unsigned char*& sourceBuffer, unsigned char* sourceEnd, QByteArray& bytes) {
+    uint16_t length;
+    if (!readBytes(sourceBuffer, sourceEnd, &length, sizeof(length)) || sourceEnd - sourceBuffer < length) {
+        return false;
+    }
+    
+    bytes = QByteArray((const char*) sourceBuffer, length);
+    sourceBuffer += length;
+    return true;
+}
+
+int QuantizedAvatarState::decodeDelta(unsigned char* sourceBuffer, int numBytes) {
+    unsigned char* bufferStart = sourceBuffer;
+    unsigned char* sourceEnd = sourceBuffer + numBytes;
+    
+    uint16_t changedFields;
+    if (!readBytes(sourceBuffer, sourceEnd, &changedFields, sizeof(changedFields))) {
+        return 0;
+    }
+    
+    if (changedFields & (1 << AVATAR_STATE_POSITION)) {
+        for (int i = 0; i < 3; i++) {
+            int32_t positionDelta;
+            int numVarintBytes = unpackSignedVarint(sourceBuffer, sourceEnd - sourceBuffer, positionDelta);
+            if (numVarintBytes == 0) {
+                return 0;
+            }
+            
+            position[i] += positionDelta;
+            sourceBuffer += numVarintBytes;
+        }
+    }
+    
+    if ((changedFields & (1 << AVATAR_STATE_BODY_ROTATION))
+            && !readBytes(sourceBuffer, sourceEnd, &bodyRotation, sizeof(bodyRotation))) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_HEAD_ROTATION))
+            && !readBytes(sourceBuffer, sourceEnd, &headRotation, sizeof(headRotation))) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_SCALE)) && !readBytes(sourceBuffer, sourceEnd, &scale, sizeof(scale))) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_LEADER)) && !readBytes(sourceBuffer, sourceEnd, &leaderID, sizeof(leaderID))) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_LEAN)) && !readBytes(sourceBuffer, sourceEnd, lean, sizeof(lean))) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_HAND_OFFSET))
+            && !readBytes(sourceBuffer, sourceEnd, handOffset, sizeof(handOffset))) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_LOOK_AT_OFFSET))
+            && !readBytes(sourceBuffer, sourceEnd, lookAtOffset, sizeof(lookAtOffset))) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_AUDIO_LOUDNESS))
+            && !readBytes(sourceBuffer, sourceEnd, &audioLoudness, sizeof(audioLoudness))) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_BIT_ITEMS)) && !readBytes(sourceBuffer, sourceEnd, &bitItems, sizeof(bitItems))) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_PUPIL_DILATION))
+            && !readBytes(sourceBuffer, sourceEnd, &pupilDilation, sizeof(pupilDilation))) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_USER_UUID)) && !readLengthPrefixedBytes(sourceBuffer, sourceEnd, userUUID)) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_CHAT_MESSAGE))
+            && !readLengthPrefixedBytes(sourceBuffer, sourceEnd, chatMessage)) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_FACESHIFT))
+            && !readLengthPrefixedBytes(sourceBuffer, sourceEnd, faceshiftData)) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_HAND_DATA)) && !readLengthPrefixedBytes(sourceBuffer, sourceEnd, handData)) {
+        return 0;
+    }
+    if ((changedFields & (1 << AVATAR_STATE_JOINTS)) && !readLengthPrefixedBytes(sourceBuffer, sourceEnd, jointData)) {
+        return 0;
+    }
+    
+    return sourceBuffer - bufferStart;
+}
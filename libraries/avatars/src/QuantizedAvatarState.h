@@ -0,0 +1,91 @@
+//
+//  QuantizedAvatarState.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__QuantizedAvatarState__
+#define __hifi__QuantizedAvatarState__
+
+#include <stdint.h>
+
+#include <QtCore/QByteArray>
+
+// positions are sent as whole steps on a grid this many steps to the meter
+const float AVATAR_POSITION_GRID_SCALE = 256.0f;
+
+// fixed point radix for offsets from the body - lean and hand (+/- 32m to 1mm), look at (+/- 512m to 2cm)
+const int AVATAR_LEAN_RADIX = 10;
+const int AVATAR_HAND_OFFSET_RADIX = 10;
+const int AVATAR_LOOK_AT_OFFSET_RADIX = 6;
+
+// a receiver acknowledges the latest broadcast packet it got and a mask of this many before it
+const int NUM_ACKNOWLEDGED_SEQUENCES = 16;
+
+// deltas are only sent against baselines at most this many packets old, so the age fits in a byte
+const int MAX_BASELINE_AGE = 255;
+
+// a receiver keeps this many of the states it got for each avatar, so the sender must not encode against a baseline
+// with more states of that avatar sent after it than this
+const int NUM_RECEIVED_AVATAR_STATES = 16;
+
+enum AvatarStateField {
+    AVATAR_STATE_POSITION = 0,
+    AVATAR_STATE_BODY_ROTATION,
+    AVATAR_STATE_HEAD_ROTATION,
+    AVATAR_STATE_SCALE,
+    AVATAR_STATE_LEADER,
+    AVATAR_STATE_LEAN,
+    AVATAR_STATE_HAND_OFFSET,
+    AVATAR_STATE_LOOK_AT_OFFSET,
+    AVATAR_STATE_AUDIO_LOUDNESS,
+    AVATAR_STATE_BIT_ITEMS,
+    AVATAR_STATE_PUPIL_DILATION,
+    AVATAR_STATE_USER_UUID,
+    AVATAR_STATE_CHAT_MESSAGE,
+    AVATAR_STATE_FACESHIFT,
+    AVATAR_STATE_HAND_DATA,
+    AVATAR_STATE_JOINTS
+};
+
+/// An avatar's broadcast state quantized to what goes on the wire, so that two states can be compared field by field
+/// and only the fields a receiver doesn't already have are sent. Filled in and applied by AvatarData.
+class QuantizedAvatarState {
+public:
+    QuantizedAvatarState();
+    
+    /// writes a mask of the fields that differ from baseline followed by those fields, positions as a difference from
+    /// the baseline position - with no baseline every non-default field is written, which depends only on this state
+    /// \return the number of bytes written
+    int encodeDelta(unsigned char* destinationBuffer, const QuantizedAvatarState* baseline) const;
+    
+    /// reads what encodeDelta wrote over this state, which should be a copy of the same baseline (or default constructed
+    /// if there was none) - this reads the same number of bytes whatever it is applied over
+    /// \return the number of bytes read, 0 if numBytes was too short
+    int decodeDelta(unsigned char* sourceBuffer, int numBytes);
+    
+    int32_t position[3];
+    uint32_t bodyRotation;
+    uint32_t headRotation;
+    uint16_t scale;
+    uint16_t leaderID;
+    int16_t lean[2];
+    int16_t handOffset[3];
+    int16_t lookAtOffset[3];
+    uint8_t audioLoudness;
+    uint8_t bitItems;
+    uint8_t pupilDilation;
+    
+    QByteArray userUUID;
+    QByteArray chatMessage;
+    QByteArray faceshiftData;
+    QByteArray handData;
+    QByteArray jointData;
+};
+
+/// fixed point with the given radix, clamped to what fits in 16 bits
+int16_t quantizeToSignedTwoByteFixed(float value, int radix);
+float unquantizeFromSignedTwoByteFixed(int16_t value, int radix);
+
+#endif /* defined(__hifi__QuantizedAvatarState__) */
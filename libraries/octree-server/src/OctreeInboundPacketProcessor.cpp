@@ -36,6 +36,8 @@ void OctreeInboundPacketProcessor::resetStats() {
     _totalPackets = 0;
     
     _singleSenderStats.clear();
+    
+    getPacketQueue().resetStats();
 }
 
 
@@ -74,6 +76,13 @@ void OctreeInboundPacketProcessor::processPacket(const HifiSockAddr& senderSockA
         }
         int atByte = numBytesPacketHeader + sizeof(sequence) + sizeof(sentAt);
         unsigned char* editData = (unsigned char*)&packetData[atByte];
+        
+        // a packet can hold many edits, especially bulk ones, so the tree is locked once for all of them
+        uint64_t startLock = usecTimestampNow();
+        _myServer->getOctree()->lockForWrite();
+        uint64_t startProcess = usecTimestampNow();
+        lockWaitTime = startProcess - startLock;
+        
         while (atByte < packetLength) {
             int maxSize = packetLength - atByte;
 
@@ -83,24 +92,17 @@ void OctreeInboundPacketProcessor::processPacket(const HifiSockAddr& senderSockA
                         packetType, packetData, packetLength, editData, atByte, maxSize);
             }
 
-            uint64_t startLock = usecTimestampNow();
-            _myServer->getOctree()->lockForWrite();
-            uint64_t startProcess = usecTimestampNow();
             int editDataBytesRead = _myServer->getOctree()->processEditPacketData(packetType, 
                                                                 packetData, packetLength, editData, maxSize, senderNode);
-            _myServer->getOctree()->unlock();
-            uint64_t endProcess = usecTimestampNow();
-
             editsInPacket++;
-            uint64_t thisProcessTime = endProcess - startProcess;
-            uint64_t thisLockWaitTime = startProcess - startLock;
-            processTime += thisProcessTime;
-            lockWaitTime += thisLockWaitTime;
 
             // skip to next voxel edit record in the packet
             editData += editDataBytesRead;
             atByte += editDataBytesRead;
         }
+        
+        _myServer->getOctree()->unlock();
+        processTime = usecTimestampNow() - startProcess;
 
         if (debugProcessPacket) {
             printf("OctreeInboundPacketProcessor::processPacket() DONE LOOPING FOR %c "
@@ -40,8 +40,7 @@ OctreeQueryNode::OctreeQueryNode(Node* owningNode) :
 
 void OctreeQueryNode::initializeOctreeSendThread(OctreeServer* octreeServer) {
     // Create octree sending thread...
-    QUuid nodeUUID = getOwningNode()->getUUID();
-    _octreeSendThread = new OctreeSendThread(nodeUUID, octreeServer);
+    _octreeSendThread = new OctreeSendThread(getOwningNodeUUID(), octreeServer);
     _octreeSendThread->initialize(true);
 }
 
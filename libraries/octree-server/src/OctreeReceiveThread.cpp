@@ -0,0 +1,51 @@
+//
+//  OctreeReceiveThread.cpp
+//  octree-server
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+//  Threaded reader for one of the sockets sharing the octree server's port.
+//
+
+#include "OctreeServer.h"
+#include "OctreeReceiveThread.h"
+
+OctreeReceiveThread::OctreeReceiveThread(OctreeServer* myServer, quint16 port) :
+    _myServer(myServer),
+    _socket(),
+    _numPacketsReceived(0)
+{
+    _socket.bind(port);
+    
+    // packets are read straight into pooled buffers, so whatever they're queued for can take them without a copy
+    for (int i = 0; i < MAX_DATAGRAMS_PER_BATCH; i++) {
+        _packets[i] = PacketBufferPool::getInstance()->acquire();
+    }
+}
+
+OctreeReceiveThread::~OctreeReceiveThread() {
+    for (int i = 0; i < MAX_DATAGRAMS_PER_BATCH; i++) {
+        _packets[i]->release();
+    }
+}
+
+bool OctreeReceiveThread::process() {
+    // sleep in the socket until something arrives, waking this often to see if we've been terminated
+    const int RECEIVE_WAIT_MSECS = 100;
+    
+    if (_socket.waitForDatagrams(RECEIVE_WAIT_MSECS)) {
+        int numPackets = _socket.readPendingPackets(_packets);
+        
+        for (int i = 0; i < numPackets; i++) {
+            if (_myServer->processReceivedPacket(_packets[i])) {
+                // whatever it was queued for holds on to that buffer now, so the next read goes into a fresh one
+                _packets[i]->release();
+                _packets[i] = PacketBufferPool::getInstance()->acquire();
+            }
+        }
+        
+        _numPacketsReceived += numPackets;
+    }
+    
+    return isStillRunning();  // keep running till they terminate us
+}
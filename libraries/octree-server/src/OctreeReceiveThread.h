@@ -0,0 +1,42 @@
+//
+//  OctreeReceiveThread.h
+//  octree-server
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+//  Threaded reader for one of the sockets sharing the octree server's port.
+//
+
+#ifndef __octree_server__OctreeReceiveThread__
+#define __octree_server__OctreeReceiveThread__
+
+#include <GenericThread.h>
+#include <PacketBuffer.h>
+#include <ReusePortSocket.h>
+
+class OctreeServer;
+
+/// Reads one of the extra sockets an OctreeServer opens on its port, so that inbound queries and edits from different
+/// clients are taken off the wire on different cores. Packets go to OctreeServer::processReceivedPacket from this thread.
+class OctreeReceiveThread : public GenericThread {
+public:
+    OctreeReceiveThread(OctreeServer* myServer, quint16 port);
+    ~OctreeReceiveThread();
+    
+    /// false if the socket couldn't share the port, in which case there's no point starting the thread
+    bool isBound() const { return _socket.isBound(); }
+    
+    uint64_t getNumPacketsReceived() const { return _numPacketsReceived; }
+    
+protected:
+    /// Implements generic processing behavior for this thread.
+    virtual bool process();
+    
+private:
+    OctreeServer* _myServer;
+    ReusePortSocket _socket;
+    PacketBuffer* _packets[MAX_DATAGRAMS_PER_BATCH];
+    uint64_t _numPacketsReceived;
+};
+
+#endif // __octree_server__OctreeReceiveThread__
@@ -30,6 +30,8 @@ bool OctreeSendThread::process() {
     
     // don't do any send processing until the initial load of the octree is complete...
     if (_myServer->isInitialLoadComplete()) {
+        // keep the node from being deleted under us if the node list removes it while we're sending
+        NodeListReadGuard readGuard;
         Node* node = NodeList::getInstance()->nodeWithUUID(_nodeUUID);
     
         if (node) {
@@ -44,11 +46,19 @@ bool OctreeSendThread::process() {
 
                 // Sometimes the node data has not yet been linked, in which case we can't really do anything
                 if (nodeData) {
+                    // hold our own reference so the data outlives an unlink from nodeKilled while we're sending
+                    nodeData->retain();
+                    
                     bool viewFrustumChanged = nodeData->updateCurrentViewFrustum();
                     if (_myServer->wantsDebugSending() && _myServer->wantsVerboseDebug()) {
                         printf("nodeData->updateCurrentViewFrustum() changed=%s\n", debug::valueOf(viewFrustumChanged));
                     }
                     packetsSent = packetDistributor(node, nodeData, viewFrustumChanged);
+                    
+                    // this interval's packets go out together
+                    NodeList::getInstance()->getBatchedNodeSocket().flush();
+                    
+                    nodeData->release();
                 }
     
                 node->unlock(); // we're done with this node for now.
@@ -136,15 +146,13 @@ int OctreeSendThread::handlePacketSend(Node* node, OctreeQueryNode* nodeData, in
             }
             
             // actually send it
-            NodeList::getInstance()->getNodeSocket().writeDatagram((char*) statsMessage, statsMessageLength,
-                                                                   node->getActiveSocket()->getAddress(),
-                                                                   node->getActiveSocket()->getPort());
+            NodeList::getInstance()->getBatchedNodeSocket().queueDatagram((char*) statsMessage, statsMessageLength,
+                                                                           *node->getActiveSocket());
             packetSent = true;
         } else {
             // not enough room in the packet, send two packets
-            NodeList::getInstance()->getNodeSocket().writeDatagram((char*) statsMessage, statsMessageLength,
-                                                                   node->getActiveSocket()->getAddress(),
-                                                                   node->getActiveSocket()->getPort());
+            NodeList::getInstance()->getBatchedNodeSocket().queueDatagram((char*) statsMessage, statsMessageLength,
+                                                                           *node->getActiveSocket());
 
             // since a stats message is only included on end of scene, don't consider any of these bytes "wasted", since
             // there was nothing else to send.
@@ -164,9 +172,8 @@ int OctreeSendThread::handlePacketSend(Node* node, OctreeQueryNode* nodeData, in
             truePacketsSent++;
             packetsSent++;
 
-            NodeList::getInstance()->getNodeSocket().writeDatagram((char*) nodeData->getPacket(), nodeData->getPacketLength(),
-                                                                   node->getActiveSocket()->getAddress(),
-                                                                   node->getActiveSocket()->getPort());
+            NodeList::getInstance()->getBatchedNodeSocket().queueDatagram((char*) nodeData->getPacket(), nodeData->getPacketLength(),
+                                                                           *node->getActiveSocket());
 
             packetSent = true;
 
@@ -187,9 +194,8 @@ int OctreeSendThread::handlePacketSend(Node* node, OctreeQueryNode* nodeData, in
         // If there's actually a packet waiting, then send it.
         if (nodeData->isPacketWaiting()) {
             // just send the voxel packet
-            NodeList::getInstance()->getNodeSocket().writeDatagram((char*) nodeData->getPacket(), nodeData->getPacketLength(),
-                                                                   node->getActiveSocket()->getAddress(),
-                                                                   node->getActiveSocket()->getPort());
+            NodeList::getInstance()->getBatchedNodeSocket().queueDatagram((char*) nodeData->getPacket(), nodeData->getPacketLength(),
+                                                                           *node->getActiveSocket());
             packetSent = true;
 
             int thisWastedBytes = MAX_PACKET_SIZE - nodeData->getPacketLength();
@@ -551,6 +557,8 @@ int OctreeSendThread::packetDistributor(Node* node, OctreeQueryNode* nodeData, b
         }
         
     } // end if bag wasn't empty, and so we sent stuff...
+    
+    _myServer->sendStreamPackets(node, nodeData, trueBytesSent, truePacketsSent);
 
     return truePacketsSent;
 }
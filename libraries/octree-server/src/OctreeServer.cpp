@@ -14,6 +14,7 @@
 
 #include "civetweb.h"
 
+#include "OctreeReceiveThread.h"
 #include "OctreeServer.h"
 #include "OctreeServerConsts.h"
 
@@ -34,11 +35,9 @@ void OctreeServer::nodeAdded(Node* node) {
 void OctreeServer::nodeKilled(Node* node) {
     // Use this to cleanup our node
     if (node->getType() == NODE_TYPE_AGENT) {
-        OctreeQueryNode* nodeData = (OctreeQueryNode*)node->getLinkedData();
-        if (nodeData) {
-            node->setLinkedData(NULL);
-            delete nodeData;
-        }
+        // drop our reference to the query node data - a send thread in the middle of a pass holds its own (see
+        // OctreeSendThread::process) and the data is deleted when the last reference is released
+        node->setLinkedData(NULL);
     }
 };
 
@@ -76,6 +75,13 @@ OctreeServer::~OctreeServer() {
         delete[] _parsedArgV;
     }
     
+    // stop reading before the processors the receive threads hand packets to go away
+    for (std::vector<OctreeReceiveThread*>::iterator receiveThread = _receiveThreads.begin();
+         receiveThread != _receiveThreads.end(); receiveThread++) {
+        (*receiveThread)->terminate();
+        delete *receiveThread;
+    }
+    
     if (_jurisdictionSender) {
         _jurisdictionSender->terminate();
         delete _jurisdictionSender;
@@ -93,6 +99,7 @@ OctreeServer::~OctreeServer() {
     
     // tell our NodeList we're done with notifications
     NodeList::getInstance()->removeHook(this);
+    NodeList::getInstance()->removeReliableMessageListener(this);
 
     delete _jurisdiction;
     _jurisdiction = NULL;
@@ -145,6 +152,7 @@ int OctreeServer::civetwebRequestHandler(struct mg_connection* connection) {
 
     if (strcmp(ri->uri, "/resetStats") == 0 && strcmp(ri->request_method, "GET") == 0) {
         theServer->_octreeInboundPacketProcessor->resetStats();
+        theServer->resetSpecialStats();
         showStats = true;
     }
     
@@ -331,6 +339,34 @@ int OctreeServer::civetwebRequestHandler(struct mg_connection* connection) {
         mg_printf(connection, "  Average Wait Lock Time/Element: %s usecs\r\n", 
             locale.toString((uint)averageLockWaitTimePerElement).rightJustified(COLUMN_WIDTH, ' ').toLocal8Bit().constData());
 
+        // how long edit packets waited to be processed, and how many were dropped because we were too far behind
+        PacketQueue& inboundPacketQueue = theServer->_octreeInboundPacketProcessor->getPacketQueue();
+        const float MEDIAN_LATENCY_PERCENTILE = 0.5f;
+        const float WORST_LATENCY_PERCENTILE = 0.99f;
+        
+        mg_printf(connection, "     Inbound Packets Now Waiting: %s packets\r\n",
+            locale.toString(inboundPacketQueue.size()).rightJustified(COLUMN_WIDTH, ' ').toLocal8Bit().constData());
+        mg_printf(connection, "    Inbound Packets Most Waiting: %s packets\r\n",
+            locale.toString(inboundPacketQueue.getMaxDepth()).rightJustified(COLUMN_WIDTH, ' ').toLocal8Bit().constData());
+        mg_printf(connection, "         Inbound Packets Dropped: %s packets\r\n",
+            locale.toString(inboundPacketQueue.getNumDropped()).rightJustified(COLUMN_WIDTH, ' ').toLocal8Bit().constData());
+        mg_printf(connection, "        Median Queue Wait/Packet: %s usecs\r\n",
+            locale.toString((uint)inboundPacketQueue.getLatencyPercentile(MEDIAN_LATENCY_PERCENTILE))
+                .rightJustified(COLUMN_WIDTH, ' ').toLocal8Bit().constData());
+        mg_printf(connection, "     99th %%ile Queue Wait/Packet: %s usecs\r\n",
+            locale.toString((uint)inboundPacketQueue.getLatencyPercentile(WORST_LATENCY_PERCENTILE))
+                .rightJustified(COLUMN_WIDTH, ' ').toLocal8Bit().constData());
+        
+        // the node socket reads whatever isn't spread across the extra receive sockets
+        mg_printf(connection, "                 Receive Sockets: %s sockets\r\n",
+            locale.toString((uint)theServer->_receiveThreads.size() + 1).rightJustified(COLUMN_WIDTH, ' ')
+                .toLocal8Bit().constData());
+        for (int i = 0; i < (int)theServer->_receiveThreads.size(); i++) {
+            mg_printf(connection, "      Packets Read By Socket %3d: %s packets\r\n", i + 1,
+                locale.toString((uint)theServer->_receiveThreads[i]->getNumPacketsReceived())
+                    .rightJustified(COLUMN_WIDTH, ' ').toLocal8Bit().constData());
+        }
+
 
         int senderNumber = 0;
         NodeToSenderStatsMap& allSenderStats = theServer->_octreeInboundPacketProcessor->getSingleSenderStats();
@@ -373,6 +409,13 @@ int OctreeServer::civetwebRequestHandler(struct mg_connection* connection) {
 
         mg_printf(connection, "%s", "\r\n");
         mg_printf(connection, "%s", "\r\n");
+        
+        QString specialStats = theServer->getSpecialStats();
+        if (!specialStats.isEmpty()) {
+            mg_printf(connection, "%s", specialStats.toLocal8Bit().constData());
+            mg_printf(connection, "%s", "\r\n");
+            mg_printf(connection, "%s", "\r\n");
+        }
 
         // display memory usage stats
         mg_printf(connection, "%s", "<b>Current Memory Usage Statistics</b>\r\n");
@@ -507,38 +550,10 @@ void OctreeServer::parsePayload() {
 }
 
 void OctreeServer::processDatagram(const QByteArray& dataByteArray, const HifiSockAddr& senderSockAddr) {
-    NodeList* nodeList = NodeList::getInstance();
-    
     PACKET_TYPE packetType = dataByteArray[0];
     
     if (packetType == getMyQueryMessageType()) {
-        bool debug = false;
-        if (debug) {
-            qDebug("Got PACKET_TYPE_VOXEL_QUERY at %llu.\n", usecTimestampNow());
-        }
-        
-        int numBytesPacketHeader = numBytesForPacketHeader((unsigned char*) dataByteArray.data());
-        
-        // If we got a PACKET_TYPE_VOXEL_QUERY, then we're talking to an NODE_TYPE_AVATAR, and we
-        // need to make sure we have it in our nodeList.
-        QUuid nodeUUID = QUuid::fromRfc4122(dataByteArray.mid(numBytesPacketHeader,
-                                                              NUM_BYTES_RFC4122_UUID));
-        
-        Node* node = nodeList->nodeWithUUID(nodeUUID);
-        
-        if (node) {
-            nodeList->updateNodeWithData(node, senderSockAddr, (unsigned char *) dataByteArray.data(),
-                                         dataByteArray.size());
-            if (!node->getActiveSocket()) {
-                // we don't have an active socket for this node, but they're talking to us
-                // this means they've heard from us and can reply, let's assume public is active
-                node->activatePublicSocket();
-            }
-            OctreeQueryNode* nodeData = (OctreeQueryNode*) node->getLinkedData();
-            if (nodeData && !nodeData->isOctreeSendThreadInitalized()) {
-                nodeData->initializeOctreeSendThread(this);
-            }
-        }
+        processQuery(senderSockAddr, (unsigned char*) dataByteArray.data(), dataByteArray.size());
     } else if (packetType == PACKET_TYPE_JURISDICTION_REQUEST) {
         _jurisdictionSender->queueReceivedPacket(senderSockAddr, (unsigned char*) dataByteArray.data(),
                                                  dataByteArray.size());
@@ -552,6 +567,100 @@ void OctreeServer::processDatagram(const QByteArray& dataByteArray, const HifiSo
     }
 }
 
+void OctreeServer::processReliableMessage(const HifiSockAddr& senderSockAddr, unsigned char* packetData, int packetLength) {
+    // NodeList unwraps these on our own thread, from processDatagram, so the message can go the same way as any other
+    processDatagram(QByteArray((char*) packetData, packetLength), senderSockAddr);
+}
+
+bool OctreeServer::processReceivedPacket(PacketBuffer* packet) {
+    unsigned char* packetData = packet->getData();
+    
+    if (!packetVersionMatch(packetData)) {
+        return false;
+    }
+    
+    PACKET_TYPE packetType = packetData[0];
+    
+    if (packetType == getMyQueryMessageType()) {
+        // keep the node we find alive even if our own thread kills it while we're using it
+        NodeListReadGuard readGuard;
+        processQuery(packet->getSockAddr(), packetData, packet->getLength());
+        return false;
+    } else if (packetType == PACKET_TYPE_JURISDICTION_REQUEST) {
+        _jurisdictionSender->queueReceivedPacket(packet);
+        return true;
+    } else if (_octreeInboundPacketProcessor && getOctree()->handlesEditPacketType(packetType)) {
+        _octreeInboundPacketProcessor->queueReceivedPacket(packet);
+        return true;
+    } else {
+        // pings, domain server lists and the rest are few, and belong to our own thread
+        QMetaObject::invokeMethod(this, "processDatagram", Qt::QueuedConnection,
+                                  Q_ARG(QByteArray, QByteArray((char*) packetData, packet->getLength())),
+                                  Q_ARG(HifiSockAddr, packet->getSockAddr()));
+        return false;
+    }
+}
+
+void OctreeServer::processQuery(const HifiSockAddr& senderSockAddr, unsigned char* packetData, int packetLength) {
+    NodeList* nodeList = NodeList::getInstance();
+    
+    bool debug = false;
+    if (debug) {
+        qDebug("Got PACKET_TYPE_VOXEL_QUERY at %llu.\n", usecTimestampNow());
+    }
+    
+    int numBytesPacketHeader = numBytesForPacketHeader(packetData);
+    
+    // If we got a PACKET_TYPE_VOXEL_QUERY, then we're talking to an NODE_TYPE_AVATAR, and we
+    // need to make sure we have it in our nodeList.
+    QUuid nodeUUID = QUuid::fromRfc4122(QByteArray((char*) packetData + numBytesPacketHeader, NUM_BYTES_RFC4122_UUID));
+    
+    Node* node = nodeList->nodeWithUUID(nodeUUID);
+    
+    if (node) {
+        nodeList->updateNodeWithData(node, senderSockAddr, packetData, packetLength);
+        if (!node->getActiveSocket()) {
+            // we don't have an active socket for this node, but they're talking to us
+            // this means they've heard from us and can reply, let's assume public is active
+            node->activatePublicSocket();
+        }
+        OctreeQueryNode* nodeData = (OctreeQueryNode*) node->getLinkedData();
+        if (nodeData && !nodeData->isOctreeSendThreadInitalized()) {
+            nodeData->initializeOctreeSendThread(this);
+        }
+    }
+}
+
+void OctreeServer::startReceiveThreads(int numReceiveSockets) {
+    NodeList* nodeList = NodeList::getInstance();
+    
+    // the node socket has to be rebound to share its port, and that happens on the thread that owns it
+    bool isSharingPort = false;
+    QMetaObject::invokeMethod(nodeList, "shareNodeSocketPort", Qt::BlockingQueuedConnection,
+                              Q_RETURN_ARG(bool, isSharingPort));
+    
+    if (!isSharingPort) {
+        qDebug("receiveSockets=%d but the port can't be shared here, reading the node socket alone\n", numReceiveSockets);
+        return;
+    }
+    
+    quint16 port = nodeList->getNodeSocket().localPort();
+    
+    // the node socket is one of the sockets sharing the port, the others each get a thread
+    for (int i = 1; i < numReceiveSockets; i++) {
+        OctreeReceiveThread* receiveThread = new OctreeReceiveThread(this, port);
+        if (!receiveThread->isBound()) {
+            delete receiveThread;
+            break;
+        }
+        
+        receiveThread->initialize(true);
+        _receiveThreads.push_back(receiveThread);
+    }
+    
+    qDebug("receiveSockets=%d sharing port %d\n", (int) _receiveThreads.size() + 1, port);
+}
+
 void OctreeServer::run() {
     // Before we do anything else, create our tree...
     _tree = createTree();
@@ -613,6 +722,7 @@ void OctreeServer::run() {
 
     // tell our NodeList about our desire to get notifications
     nodeList->addHook(this);
+    nodeList->addReliableMessageListener(this);
     nodeList->linkedDataCreateCallback = &OctreeServer::attachQueryNodeToNode;
 
     srand((unsigned)time(0));
@@ -680,6 +790,13 @@ void OctreeServer::run() {
     // set up our OctreeServerPacketProcessor
     _octreeInboundPacketProcessor = new OctreeInboundPacketProcessor(this);
     _octreeInboundPacketProcessor->initialize(true);
+    
+    // spread inbound packets across more sockets and threads, now that the processors they feed are running
+    const char* RECEIVE_SOCKETS = "--receiveSockets";
+    const char* receiveSockets = getCmdOption(_argc, _argv, RECEIVE_SOCKETS);
+    if (receiveSockets && atoi(receiveSockets) > 1) {
+        startReceiveThreads(atoi(receiveSockets));
+    }
 
     // Convert now to tm struct for local timezone
     tm* localtm = localtime(&_started);
@@ -705,4 +822,8 @@ void OctreeServer::run() {
     QTimer* pingNodesTimer = new QTimer(this);
     connect(pingNodesTimer, SIGNAL(timeout()), nodeList, SLOT(pingInactiveNodes()));
     pingNodesTimer->start(PING_INACTIVE_NODE_INTERVAL_USECS / 1000);
+    
+    QTimer* reliableResendTimer = new QTimer(this);
+    connect(reliableResendTimer, SIGNAL(timeout()), nodeList, SLOT(resendReliableMessages()));
+    reliableResendTimer->start(RELIABLE_RESEND_INTERVAL_USECS / 1000);
 }
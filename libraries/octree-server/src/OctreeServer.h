@@ -10,6 +10,8 @@
 #ifndef __octree_server__OctreeServer__
 #define __octree_server__OctreeServer__
 
+#include <vector>
+
 #include <QStringList>
 #include <QDateTime>
 #include <QtCore/QCoreApplication>
@@ -22,8 +24,10 @@
 #include "OctreeServerConsts.h"
 #include "OctreeInboundPacketProcessor.h"
 
+class OctreeReceiveThread;
+
 /// Handles assignments of type OctreeServer - sending octrees to various clients.
-class OctreeServer : public ThreadedAssignment, public NodeListHook {
+class OctreeServer : public ThreadedAssignment, public NodeListHook, public ReliableMessageListener {
 public:                
     OctreeServer(const unsigned char* dataBuffer, int numBytes);
     ~OctreeServer();
@@ -58,12 +62,28 @@ public:
     virtual void beforeRun() { };
     virtual bool hasSpecialPacketToSend() { return false; }
     virtual int sendSpecialPacket(Node* node) { return 0; }
+    
+    /// called by each node's send thread every interval, whether or not it had octree content to send, for streams of
+    /// the server's own that every node should get - adds what it sent to bytesSent and packetsSent
+    virtual void sendStreamPackets(Node* node, OctreeQueryNode* nodeData, int& bytesSent, int& packetsSent) { }
+    
+    /// extra lines for the status page, preformatted text like the rest of it
+    virtual QString getSpecialStats() { return QString(); }
+    virtual void resetSpecialStats() { }
 
     static void attachQueryNodeToNode(Node* newNode);
 
     // NodeListHook 
     virtual void nodeAdded(Node* node);
     virtual void nodeKilled(Node* node);
+    
+    // ReliableMessageListener
+    virtual void processReliableMessage(const HifiSockAddr& senderSockAddr, unsigned char* packetData, int packetLength);
+
+    /// handles a packet read by one of the receive threads, on that thread - queries are handled there and then, edits and
+    /// jurisdiction requests are queued for their processors, anything else goes to processDatagram on our own thread
+    /// \return true if the packet was queued, in which case whatever it was queued for holds a reference to it
+    bool processReceivedPacket(PacketBuffer* packet);
 
 public slots:
     /// runs the voxel server assignment
@@ -87,8 +107,15 @@ protected:
     OctreeInboundPacketProcessor* _octreeInboundPacketProcessor;
     OctreePersistThread* _persistThread;
 
+    std::vector<OctreeReceiveThread*> _receiveThreads;
+
     void parsePayload();
     void initMongoose(int port);
+    
+    /// shares our port between the node socket and numReceiveSockets - 1 more, each read on its own thread
+    void startReceiveThreads(int numReceiveSockets);
+    
+    void processQuery(const HifiSockAddr& senderSockAddr, unsigned char* packetData, int packetLength);
     static int civetwebRequestHandler(struct mg_connection *connection);
     static OctreeServer* _theInstance;
     time_t _started;
@@ -20,9 +20,9 @@ JurisdictionListener::JurisdictionListener(NODE_TYPE type, PacketSenderNotify* n
     PacketSender(notify, JurisdictionListener::DEFAULT_PACKETS_PER_SECOND)
 {
     _nodeType = type;
-    ReceivedPacketProcessor::_dontSleep = true; // we handle sleeping so this class doesn't need to
     NodeList* nodeList = NodeList::getInstance();
     nodeList->addHook(this);
+    nodeList->addReliableMessageListener(this);
 
     //qDebug("JurisdictionListener::JurisdictionListener(NODE_TYPE type=%c)\n", type);
 
@@ -31,6 +31,7 @@ JurisdictionListener::JurisdictionListener(NODE_TYPE type, PacketSenderNotify* n
 JurisdictionListener::~JurisdictionListener() {
     NodeList* nodeList = NodeList::getInstance();
     nodeList->removeHook(this);
+    nodeList->removeReliableMessageListener(this);
 }
 
 void JurisdictionListener::nodeAdded(Node* node) {
@@ -43,32 +44,31 @@ void JurisdictionListener::nodeKilled(Node* node) {
     }
 }
 
-bool JurisdictionListener::queueJurisdictionRequest() {
-    //qDebug() << "JurisdictionListener::queueJurisdictionRequest()\n";
+void JurisdictionListener::processReliableMessage(const HifiSockAddr& senderSockAddr, unsigned char* packetData,
+                                                  int packetLength) {
+    // PACKET_TYPE_JURISDICTION, first byte is the node type...
+    if (packetData[0] == PACKET_TYPE_JURISDICTION && packetData[numBytesForPacketHeader(packetData)] == getNodeType()) {
+        queueReceivedPacket(senderSockAddr, packetData, packetLength);
+    }
+}
 
-    static unsigned char buffer[MAX_PACKET_SIZE];
-    unsigned char* bufferOut = &buffer[0];
-    ssize_t sizeOut = populateTypeAndVersion(bufferOut, PACKET_TYPE_JURISDICTION_REQUEST);
-    int nodeCount = 0;
+void JurisdictionListener::sendJurisdictionRequests() {
+    unsigned char buffer[MAX_PACKET_HEADER_BYTES];
+    int sizeOut = populateTypeAndVersion(buffer, PACKET_TYPE_JURISDICTION_REQUEST);
+    uint64_t now = usecTimestampNow();
 
     NodeList* nodeList = NodeList::getInstance();
     for (NodeList::iterator node = nodeList->begin(); node != nodeList->end(); node++) {
-        if (nodeList->getNodeActiveSocketOrPing(&(*node)) && 
-            node->getType() == getNodeType()) {
-            const HifiSockAddr* nodeAddress = node->getActiveSocket();
-            PacketSender::queuePacketForSending(*nodeAddress, bufferOut, sizeOut);
-            nodeCount++;
+        if (node->getType() == getNodeType() && _jurisdictions.find(node->getUUID()) == _jurisdictions.end()
+            && nodeList->getNodeActiveSocketOrPing(&(*node))) {
+            
+            std::map<QUuid, uint64_t>::iterator lastRequest = _lastRequestTimes.find(node->getUUID());
+            if (lastRequest == _lastRequestTimes.end() || now - lastRequest->second > REPEAT_REQUEST_USECS) {
+                nodeList->sendReliableMessage(*node->getActiveSocket(), buffer, sizeOut);
+                _lastRequestTimes[node->getUUID()] = now;
+            }
         }
     }
-
-    if (nodeCount > 0){
-        setPacketsPerSecond(nodeCount);
-    } else {
-        setPacketsPerSecond(NO_SERVER_CHECK_RATE);
-    }
-    
-    // keep going if still running
-    return isStillRunning();
 }
 
 void JurisdictionListener::processPacket(const HifiSockAddr& senderAddress, unsigned char*  packetData, ssize_t packetLength) {
@@ -86,12 +86,10 @@ void JurisdictionListener::processPacket(const HifiSockAddr& senderAddress, unsi
 bool JurisdictionListener::process() {
     bool continueProcessing = isStillRunning();
 
-    // If we're still running, and we don't have any requests waiting to be sent, then queue our jurisdiction requests
-    if (continueProcessing && !hasPacketsToSend()) {
-        queueJurisdictionRequest();
-        continueProcessing = PacketSender::process();
-    }
+    // ask any servers we haven't heard from yet, the requests themselves are resent by NodeList until they arrive
     if (continueProcessing) {
+        sendJurisdictionRequests();
+        
         // NOTE: This will sleep if there are no pending packets to process
         continueProcessing = ReceivedPacketProcessor::process();
     }
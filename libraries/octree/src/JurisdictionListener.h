@@ -11,20 +11,25 @@
 #ifndef __shared__JurisdictionListener__
 #define __shared__JurisdictionListener__
 
+#include <map>
+
 #include <NodeList.h>
 #include <PacketSender.h>
 #include <ReceivedPacketProcessor.h>
 
 #include "JurisdictionMap.h"
 
-/// Sends out PACKET_TYPE_JURISDICTION_REQUEST packets to all voxel servers and then listens for and processes
-/// the PACKET_TYPE_JURISDICTION packets it receives in order to maintain an accurate state of all jurisidictions
-/// within the domain. As with other ReceivedPacketProcessor classes the user is responsible for reading inbound packets
-/// and adding them to the processing queue by calling queueReceivedPacket()
-class JurisdictionListener : public NodeListHook, public PacketSender, public ReceivedPacketProcessor {
+/// Sends a reliable PACKET_TYPE_JURISDICTION_REQUEST to each voxel server whose jurisdiction it doesn't know yet and then
+/// listens for and processes the PACKET_TYPE_JURISDICTION packets it receives in order to maintain an accurate state of
+/// all jurisidictions within the domain. The servers answer with reliable messages, which the listener picks up from
+/// NodeList itself - queueReceivedPacket() is still there for callers that read a jurisdiction packet directly.
+class JurisdictionListener : public NodeListHook, public ReliableMessageListener, public PacketSender,
+                             public ReceivedPacketProcessor {
 public:
     static const int DEFAULT_PACKETS_PER_SECOND = 1;
-    static const int NO_SERVER_CHECK_RATE = 60; // if no servers yet detected, keep checking at 60fps
+    
+    // the request is reliable, so it's only repeated for a server that gave up on it or went away and came back
+    static const uint64_t REPEAT_REQUEST_USECS = 10 * 1000 * 1000;
 
     JurisdictionListener(NODE_TYPE type = NODE_TYPE_VOXEL_SERVER, PacketSenderNotify* notify = NULL);
     ~JurisdictionListener();
@@ -37,6 +42,9 @@ public:
     void nodeAdded(Node* node);
     /// Called by NodeList to inform us that a node has been killed.
     void nodeKilled(Node* node);
+    
+    /// Called by NodeList with the reliable messages it receives, queues the jurisdictions of our node type
+    void processReliableMessage(const HifiSockAddr& senderSockAddr, unsigned char* packetData, int packetLength);
 
     NODE_TYPE getNodeType() const { return _nodeType; }
     void setNodeType(NODE_TYPE type) { _nodeType = type; }
@@ -53,7 +61,8 @@ protected:
 private:
     NodeToJurisdictionMap _jurisdictions;
     NODE_TYPE _nodeType;
+    std::map<QUuid, uint64_t> _lastRequestTimes;
 
-    bool queueJurisdictionRequest();
+    void sendJurisdictionRequests();
 };
 #endif // __shared__JurisdictionListener__
@@ -57,27 +57,23 @@ bool JurisdictionSender::process() {
         } else {
             sizeOut = JurisdictionMap::packEmptyJurisdictionIntoMessage(getNodeType(), bufferOut, MAX_PACKET_SIZE);
         }
-        int nodeCount = 0;
+
+        NodeList* nodeList = NodeList::getInstance();
+        NodeListReadGuard readGuard;
 
         lockRequestingNodes();
         while (!_nodesRequestingJurisdictions.empty()) {
 
             QUuid nodeUUID = _nodesRequestingJurisdictions.front();
             _nodesRequestingJurisdictions.pop();
-            Node* node = NodeList::getInstance()->nodeWithUUID(nodeUUID);
+            Node* node = nodeList->nodeWithUUID(nodeUUID);
 
-            if (node->getActiveSocket() != NULL) {
-                const HifiSockAddr* nodeAddress = node->getActiveSocket();
-                queuePacketForSending(*nodeAddress, bufferOut, sizeOut);
-                nodeCount++;
+            // our answer is sent reliably, so the requester only has to ask once
+            if (node && node->getActiveSocket() != NULL) {
+                nodeList->sendReliableMessage(*node->getActiveSocket(), bufferOut, sizeOut);
             }
         }
         unlockRequestingNodes();
-
-        // set our packets per second to be the number of nodes
-        setPacketsPerSecond(nodeCount);
-
-        continueProcessing = PacketSender::process();
     }
     return continueProcessing;
 }
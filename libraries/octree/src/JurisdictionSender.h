@@ -18,8 +18,8 @@
 #include "JurisdictionMap.h"
 
 /// Will process PACKET_TYPE_JURISDICTION_REQUEST packets and send out PACKET_TYPE_JURISDICTION packets
-/// to requesting parties. As with other ReceivedPacketProcessor classes the user is responsible for reading inbound packets
-/// and adding them to the processing queue by calling queueReceivedPacket()
+/// to requesting parties with NodeList::sendReliableMessage. As with other ReceivedPacketProcessor classes the user is
+/// responsible for reading inbound packets and adding them to the processing queue by calling queueReceivedPacket()
 class JurisdictionSender : public PacketSender, public ReceivedPacketProcessor {
 public:
     static const int DEFAULT_PACKETS_PER_SECOND = 1;
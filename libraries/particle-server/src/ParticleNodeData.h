@@ -15,8 +15,15 @@
 
 class ParticleNodeData : public OctreeQueryNode {
 public:
-    ParticleNodeData(Node* owningNode) : OctreeQueryNode(owningNode) {  };
+    ParticleNodeData(Node* owningNode) : OctreeQueryNode(owningNode), _lastSnapshotSent(0) {  };
     virtual PACKET_TYPE getMyPacketType() const { return PACKET_TYPE_PARTICLE_DATA; }
+    
+    /// the sequence number of the last particle snapshot sent to this node
+    uint64_t getLastSnapshotSent() const { return _lastSnapshotSent; }
+    void setLastSnapshotSent(uint64_t lastSnapshotSent) { _lastSnapshotSent = lastSnapshotSent; }
+
+private:
+    uint64_t _lastSnapshotSent;
 };
 
 #endif /* defined(__hifi__ParticleNodeData__) */
@@ -6,6 +6,12 @@
 //  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
 //
 
+#include <algorithm>
+
+#include <QtCore/QLocale>
+#include <QtCore/QTimer>
+
+#include <ParticleScriptEngine.h>
 #include <ParticleTree.h>
 
 #include "ParticleServer.h"
@@ -16,8 +22,18 @@ const char* PARTICLE_SERVER_NAME = "Particle";
 const char* PARTICLE_SERVER_LOGGING_TARGET_NAME = "particle-server";
 const char* LOCAL_PARTICLES_PERSIST_FILE = "resources/particles.svo";
 
-ParticleServer::ParticleServer(const unsigned char* dataBuffer, int numBytes) : OctreeServer(dataBuffer, numBytes) {
-    // nothing special to do here...
+ParticleServer::ParticleServer(const unsigned char* dataBuffer, int numBytes) :
+    OctreeServer(dataBuffer, numBytes),
+    _collisionSystem(),
+    _lastSnapshotUsecs(0),
+    _snapshotMutex(),
+    _snapshotPackets(),
+    _snapshotSequence(0),
+    _numSimulationTicks(0),
+    _totalSimulationUsecs(0),
+    _maxSimulationUsecs(0),
+    _numSnapshotPacketsSent(0)
+{
 }
 
 ParticleServer::~ParticleServer() {
@@ -36,7 +52,135 @@ Octree* ParticleServer::createTree() {
 }
 
 void ParticleServer::beforeRun() {
-    // nothing special to do...
+    // no voxels or audio here, the particles only collide with each other
+    _collisionSystem.init(NULL, (ParticleTree*)_tree, NULL);
+    
+    QTimer* simulationTimer = new QTimer(this);
+    connect(simulationTimer, SIGNAL(timeout()), this, SLOT(simulate()));
+    simulationTimer->start(PARTICLE_SIMULATION_INTERVAL_USECS / 1000);
+}
+
+void ParticleServer::simulate() {
+    ParticleTree* tree = (ParticleTree*)_tree;
+    uint64_t startUsecs = usecTimestampNow();
+    
+    tree->lockForWrite();
+    tree->update();
+    tree->unlock();
+    
+    _collisionSystem.update();
+    
+    if (startUsecs - _lastSnapshotUsecs >= PARTICLE_SNAPSHOT_INTERVAL_USECS) {
+        std::vector<QByteArray> snapshotPackets;
+        tree->lockForRead();
+        tree->encodeSnapshotPackets(snapshotPackets);
+        tree->unlock();
+        
+        QMutexLocker locker(&_snapshotMutex);
+        _snapshotPackets.swap(snapshotPackets);
+        _snapshotSequence++;
+        _lastSnapshotUsecs = startUsecs;
+    }
+    
+    uint64_t elapsedUsecs = usecTimestampNow() - startUsecs;
+    _numSimulationTicks++;
+    _totalSimulationUsecs += elapsedUsecs;
+    _maxSimulationUsecs = std::max(_maxSimulationUsecs, elapsedUsecs);
+}
+
+void ParticleServer::sendStreamPackets(Node* node, OctreeQueryNode* nodeData, int& bytesSent, int& packetsSent) {
+    ParticleNodeData* particleNodeData = (ParticleNodeData*)nodeData;
+    
+    // take our own reference to the latest snapshot, so the simulation can replace it while we send
+    _snapshotMutex.lock();
+    if (particleNodeData->getLastSnapshotSent() == _snapshotSequence) {
+        _snapshotMutex.unlock();
+        return;
+    }
+    std::vector<QByteArray> snapshotPackets = _snapshotPackets;
+    particleNodeData->setLastSnapshotSent(_snapshotSequence);
+    _numSnapshotPacketsSent += snapshotPackets.size();
+    _snapshotMutex.unlock();
+    
+    for (int i = 0; i < snapshotPackets.size(); i++) {
+        NodeList::getInstance()->getNodeSocket().writeDatagram(snapshotPackets[i].constData(), snapshotPackets[i].size(),
+                                                               node->getActiveSocket()->getAddress(),
+                                                               node->getActiveSocket()->getPort());
+        bytesSent += snapshotPackets[i].size();
+        packetsSent++;
+    }
+}
+
+// the status page lines up its values after a 32 character label
+static QString statsLine(const QString& label, const QLocale& locale, qulonglong value, const char* units) {
+    const int LABEL_WIDTH = 32;
+    const int COLUMN_WIDTH = 10;
+    return QString("%1: %2 %3\r\n").arg(label.rightJustified(LABEL_WIDTH, ' '),
+                                       locale.toString(value).rightJustified(COLUMN_WIDTH, ' '), units);
+}
+
+static bool scriptTakesLonger(const ParticleScriptStats& a, const ParticleScriptStats& b) {
+    return a.totalUsecs > b.totalUsecs;
+}
+
+QString ParticleServer::getSpecialStats() {
+    QLocale locale(QLocale::English);
+    QString stats = "<b>Particle Script Statistics... <a href='/resetStats'>[RESET]</a></b>\r\n";
+    
+    stats += statsLine("Simulation Ticks", locale, _numSimulationTicks, "ticks");
+    stats += statsLine("Average Time/Tick", locale,
+                       _numSimulationTicks == 0 ? 0 : _totalSimulationUsecs / _numSimulationTicks, "usecs");
+    stats += statsLine("Max Time/Tick", locale, _maxSimulationUsecs, "usecs");
+    _tree->lockForRead();
+    stats += statsLine("Particles Simulated", locale, ((ParticleTree*)_tree)->getStore().getNumParticles(), "particles");
+    _tree->unlock();
+    stats += statsLine("Collisions", locale, (qulonglong)_collisionSystem.getCollisionsPerSecond(), "per second");
+    _snapshotMutex.lock();
+    stats += statsLine("Snapshot Packets Sent", locale, _numSnapshotPacketsSent, "packets");
+    _snapshotMutex.unlock();
+    
+    ParticleScriptCacheStats cacheStats = ParticleScriptEngine::getCacheStats();
+    stats += statsLine("Script Engines", locale, cacheStats.numEngines, "engines");
+    stats += statsLine("Cached Scripts", locale, cacheStats.numCachedScripts, "scripts");
+    stats += statsLine("Script Cache Hits", locale, cacheStats.numHits, "runs");
+    stats += statsLine("Script Compiles", locale, cacheStats.numCompiles, "scripts");
+    stats += statsLine("Script Evictions", locale, cacheStats.numEvictions, "scripts");
+    
+    // the scripts costing us the most, most expensive first
+    const int MAX_SCRIPTS_TO_SHOW = 20;
+    const int MAX_SCRIPT_CHARACTERS_TO_SHOW = 60;
+    
+    std::vector<ParticleScriptStats> scriptStats;
+    ParticleScriptEngine::getScriptStats(scriptStats);
+    std::sort(scriptStats.begin(), scriptStats.end(), scriptTakesLonger);
+    
+    for (int i = 0; i < scriptStats.size() && i < MAX_SCRIPTS_TO_SHOW; i++) {
+        const ParticleScriptStats& script = scriptStats[i];
+        QString scriptText = script.script.simplified();
+        if (scriptText.size() > MAX_SCRIPT_CHARACTERS_TO_SHOW) {
+            scriptText = scriptText.left(MAX_SCRIPT_CHARACTERS_TO_SHOW) + "...";
+        }
+        
+        stats += QString("\r\n             Stats for script %1: %2\r\n").arg(i + 1).arg(scriptText.toHtmlEscaped());
+        stats += statsLine("Runs", locale, script.numRuns, "runs");
+        stats += statsLine("Exceptions", locale, script.numExceptions, "runs");
+        stats += statsLine("Total Time", locale, script.totalUsecs, "usecs");
+        stats += statsLine("Average Time/Run", locale, script.numRuns == 0 ? 0 : script.totalUsecs / script.numRuns, "usecs");
+        stats += statsLine("Max Time/Run", locale, script.maxUsecs, "usecs");
+    }
+    
+    return stats;
+}
+
+void ParticleServer::resetSpecialStats() {
+    ParticleScriptEngine::resetStats();
+    
+    _numSimulationTicks = 0;
+    _totalSimulationUsecs = 0;
+    _maxSimulationUsecs = 0;
+    
+    QMutexLocker locker(&_snapshotMutex);
+    _numSnapshotPacketsSent = 0;
 }
 
 void ParticleServer::particleCreated(const Particle& newParticle, Node* node) {
@@ -59,7 +203,6 @@ void ParticleServer::particleCreated(const Particle& newParticle, Node* node) {
     copyAt += sizeof(particleID);
     packetLength += sizeof(particleID);
     
-    NodeList::getInstance()->getNodeSocket().writeDatagram((char*) outputBuffer, packetLength,
-                                                           node->getActiveSocket()->getAddress(),
-                                                           node->getActiveSocket()->getPort());
+    // the creator can't tell its particle from the others until it hears this, so make sure it does
+    NodeList::getInstance()->sendReliableMessage(*node->getActiveSocket(), outputBuffer, packetLength);
 }
@@ -10,14 +10,22 @@
 #ifndef __particle_server__ParticleServer__
 #define __particle_server__ParticleServer__
 
+#include <vector>
+
+#include <QtCore/QMutex>
+
 #include <OctreeServer.h>
 
 #include "Particle.h"
+#include "ParticleCollisionSystem.h"
 #include "ParticleServerConsts.h"
 #include "ParticleTree.h"
 
-/// Handles assignments of type ParticleServer - sending particles to various clients.
+/// Handles assignments of type ParticleServer - sending particles to various clients. The server owns the simulation:
+/// it moves and collides the particles at a fixed rate, and streams snapshots of their motion to the clients, which
+/// extrapolate between them.
 class ParticleServer : public OctreeServer, public NewlyCreatedParticleHook {
+    Q_OBJECT
 public:                
     ParticleServer(const unsigned char* dataBuffer, int numBytes);
     ~ParticleServer();
@@ -33,10 +41,29 @@ public:
     
     // subclass may implement these method
     virtual void beforeRun();
+    virtual QString getSpecialStats();
+    virtual void resetSpecialStats();
+    virtual void sendStreamPackets(Node* node, OctreeQueryNode* nodeData, int& bytesSent, int& packetsSent);
 
     virtual void particleCreated(const Particle& newParticle, Node* senderNode);
 
+private slots:
+    void simulate();
+
 private:
+    ParticleCollisionSystem _collisionSystem;
+    
+    uint64_t _lastSnapshotUsecs;
+    
+    // the latest snapshot, which the send threads read
+    QMutex _snapshotMutex;
+    std::vector<QByteArray> _snapshotPackets;
+    uint64_t _snapshotSequence;
+    
+    uint64_t _numSimulationTicks;
+    uint64_t _totalSimulationUsecs;
+    uint64_t _maxSimulationUsecs;
+    uint64_t _numSnapshotPacketsSent;
 };
 
 #endif // __particle_server__ParticleServer__
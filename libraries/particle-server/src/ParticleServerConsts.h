@@ -13,4 +13,8 @@ extern const char* PARTICLE_SERVER_NAME;
 extern const char* PARTICLE_SERVER_LOGGING_TARGET_NAME;
 extern const char* LOCAL_PARTICLES_PERSIST_FILE;
 
+// the server simulates the particles this often, and sends clients where they are this often to extrapolate from
+const int PARTICLE_SIMULATION_INTERVAL_USECS = 1000 * 1000 / 30;
+const int PARTICLE_SNAPSHOT_INTERVAL_USECS = 100 * 1000;
+
 #endif // __particle_server__ParticleServerConsts__
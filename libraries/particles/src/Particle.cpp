@@ -14,6 +14,7 @@
 #include <SharedUtil.h> // usecTimestampNow()
 
 #include "Particle.h"
+#include "ParticleScriptEngine.h"
 
 uint32_t Particle::_nextID = 0;
 
@@ -354,8 +355,7 @@ bool Particle::encodeParticleEditMessageDetails(PACKET_TYPE command, int count,
 }
 
 
-void Particle::update() {
-    uint64_t now = usecTimestampNow();
+void Particle::update(uint64_t now) {
     uint64_t elapsed = now - _lastUpdated;
     uint64_t USECS_PER_SECOND = 1000 * 1000;
     float timeElapsed = (float)((float)elapsed/(float)USECS_PER_SECOND);
@@ -388,25 +388,7 @@ void Particle::update() {
 
 void Particle::runScript() {
     if (!_updateScript.isEmpty()) {
-        QScriptEngine engine;
-    
-        // register meta-type for glm::vec3 and rgbColor conversions
-        registerMetaTypes(&engine);
-    
-        ParticleScriptObject particleScriptable(this);
-        QScriptValue particleValue = engine.newQObject(&particleScriptable);
-        engine.globalObject().setProperty("Particle", particleValue);
-        
-        QScriptValue treeScaleValue = engine.newVariant(QVariant(TREE_SCALE));
-        engine.globalObject().setProperty("TREE_SCALE", TREE_SCALE);
-    
-        //qDebug() << "Downloaded script:" << _updateScript << "\n";
-        QScriptValue result = engine.evaluate(_updateScript);
-        //qDebug() << "Evaluated script.\n";
-    
-        if (engine.hasUncaughtException()) {
-            int line = engine.uncaughtExceptionLineNumber();
-            qDebug() << "Uncaught exception at line" << line << ":" << result.toString() << "\n";
-        }
+        // the engine and the compiled script are shared with every other scripted particle this thread updates
+        ParticleScriptEngine::getInstance()->runScript(this);
     }
 }
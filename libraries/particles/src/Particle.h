@@ -41,6 +41,7 @@ const glm::vec3 DEFAULT_GRAVITY(0, (-9.8f / TREE_SCALE), 0);
 const QString DEFAULT_SCRIPT("");
 
 class Particle  {
+    friend class ParticleStore; // to copy particles in and out of its arrays whole
     
 public:
     Particle();
@@ -91,7 +92,8 @@ public:
     static bool encodeParticleEditMessageDetails(PACKET_TYPE command, int count, const ParticleDetail* details, 
                         unsigned char* bufferOut, int sizeIn, int& sizeOut);
 
-    void update();
+    /// advances the particle to now, running its script first if it has one
+    void update(uint64_t now);
 
     void debugDump() const;
 protected:
@@ -120,7 +122,10 @@ protected:
 class ParticleScriptObject  : public QObject {
     Q_OBJECT
 public:
-    ParticleScriptObject(Particle* particle) { _particle = particle; }
+    ParticleScriptObject(Particle* particle = NULL) { _particle = particle; }
+    
+    /// rebinds the object, so one can be reused for each particle whose script is run
+    void setParticle(Particle* particle) { _particle = particle; }
 
 public slots:
     glm::vec3 getPosition() const { return _particle->getPosition(); }
@@ -7,17 +7,28 @@
 //
 //
 
+#include <algorithm>
+#include <math.h>
+
 #include <AbstractAudioInterface.h>
+#include <GeometryUtil.h>
 #include <VoxelTree.h>
 
 #include "Particle.h"
 #include "ParticleCollisionSystem.h"
-#include "ParticleEditHandle.h"
 #include "ParticleEditPacketSender.h"
 #include "ParticleTree.h"
 
 ParticleCollisionSystem::ParticleCollisionSystem(ParticleEditPacketSender* packetSender, 
-    ParticleTree* particles, VoxelTree* voxels, AbstractAudioInterface* audio) {
+    ParticleTree* particles, VoxelTree* voxels, AbstractAudioInterface* audio) :
+    _cellSize(MIN_COLLISION_CELL_SIZE),
+    _maxRadius(0.0f),
+    _numParticlesChecked(0),
+    _collisionsSinceStats(0),
+    _lastStatsUsecs(usecTimestampNow()),
+    _collisionsPerSecond(0.0f),
+    _lastUpdateUsecs(0)
+{
     init(packetSender, particles, voxels, audio);
 }
 
@@ -32,62 +43,196 @@ void ParticleCollisionSystem::init(ParticleEditPacketSender* packetSender,
 ParticleCollisionSystem::~ParticleCollisionSystem() {
 }
 
-bool ParticleCollisionSystem::updateOperation(OctreeElement* element, void* extraData) {
-    ParticleCollisionSystem* system = static_cast<ParticleCollisionSystem*>(extraData);
-    ParticleTreeElement* particleTreeElement = static_cast<ParticleTreeElement*>(element);
-
-    // iterate the particles...
-    std::vector<Particle>& particles = particleTreeElement->getParticles();
-    uint16_t numberOfParticles = particles.size();
-    for (uint16_t i = 0; i < numberOfParticles; i++) {
-        Particle* particle = &particles[i];
-        system->checkParticle(particle);
+void ParticleCollisionSystem::update() {
+    uint64_t startUsecs = usecTimestampNow();
+    
+    // update all particles
+    _particles->lockForWrite();
+    
+    buildGrid();
+    findParticleCollisions();
+    if (_voxels) {
+        findVoxelCollisions();
+    }
+    resolveCollisions();
+    
+    _particles->unlock();
+    
+    uint64_t endUsecs = usecTimestampNow();
+    _lastUpdateUsecs = endUsecs - startUsecs;
+    
+    const uint64_t USECS_PER_STATS_PERIOD = 1000 * 1000;
+    if (endUsecs - _lastStatsUsecs >= USECS_PER_STATS_PERIOD) {
+        _collisionsPerSecond = _collisionsSinceStats * (float)USECS_PER_STATS_PERIOD / (endUsecs - _lastStatsUsecs);
+        _collisionsSinceStats = 0;
+        _lastStatsUsecs = endUsecs;
     }
+}
 
-    return true;
+quint64 ParticleCollisionSystem::cellKeyFor(const glm::vec3& position) const {
+    // 21 bits per axis, offset so that particles a little outside the tree still get cells of their own
+    const int CELL_COORDINATE_OFFSET = 1 << 20;
+    const quint64 CELL_COORDINATE_MASK = (1 << 21) - 1;
+    quint64 x = (quint64)((int)floorf(position.x / _cellSize) + CELL_COORDINATE_OFFSET) & CELL_COORDINATE_MASK;
+    quint64 y = (quint64)((int)floorf(position.y / _cellSize) + CELL_COORDINATE_OFFSET) & CELL_COORDINATE_MASK;
+    quint64 z = (quint64)((int)floorf(position.z / _cellSize) + CELL_COORDINATE_OFFSET) & CELL_COORDINATE_MASK;
+    return (x << 42) | (y << 21) | z;
 }
 
+void ParticleCollisionSystem::buildGrid() {
+    const ParticleStore& store = _particles->getStore();
+    int numSlots = store.getNumSlots();
+    
+    _maxRadius = 0.0f;
+    for (int i = 0; i < numSlots; i++) {
+        if (store.isUsed(i)) {
+            _maxRadius = std::max(_maxRadius, store.getRadius(i));
+        }
+    }
+    
+    // two particles can only touch if their centers are within two of the largest radii of each other
+    _cellSize = std::max(2.0f * _maxRadius, MIN_COLLISION_CELL_SIZE);
+    
+    _cellHeads.clear();
+    _nextInCell.assign(numSlots, -1);
+    _particlePenetrations.assign(numSlots, glm::vec3(0.0f, 0.0f, 0.0f));
+    _voxelPenetrations.assign(numSlots, glm::vec3(0.0f, 0.0f, 0.0f));
+    _hitParticle.assign(numSlots, false);
+    _hitVoxel.assign(numSlots, false);
+    _numParticlesChecked = 0;
+    
+    for (int i = 0; i < numSlots; i++) {
+        if (store.isUsed(i)) {
+            quint64 cellKey = cellKeyFor(store.getPosition(i));
+            _nextInCell[i] = _cellHeads.value(cellKey, -1);
+            _cellHeads.insert(cellKey, i);
+            _numParticlesChecked++;
+        }
+    }
+}
 
-void ParticleCollisionSystem::update() {
-    // update all particles
-    _particles->lockForWrite();
-    _particles->recurseTreeWithOperation(updateOperation, this);
-    _particles->unlock();
+void ParticleCollisionSystem::findParticleCollisions() {
+    const ParticleStore& store = _particles->getStore();
+    int numSlots = store.getNumSlots();
+    
+    for (int i = 0; i < numSlots; i++) {
+        if (!store.isUsed(i)) {
+            continue;
+        }
+        glm::vec3 center = store.getPosition(i);
+        float radius = store.getRadius(i);
+        
+        for (int x = -1; x <= 1; x++) {
+            for (int y = -1; y <= 1; y++) {
+                for (int z = -1; z <= 1; z++) {
+                    quint64 cellKey = cellKeyFor(center + glm::vec3(x, y, z) * _cellSize);
+                    
+                    // each pair is tested once, from the particle with the lower index
+                    for (int j = _cellHeads.value(cellKey, -1); j != -1; j = _nextInCell[j]) {
+                        glm::vec3 penetration;
+                        if (j > i && findSphereSpherePenetration(center, radius, store.getPosition(j), store.getRadius(j),
+                                                                 penetration)) {
+                            _particlePenetrations[i] = addPenetrations(_particlePenetrations[i], penetration);
+                            _particlePenetrations[j] = addPenetrations(_particlePenetrations[j], -penetration);
+                            _hitParticle[i] = true;
+                            _hitParticle[j] = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
 }
 
+class CellVoxelsArgs {
+public:
+    glm::vec3 cellCenter;
+    float expansion;
+    std::vector<OctreeElement*>* voxels;
+};
 
-void ParticleCollisionSystem::checkParticle(Particle* particle) {
-    updateCollisionWithVoxels(particle);
-    updateCollisionWithParticles(particle);
+bool ParticleCollisionSystem::findCellVoxelsOperation(OctreeElement* element, void* extraData) {
+    CellVoxelsArgs* args = static_cast<CellVoxelsArgs*>(extraData);
+    
+    // coarse check against bounds
+    if (!element->getAABox().expandedContains(args->cellCenter, args->expansion)) {
+        return false;
+    }
+    if (!element->isLeaf()) {
+        return true; // recurse on children
+    }
+    if (element->hasContent()) {
+        args->voxels->push_back(element);
+    }
+    return false;
 }
 
-void ParticleCollisionSystem::updateCollisionWithVoxels(Particle* particle) {
-    glm::vec3 center = particle->getPosition() * (float)TREE_SCALE;
-    float radius = particle->getRadius() * (float)TREE_SCALE;
-    const float VOXEL_ELASTICITY = 1.4f;
-    const float VOXEL_DAMPING = 0.0;
-    const float VOXEL_COLLISION_FREQUENCY = 0.5f;
-    glm::vec3 penetration;
-    OctreeElement* penetratedVoxel;
-    if (_voxels->findSpherePenetration(center, radius, penetration, &penetratedVoxel)) {
-        penetration /= (float)TREE_SCALE;
-        updateCollisionSound(particle, penetration, VOXEL_COLLISION_FREQUENCY);
-        applyHardCollision(particle, penetration, VOXEL_ELASTICITY, VOXEL_DAMPING);
+void ParticleCollisionSystem::findVoxelCollisions() {
+    const ParticleStore& store = _particles->getStore();
+    
+    // one search of the voxel tree per occupied cell, for every voxel that any particle in the cell could touch
+    for (QHash<quint64, int>::const_iterator cell = _cellHeads.constBegin(); cell != _cellHeads.constEnd(); ++cell) {
+        glm::vec3 anyCenter = store.getPosition(cell.value());
+        glm::vec3 cellCorner = glm::floor(anyCenter / _cellSize) * _cellSize;
+        CellVoxelsArgs args = { cellCorner + glm::vec3(0.5f, 0.5f, 0.5f) * _cellSize, 0.5f * _cellSize + _maxRadius,
+                                &_cellVoxels };
+        _cellVoxels.clear();
+        _voxels->recurseTreeWithOperation(findCellVoxelsOperation, &args);
+        
+        for (int i = cell.value(); i != -1; i = _nextInCell[i]) {
+            glm::vec3 center = store.getPosition(i);
+            float radius = store.getRadius(i);
+            
+            for (int v = 0; v < _cellVoxels.size(); v++) {
+                glm::vec3 penetration;
+                if (_cellVoxels[v]->getAABox().expandedContains(center, radius) &&
+                        _cellVoxels[v]->findSpherePenetration(center, radius, penetration)) {
+                    _voxelPenetrations[i] = addPenetrations(_voxelPenetrations[i], penetration);
+                    _hitVoxel[i] = true;
+                }
+            }
+        }
     }
 }
 
-void ParticleCollisionSystem::updateCollisionWithParticles(Particle* particle) {
-    glm::vec3 center = particle->getPosition() * (float)TREE_SCALE;
-    float radius = particle->getRadius() * (float)TREE_SCALE;
+void ParticleCollisionSystem::resolveCollisions() {
     const float VOXEL_ELASTICITY = 1.4f;
     const float VOXEL_DAMPING = 0.0;
     const float VOXEL_COLLISION_FREQUENCY = 0.5f;
-    glm::vec3 penetration;
-    OctreeElement* penetratedElement;
-    if (_particles->findSpherePenetration(center, radius, penetration, &penetratedElement)) {
-        penetration /= (float)TREE_SCALE;
-        updateCollisionSound(particle, penetration, VOXEL_COLLISION_FREQUENCY);
-        applyHardCollision(particle, penetration, VOXEL_ELASTICITY, VOXEL_DAMPING);
+    
+    ParticleStore& store = _particles->getStore();
+    int numSlots = store.getNumSlots();
+    
+    _edits.clear();
+    for (int i = 0; i < numSlots; i++) {
+        if (!_hitVoxel[i] && !_hitParticle[i]) {
+            continue;
+        }
+        Particle particle = store.get(i);
+        if (_hitVoxel[i]) {
+            updateCollisionSound(&particle, _voxelPenetrations[i], VOXEL_COLLISION_FREQUENCY);
+            applyHardCollision(&particle, _voxelPenetrations[i], VOXEL_ELASTICITY, VOXEL_DAMPING);
+            _collisionsSinceStats++;
+        }
+        if (_hitParticle[i]) {
+            updateCollisionSound(&particle, _particlePenetrations[i], VOXEL_COLLISION_FREQUENCY);
+            applyHardCollision(&particle, _particlePenetrations[i], VOXEL_ELASTICITY, VOXEL_DAMPING);
+            _collisionsSinceStats++;
+        }
+        
+        xColor color = particle.getColor();
+        ParticleDetail edit = { particle.getID(), usecTimestampNow(), particle.getPosition(), particle.getRadius(),
+            { color.red, color.green, color.blue }, particle.getVelocity(), particle.getGravity(), particle.getDamping(), particle.getUpdateScript(),
+            UNKNOWN_TOKEN };
+        _edits.push_back(edit);
+        
+        // our own tree has the new state right away, as it would from a ParticleEditHandle
+        store.set(i, particle);
+    }
+    
+    if (_edits.size() > 0 && _packetSender) {
+        _packetSender->queueParticleEditMessages(PACKET_TYPE_PARTICLE_ADD_OR_EDIT, _edits.size(), &_edits[0]);
+        _packetSender->releaseQueuedMessages();
     }
 }
 
@@ -118,13 +263,16 @@ void ParticleCollisionSystem::applyHardCollision(Particle* particle, const glm::
             velocity *= 0.f;
         }
     }
-    ParticleEditHandle particleEditHandle(_packetSender, _particles, particle->getID());
-    particleEditHandle.updateParticle(position, particle->getRadius(), particle->getColor(), velocity, 
-                           particle->getGravity(), particle->getDamping(), particle->getUpdateScript());
+    particle->setPosition(position);
+    particle->setVelocity(velocity);
 }
 
 
 void ParticleCollisionSystem::updateCollisionSound(Particle* particle, const glm::vec3 &penetration, float frequency) {
+    // servers simulate without making any noise
+    if (!_audio) {
+        return;
+    }
                                 
     //  consider whether to have the collision make a sound
     const float AUDIBLE_COLLISION_THRESHOLD = 0.02f;
@@ -12,7 +12,9 @@
 
 #include <glm/glm.hpp>
 #include <stdint.h>
+#include <vector>
 
+#include <QtCore/QHash>
 #include <QtScript/QScriptEngine>
 #include <QtCore/QObject>
 
@@ -22,10 +24,19 @@
 #include "Particle.h"
 
 class AbstractAudioInterface;
+class OctreeElement;
 class ParticleEditPacketSender;
 class ParticleTree;
 class VoxelTree;
 
+// the grid cells are never smaller than this, in tree units, so a crowd of tiny particles doesn't spread over countless cells
+const float MIN_COLLISION_CELL_SIZE = 0.0001f;
+
+/// Finds and resolves the collisions of the particles in a ParticleTree with each other and with the voxels in a VoxelTree.
+/// Each update() bins the particles into a uniform grid whose cells are as wide as the largest particle, so that any two
+/// particles that touch are in the same or neighboring cells, and looks up the voxels near each occupied cell once for
+/// all the particles in it. The colliding particles are then resolved together and their new states sent as one batch
+/// of edit messages.
 class ParticleCollisionSystem {
 public:
     ParticleCollisionSystem(ParticleEditPacketSender* packetSender = NULL, ParticleTree* particles = NULL, 
@@ -38,20 +49,47 @@ public:
     ~ParticleCollisionSystem();
 
     void update();
-    void checkParticle(Particle* particle);
-    void updateCollisionWithVoxels(Particle* particle);
-    void updateCollisionWithParticles(Particle* particle);
     void applyHardCollision(Particle* particle, const glm::vec3& penetration, float elasticity, float damping);
     void updateCollisionSound(Particle* particle, const glm::vec3 &penetration, float frequency);
+    
+    int getNumParticlesChecked() const { return _numParticlesChecked; }
+    float getCollisionsPerSecond() const { return _collisionsPerSecond; }
+    uint64_t getLastUpdateUsecs() const { return _lastUpdateUsecs; }
 
 private:
-    static bool updateOperation(OctreeElement* element, void* extraData);
-
+    void buildGrid();
+    void findParticleCollisions();
+    void findVoxelCollisions();
+    void resolveCollisions();
+    
+    quint64 cellKeyFor(const glm::vec3& position) const;
+    
+    static bool findCellVoxelsOperation(OctreeElement* element, void* extraData);
 
     ParticleEditPacketSender* _packetSender;
     ParticleTree* _particles;
     VoxelTree* _voxels;
     AbstractAudioInterface* _audio;
+    
+    // the broad phase, rebuilt each update and kept between them only to reuse its memory
+    float _cellSize;
+    float _maxRadius;
+    QHash<quint64, int> _cellHeads; // the first particle in each occupied cell
+    std::vector<int> _nextInCell; // by store index, the next particle in the same cell or -1
+    std::vector<OctreeElement*> _cellVoxels;
+    
+    // the narrow phase results, by store index
+    std::vector<glm::vec3> _particlePenetrations;
+    std::vector<glm::vec3> _voxelPenetrations;
+    std::vector<bool> _hitParticle;
+    std::vector<bool> _hitVoxel;
+    std::vector<ParticleDetail> _edits;
+    
+    int _numParticlesChecked;
+    int _collisionsSinceStats;
+    uint64_t _lastStatsUsecs;
+    float _collisionsPerSecond;
+    uint64_t _lastUpdateUsecs;
 };
 
 #endif /* defined(__hifi__ParticleCollisionSystem__) */
\ No newline at end of file
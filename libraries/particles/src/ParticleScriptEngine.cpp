@@ -0,0 +1,206 @@
+//
+//  ParticleScriptEngine.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <algorithm>
+
+#include <QtCore/QDebug>
+#include <QtCore/QThreadStorage>
+
+#include <RegisteredMetaTypes.h>
+#include <SharedUtil.h> // usecTimestampNow()
+
+#include "ParticleScriptEngine.h"
+
+QMutex ParticleScriptEngine::_enginesMutex;
+std::vector<ParticleScriptEngine*> ParticleScriptEngine::_engines;
+
+// deletes each thread's engine when the thread exits
+static QThreadStorage<ParticleScriptEngine*> threadEngines;
+
+ParticleScriptEngine* ParticleScriptEngine::getInstance() {
+    if (!threadEngines.hasLocalData()) {
+        threadEngines.setLocalData(new ParticleScriptEngine());
+    }
+    return threadEngines.localData();
+}
+
+ParticleScriptEngine::ParticleScriptEngine() :
+    _engine(),
+    _particleScriptable(),
+    _cachedScripts(),
+    _statsMutex(),
+    _numHits(0),
+    _numCompiles(0),
+    _numEvictions(0)
+{
+    // register meta-type for glm::vec3 and rgbColor conversions
+    registerMetaTypes(&_engine);
+    
+    _engine.globalObject().setProperty("Particle", _engine.newQObject(&_particleScriptable));
+    _engine.globalObject().setProperty("TREE_SCALE", TREE_SCALE);
+    
+    QMutexLocker locker(&_enginesMutex);
+    _engines.push_back(this);
+}
+
+ParticleScriptEngine::~ParticleScriptEngine() {
+    _enginesMutex.lock();
+    _engines.erase(std::find(_engines.begin(), _engines.end(), this));
+    _enginesMutex.unlock();
+    
+    for (QHash<QString, CachedScript*>::iterator script = _cachedScripts.begin(); script != _cachedScripts.end(); ++script) {
+        delete script.value();
+    }
+}
+
+void ParticleScriptEngine::runScript(Particle* particle) {
+    QString updateScript = particle->getUpdateScript();
+    
+    CachedScript* cachedScript = _cachedScripts.value(updateScript);
+    if (cachedScript) {
+        QMutexLocker locker(&_statsMutex);
+        _numHits++;
+    } else {
+        cachedScript = compileScript(updateScript);
+    }
+    
+    _particleScriptable.setParticle(particle);
+    
+    uint64_t startUsecs = usecTimestampNow();
+    
+    // a context of its own, so the script's variables start out undefined each time as they would in a new engine
+    _engine.pushContext();
+    QScriptValue result = _engine.evaluate(cachedScript->program);
+    _engine.popContext();
+    
+    uint64_t endUsecs = usecTimestampNow();
+    
+    _particleScriptable.setParticle(NULL);
+    
+    bool hadException = _engine.hasUncaughtException();
+    if (hadException) {
+        int line = _engine.uncaughtExceptionLineNumber();
+        qDebug() << "Uncaught exception at line" << line << ":" << result.toString() << "\n";
+        _engine.clearExceptions();
+    }
+    
+    uint64_t elapsedUsecs = endUsecs - startUsecs;
+    cachedScript->lastRunUsecs = endUsecs;
+    
+    QMutexLocker locker(&_statsMutex);
+    ParticleScriptStats& stats = cachedScript->stats;
+    stats.numRuns++;
+    stats.totalUsecs += elapsedUsecs;
+    stats.maxUsecs = std::max(stats.maxUsecs, elapsedUsecs);
+    if (hadException) {
+        stats.numExceptions++;
+    }
+}
+
+ParticleScriptEngine::CachedScript* ParticleScriptEngine::compileScript(const QString& script) {
+    if (_cachedScripts.size() >= MAX_CACHED_PARTICLE_SCRIPTS) {
+        evictLeastRecentlyRunScript();
+    }
+    
+    CachedScript* cachedScript = new CachedScript();
+    cachedScript->program = QScriptProgram(script);
+    cachedScript->lastRunUsecs = 0;
+    cachedScript->stats.script = script;
+    cachedScript->stats.numRuns = 0;
+    cachedScript->stats.numExceptions = 0;
+    cachedScript->stats.totalUsecs = 0;
+    cachedScript->stats.maxUsecs = 0;
+    
+    QMutexLocker locker(&_statsMutex);
+    _cachedScripts.insert(script, cachedScript);
+    _numCompiles++;
+    
+    return cachedScript;
+}
+
+void ParticleScriptEngine::evictLeastRecentlyRunScript() {
+    QHash<QString, CachedScript*>::iterator leastRecentlyRun = _cachedScripts.begin();
+    
+    for (QHash<QString, CachedScript*>::iterator script = _cachedScripts.begin(); script != _cachedScripts.end(); ++script) {
+        if (script.value()->lastRunUsecs < leastRecentlyRun.value()->lastRunUsecs) {
+            leastRecentlyRun = script;
+        }
+    }
+    
+    QMutexLocker locker(&_statsMutex);
+    delete leastRecentlyRun.value();
+    _cachedScripts.erase(leastRecentlyRun);
+    _numEvictions++;
+}
+
+ParticleScriptCacheStats ParticleScriptEngine::getCacheStats() {
+    ParticleScriptCacheStats cacheStats = { 0, 0, 0, 0, 0 };
+    
+    QMutexLocker enginesLocker(&_enginesMutex);
+    for (int i = 0; i < _engines.size(); i++) {
+        QMutexLocker statsLocker(&_engines[i]->_statsMutex);
+        
+        cacheStats.numEngines++;
+        cacheStats.numCachedScripts += _engines[i]->_cachedScripts.size();
+        cacheStats.numHits += _engines[i]->_numHits;
+        cacheStats.numCompiles += _engines[i]->_numCompiles;
+        cacheStats.numEvictions += _engines[i]->_numEvictions;
+    }
+    
+    return cacheStats;
+}
+
+void ParticleScriptEngine::getScriptStats(std::vector<ParticleScriptStats>& scriptStats) {
+    QHash<QString, ParticleScriptStats> statsByScript;
+    
+    QMutexLocker enginesLocker(&_enginesMutex);
+    for (int i = 0; i < _engines.size(); i++) {
+        QMutexLocker statsLocker(&_engines[i]->_statsMutex);
+        
+        const QHash<QString, CachedScript*>& cachedScripts = _engines[i]->_cachedScripts;
+        for (QHash<QString, CachedScript*>::const_iterator script = cachedScripts.constBegin();
+             script != cachedScripts.constEnd(); ++script) {
+            
+            const ParticleScriptStats& stats = script.value()->stats;
+            
+            if (!statsByScript.contains(script.key())) {
+                statsByScript.insert(script.key(), stats);
+            } else {
+                ParticleScriptStats& totalStats = statsByScript[script.key()];
+                totalStats.numRuns += stats.numRuns;
+                totalStats.numExceptions += stats.numExceptions;
+                totalStats.totalUsecs += stats.totalUsecs;
+                totalStats.maxUsecs = std::max(totalStats.maxUsecs, stats.maxUsecs);
+            }
+        }
+    }
+    
+    for (QHash<QString, ParticleScriptStats>::const_iterator stats = statsByScript.constBegin();
+         stats != statsByScript.constEnd(); ++stats) {
+        scriptStats.push_back(stats.value());
+    }
+}
+
+void ParticleScriptEngine::resetStats() {
+    QMutexLocker enginesLocker(&_enginesMutex);
+    for (int i = 0; i < _engines.size(); i++) {
+        QMutexLocker statsLocker(&_engines[i]->_statsMutex);
+        
+        _engines[i]->_numHits = 0;
+        _engines[i]->_numCompiles = 0;
+        _engines[i]->_numEvictions = 0;
+        
+        QHash<QString, CachedScript*>& cachedScripts = _engines[i]->_cachedScripts;
+        for (QHash<QString, CachedScript*>::iterator script = cachedScripts.begin(); script != cachedScripts.end(); ++script) {
+            ParticleScriptStats& stats = script.value()->stats;
+            stats.numRuns = 0;
+            stats.numExceptions = 0;
+            stats.totalUsecs = 0;
+            stats.maxUsecs = 0;
+        }
+    }
+}
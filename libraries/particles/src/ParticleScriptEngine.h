@@ -0,0 +1,93 @@
+//
+//  ParticleScriptEngine.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__ParticleScriptEngine__
+#define __hifi__ParticleScriptEngine__
+
+#include <stdint.h>
+#include <vector>
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtScript/QScriptEngine>
+#include <QtScript/QScriptProgram>
+
+#include "Particle.h"
+
+// once this many different scripts are compiled, the one that ran least recently is dropped to make room
+const int MAX_CACHED_PARTICLE_SCRIPTS = 256;
+
+/// How often and how long one update script has run, across all the threads that ran it
+class ParticleScriptStats {
+public:
+    QString script;
+    uint numRuns;
+    uint numExceptions;
+    uint64_t totalUsecs;
+    uint64_t maxUsecs;
+};
+
+/// How well the compiled scripts are being reused, across all the threads that run them
+class ParticleScriptCacheStats {
+public:
+    int numEngines;
+    int numCachedScripts;
+    uint64_t numHits;
+    uint64_t numCompiles;
+    uint64_t numEvictions;
+};
+
+/// Runs particle update scripts. Each thread that updates particles gets one engine, created the first time it runs a
+/// script and kept until the thread exits, and each engine compiles a script the first time it sees its text and keeps
+/// the compiled program for the particles that share it. The particle being updated is bound to the "Particle" global
+/// for the duration of its script, which runs in a context of its own so its variables don't outlive it.
+class ParticleScriptEngine {
+public:
+    /// the engine belonging to the calling thread
+    static ParticleScriptEngine* getInstance();
+    
+    ~ParticleScriptEngine();
+    
+    /// runs the particle's update script, which may alter its state
+    void runScript(Particle* particle);
+    
+    /// the stats of every thread's engine, added up per script - safe to call from any thread
+    static ParticleScriptCacheStats getCacheStats();
+    static void getScriptStats(std::vector<ParticleScriptStats>& scriptStats);
+    static void resetStats();
+
+private:
+    ParticleScriptEngine();
+    ParticleScriptEngine(const ParticleScriptEngine&);
+    ParticleScriptEngine& operator=(const ParticleScriptEngine&);
+    
+    class CachedScript {
+    public:
+        QScriptProgram program;
+        uint64_t lastRunUsecs;
+        ParticleScriptStats stats;
+    };
+    
+    CachedScript* compileScript(const QString& script);
+    void evictLeastRecentlyRunScript();
+    
+    QScriptEngine _engine;
+    ParticleScriptObject _particleScriptable;
+    
+    QHash<QString, CachedScript*> _cachedScripts;
+    
+    // the stats are read by whoever shows them, the rest of the engine only by its own thread
+    mutable QMutex _statsMutex;
+    uint64_t _numHits;
+    uint64_t _numCompiles;
+    uint64_t _numEvictions;
+    
+    static QMutex _enginesMutex;
+    static std::vector<ParticleScriptEngine*> _engines;
+};
+
+#endif /* defined(__hifi__ParticleScriptEngine__) */
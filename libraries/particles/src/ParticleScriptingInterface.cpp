@@ -9,15 +9,32 @@
 #include "ParticleScriptingInterface.h"
 
 ParticleScriptingInterface::ParticleScriptingInterface() :
-    _jurisdictionListener(NODE_TYPE_PARTICLE_SERVER),
+    _particlePacketSender(new ParticleEditPacketSender()),
+    _jurisdictionListener(new JurisdictionListener(NODE_TYPE_PARTICLE_SERVER)),
+    _ownsPacketSender(true),
     _nextCreatorTokenID(0)
 {
-    _jurisdictionListener.initialize(true);
-    _particlePacketSender.setServerJurisdictions(_jurisdictionListener.getJurisdictions());
+    _jurisdictionListener->initialize(true);
+    _particlePacketSender->setServerJurisdictions(_jurisdictionListener->getJurisdictions());
+}
+
+ParticleScriptingInterface::ParticleScriptingInterface(ParticleEditPacketSender* sharedPacketSender) :
+    _particlePacketSender(sharedPacketSender),
+    _jurisdictionListener(NULL),
+    _ownsPacketSender(false),
+    _nextCreatorTokenID(0)
+{
+}
+
+ParticleScriptingInterface::~ParticleScriptingInterface() {
+    if (_ownsPacketSender) {
+        delete _jurisdictionListener;
+        delete _particlePacketSender;
+    }
 }
 
 void ParticleScriptingInterface::queueParticleAdd(PACKET_TYPE addPacketType, ParticleDetail& addParticleDetails) {
-    _particlePacketSender.queueParticleEditMessages(addPacketType, 1, &addParticleDetails);
+    _particlePacketSender->queueParticleEditMessages(addPacketType, 1, &addParticleDetails);
 }
 
 uint32_t ParticleScriptingInterface::queueParticleAdd(glm::vec3 position, float radius, 
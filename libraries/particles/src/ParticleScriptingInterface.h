@@ -18,71 +18,93 @@
 class ParticleScriptingInterface : public QObject {
     Q_OBJECT
 public:
+    /// sends with a packet sender and jurisdiction listener of its own
     ParticleScriptingInterface();
     
-    ParticleEditPacketSender* getParticlePacketSender() { return &_particlePacketSender; }
-    JurisdictionListener* getJurisdictionListener() { return &_jurisdictionListener; }
+    /// queues edits with a packet sender shared by several scripts, whose owner keeps its jurisdictions and processes it
+    ParticleScriptingInterface(ParticleEditPacketSender* sharedPacketSender);
+    
+    ~ParticleScriptingInterface();
+    
+    ParticleEditPacketSender* getParticlePacketSender() { return _particlePacketSender; }
+    
+    /// NULL if the packet sender is shared
+    JurisdictionListener* getJurisdictionListener() { return _jurisdictionListener; }
 public slots:
     /// queues the creation of a Particle which will be sent by calling process on the PacketSender
     /// returns the creatorTokenID for the newly created particle
     uint32_t queueParticleAdd(glm::vec3 position, float radius, 
             xColor color, glm::vec3 velocity, glm::vec3 gravity, float damping, QString updateScript);
     
-    /// Set the desired max packet size in bytes that should be created
-    void setMaxPacketSize(int maxPacketSize) { return _particlePacketSender.setMaxPacketSize(maxPacketSize); }
+    /// Set the desired max packet size in bytes that should be created - ignored when the packet sender is shared with
+    /// the other scripts hosted by this worker, so one script can't change the limits of the rest
+    void setMaxPacketSize(int maxPacketSize) {
+        if (_ownsPacketSender) {
+            _particlePacketSender->setMaxPacketSize(maxPacketSize);
+        }
+    }
 
     /// returns the current desired max packet size in bytes that will be created
-    int getMaxPacketSize() const { return _particlePacketSender.getMaxPacketSize(); }
+    int getMaxPacketSize() const { return _particlePacketSender->getMaxPacketSize(); }
 
-    /// set the max packets per second send rate
-    void setPacketsPerSecond(int packetsPerSecond) { return _particlePacketSender.setPacketsPerSecond(packetsPerSecond); }
+    /// set the max packets per second send rate - ignored when the packet sender is shared with the other scripts
+    /// hosted by this worker
+    void setPacketsPerSecond(int packetsPerSecond) {
+        if (_ownsPacketSender) {
+            _particlePacketSender->setPacketsPerSecond(packetsPerSecond);
+        }
+    }
 
     /// get the max packets per second send rate
-    int getPacketsPerSecond() const  { return _particlePacketSender.getPacketsPerSecond(); }
+    int getPacketsPerSecond() const  { return _particlePacketSender->getPacketsPerSecond(); }
 
     /// does a particle server exist to send to
-    bool serversExist() const { return _particlePacketSender.serversExist(); }
+    bool serversExist() const { return _particlePacketSender->serversExist(); }
 
     /// are there packets waiting in the send queue to be sent
-    bool hasPacketsToSend() const { return _particlePacketSender.hasPacketsToSend(); }
+    bool hasPacketsToSend() const { return _particlePacketSender->hasPacketsToSend(); }
 
     /// how many packets are there in the send queue waiting to be sent
-    int packetsToSendCount() const { return _particlePacketSender.packetsToSendCount(); }
+    int packetsToSendCount() const { return _particlePacketSender->packetsToSendCount(); }
 
     /// returns the packets per second send rate of this object over its lifetime
-    float getLifetimePPS() const { return _particlePacketSender.getLifetimePPS(); }
+    float getLifetimePPS() const { return _particlePacketSender->getLifetimePPS(); }
 
     /// returns the bytes per second send rate of this object over its lifetime
-    float getLifetimeBPS() const { return _particlePacketSender.getLifetimeBPS(); }
+    float getLifetimeBPS() const { return _particlePacketSender->getLifetimeBPS(); }
     
     /// returns the packets per second queued rate of this object over its lifetime
-    float getLifetimePPSQueued() const  { return _particlePacketSender.getLifetimePPSQueued(); }
+    float getLifetimePPSQueued() const  { return _particlePacketSender->getLifetimePPSQueued(); }
 
     /// returns the bytes per second queued rate of this object over its lifetime
-    float getLifetimeBPSQueued() const { return _particlePacketSender.getLifetimeBPSQueued(); }
+    float getLifetimeBPSQueued() const { return _particlePacketSender->getLifetimeBPSQueued(); }
 
     /// returns lifetime of this object from first packet sent to now in usecs
-    long long unsigned int getLifetimeInUsecs() const { return _particlePacketSender.getLifetimeInUsecs(); }
+    long long unsigned int getLifetimeInUsecs() const { return _particlePacketSender->getLifetimeInUsecs(); }
 
     /// returns lifetime of this object from first packet sent to now in usecs
-    float getLifetimeInSeconds() const { return _particlePacketSender.getLifetimeInSeconds(); }
+    float getLifetimeInSeconds() const { return _particlePacketSender->getLifetimeInSeconds(); }
 
     /// returns the total packets sent by this object over its lifetime
-    long long unsigned int getLifetimePacketsSent() const { return _particlePacketSender.getLifetimePacketsSent(); }
+    long long unsigned int getLifetimePacketsSent() const { return _particlePacketSender->getLifetimePacketsSent(); }
 
     /// returns the total bytes sent by this object over its lifetime
-    long long unsigned int getLifetimeBytesSent() const { return _particlePacketSender.getLifetimeBytesSent(); }
+    long long unsigned int getLifetimeBytesSent() const { return _particlePacketSender->getLifetimeBytesSent(); }
 
     /// returns the total packets queued by this object over its lifetime
-    long long unsigned int getLifetimePacketsQueued() const { return _particlePacketSender.getLifetimePacketsQueued(); }
+    long long unsigned int getLifetimePacketsQueued() const { return _particlePacketSender->getLifetimePacketsQueued(); }
 
     /// returns the total bytes queued by this object over its lifetime
-    long long unsigned int getLifetimeBytesQueued() const { return _particlePacketSender.getLifetimeBytesQueued(); }
+    long long unsigned int getLifetimeBytesQueued() const { return _particlePacketSender->getLifetimeBytesQueued(); }
 
 private:
+    ParticleScriptingInterface(const ParticleScriptingInterface&);
+    ParticleScriptingInterface& operator=(const ParticleScriptingInterface&);
+    
     /// attached ParticleEditPacketSender that handles queuing and sending of packets to VS
-    ParticleEditPacketSender _particlePacketSender;
-    JurisdictionListener _jurisdictionListener;
+    ParticleEditPacketSender* _particlePacketSender;
+    JurisdictionListener* _jurisdictionListener;
+    bool _ownsPacketSender;
     
     void queueParticleAdd(PACKET_TYPE addPacketType, ParticleDetail& addParticleDetails);
     
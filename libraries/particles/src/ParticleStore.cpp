@@ -0,0 +1,236 @@
+//
+//  ParticleStore.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <string.h>
+
+#include "ParticleStore.h"
+
+// the number of hot float arrays carved out of the aligned block
+const int NUM_HOT_ARRAYS = 12;
+
+ParticleStore::ParticleStore() :
+    _capacity(0),
+    _size(0),
+    _freeSlots(),
+    _indexByID(),
+    _hotBlock(NULL),
+    _positionX(NULL),
+    _positionY(NULL),
+    _positionZ(NULL),
+    _velocityX(NULL),
+    _velocityY(NULL),
+    _velocityZ(NULL),
+    _gravityX(NULL),
+    _gravityY(NULL),
+    _gravityZ(NULL),
+    _damping(NULL),
+    _radius(NULL),
+    _timeStep(NULL)
+{
+}
+
+ParticleStore::~ParticleStore() {
+    delete[] _hotBlock;
+}
+
+int ParticleStore::add(const Particle& particle) {
+    int index;
+    if (!_freeSlots.empty()) {
+        index = _freeSlots.back();
+        _freeSlots.pop_back();
+    } else {
+        if (_size == _capacity) {
+            grow();
+        }
+        index = _size++;
+        _id.push_back(0);
+        _lastUpdated.push_back(0);
+        _color.push_back(Color());
+        _updateScript.push_back(QString());
+        _creatorTokenID.push_back(UNKNOWN_TOKEN);
+        _shouldDie.push_back(false);
+        _newlyCreated.push_back(false);
+        _isUsed.push_back(false);
+        _element.push_back(NULL);
+    }
+    _isUsed[index] = true;
+    _element[index] = NULL;
+    set(index, particle);
+    return index;
+}
+
+void ParticleStore::remove(int index) {
+    _indexByID.remove(_id[index]);
+    
+    // a free slot is left all zeroes, so integrating it changes nothing
+    _positionX[index] = _positionY[index] = _positionZ[index] = 0.0f;
+    _velocityX[index] = _velocityY[index] = _velocityZ[index] = 0.0f;
+    _gravityX[index] = _gravityY[index] = _gravityZ[index] = 0.0f;
+    _damping[index] = 0.0f;
+    _radius[index] = 0.0f;
+    _timeStep[index] = 0.0f;
+    
+    _updateScript[index] = QString();
+    _isUsed[index] = false;
+    _element[index] = NULL;
+    _freeSlots.push_back(index);
+}
+
+void ParticleStore::clear() {
+    for (int i = 0; i < _size; i++) {
+        if (_isUsed[i]) {
+            remove(i);
+        }
+    }
+}
+
+Particle ParticleStore::get(int index) const {
+    rgbColor color;
+    memcpy(color, _color[index].color, sizeof(rgbColor));
+    
+    Particle particle(getPosition(index), _radius[index], color,
+                      glm::vec3(_velocityX[index], _velocityY[index], _velocityZ[index]), _damping[index],
+                      glm::vec3(_gravityX[index], _gravityY[index], _gravityZ[index]), _updateScript[index], _id[index]);
+    particle._lastUpdated = _lastUpdated[index];
+    particle._shouldDie = _shouldDie[index];
+    particle._creatorTokenID = _creatorTokenID[index];
+    particle._newlyCreated = _newlyCreated[index];
+    return particle;
+}
+
+void ParticleStore::set(int index, const Particle& particle) {
+    if (_indexByID.value(_id[index], -1) == index) {
+        _indexByID.remove(_id[index]);
+    }
+    _indexByID.insert(particle.getID(), index);
+    
+    const glm::vec3& position = particle.getPosition();
+    _positionX[index] = position.x;
+    _positionY[index] = position.y;
+    _positionZ[index] = position.z;
+    
+    const glm::vec3& velocity = particle.getVelocity();
+    _velocityX[index] = velocity.x;
+    _velocityY[index] = velocity.y;
+    _velocityZ[index] = velocity.z;
+    
+    const glm::vec3& gravity = particle.getGravity();
+    _gravityX[index] = gravity.x;
+    _gravityY[index] = gravity.y;
+    _gravityZ[index] = gravity.z;
+    
+    _damping[index] = particle.getDamping();
+    _radius[index] = particle.getRadius();
+    _timeStep[index] = 0.0f;
+    
+    _id[index] = particle.getID();
+    _lastUpdated[index] = particle.getLastUpdated();
+    memcpy(_color[index].color, particle.getColor(), sizeof(rgbColor));
+    _updateScript[index] = particle.getUpdateScript();
+    _creatorTokenID[index] = particle.getCreatorTokenID();
+    _shouldDie[index] = particle.getShouldDie();
+    _newlyCreated[index] = particle.isNewlyCreated();
+}
+
+void ParticleStore::setMotion(int index, const glm::vec3& position, const glm::vec3& velocity, uint64_t lastUpdated) {
+    _positionX[index] = position.x;
+    _positionY[index] = position.y;
+    _positionZ[index] = position.z;
+    _velocityX[index] = velocity.x;
+    _velocityY[index] = velocity.y;
+    _velocityZ[index] = velocity.z;
+    _lastUpdated[index] = lastUpdated;
+}
+
+void ParticleStore::update(uint64_t now) {
+    const float USECS_PER_SECOND = 1000.0f * 1000.0f;
+    const float STILL_MOVING = 0.05 / TREE_SCALE;
+    
+    for (int i = 0; i < _size; i++) {
+        if (!_isUsed[i]) {
+            continue;
+        }
+        if (hasScript(i)) {
+            // the script may change anything about the particle, so it's updated one at a time as a whole Particle
+            Particle particle = get(i);
+            particle.update(now);
+            set(i, particle);
+        } else {
+            // the same default as Particle::update(), decided before this frame's integration
+            float speedSquared = _velocityX[i] * _velocityX[i] + _velocityY[i] * _velocityY[i] +
+                                 _velocityZ[i] * _velocityZ[i];
+            _shouldDie[i] = speedSquared < STILL_MOVING * STILL_MOVING;
+            
+            _timeStep[i] = (float)(now - _lastUpdated[i]) / USECS_PER_SECOND;
+            _lastUpdated[i] = now;
+        }
+    }
+    
+    integrate();
+}
+
+// The same steps as Particle::update(), written without branches over the hot arrays so the compiler can vectorize it.
+// Slots with a zero time step - free ones and those already updated by their script - come out unchanged.
+void ParticleStore::integrate() {
+    for (int i = 0; i < _size; i++) {
+        float timeStep = _timeStep[i];
+        
+        float positionX = _positionX[i] + _velocityX[i] * timeStep;
+        float positionY = _positionY[i] + _velocityY[i] * timeStep;
+        float positionZ = _positionZ[i] + _velocityZ[i] * timeStep;
+        
+        // handle bounces off the ground...
+        float bounce = (positionY <= 0.0f && timeStep > 0.0f) ? 1.0f : 0.0f;
+        float velocityX = _velocityX[i];
+        float velocityY = _velocityY[i] * (1.0f - 2.0f * bounce);
+        float velocityZ = _velocityZ[i];
+        positionY *= (1.0f - bounce);
+        
+        // handle gravity....
+        velocityX += _gravityX[i] * timeStep;
+        velocityY += _gravityY[i] * timeStep;
+        velocityZ += _gravityZ[i] * timeStep;
+        
+        // handle damping
+        float dampingFactor = 1.0f - _damping[i] * timeStep;
+        
+        _positionX[i] = positionX;
+        _positionY[i] = positionY;
+        _positionZ[i] = positionZ;
+        _velocityX[i] = velocityX * dampingFactor;
+        _velocityY[i] = velocityY * dampingFactor;
+        _velocityZ[i] = velocityZ * dampingFactor;
+        _timeStep[i] = 0.0f;
+    }
+}
+
+void ParticleStore::grow() {
+    int newCapacity = (_capacity == 0) ? PARTICLE_STORE_INITIAL_CAPACITY : _capacity * 2;
+    int arrayBytes = newCapacity * sizeof(float);
+    
+    unsigned char* newBlock = new unsigned char[NUM_HOT_ARRAYS * arrayBytes + PARTICLE_STORE_ALIGNMENT];
+    memset(newBlock, 0, NUM_HOT_ARRAYS * arrayBytes + PARTICLE_STORE_ALIGNMENT);
+    
+    // the capacity is a multiple of the alignment, so if the first array is aligned they all are
+    unsigned char* alignedStart = newBlock + (PARTICLE_STORE_ALIGNMENT -
+                                              ((uintptr_t)newBlock % PARTICLE_STORE_ALIGNMENT)) % PARTICLE_STORE_ALIGNMENT;
+    
+    float** hotArrays[NUM_HOT_ARRAYS] = { &_positionX, &_positionY, &_positionZ, &_velocityX, &_velocityY, &_velocityZ,
+                                          &_gravityX, &_gravityY, &_gravityZ, &_damping, &_radius, &_timeStep };
+    
+    for (int i = 0; i < NUM_HOT_ARRAYS; i++) {
+        float* newArray = (float*)(alignedStart + i * arrayBytes);
+        if (*hotArrays[i]) {
+            memcpy(newArray, *hotArrays[i], _size * sizeof(float));
+        }
+        *hotArrays[i] = newArray;
+    }
+    
+    delete[] _hotBlock;
+    _hotBlock = newBlock;
+    _capacity = newCapacity;
+}
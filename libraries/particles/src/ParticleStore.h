@@ -0,0 +1,121 @@
+//
+//  ParticleStore.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__ParticleStore__
+#define __hifi__ParticleStore__
+
+#include <stdint.h>
+#include <vector>
+
+#include <QtCore/QHash>
+
+#include "Particle.h"
+
+class ParticleTreeElement;
+
+// the hot arrays start on this boundary and are padded to a multiple of it, so the integration loop can be vectorized
+const int PARTICLE_STORE_ALIGNMENT = 16;
+const int PARTICLE_STORE_INITIAL_CAPACITY = 256;
+
+/// Holds every particle of a ParticleTree as a structure of arrays. The state touched each frame - position, velocity,
+/// gravity, damping and radius - lives in separate aligned float arrays so that update() can integrate all the
+/// particles without scripts in one pass over contiguous memory. The rest of each particle, including its script,
+/// is kept in arrays of its own that the integration never reads.
+/// Particles are addressed by slot index, which stays the same for as long as the particle is stored, and slots freed
+/// by remove() are reused.
+class ParticleStore {
+public:
+    ParticleStore();
+    ~ParticleStore();
+    
+    /// \return the index of the slot the particle was stored in
+    int add(const Particle& particle);
+    void remove(int index);
+    void clear();
+    
+    /// \return the index of the particle with this ID, or -1 if there isn't one
+    int find(uint32_t id) const { return _indexByID.value(id, -1); }
+    
+    /// copies the particle in the slot out of the store
+    Particle get(int index) const;
+    
+    /// replaces the particle in the slot, which keeps its index and element
+    void set(int index, const Particle& particle);
+    
+    /// replaces just where the particle is and where it's going, as of lastUpdated
+    void setMotion(int index, const glm::vec3& position, const glm::vec3& velocity, uint64_t lastUpdated);
+    
+    int getNumParticles() const { return _indexByID.size(); }
+    
+    /// every particle's index is below this, though not every index below it holds a particle
+    int getNumSlots() const { return _size; }
+    bool isUsed(int index) const { return _isUsed[index]; }
+    
+    uint32_t getID(int index) const { return _id[index]; }
+    glm::vec3 getPosition(int index) const {
+        return glm::vec3(_positionX[index], _positionY[index], _positionZ[index]);
+    }
+    glm::vec3 getVelocity(int index) const {
+        return glm::vec3(_velocityX[index], _velocityY[index], _velocityZ[index]);
+    }
+    float getRadius(int index) const { return _radius[index]; }
+    const rgbColor& getColor(int index) const { return _color[index].color; }
+    bool getShouldDie(int index) const { return _shouldDie[index]; }
+    bool hasScript(int index) const { return !_updateScript[index].isEmpty(); }
+    
+    /// the element whose list of particles holds the slot
+    ParticleTreeElement* getElement(int index) const { return _element[index]; }
+    void setElement(int index, ParticleTreeElement* element) { _element[index] = element; }
+    
+    /// advances every particle to now, running the scripts of those that have them
+    void update(uint64_t now);
+
+private:
+    ParticleStore(const ParticleStore&);
+    ParticleStore& operator=(const ParticleStore&);
+    
+    // rgbColor is an array type, so it is wrapped to be kept in a vector
+    struct Color {
+        rgbColor color;
+    };
+    
+    void grow();
+    void integrate();
+    
+    int _capacity;
+    int _size; // slots in use or on the free list, all below this index
+    std::vector<int> _freeSlots;
+    QHash<uint32_t, int> _indexByID;
+    
+    // hot state, in one aligned block
+    unsigned char* _hotBlock;
+    float* _positionX;
+    float* _positionY;
+    float* _positionZ;
+    float* _velocityX;
+    float* _velocityY;
+    float* _velocityZ;
+    float* _gravityX;
+    float* _gravityY;
+    float* _gravityZ;
+    float* _damping;
+    float* _radius;
+    float* _timeStep; // seconds to integrate this frame, zero for free slots and particles updated by their script
+    
+    // cold state
+    std::vector<uint32_t> _id;
+    std::vector<uint64_t> _lastUpdated;
+    std::vector<Color> _color;
+    std::vector<QString> _updateScript;
+    std::vector<uint32_t> _creatorTokenID;
+    std::vector<bool> _shouldDie;
+    std::vector<bool> _newlyCreated;
+    std::vector<bool> _isUsed;
+    std::vector<ParticleTreeElement*> _element;
+};
+
+#endif /* defined(__hifi__ParticleStore__) */
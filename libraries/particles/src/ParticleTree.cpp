@@ -6,16 +6,28 @@
 //  Copyright (c) 2013 High Fidelity, Inc. All rights reserved.
 //
 
+#include <BatchedUdpSocket.h>
+#include <PacketHeaders.h>
+
 #include "ParticleTree.h"
 
+const int BYTES_PER_SNAPSHOT_PARTICLE = sizeof(uint32_t) + sizeof(glm::vec3) + sizeof(glm::vec3);
+
 ParticleTree::ParticleTree(bool shouldReaverage) : Octree(shouldReaverage) {
     ParticleTreeElement* rootNode = createNewElement();
     rootNode->setTree(this);
     _rootNode = rootNode;
 }
 
+ParticleTree::~ParticleTree() {
+    // our elements give their particles back to the store as they're deleted, so they have to go before it does
+    delete _rootNode;
+    _rootNode = NULL;
+}
+
 ParticleTreeElement* ParticleTree::createNewElement(unsigned char * octalCode) const {
     ParticleTreeElement* newElement = new ParticleTreeElement(octalCode); 
+    newElement->setTree(const_cast<ParticleTree*>(this));
     return newElement;
 }
 
@@ -30,35 +42,25 @@ bool ParticleTree::handlesEditPacketType(PACKET_TYPE packetType) const {
 }
 
 
-class FindAndUpdateParticleArgs {
-public:
-    const Particle& searchParticle;
-    bool found;
-};
-    
-bool ParticleTree::findAndUpdateOperation(OctreeElement* element, void* extraData) {
-    FindAndUpdateParticleArgs* args = static_cast<FindAndUpdateParticleArgs*>(extraData);
-    ParticleTreeElement* particleTreeElement = static_cast<ParticleTreeElement*>(element);
-    if (particleTreeElement->containsParticle(args->searchParticle)) {
-        particleTreeElement->updateParticle(args->searchParticle);
-        args->found = true;
-        return false; // stop searching
-    }
-    return true;
-}
-
 void ParticleTree::storeParticle(const Particle& particle) {
     // First, look for the existing particle in the tree..
-    FindAndUpdateParticleArgs args = { particle, false };
-    recurseTreeWithOperation(findAndUpdateOperation, &args);
+    int index = _store.find(particle.getID());
     
-    // if we didn't find it in the tree, then store it...
-    if (!args.found) {
+    if (index >= 0) {
+        _store.set(index, particle);
+        
+        // if it has moved out of its element, the next update() will move it
+        ParticleTreeElement* element = _store.getElement(index);
+        if (element) {
+            element->markWithChangedTime();
+        }
+    } else {
+        // if we didn't find it in the tree, then store it...
         glm::vec3 position = particle.getPosition();
         float size = particle.getRadius();
         ParticleTreeElement* element = (ParticleTreeElement*)getOrCreateChildElementAt(position.x, position.y, position.z, size);
 
-        element->storeParticle(particle);
+        element->addParticle(_store.add(particle));
     }    
     // what else do we need to do here to get reaveraging to work
     _isDirty = true;
@@ -69,7 +71,7 @@ public:
     glm::vec3 position;
     float targetRadius;
     bool found;
-    const Particle* closestParticle;
+    int closestParticle;
     float closestParticleDistance;
 };
     
@@ -81,11 +83,11 @@ bool ParticleTree::findNearPointOperation(OctreeElement* element, void* extraDat
 
     // If this particleTreeElement contains the point, then search it...
     if (particleTreeElement->getAABox().contains(args->position)) {
-        const Particle* thisClosestParticle = particleTreeElement->getClosestParticle(args->position);
+        int thisClosestParticle = particleTreeElement->getClosestParticle(args->position);
         
-        // we may have gotten NULL back, meaning no particle was available
-        if (thisClosestParticle) {
-            glm::vec3 particlePosition = thisClosestParticle->getPosition();
+        // we may have gotten -1 back, meaning no particle was available
+        if (thisClosestParticle >= 0) {
+            glm::vec3 particlePosition = particleTreeElement->_myTree->getStore().getPosition(thisClosestParticle);
             float distanceFromPointToParticle = glm::distance(particlePosition, args->position);
             
             // If we're within our target radius
@@ -107,11 +109,14 @@ bool ParticleTree::findNearPointOperation(OctreeElement* element, void* extraDat
     return false;
 }
 
-const Particle* ParticleTree::findClosestParticle(glm::vec3 position, float targetRadius) {
+bool ParticleTree::findClosestParticle(glm::vec3 position, float targetRadius, Particle& closestParticle) {
     // First, look for the existing particle in the tree..
-    FindNearPointArgs args = { position, targetRadius, false, NULL, FLT_MAX };
+    FindNearPointArgs args = { position, targetRadius, false, -1, FLT_MAX };
     recurseTreeWithOperation(findNearPointOperation, &args);
-    return args.closestParticle;
+    if (args.found) {
+        closestParticle = _store.get(args.closestParticle);
+    }
+    return args.found;
 }
 
 
@@ -136,6 +141,81 @@ int ParticleTree::processEditPacketData(PACKET_TYPE packetType, unsigned char* p
     return processedBytes;
 }
 
+void ParticleTree::encodeSnapshotPackets(std::vector<QByteArray>& packets) const {
+    unsigned char packet[MAX_PACKET_SIZE];
+    int numBytesPacketHeader = populateTypeAndVersion(packet, PACKET_TYPE_PARTICLE_SNAPSHOT);
+    const unsigned char* firstParticleAt = packet + numBytesPacketHeader + sizeof(uint16_t);
+    
+    uint16_t numberOfParticles = 0;
+    unsigned char* dataAt = (unsigned char*) firstParticleAt;
+    
+    for (int i = 0; i < _store.getNumSlots(); i++) {
+        if (!_store.isUsed(i) || _store.hasScript(i)) {
+            continue;
+        }
+        
+        // start another packet when this one is full
+        if (dataAt + BYTES_PER_SNAPSHOT_PARTICLE > packet + MAX_PACKET_SIZE) {
+            memcpy(packet + numBytesPacketHeader, &numberOfParticles, sizeof(numberOfParticles));
+            packets.push_back(QByteArray((char*) packet, dataAt - packet));
+            numberOfParticles = 0;
+            dataAt = (unsigned char*) firstParticleAt;
+        }
+        
+        uint32_t id = _store.getID(i);
+        glm::vec3 position = _store.getPosition(i);
+        glm::vec3 velocity = _store.getVelocity(i);
+        memcpy(dataAt, &id, sizeof(id));
+        dataAt += sizeof(id);
+        memcpy(dataAt, &position, sizeof(position));
+        dataAt += sizeof(position);
+        memcpy(dataAt, &velocity, sizeof(velocity));
+        dataAt += sizeof(velocity);
+        numberOfParticles++;
+    }
+    
+    if (numberOfParticles > 0) {
+        memcpy(packet + numBytesPacketHeader, &numberOfParticles, sizeof(numberOfParticles));
+        packets.push_back(QByteArray((char*) packet, dataAt - packet));
+    }
+}
+
+void ParticleTree::processSnapshotPacket(const unsigned char* packetData, int packetLength) {
+    int numBytesPacketHeader = numBytesForPacketHeader(packetData);
+    if (packetLength < numBytesPacketHeader + (int) sizeof(uint16_t)) {
+        return;
+    }
+    
+    const unsigned char* dataAt = packetData + numBytesPacketHeader;
+    uint16_t numberOfParticles;
+    memcpy(&numberOfParticles, dataAt, sizeof(numberOfParticles));
+    dataAt += sizeof(numberOfParticles);
+    
+    if (packetLength < (dataAt - packetData) + numberOfParticles * BYTES_PER_SNAPSHOT_PARTICLE) {
+        return;
+    }
+    
+    // we don't share a clock with the server, so the snapshot counts as current when it gets here
+    uint64_t now = usecTimestampNow();
+    
+    for (uint16_t i = 0; i < numberOfParticles; i++) {
+        uint32_t id;
+        glm::vec3 position;
+        glm::vec3 velocity;
+        memcpy(&id, dataAt, sizeof(id));
+        dataAt += sizeof(id);
+        memcpy(&position, dataAt, sizeof(position));
+        dataAt += sizeof(position);
+        memcpy(&velocity, dataAt, sizeof(velocity));
+        dataAt += sizeof(velocity);
+        
+        int index = _store.find(id);
+        if (index >= 0) {
+            _store.setMotion(index, position, velocity, now);
+        }
+    }
+}
+
 void ParticleTree::notifyNewlyCreatedParticle(const Particle& newParticle, Node* senderNode) {
     _newlyCreatedHooksLock.lockForRead();
     for (int i = 0; i < _newlyCreatedHooks.size(); i++) {
@@ -169,38 +249,66 @@ bool ParticleTree::updateOperation(OctreeElement* element, void* extraData) {
     return true;
 }
 
-bool ParticleTree::pruneOperation(OctreeElement* element, void* extraData) {
-    ParticleTreeElement* particleTreeElement = static_cast<ParticleTreeElement*>(element);
-    for (int i = 0; i < NUMBER_OF_CHILDREN; i++) {
-        ParticleTreeElement* childAt = particleTreeElement->getChildAtIndex(i);
-        if (childAt && childAt->isLeaf() && !childAt->hasParticles()) {
-            particleTreeElement->deleteChildAtIndex(i);
-        }
-    }
-    return true;
-}
-
 void ParticleTree::update() {
     _isDirty = true;
 
+    // move all the particles forward to the same moment
+    _store.update(usecTimestampNow());
+
     ParticleTreeUpdateArgs args = { };
     recurseTreeWithOperation(updateOperation, &args);
     
-    // now add back any of the particles that moved elements....
+    // now move the particles that left their elements, all together, and prune the elements they left empty
+    std::set<ParticleTreeElement*> vacatedElements;
+    AABox treeBounds = getRoot()->getAABox();
+    
     int movingParticles = args._movingParticles.size();
     for (int i = 0; i < movingParticles; i++) {
-        bool shouldDie = args._movingParticles[i].getShouldDie();
+        int index = args._movingParticles[i];
+        ParticleTreeElement* oldElement = _store.getElement(index);
+        vacatedElements.insert(oldElement);
 
         // if the particle is still inside our total bounds, then re-add it
-        AABox treeBounds = getRoot()->getAABox();
-        
-        if (!shouldDie && treeBounds.contains(args._movingParticles[i].getPosition())) {
-            storeParticle(args._movingParticles[i]);
+        if (!_store.getShouldDie(index) && treeBounds.contains(_store.getPosition(index))) {
+            relocateParticle(index, oldElement);
+        } else {
+            _store.remove(index);
         }
     }
     
-    // prune the tree...
-    recurseTreeWithOperation(pruneOperation, NULL);
+    pruneVacatedElements(vacatedElements);
 }
 
+void ParticleTree::relocateParticle(int index, ParticleTreeElement* oldElement) {
+    glm::vec3 position = _store.getPosition(index);
+    float size = _store.getRadius(index);
+    
+    // up to the nearest ancestor that contains where the particle is now, and is big enough to hold it...
+    ParticleTreeElement* ancestor = oldElement;
+    while (ancestor->getParent() && (!ancestor->getAABox().contains(position) || ancestor->getScale() < size)) {
+        ancestor = ancestor->getParent();
+    }
+    
+    // ...and back down from there to the element it belongs in
+    ParticleTreeElement* newElement = (ParticleTreeElement*)ancestor->getOrCreateChildElementAt(position.x, position.y,
+                                                                                               position.z, size);
+    newElement->addParticle(index);
+}
 
+void ParticleTree::pruneVacatedElements(std::set<ParticleTreeElement*>& vacatedElements) {
+    while (!vacatedElements.empty()) {
+        ParticleTreeElement* element = *vacatedElements.begin();
+        vacatedElements.erase(vacatedElements.begin());
+        
+        // an empty leaf goes, and so may the parent it leaves empty, but never the root
+        while (element->getParent() && element->isLeaf() && !element->hasParticles()) {
+            ParticleTreeElement* parent = element->getParent();
+            
+            // it may be waiting its own turn, but there won't be anything left of it to prune
+            vacatedElements.erase(element);
+            parent->removeChild(element);
+            
+            element = parent;
+        }
+    }
+}
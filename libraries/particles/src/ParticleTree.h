@@ -9,12 +9,15 @@
 #ifndef __hifi__ParticleTree__
 #define __hifi__ParticleTree__
 
+#include <set>
+
 #include <Octree.h>
+#include "ParticleStore.h"
 #include "ParticleTreeElement.h"
 
 class ParticleTreeUpdateArgs {
 public:
-    std::vector<Particle> _movingParticles;
+    std::vector<int> _movingParticles; // store indexes of the particles that left their element
 };
 
 class NewlyCreatedParticleHook {
@@ -26,6 +29,7 @@ class ParticleTree : public Octree {
     Q_OBJECT
 public:
     ParticleTree(bool shouldReaverage = false);
+    ~ParticleTree();
     
     /// Implements our type specific root element factory
     virtual ParticleTreeElement* createNewElement(unsigned char * octalCode = NULL) const;
@@ -43,7 +47,22 @@ public:
     virtual void update();    
 
     void storeParticle(const Particle& particle);
-    const Particle* findClosestParticle(glm::vec3 position, float targetRadius);
+    
+    /// \return true if a particle was found within targetRadius of position, in which case closestParticle is a copy of it
+    bool findClosestParticle(glm::vec3 position, float targetRadius, Particle& closestParticle);
+    
+    /// Writes where each particle without a script is and how fast it's going into as many PACKET_TYPE_PARTICLE_SNAPSHOT
+    /// packets as it takes, so that clients can correct their own extrapolation:
+    ///     header | number of particles | for each: ID, position, velocity
+    /// Particles with scripts are left out, since their elements are resent whole whenever the script runs.
+    void encodeSnapshotPackets(std::vector<QByteArray>& packets) const;
+    
+    /// applies a snapshot from the server to the particles we know about, as of when it arrived
+    void processSnapshotPacket(const unsigned char* packetData, int packetLength);
+    
+    /// the particles of every element, which hold indexes into it
+    ParticleStore& getStore() { return _store; }
+    const ParticleStore& getStore() const { return _store; }
 
     void addNewlyCreatedHook(NewlyCreatedParticleHook* hook);
     void removeNewlyCreatedHook(NewlyCreatedParticleHook* hook);
@@ -51,14 +70,18 @@ public:
 private:
 
     static bool updateOperation(OctreeElement* element, void* extraData);
-    static bool findAndUpdateOperation(OctreeElement* element, void* extraData);
     static bool findNearPointOperation(OctreeElement* element, void* extraData);
-    static bool pruneOperation(OctreeElement* element, void* extraData);
+    
+    /// moves a particle that has left oldElement by way of their nearest common ancestor, rather than from the root
+    void relocateParticle(int index, ParticleTreeElement* oldElement);
+    void pruneVacatedElements(std::set<ParticleTreeElement*>& vacatedElements);
     
     void notifyNewlyCreatedParticle(const Particle& newParticle, Node* senderNode);
     
     QReadWriteLock _newlyCreatedHooksLock;
     std::vector<NewlyCreatedParticleHook*> _newlyCreatedHooks;
+    
+    ParticleStore _store;
 };
 
 #endif /* defined(__hifi__ParticleTree__) */
@@ -13,12 +13,20 @@
 #include "ParticleTree.h"
 #include "ParticleTreeElement.h"
 
-ParticleTreeElement::ParticleTreeElement(unsigned char* octalCode) : OctreeElement() { 
+ParticleTreeElement::ParticleTreeElement(unsigned char* octalCode) : OctreeElement(), _myTree(NULL), _parent(NULL) { 
     init(octalCode);
 };
 
 ParticleTreeElement::~ParticleTreeElement() {
     _voxelMemoryUsage -= sizeof(ParticleTreeElement);
+    
+    // our particles go with us
+    if (_myTree) {
+        ParticleStore& store = _myTree->getStore();
+        for (int i = 0; i < _particleIndexes.size(); i++) {
+            store.remove(_particleIndexes[i]);
+        }
+    }
 }
 
 // This will be called primarily on addChildAt(), which means we're adding a child of our
@@ -28,6 +36,7 @@ ParticleTreeElement::~ParticleTreeElement() {
 OctreeElement* ParticleTreeElement::createNewElement(unsigned char* octalCode) const {
     ParticleTreeElement* newChild = new ParticleTreeElement(octalCode);
     newChild->setTree(_myTree);
+    newChild->_parent = const_cast<ParticleTreeElement*>(this);
     return newChild;
 }
 
@@ -47,12 +56,13 @@ bool ParticleTreeElement::appendElementData(OctreePacketData* packetData) const
     bool success = true; // assume the best...
 
     // write our particles out...
-    uint16_t numberOfParticles = _particles.size();
+    const ParticleStore& store = _myTree->getStore();
+    uint16_t numberOfParticles = _particleIndexes.size();
     success = packetData->appendValue(numberOfParticles);
 
     if (success) {
         for (uint16_t i = 0; i < numberOfParticles; i++) {
-            const Particle& particle = _particles[i];
+            Particle particle = store.get(_particleIndexes[i]);
             success = particle.appendParticleData(packetData);
             if (!success) {
                 break;
@@ -63,21 +73,27 @@ bool ParticleTreeElement::appendElementData(OctreePacketData* packetData) const
 }
 
 void ParticleTreeElement::update(ParticleTreeUpdateArgs& args) {
-    markWithChangedTime();
-
-    // update our contained particles
-    uint16_t numberOfParticles = _particles.size();
+    // our contained particles have already been updated by the store, we just hand off the ones that left
+    const ParticleStore& store = _myTree->getStore();
+    uint16_t numberOfParticles = _particleIndexes.size();
 
     for (uint16_t i = 0; i < numberOfParticles; i++) {
-        _particles[i].update();
+        int index = _particleIndexes[i];
+        
+        // where the others are and how fast they're going goes out in snapshots, but a script may have changed anything
+        if (store.hasScript(index)) {
+            markWithChangedTime();
+        }
 
         // If the particle wants to die, or if it's left our bounding box, then move it
         // into the arguments moving particles. These will be added back or deleted completely
-        if (_particles[i].getShouldDie() || !_box.contains(_particles[i].getPosition())) {
-            args._movingParticles.push_back(_particles[i]);
+        if (store.getShouldDie(index) || !_box.contains(store.getPosition(index))) {
+            args._movingParticles.push_back(index);
             
-            // erase this particle
-            _particles.erase(_particles.begin()+i);
+            // erase this particle, order doesn't matter so the last one takes its place
+            _particleIndexes[i] = _particleIndexes.back();
+            _particleIndexes.pop_back();
+            markWithChangedTime();
             
             // reduce our index since we just removed this item
             i--;
@@ -87,10 +103,11 @@ void ParticleTreeElement::update(ParticleTreeUpdateArgs& args) {
 }
 
 bool ParticleTreeElement::findSpherePenetration(const glm::vec3& center, float radius, glm::vec3& penetration) const {
-    uint16_t numberOfParticles = _particles.size();
+    const ParticleStore& store = _myTree->getStore();
+    uint16_t numberOfParticles = _particleIndexes.size();
     for (uint16_t i = 0; i < numberOfParticles; i++) {
-        glm::vec3 particleCenter = _particles[i].getPosition();
-        float particleRadius = _particles[i].getRadius();
+        glm::vec3 particleCenter = store.getPosition(_particleIndexes[i]);
+        float particleRadius = store.getRadius(_particleIndexes[i]);
         
         // don't penetrate yourself
         if (particleCenter == center && particleRadius == radius) {
@@ -104,35 +121,16 @@ bool ParticleTreeElement::findSpherePenetration(const glm::vec3& center, float r
     return false;
 }
 
-bool ParticleTreeElement::containsParticle(const Particle& particle) const {
-    uint16_t numberOfParticles = _particles.size();
-    for (uint16_t i = 0; i < numberOfParticles; i++) {
-        if (_particles[i].getID() == particle.getID()) {
-            return true;
-        }
-    }
-    return false;    
-}
-
-bool ParticleTreeElement::updateParticle(const Particle& particle) {
-    uint16_t numberOfParticles = _particles.size();
-    for (uint16_t i = 0; i < numberOfParticles; i++) {
-        if (_particles[i].getID() == particle.getID()) {
-            _particles[i] = particle;
-            return true;
-        }
-    }
-    return false;    
-}
-
-const Particle* ParticleTreeElement::getClosestParticle(glm::vec3 position) const {
-    const Particle* closestParticle = NULL;
+int ParticleTreeElement::getClosestParticle(glm::vec3 position) const {
+    const ParticleStore& store = _myTree->getStore();
+    int closestParticle = -1;
     float closestParticleDistance = FLT_MAX;
-    uint16_t numberOfParticles = _particles.size();
+    uint16_t numberOfParticles = _particleIndexes.size();
     for (uint16_t i = 0; i < numberOfParticles; i++) {
-        float distanceToParticle = glm::distance(position, _particles[i].getPosition());
+        float distanceToParticle = glm::distance(position, store.getPosition(_particleIndexes[i]));
         if (distanceToParticle < closestParticleDistance) {
-            closestParticle = &_particles[i];
+            closestParticle = _particleIndexes[i];
+            closestParticleDistance = distanceToParticle;
         }
     }
     return closestParticle;    
@@ -185,8 +183,18 @@ bool ParticleTreeElement::collapseChildren() {
 }
 
 
-void ParticleTreeElement::storeParticle(const Particle& particle) {
-    _particles.push_back(particle);
+void ParticleTreeElement::removeChild(ParticleTreeElement* child) {
+    for (int i = 0; i < NUMBER_OF_CHILDREN; i++) {
+        if (getChildAtIndex(i) == child) {
+            deleteChildAtIndex(i);
+            return;
+        }
+    }
+}
+
+void ParticleTreeElement::addParticle(int index) {
+    _particleIndexes.push_back(index);
+    _myTree->getStore().setElement(index, this);
     markWithChangedTime();
 }
 
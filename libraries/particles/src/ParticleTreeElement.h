@@ -74,22 +74,27 @@ public:
 
     virtual bool findSpherePenetration(const glm::vec3& center, float radius, glm::vec3& penetration) const;
 
-    const std::vector<Particle>& getParticles() const { return _particles; }
-    std::vector<Particle>& getParticles() { return _particles; }
-    bool hasParticles() const { return _particles.size() > 0; }
+    /// the indexes in the tree's ParticleStore of the particles in this element
+    const std::vector<int>& getParticleIndexes() const { return _particleIndexes; }
+    bool hasParticles() const { return _particleIndexes.size() > 0; }
     
     void update(ParticleTreeUpdateArgs& args);
     void setTree(ParticleTree* tree) { _myTree = tree; }
     
-    bool containsParticle(const Particle& particle) const;
-    bool updateParticle(const Particle& particle);
-    const Particle* getClosestParticle(glm::vec3 position) const;
+    /// the element this one is a child of, or NULL for the root
+    ParticleTreeElement* getParent() const { return _parent; }
+    
+    /// \return the store index of the particle closest to position, or -1 if there are no particles
+    int getClosestParticle(glm::vec3 position) const;
 
 protected:
-    void storeParticle(const Particle& particle);
+    void addParticle(int index);
+
+    void removeChild(ParticleTreeElement* child);
 
     ParticleTree* _myTree;
-    std::vector<Particle> _particles;
+    ParticleTreeElement* _parent;
+    std::vector<int> _particleIndexes;
 };
 
 #endif /* defined(__hifi__ParticleTreeElement__) */
\ No newline at end of file
@@ -0,0 +1,248 @@
+//
+//  BatchedUdpSocket.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+#include "PacketBuffer.h"
+
+#include "BatchedUdpSocket.h"
+
+#ifdef __linux__
+static void sockAddrToNative(const HifiSockAddr& sockAddr, sockaddr_in& nativeSockAddr) {
+    memset(&nativeSockAddr, 0, sizeof(nativeSockAddr));
+    nativeSockAddr.sin_family = AF_INET;
+    nativeSockAddr.sin_addr.s_addr = htonl(sockAddr.getAddress().toIPv4Address());
+    nativeSockAddr.sin_port = htons(sockAddr.getPort());
+}
+
+static void sockAddrFromNative(const sockaddr_in& nativeSockAddr, HifiSockAddr& sockAddr) {
+    sockAddr.setAddress(QHostAddress(ntohl(nativeSockAddr.sin_addr.s_addr)));
+    sockAddr.setPort(ntohs(nativeSockAddr.sin_port));
+}
+#endif
+
+BatchedUdpSocket::BatchedUdpSocket(QUdpSocket& socket) :
+    _socket(socket),
+#ifdef __linux__
+    _isBatching(1),
+#else
+    _isBatching(0),
+#endif
+    _sendMutex(),
+    _sendBuffers(new unsigned char[MAX_DATAGRAMS_PER_BATCH * MAX_PACKET_SIZE]),
+    _numQueuedDatagrams(0),
+    _receiveBuffers(new unsigned char[MAX_DATAGRAMS_PER_BATCH * MAX_PACKET_SIZE]),
+    _numDatagramsSent(0),
+    _numSendCalls(0),
+    _numDatagramsReceived(0),
+    _numReceiveCalls(0)
+{
+    for (int i = 0; i < MAX_DATAGRAMS_PER_BATCH; i++) {
+        _receivedDatagrams[i].data = _receiveBuffers + i * MAX_PACKET_SIZE;
+        _receivedDatagrams[i].size = 0;
+    }
+}
+
+BatchedUdpSocket::~BatchedUdpSocket() {
+    delete[] _sendBuffers;
+    delete[] _receiveBuffers;
+}
+
+void BatchedUdpSocket::queueDatagram(const char* data, int size, const HifiSockAddr& destinationSockAddr) {
+    if (size > MAX_PACKET_SIZE) {
+        qDebug("BatchedUdpSocket::queueDatagram() dropped a %d byte datagram, larger than MAX_PACKET_SIZE\n", size);
+        return;
+    }
+    
+    QMutexLocker locker(&_sendMutex);
+    
+    if (_numQueuedDatagrams == MAX_DATAGRAMS_PER_BATCH) {
+        sendQueuedDatagrams();
+    }
+    
+    memcpy(_sendBuffers + _numQueuedDatagrams * MAX_PACKET_SIZE, data, size);
+    _sendSizes[_numQueuedDatagrams] = size;
+    _sendSockAddrs[_numQueuedDatagrams] = destinationSockAddr;
+    _numQueuedDatagrams++;
+}
+
+void BatchedUdpSocket::flush() {
+    QMutexLocker locker(&_sendMutex);
+    sendQueuedDatagrams();
+}
+
+void BatchedUdpSocket::sendQueuedDatagrams() {
+    int numSent = 0;
+    
+#ifdef __linux__
+    if (_isBatching.loadAcquire()) {
+        mmsghdr messages[MAX_DATAGRAMS_PER_BATCH];
+        iovec vectors[MAX_DATAGRAMS_PER_BATCH];
+        sockaddr_in destinations[MAX_DATAGRAMS_PER_BATCH];
+        
+        memset(messages, 0, _numQueuedDatagrams * sizeof(mmsghdr));
+        
+        for (int i = 0; i < _numQueuedDatagrams; i++) {
+            vectors[i].iov_base = _sendBuffers + i * MAX_PACKET_SIZE;
+            vectors[i].iov_len = _sendSizes[i];
+            
+            sockAddrToNative(_sendSockAddrs[i], destinations[i]);
+            
+            messages[i].msg_hdr.msg_name = &destinations[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(destinations[i]);
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        
+        int socketDescriptor = _socket.socketDescriptor();
+        
+        while (numSent < _numQueuedDatagrams) {
+            int result = sendmmsg(socketDescriptor, messages + numSent, _numQueuedDatagrams - numSent, 0);
+            _numSendCalls++;
+            
+            if (result > 0) {
+                numSent += result;
+            } else if (result < 0 && errno == ENOSYS) {
+                // built against a libc that has it, running on a kernel that doesn't
+                qDebug("sendmmsg is not supported, falling back to a datagram at a time\n");
+                _isBatching.storeRelease(0);
+                break;
+            } else {
+                // like writeDatagram, a datagram that can't go out is dropped - skip it and keep going with the rest
+                numSent++;
+            }
+        }
+    }
+#endif
+    
+    for (; numSent < _numQueuedDatagrams; numSent++) {
+        _socket.writeDatagram((char*) _sendBuffers + numSent * MAX_PACKET_SIZE, _sendSizes[numSent],
+                              _sendSockAddrs[numSent].getAddress(), _sendSockAddrs[numSent].getPort());
+        _numSendCalls++;
+    }
+    
+    _numDatagramsSent += _numQueuedDatagrams;
+    _numQueuedDatagrams = 0;
+}
+
+int BatchedUdpSocket::receiveDatagrams(ReceivedDatagram* datagrams) {
+    int numDatagrams = 0;
+    
+#ifdef __linux__
+    if (_isBatching.loadAcquire()) {
+        // the last slot is left for the read through the QUdpSocket below
+        const int MAX_BATCHED_RECEIVES = MAX_DATAGRAMS_PER_BATCH - 1;
+        
+        mmsghdr messages[MAX_BATCHED_RECEIVES];
+        iovec vectors[MAX_BATCHED_RECEIVES];
+        sockaddr_in senders[MAX_BATCHED_RECEIVES];
+        
+        memset(messages, 0, sizeof(messages));
+        
+        for (int i = 0; i < MAX_BATCHED_RECEIVES; i++) {
+            vectors[i].iov_base = datagrams[i].data;
+            vectors[i].iov_len = MAX_PACKET_SIZE;
+            
+            messages[i].msg_hdr.msg_name = &senders[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        
+        int result = recvmmsg(_socket.socketDescriptor(), messages, MAX_BATCHED_RECEIVES, MSG_DONTWAIT, NULL);
+        _numReceiveCalls++;
+        
+        if (result > 0) {
+            for (int i = 0; i < result; i++) {
+                if (messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    qDebug("BatchedUdpSocket dropped a datagram larger than MAX_PACKET_SIZE\n");
+                } else if (messages[i].msg_len > 0) {
+                    datagrams[numDatagrams].size = messages[i].msg_len;
+                    sockAddrFromNative(senders[i], datagrams[numDatagrams].senderSockAddr);
+                    
+                    if (numDatagrams != i) {
+                        memcpy(datagrams[numDatagrams].data, datagrams[i].data, messages[i].msg_len);
+                    }
+                    numDatagrams++;
+                }
+            }
+        } else if (result < 0 && errno == ENOSYS) {
+            qDebug("recvmmsg is not supported, falling back to a datagram at a time\n");
+            _isBatching.storeRelease(0);
+        }
+    }
+#endif
+    
+    // finish with a read through the QUdpSocket - besides picking up whatever is left, this is what re-enables its read
+    // notifier, without which it would stop emitting readyRead
+    do {
+        ReceivedDatagram& datagram = datagrams[numDatagrams];
+        
+        // readDatagram quietly cuts a datagram down to the size asked for, so check first
+        qint64 numPendingBytes = _socket.pendingDatagramSize();
+        
+        qint64 numBytesRead = _socket.readDatagram((char*) datagram.data, MAX_PACKET_SIZE,
+                                                   datagram.senderSockAddr.getAddressPointer(),
+                                                   datagram.senderSockAddr.getPortPointer());
+        _numReceiveCalls++;
+        
+        if (numBytesRead < 0) {
+            break;
+        } else if (numPendingBytes > MAX_PACKET_SIZE) {
+            qDebug("BatchedUdpSocket dropped a %lld byte datagram, larger than MAX_PACKET_SIZE\n", numPendingBytes);
+        } else if (numBytesRead > 0) {
+            datagram.size = numBytesRead;
+            numDatagrams++;
+        }
+    } while (!_isBatching.loadAcquire() && numDatagrams < MAX_DATAGRAMS_PER_BATCH && _socket.hasPendingDatagrams());
+    
+    _numDatagramsReceived += numDatagrams;
+    
+    return numDatagrams;
+}
+
+int BatchedUdpSocket::readPendingPackets(PacketBuffer* packets[MAX_DATAGRAMS_PER_BATCH]) {
+    ReceivedDatagram datagrams[MAX_DATAGRAMS_PER_BATCH];
+    for (int i = 0; i < MAX_DATAGRAMS_PER_BATCH; i++) {
+        datagrams[i].data = packets[i]->getData();
+        datagrams[i].size = 0;
+    }
+    
+    int numDatagrams = receiveDatagrams(datagrams);
+    
+    for (int i = 0; i < numDatagrams; i++) {
+        packets[i]->setSockAddr(datagrams[i].senderSockAddr);
+        packets[i]->setLength(datagrams[i].size);
+    }
+    
+    return numDatagrams;
+}
+
+bool BatchedUdpSocket::waitForDatagrams(int timeoutMsecs) {
+#ifdef _WIN32
+    return _socket.hasPendingDatagrams() || (timeoutMsecs > 0 && _socket.waitForReadyRead(timeoutMsecs));
+#else
+    pollfd socketPoll;
+    socketPoll.fd = _socket.socketDescriptor();
+    socketPoll.events = POLLIN;
+    socketPoll.revents = 0;
+    
+    // an interrupted poll just reports nothing pending, the caller will be back
+    return poll(&socketPoll, 1, timeoutMsecs) > 0 && (socketPoll.revents & POLLIN);
+#endif
+}
@@ -0,0 +1,105 @@
+//
+//  BatchedUdpSocket.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+//  Batches datagrams through a QUdpSocket with sendmmsg/recvmmsg where the platform has them.
+//
+
+#ifndef __hifi__BatchedUdpSocket__
+#define __hifi__BatchedUdpSocket__
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtNetwork/QUdpSocket>
+
+#include "HifiSockAddr.h"
+
+const int MAX_PACKET_SIZE = 1500;
+
+// the most datagrams sent or received with one system call
+const int MAX_DATAGRAMS_PER_BATCH = 64;
+
+class PacketBuffer;
+
+/// a datagram read by BatchedUdpSocket - its data lives in the socket's receive pool
+class ReceivedDatagram {
+public:
+    unsigned char* data;
+    int size;
+    HifiSockAddr senderSockAddr;
+};
+
+/// Sends and receives datagrams on a bound QUdpSocket in batches. Outgoing datagrams are copied into a queue that is
+/// sent with one sendmmsg when flushed (or when it fills), incoming ones are drained with recvmmsg into a reusable pool.
+/// Where those calls are missing this falls back to a datagram at a time through the QUdpSocket.
+class BatchedUdpSocket {
+public:
+    BatchedUdpSocket(QUdpSocket& socket);
+    ~BatchedUdpSocket();
+    
+    /// queues a datagram to go out with the next flush, flushing first if the queue is full - thread safe
+    void queueDatagram(const char* data, int size, const HifiSockAddr& destinationSockAddr);
+    void queueDatagram(const QByteArray& datagram, const HifiSockAddr& destinationSockAddr) {
+        queueDatagram(datagram.constData(), datagram.size(), destinationSockAddr);
+    }
+    
+    /// sends everything queued, whichever thread queued it - callers flush after each burst they queue - thread safe
+    void flush();
+    
+    /// reads up to MAX_DATAGRAMS_PER_BATCH pending datagrams into the receive pool, where they stay until the next call -
+    /// only call this from the thread that owns the socket
+    /// \return the number of datagrams read, MAX_DATAGRAMS_PER_BATCH if there may be more pending
+    int readPendingDatagrams() { return receiveDatagrams(_receivedDatagrams); }
+    
+    const ReceivedDatagram& getReceivedDatagram(int index) const { return _receivedDatagrams[index]; }
+    
+    /// reads up to MAX_DATAGRAMS_PER_BATCH pending datagrams straight into the caller's pooled buffers, setting their length
+    /// and sender, so they can be queued on without a copy - the same threading rules as readPendingDatagrams apply
+    /// \return the number of buffers filled, MAX_DATAGRAMS_PER_BATCH if there may be more pending
+    int readPendingPackets(PacketBuffer* packets[MAX_DATAGRAMS_PER_BATCH]);
+    
+    /// blocks until a datagram is pending or timeoutMsecs have passed, without spinning - a timeout of 0 only checks
+    /// \return true if there is a datagram to read
+    bool waitForDatagrams(int timeoutMsecs);
+    
+    /// true if datagrams go through sendmmsg/recvmmsg - false if this platform doesn't have them, or they failed with ENOSYS
+    bool isBatching() const { return _isBatching.loadAcquire(); }
+    
+    quint64 getNumDatagramsSent() const { return _numDatagramsSent; }
+    quint64 getNumSendCalls() const { return _numSendCalls; }
+    quint64 getNumDatagramsReceived() const { return _numDatagramsReceived; }
+    quint64 getNumReceiveCalls() const { return _numReceiveCalls; }
+private:
+    // disallow copying of BatchedUdpSocket objects
+    BatchedUdpSocket(const BatchedUdpSocket&);
+    BatchedUdpSocket& operator= (const BatchedUdpSocket&);
+    
+    /// sends what's queued - call with the send mutex held
+    void sendQueuedDatagrams();
+    
+    /// reads pending datagrams into the MAX_DATAGRAMS_PER_BATCH buffers that datagrams point at
+    int receiveDatagrams(ReceivedDatagram* datagrams);
+    
+    QUdpSocket& _socket;
+    
+    // cleared by whichever thread first finds the kernel lacks sendmmsg/recvmmsg, read by all of them
+    QAtomicInt _isBatching;
+    
+    QMutex _sendMutex;
+    unsigned char* _sendBuffers;
+    int _sendSizes[MAX_DATAGRAMS_PER_BATCH];
+    HifiSockAddr _sendSockAddrs[MAX_DATAGRAMS_PER_BATCH];
+    int _numQueuedDatagrams;
+    
+    unsigned char* _receiveBuffers;
+    ReceivedDatagram _receivedDatagrams[MAX_DATAGRAMS_PER_BATCH];
+    
+    quint64 _numDatagramsSent;
+    quint64 _numSendCalls;
+    quint64 _numDatagramsReceived;
+    quint64 _numReceiveCalls;
+};
+
+#endif /* defined(__hifi__BatchedUdpSocket__) */
@@ -79,6 +79,11 @@ QDebug operator<<(QDebug debug, const HifiSockAddr &hifiSockAddr) {
     return debug;
 }
 
+uint qHash(const HifiSockAddr& key) {
+    // our sockets are all IPv4, so mixing the port into the address spreads them well enough
+    return key.getAddress().toIPv4Address() ^ ((uint) key.getPort() << 16) ^ key.getPort();
+}
+
 quint32 getHostOrderLocalAddress() {
     
     static int localAddress = 0;
@@ -45,6 +45,9 @@ private:
 
 quint32 getHostOrderLocalAddress();
 
+/// lets HifiSockAddr be used as a QHash key
+uint qHash(const HifiSockAddr& key);
+
 Q_DECLARE_METATYPE(HifiSockAddr)
 
 #endif /* defined(__hifi__HifiSockAddr__) */
@@ -39,7 +39,7 @@ Node::Node(const QUuid& uuid, char type, const HifiSockAddr& publicSocket, const
 
 Node::~Node() {
     if (_linkedData) {
-        _linkedData->deleteOrDeleteLater();
+        _linkedData->release();
     }
     
     delete _bytesReceivedMovingAverage;
@@ -47,6 +47,18 @@ Node::~Node() {
     pthread_mutex_destroy(&_mutex);
 }
 
+void Node::setLinkedData(NodeData* linkedData) {
+    if (linkedData) {
+        linkedData->retain();
+    }
+    
+    if (_linkedData) {
+        _linkedData->release();
+    }
+    
+    _linkedData = linkedData;
+}
+
 // Names of Node Types
 const char* NODE_TYPE_NAME_DOMAIN = "Domain";
 const char* NODE_TYPE_NAME_VOXEL_SERVER = "Voxel Server";
@@ -57,7 +57,8 @@ public:
     void activateLocalSocket();
     
     NodeData* getLinkedData() const { return _linkedData; }
-    void setLinkedData(NodeData* linkedData) { _linkedData = linkedData; }
+    /// retains linkedData and releases whatever was linked before - retain the old data first to keep using it
+    void setLinkedData(NodeData* linkedData);
     
     bool isAlive() const { return _isAlive; }
     void setAlive(bool isAlive) { _isAlive = isAlive; }
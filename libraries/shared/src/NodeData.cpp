@@ -6,10 +6,13 @@
 //  Copyright (c) 2013 High Fidelity, Inc. All rights reserved.
 //
 
+#include "Node.h"
+
 #include "NodeData.h"
 
 NodeData::NodeData(Node* owningNode) :
-    _owningNode(owningNode)
+    _owningNodeUUID(owningNode ? owningNode->getUUID() : QUuid()),
+    _referenceCount(0)
 {
     
 }
@@ -20,4 +23,9 @@ NodeData::~NodeData() {
 
 void NodeData::deleteOrDeleteLater() {
     delete this;
-}
\ No newline at end of file
+}
+void NodeData::release() {
+    if (!_referenceCount.deref()) {
+        deleteOrDeleteLater();
+    }
+}
@@ -9,7 +9,9 @@
 #ifndef hifi_NodeData_h
 #define hifi_NodeData_h
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QObject>
+#include <QtCore/QUuid>
 
 class Node;
 
@@ -23,9 +25,19 @@ public:
     
     virtual void deleteOrDeleteLater();
     
-    Node* getOwningNode() { return _owningNode; }
-protected:
-    Node* _owningNode;
+    /// linked data is reference counted so that a thread still reading it can outlive the node that owned it
+    /// the owning node holds one reference, taken in Node::setLinkedData
+    void retain() { _referenceCount.ref(); }
+    
+    /// drops a reference, handing the data to deleteOrDeleteLater once the last one is gone
+    void release();
+    
+    /// the UUID of the node this data is linked to, null if it isn't any node's - the node itself is deleted some time
+    /// after it is killed while the data may live on, so look it up with NodeList::nodeWithUUID when it's needed
+    const QUuid& getOwningNodeUUID() const { return _owningNodeUUID; }
+private:
+    QUuid _owningNodeUUID;
+    QAtomicInt _referenceCount;
 };
 
 #endif
@@ -6,6 +6,7 @@
 //  Copyright (c) 2013 High Fidelity, Inc. All rights reserved.
 //
 
+#include <algorithm>
 #include <pthread.h>
 #include <cstring>
 #include <cstdlib>
@@ -20,6 +21,8 @@
 #include "NodeList.h"
 #include "NodeTypes.h"
 #include "PacketHeaders.h"
+#include "ReliableChannel.h"
+#include "ReusePortSocket.h"
 #include "SharedUtil.h"
 #include "UUID.h"
 
@@ -33,6 +36,19 @@ const unsigned short DEFAULT_DOMAIN_SERVER_PORT = 40102;
 
 NodeList* NodeList::_sharedInstance = NULL;
 
+NodeListSnapshot::NodeListSnapshot() :
+    nodeBuckets(),
+    numNodes(0)
+{
+    
+}
+
+NodeListSnapshot::~NodeListSnapshot() {
+    for (int i = 0; i < MAX_NUM_NODES / NODES_PER_BUCKET; i++) {
+        delete[] nodeBuckets[i];
+    }
+}
+
 NodeList* NodeList::createInstance(char ownerType, unsigned short int socketListenPort) {
     if (!_sharedInstance) {
         _sharedInstance = new NodeList(ownerType, socketListenPort);
@@ -54,26 +70,71 @@ NodeList* NodeList::getInstance() {
 NodeList::NodeList(char newOwnerType, unsigned short int newSocketListenPort) :
     _domainHostname(DEFAULT_DOMAIN_HOSTNAME),
     _domainSockAddr(HifiSockAddr(QHostAddress::Null, DEFAULT_DOMAIN_SERVER_PORT)),
-    _nodeBuckets(),
-    _numNodes(0),
+    _snapshot(new NodeListSnapshot()),
+    _nodeListWriteMutex(),
+    _readEpoch(0),
     _nodeSocket(),
+    _batchedNodeSocket(_nodeSocket),
     _ownerType(newOwnerType),
     _nodeTypesOfInterest(NULL),
     _ownerUUID(QUuid::createUuid()),
     _numNoReplyDomainCheckIns(0),
+    _domainListVersion(NO_DOMAIN_LIST_VERSION),
+    _incomingDomainListFromVersion(NO_DOMAIN_LIST_VERSION),
+    _incomingDomainListToVersion(NO_DOMAIN_LIST_VERSION),
+    _incomingDomainListPackets(),
+    _numIncomingDomainListPackets(0),
+    _numLocalNodeKills(0),
+    _numLocalNodeKillsBeforeFullList(0),
+    _numLocalNodeKillsBeforeIncomingList(0),
     _assignmentServerSocket(),
     _publicSockAddr(),
     _hasCompletedInitialSTUNFailure(false),
-    _stunRequestsSinceSuccess(0)
+    _stunRequestsSinceSuccess(0),
+    _reliableDeliveryMutex(QMutex::Recursive)
 {
     _nodeSocket.bind(QHostAddress::AnyIPv4, newSocketListenPort);
     qDebug() << "NodeList socket is listening on" << _nodeSocket.localPort() << "\n";
 }
 
+bool NodeList::shareNodeSocketPort() {
+    if (!ReusePortSocket::isSupported()) {
+        return false;
+    }
+    
+    quint16 port = _nodeSocket.localPort();
+    
+    // a port can only be shared by sockets that all asked to share it before they bound, so close ours and bind it again
+    _nodeSocket.close();
+    
+    int descriptor = ReusePortSocket::openDescriptor(port);
+    if (descriptor != -1 && _nodeSocket.setSocketDescriptor(descriptor, QAbstractSocket::BoundState)) {
+        qDebug() << "NodeList socket is sharing port" << port << "\n";
+        return true;
+    }
+    
+    if (descriptor != -1) {
+        ::close(descriptor);
+    }
+    
+    _nodeSocket.bind(QHostAddress::AnyIPv4, port);
+    return false;
+}
+
 NodeList::~NodeList() {
     delete _nodeTypesOfInterest;
     
     clear();
+    
+    for (QHash<HifiSockAddr, ReliableChannel*>::iterator channel = _reliableChannels.begin();
+         channel != _reliableChannels.end(); ++channel) {
+        delete channel.value();
+    }
+    
+    // nobody can be reading any more, so there's no need to wait out the epochs
+    deleteRetiredNodes(_retiredBeforeFlip);
+    deleteRetiredNodes(_retiredSinceFlip);
+    delete _snapshot.loadAcquire();
 }
 
 void NodeList::setDomainHostname(const QString& domainHostname) {
@@ -108,15 +169,19 @@ void NodeList::setDomainHostname(const QString& domainHostname) {
 }
 
 void NodeList::timePingReply(const HifiSockAddr& nodeAddress, unsigned char *packetData) {
-    for(NodeList::iterator node = begin(); node != end(); node++) {
-        if (node->getPublicSocket() == nodeAddress ||
-            node->getLocalSocket() == nodeAddress) {
-
-            int pingTime = usecTimestampNow() - *(uint64_t*)(packetData + numBytesForPacketHeader(packetData));
-            
-            node->setPingMs(pingTime / 1000);
-            break;
-        }
+    Node* node = nodeWithPublicOrLocalSocket(nodeAddress, false);
+    
+    if (node) {
+        int pingTime = usecTimestampNow() - *(uint64_t*)(packetData + numBytesForPacketHeader(packetData));
+        
+        node->setPingMs(pingTime / 1000);
+    }
+    
+    // pings keep the retransmit timeout current even while there are no reliable messages to time
+    QMutexLocker locker(&_reliableChannelsMutex);
+    ReliableChannel* channel = _reliableChannels.value(nodeAddress);
+    if (channel) {
+        channel->addRttSample(usecTimestampNow() - *(uint64_t*)(packetData + numBytesForPacketHeader(packetData)));
     }
 }
 
@@ -154,49 +219,15 @@ void NodeList::processNodeData(const HifiSockAddr& senderSockAddr, unsigned char
             processKillNode(packetData, dataBytes);
             break;
         }
-    }
-}
-
-void NodeList::processBulkNodeData(const HifiSockAddr& senderAddress, unsigned char *packetData, int numTotalBytes) {
-    
-    // find the avatar mixer in our node list and update the lastRecvTime from it
-    Node* bulkSendNode = nodeWithAddress(senderAddress);
-
-    if (bulkSendNode) {
-        
-        bulkSendNode->setLastHeardMicrostamp(usecTimestampNow());
-        bulkSendNode->recordBytesReceived(numTotalBytes);
-        
-        int numBytesPacketHeader = numBytesForPacketHeader(packetData);
-        
-        unsigned char* startPosition = packetData;
-        unsigned char* currentPosition = startPosition + numBytesPacketHeader;
-        unsigned char packetHolder[numTotalBytes];
-        
-        // we've already verified packet version for the bulk packet, so all head data in the packet is also up to date
-        populateTypeAndVersion(packetHolder, PACKET_TYPE_HEAD_DATA);
-        
-        while ((currentPosition - startPosition) < numTotalBytes) {
-            
-            memcpy(packetHolder + numBytesPacketHeader,
-                   currentPosition,
-                   numTotalBytes - (currentPosition - startPosition));
-            
-            QUuid nodeUUID = QUuid::fromRfc4122(QByteArray((char*)currentPosition, NUM_BYTES_RFC4122_UUID));
-            Node* matchingNode = nodeWithUUID(nodeUUID);
-            
-            if (!matchingNode) {
-                // we're missing this node, we need to add it to the list
-                matchingNode = addOrUpdateNode(nodeUUID, NODE_TYPE_AGENT, HifiSockAddr(), HifiSockAddr());
-            }
-            
-            currentPosition += updateNodeWithData(matchingNode,
-                                                  HifiSockAddr(),
-                                                  packetHolder,
-                                                  numTotalBytes - (currentPosition - startPosition));
-            
+        case PACKET_TYPE_RELIABLE: {
+            processReliableMessage(senderSockAddr, packetData, dataBytes);
+            break;
         }
-    }    
+        case PACKET_TYPE_RELIABLE_ACK: {
+            processReliableAck(senderSockAddr, packetData, dataBytes);
+            break;
+        }
+    }
 }
 
 int NodeList::updateNodeWithData(Node *node, const HifiSockAddr& senderSockAddr, unsigned char *packetData, int dataBytes) {
@@ -228,23 +259,67 @@ int NodeList::updateNodeWithData(Node *node, const HifiSockAddr& senderSockAddr,
 }
 
 Node* NodeList::nodeWithAddress(const HifiSockAddr &senderSockAddr) {
-    for(NodeList::iterator node = begin(); node != end(); node++) {
-        if (node->getActiveSocket() && *node->getActiveSocket() == senderSockAddr) {
-            return &(*node);
+    return nodeWithPublicOrLocalSocket(senderSockAddr, true);
+}
+
+Node* NodeList::nodeWithUUID(const QUuid& nodeUUID) {
+    QMutexLocker locker(&_nodeIndexMutex);
+    return _nodeHashByUUID.value(nodeUUID);
+}
+
+Node* NodeList::nodeWithPublicOrLocalSocket(const HifiSockAddr& sockAddr, bool mustBeActive) {
+    QMutexLocker locker(&_nodeIndexMutex);
+    
+    Node* matchingNode = NULL;
+    
+    QMultiHash<HifiSockAddr, Node*>::const_iterator node = _nodeHashBySocket.constFind(sockAddr);
+    
+    while (node != _nodeHashBySocket.constEnd() && node.key() == sockAddr) {
+        if (node.value()->getActiveSocket() && *node.value()->getActiveSocket() == sockAddr) {
+            // the index can't know which socket is active, so check it here
+            return node.value();
+        } else if (!mustBeActive && !matchingNode) {
+            matchingNode = node.value();
         }
+        
+        ++node;
     }
     
-    return NULL;
+    return matchingNode;
 }
 
-Node* NodeList::nodeWithUUID(const QUuid& nodeUUID) {
-    for(NodeList::iterator node = begin(); node != end(); node++) {
-        if (node->getUUID() == nodeUUID) {
-            return &(*node);
-        }
+void NodeList::addNodeToIndex(Node* node) {
+    QMutexLocker locker(&_nodeIndexMutex);
+    
+    _nodeHashByUUID.insert(node->getUUID(), node);
+    
+    // nodes we only know through the avatar mixer have null sockets, those are never a sender address
+    if (!node->getPublicSocket().isNull()) {
+        _nodeHashBySocket.insert(node->getPublicSocket(), node);
+    }
+    
+    if (!node->getLocalSocket().isNull() && node->getLocalSocket() != node->getPublicSocket()) {
+        _nodeHashBySocket.insert(node->getLocalSocket(), node);
     }
+}
 
-    return NULL;
+void NodeList::removeNodeFromIndex(Node* node) {
+    QMutexLocker locker(&_nodeIndexMutex);
+    
+    if (_nodeHashByUUID.value(node->getUUID()) == node) {
+        _nodeHashByUUID.remove(node->getUUID());
+    }
+    
+    _nodeHashBySocket.remove(node->getPublicSocket(), node);
+    _nodeHashBySocket.remove(node->getLocalSocket(), node);
+}
+
+int NodeList::size() const {
+    int readEpoch = pinReadEpoch();
+    int numNodes = _snapshot.loadAcquire()->numNodes.loadAcquire();
+    unpinReadEpoch(readEpoch);
+    
+    return numNodes;
 }
 
 int NodeList::getNumAliveNodes() const {
@@ -262,18 +337,108 @@ int NodeList::getNumAliveNodes() const {
 void NodeList::clear() {
     qDebug() << "Clearing the NodeList. Deleting all nodes in list.\n";
     
-    // delete all of the nodes in the list, set the pointers back to NULL and the number of nodes to 0
-    for (int i = 0; i < _numNodes; i++) {
-        Node** nodeBucket = _nodeBuckets[i / NODES_PER_BUCKET];
-        Node* node = nodeBucket[i % NODES_PER_BUCKET];
+    QMutexLocker writeLocker(&_nodeListWriteMutex);
+    
+    _nodeIndexMutex.lock();
+    _nodeHashByUUID.clear();
+    _nodeHashBySocket.clear();
+    _nodeIndexMutex.unlock();
+    
+    // swap in an empty list - the nodes themselves are deleted once no reader can be walking them
+    compactNodeList(true);
+    reclaimRetiredNodes();
+    
+    // with no nodes left, the next check-in has to get the full list, which may have the versions of the last one we had
+    _domainListVersion = NO_DOMAIN_LIST_VERSION;
+    resetIncomingDomainList();
+}
+
+void NodeList::resetIncomingDomainList() {
+    _incomingDomainListFromVersion = NO_DOMAIN_LIST_VERSION;
+    _incomingDomainListToVersion = NO_DOMAIN_LIST_VERSION;
+    _incomingDomainListPackets.clear();
+    _numIncomingDomainListPackets = 0;
+}
+
+int NodeList::pinReadEpoch() const {
+    while (true) {
+        int readEpoch = _readEpoch.loadAcquire();
+        _numEpochReaders[readEpoch].fetchAndAddOrdered(1);
         
-        node->lock();
-        delete node;
+        // if the writer flipped the epoch before it could see our count we have to count against the new one,
+        // otherwise it may already have decided the old epoch was drained
+        if (_readEpoch.fetchAndAddOrdered(0) == readEpoch) {
+            return readEpoch;
+        }
+        
+        _numEpochReaders[readEpoch].fetchAndAddOrdered(-1);
+    }
+}
+
+void NodeList::compactNodeList(bool shouldRemoveAllNodes) {
+    NodeListSnapshot* oldSnapshot = _snapshot.loadAcquire();
+    int numOldNodes = oldSnapshot->numNodes.loadAcquire();
+    
+    NodeListSnapshot* newSnapshot = new NodeListSnapshot();
+    int numNewNodes = 0;
+    
+    for (int i = 0; i < numOldNodes; i++) {
+        Node* node = oldSnapshot->nodeAt(i);
         
-        node = NULL;
+        if (node->isAlive() && !shouldRemoveAllNodes) {
+            int bucketIndex = numNewNodes / NODES_PER_BUCKET;
+            
+            if (!newSnapshot->nodeBuckets[bucketIndex]) {
+                newSnapshot->nodeBuckets[bucketIndex] = new Node*[NODES_PER_BUCKET]();
+            }
+            
+            newSnapshot->nodeBuckets[bucketIndex][numNewNodes % NODES_PER_BUCKET] = node;
+            ++numNewNodes;
+        } else {
+            node->setAlive(false);
+            _retiredSinceFlip.nodes.push_back(node);
+        }
+    }
+    
+    if (numNewNodes == numOldNodes) {
+        // nothing to remove, keep walking the same buckets
+        delete newSnapshot;
+        return;
     }
     
-    _numNodes = 0;
+    newSnapshot->numNodes.storeRelease(numNewNodes);
+    _snapshot.fetchAndStoreOrdered(newSnapshot);
+    
+    _retiredSinceFlip.snapshots.push_back(oldSnapshot);
+}
+
+void NodeList::reclaimRetiredNodes() {
+    int previousEpoch = 1 - _readEpoch.loadAcquire();
+    
+    if (_numEpochReaders[previousEpoch].fetchAndAddOrdered(0) == 0) {
+        // every reader that started before the last flip is done, so whatever was retired before it is unreachable
+        deleteRetiredNodes(_retiredBeforeFlip);
+        
+        std::swap(_retiredBeforeFlip, _retiredSinceFlip);
+        
+        // readers from here on count against the drained epoch, leaving the current one to drain by the next pass
+        _readEpoch.fetchAndStoreOrdered(previousEpoch);
+    }
+}
+
+void NodeList::deleteRetiredNodes(RetiredNodes& retiredNodes) {
+    for (std::vector<Node*>::iterator node = retiredNodes.nodes.begin(); node != retiredNodes.nodes.end(); node++) {
+        delete *node;
+    }
+    
+    for (std::vector<NodeListSnapshot*>::iterator snapshot = retiredNodes.snapshots.begin();
+         snapshot != retiredNodes.snapshots.end();
+         snapshot++) {
+        delete *snapshot;
+    }
+    
+    retiredNodes.nodes.clear();
+    retiredNodes.snapshots.clear();
 }
 
 void NodeList::reset() {
@@ -444,6 +609,88 @@ void NodeList::sendKillNode(const char* nodeTypes, int numNodeTypes) {
     broadcastToNodes(packet, packetPosition - packet, nodeTypes, numNodeTypes);
 }
 
+bool NodeList::sendReliableMessage(const HifiSockAddr& destinationSockAddr, const unsigned char* packetData,
+                                   int packetLength) {
+    QMutexLocker locker(&_reliableChannelsMutex);
+    return reliableChannelWith(destinationSockAddr)->sendMessage(_nodeSocket, packetData, packetLength);
+}
+
+void NodeList::processReliableMessage(const HifiSockAddr& senderSockAddr, unsigned char* packetData, size_t dataBytes) {
+    std::vector<QByteArray> deliveredMessages;
+    
+    _reliableChannelsMutex.lock();
+    reliableChannelWith(senderSockAddr)->processMessage(_nodeSocket, packetData, dataBytes, deliveredMessages);
+    
+    // listeners may send reliable messages of their own, so they're called without the channel lock
+    _reliableChannelsMutex.unlock();
+    
+    if (deliveredMessages.empty()) {
+        return;
+    }
+    
+    QMutexLocker deliveryLocker(&_reliableDeliveryMutex);
+    
+    // a listener may remove listeners from its callback, so walk a copy and skip the ones that are gone
+    std::vector<ReliableMessageListener*> listeners = _reliableMessageListeners;
+    
+    for (int i = 0; i < deliveredMessages.size(); i++) {
+        unsigned char* messageData = (unsigned char*) deliveredMessages[i].data();
+        
+        if (deliveredMessages[i].size() >= MAX_PACKET_HEADER_BYTES && packetVersionMatch(messageData)) {
+            for (int j = 0; j < listeners.size(); j++) {
+                if (std::find(_reliableMessageListeners.begin(), _reliableMessageListeners.end(), listeners[j])
+                    != _reliableMessageListeners.end()) {
+                    listeners[j]->processReliableMessage(senderSockAddr, messageData, deliveredMessages[i].size());
+                }
+            }
+        }
+    }
+}
+
+void NodeList::processReliableAck(const HifiSockAddr& senderSockAddr, unsigned char* packetData, size_t dataBytes) {
+    QMutexLocker locker(&_reliableChannelsMutex);
+    ReliableChannel* channel = _reliableChannels.value(senderSockAddr);
+    
+    if (channel) {
+        channel->processAck(_nodeSocket, packetData, dataBytes);
+    }
+}
+
+ReliableChannel* NodeList::reliableChannelWith(const HifiSockAddr& sockAddr) {
+    ReliableChannel* channel = _reliableChannels.value(sockAddr);
+    
+    if (!channel) {
+        // start the retransmit timer from the ping if we've been pinging this node
+        int pingUsecs = 0;
+        
+        NodeListReadGuard readGuard;
+        Node* node = nodeWithPublicOrLocalSocket(sockAddr, false);
+        if (node) {
+            pingUsecs = node->getPingMs() * 1000;
+        }
+        
+        channel = new ReliableChannel(sockAddr, pingUsecs);
+        _reliableChannels.insert(sockAddr, channel);
+    }
+    
+    return channel;
+}
+
+void NodeList::resendReliableMessages() {
+    QMutexLocker locker(&_reliableChannelsMutex);
+    
+    QHash<HifiSockAddr, ReliableChannel*>::iterator channel = _reliableChannels.begin();
+    while (channel != _reliableChannels.end()) {
+        if (channel.value()->isIdle()) {
+            delete channel.value();
+            channel = _reliableChannels.erase(channel);
+        } else {
+            channel.value()->resendTimedOutMessages(_nodeSocket);
+            ++channel;
+        }
+    }
+}
+
 void NodeList::processKillNode(unsigned char* packetData, size_t dataBytes) {
     // skip the header
     int numBytesPacketHeader = numBytesForPacketHeader(packetData);
@@ -460,6 +707,7 @@ void NodeList::processKillNode(unsigned char* packetData, size_t dataBytes) {
     Node* node = nodeWithUUID(nodeUUID);
     if (node) {
         killNode(node, true);
+        _numLocalNodeKills.fetchAndAddOrdered(1);
     }
 }
 
@@ -505,9 +753,10 @@ void NodeList::sendDomainServerCheckIn() {
         const int IP_ADDRESS_BYTES = 4;
         
         // check in packet has header, optional UUID, node type, port, IP, node types of interest, null termination
+        // and the version of the domain list we have
         int numPacketBytes = sizeof(PACKET_TYPE) + sizeof(PACKET_VERSION) + sizeof(NODE_TYPE) +
             NUM_BYTES_RFC4122_UUID + (2 * (sizeof(uint16_t) + IP_ADDRESS_BYTES)) +
-            numBytesNodesOfInterest + sizeof(unsigned char);
+            numBytesNodesOfInterest + sizeof(unsigned char) + sizeof(_domainListVersion);
         
         unsigned char checkInPacket[numPacketBytes];
         unsigned char* packetPosition = checkInPacket;
@@ -544,6 +793,13 @@ void NodeList::sendDomainServerCheckIn() {
             packetPosition += numBytesNodesOfInterest;
         }
         
+        // so the domain-server can reply with just what changed since, unless we've killed a node it still lists
+        uint32_t knownListVersion = (_numLocalNodeKills.loadAcquire() == _numLocalNodeKillsBeforeFullList.loadAcquire())
+            ? _domainListVersion
+            : NO_DOMAIN_LIST_VERSION;
+        memcpy(packetPosition, &knownListVersion, sizeof(knownListVersion));
+        packetPosition += sizeof(knownListVersion);
+        
         _nodeSocket.writeDatagram((char*) checkInPacket, packetPosition - checkInPacket,
                                   _domainSockAddr.getAddress(), _domainSockAddr.getPort());
         const int NUM_DOMAIN_SERVER_CHECKINS_PER_STUN_REQUEST = 5;
@@ -563,35 +819,108 @@ int NodeList::processDomainServerList(unsigned char* packetData, size_t dataByte
     // this is a packet from the domain server, reset the count of un-replied check-ins
     _numNoReplyDomainCheckIns = 0;
     
+    unsigned char* readPtr = packetData + numBytesForPacketHeader(packetData);
+    unsigned char* endPtr = packetData + dataBytes;
+    
+    if (endPtr - readPtr < DOMAIN_LIST_HEADER_BYTES) {
+        return 0;
+    }
+    
+    unsigned char flags = *readPtr++;
+    
+    uint32_t fromVersion, toVersion;
+    memcpy(&fromVersion, readPtr, sizeof(fromVersion));
+    readPtr += sizeof(fromVersion);
+    memcpy(&toVersion, readPtr, sizeof(toVersion));
+    readPtr += sizeof(toVersion);
+    
+    uint16_t packetIndex;
+    memcpy(&packetIndex, readPtr, sizeof(packetIndex));
+    readPtr += sizeof(packetIndex);
+    
+    bool isFullList = flags & DOMAIN_LIST_FULL_FLAG;
+    
+    if (!isFullList && fromVersion != _domainListVersion) {
+        // these are changes to a list we don't have, the reply to our next check-in will start from the one we do have
+        return 0;
+    }
+    
+    if (fromVersion != _incomingDomainListFromVersion || toVersion != _incomingDomainListToVersion) {
+        // this is the first packet we've seen of a new reply
+        resetIncomingDomainList();
+        _incomingDomainListFromVersion = fromVersion;
+        _incomingDomainListToVersion = toVersion;
+        
+        // a full list put together before it started arriving has every node we had killed by then
+        _numLocalNodeKillsBeforeIncomingList = _numLocalNodeKills.loadAcquire();
+    }
+    
+    if (_incomingDomainListPackets.contains(packetIndex)) {
+        return 0;
+    }
+    _incomingDomainListPackets.insert(packetIndex);
+    
+    if (flags & DOMAIN_LIST_LAST_PACKET_FLAG) {
+        _numIncomingDomainListPackets = packetIndex + 1;
+    }
+    
     int readNodes = 0;
-
-    char nodeType;
     
     // assumes only IPv4 addresses
     HifiSockAddr nodePublicSocket;
     HifiSockAddr nodeLocalSocket;
     
-    unsigned char* readPtr = packetData + numBytesForPacketHeader(packetData);
-    unsigned char* startPtr = packetData;
-    
-    while((readPtr - startPtr) < dataBytes - sizeof(uint16_t)) {
-        nodeType = *readPtr++;
+    while (readPtr < endPtr) {
+        int numRecordBytes = (*readPtr == DOMAIN_LIST_NODE_REMOVED)
+            ? DOMAIN_LIST_REMOVED_NODE_BYTES
+            : DOMAIN_LIST_NODE_BYTES;
+        
+        if (endPtr - readPtr < numRecordBytes) {
+            // the packet was cut short - keep what we read from it, but wait for it again before the reply is complete
+            _incomingDomainListPackets.remove(packetIndex);
+            break;
+        }
+        
+        unsigned char change = *readPtr++;
+        char nodeType = *readPtr++;
         QUuid nodeUUID = QUuid::fromRfc4122(QByteArray((char*) readPtr, NUM_BYTES_RFC4122_UUID));
         readPtr += NUM_BYTES_RFC4122_UUID;
+        
+        if (change == DOMAIN_LIST_NODE_REMOVED) {
+            // the domain-server has let this node go, there's no need to wait for it to fall silent
+            Node* removedNode = nodeWithUUID(nodeUUID);
+            if (removedNode) {
+                killNode(removedNode);
+            }
+        } else {
+            readPtr += HifiSockAddr::unpackSockAddr(readPtr, nodePublicSocket);
+            readPtr += HifiSockAddr::unpackSockAddr(readPtr, nodeLocalSocket);
+            
+            // if the public socket address is 0 then it's reachable at the same IP
+            // as the domain server
+            if (nodePublicSocket.getAddress().isNull()) {
+                nodePublicSocket.setAddress(_domainSockAddr.getAddress());
+            }
+            
+            addOrUpdateNode(nodeUUID, nodeType, nodePublicSocket, nodeLocalSocket);
+        }
+        
+        readNodes++;
+    }
     
-        readPtr += HifiSockAddr::unpackSockAddr(readPtr, nodePublicSocket);
-        readPtr += HifiSockAddr::unpackSockAddr(readPtr, nodeLocalSocket);
+    if (_numIncomingDomainListPackets > 0 && _incomingDomainListPackets.size() == _numIncomingDomainListPackets) {
+        // we have the whole reply, so our next check-in only needs what changes after it
+        _domainListVersion = toVersion;
         
-        // if the public socket address is 0 then it's reachable at the same IP
-        // as the domain server
-        if (nodePublicSocket.getAddress().isNull()) {
-            nodePublicSocket.setAddress(_domainSockAddr.getAddress());
+        if (isFullList) {
+            _numLocalNodeKillsBeforeFullList.fetchAndStoreOrdered(_numLocalNodeKillsBeforeIncomingList);
         }
         
-        addOrUpdateNode(nodeUUID, nodeType, nodePublicSocket, nodeLocalSocket);
+        // the same versions can come again - a full list we asked for after killing a node, when nothing has changed
+        // since the last one - and have to be taken as a new reply
+        resetIncomingDomainList();
     }
     
-
     return readNodes;
 }
 
@@ -636,16 +965,9 @@ void NodeList::pingPublicAndLocalSocketsForInactiveNode(Node* node) {
 
 Node* NodeList::addOrUpdateNode(const QUuid& uuid, char nodeType,
                                 const HifiSockAddr& publicSocket, const HifiSockAddr& localSocket) {
-    NodeList::iterator node = end();
+    Node* node = nodeWithUUID(uuid);
     
-    for (node = begin(); node != end(); node++) {
-        if (node->getUUID() == uuid) {
-            // we already have this node, stop checking
-            break;
-        }
-    }
-    
-    if (node == end()) {
+    if (!node) {
         // we didn't have this node, so add them
         Node* newNode = new Node(uuid, nodeType, publicSocket, localSocket);
         
@@ -663,34 +985,51 @@ Node* NodeList::addOrUpdateNode(const QUuid& uuid, char nodeType,
         }
         
         // check if we need to change this node's public or local sockets
-        if (publicSocket != node->getPublicSocket()) {
-            node->setPublicSocket(publicSocket);
-            qDebug() << "Public socket change for node" << *node << "\n";
-        }
-        
-        if (localSocket != node->getLocalSocket()) {
-            node->setLocalSocket(localSocket);
-            qDebug() << "Local socket change for node" << *node << "\n";
+        if (publicSocket != node->getPublicSocket() || localSocket != node->getLocalSocket()) {
+            // take the node out of the socket index while its sockets change, then put it back under the new ones
+            removeNodeFromIndex(node);
+            
+            if (publicSocket != node->getPublicSocket()) {
+                node->setPublicSocket(publicSocket);
+                qDebug() << "Public socket change for node" << *node << "\n";
+            }
+            
+            if (localSocket != node->getLocalSocket()) {
+                node->setLocalSocket(localSocket);
+                qDebug() << "Local socket change for node" << *node << "\n";
+            }
+            
+            addNodeToIndex(node);
         }
         
         node->unlock();
         
         // we had this node already, do nothing for now
-        return &*node;
+        return node;
     }    
 }
 
 void NodeList::addNodeToList(Node* newNode) {
+    _nodeListWriteMutex.lock();
+    
+    NodeListSnapshot* snapshot = _snapshot.loadAcquire();
+    int numNodes = snapshot->numNodes.loadAcquire();
+    
     // find the correct array to add this node to
-    int bucketIndex = _numNodes / NODES_PER_BUCKET;
+    int bucketIndex = numNodes / NODES_PER_BUCKET;
     
-    if (!_nodeBuckets[bucketIndex]) {
-        _nodeBuckets[bucketIndex] = new Node*[NODES_PER_BUCKET]();
+    if (!snapshot->nodeBuckets[bucketIndex]) {
+        snapshot->nodeBuckets[bucketIndex] = new Node*[NODES_PER_BUCKET]();
     }
     
-    _nodeBuckets[bucketIndex][_numNodes % NODES_PER_BUCKET] = newNode;
+    snapshot->nodeBuckets[bucketIndex][numNodes % NODES_PER_BUCKET] = newNode;
     
-    ++_numNodes;
+    // readers only look as far as the count they loaded, so the node has to be in place before it is published
+    snapshot->numNodes.storeRelease(numNodes + 1);
+    
+    addNodeToIndex(newNode);
+    
+    _nodeListWriteMutex.unlock();
     
     qDebug() << "Added" << *newNode << "\n";
     
@@ -732,18 +1071,23 @@ const HifiSockAddr* NodeList::getNodeActiveSocketOrPing(Node* node) {
 }
 
 void NodeList::activateSocketFromNodeCommunication(const HifiSockAddr& nodeAddress) {
-    for(NodeList::iterator node = begin(); node != end(); node++) {
-        if (!node->getActiveSocket()) {
-            // check both the public and local addresses for each node to see if we find a match
-            // prioritize the private address so that we prune erroneous local matches
-            if (node->getPublicSocket() ==  nodeAddress) {
-                node->activatePublicSocket();
-                break;
-            } else if (node->getLocalSocket() == nodeAddress) {
-                node->activateLocalSocket();
-                break;
+    QMutexLocker locker(&_nodeIndexMutex);
+    
+    QMultiHash<HifiSockAddr, Node*>::const_iterator node = _nodeHashBySocket.constFind(nodeAddress);
+    
+    while (node != _nodeHashBySocket.constEnd() && node.key() == nodeAddress) {
+        if (!node.value()->getActiveSocket()) {
+            // prioritize the public address so that we prune erroneous local matches
+            if (node.value()->getPublicSocket() == nodeAddress) {
+                node.value()->activatePublicSocket();
+            } else {
+                node.value()->activateLocalSocket();
             }
+            
+            break;
         }
+        
+        ++node;
     }
 }
 
@@ -769,6 +1113,7 @@ void NodeList::killNode(Node* node, bool mustLockNode) {
     notifyHooksOfKilledNode(&*node);
     
     node->setAlive(false);
+    removeNodeFromIndex(node);
     
     if (mustLockNode) {
         node->unlock();
@@ -784,10 +1129,16 @@ void NodeList::removeSilentNodes() {
         if ((usecTimestampNow() - node->getLastHeardMicrostamp()) > NODE_SILENCE_THRESHOLD_USECS) {
             // kill this node, don't lock - we already did it
             nodeList->killNode(&(*node), false);
+            nodeList->_numLocalNodeKills.fetchAndAddOrdered(1);
         }
         
         node->unlock();
     }
+    
+    // drop the dead nodes from the list and delete the ones no reader can see any more
+    QMutexLocker writeLocker(&nodeList->_nodeListWriteMutex);
+    nodeList->compactNodeList(false);
+    nodeList->reclaimRetiredNodes();
 }
 
 const QString QSETTINGS_GROUP_NAME = "NodeList";
@@ -821,39 +1172,92 @@ void NodeList::saveData(QSettings* settings) {
 }
 
 NodeList::iterator NodeList::begin() const {
-    Node** nodeBucket = NULL;
+    NodeListIterator iterator(this, 0);
     
-    for (int i = 0; i < _numNodes; i++) {
-        if (i % NODES_PER_BUCKET == 0) {
-            nodeBucket =  _nodeBuckets[i / NODES_PER_BUCKET];
-        }
-        
-        if (nodeBucket[i % NODES_PER_BUCKET]->isAlive()) {
-            return NodeListIterator(this, i);
-        }
+    if (!iterator.isAtEnd() && !iterator->isAlive()) {
+        // start from the first alive node
+        iterator.skipDeadAndStopIncrement();
     }
     
-    // there's no alive node to start from - return the end
-    return end();
+    return iterator;
 }
 
 NodeList::iterator NodeList::end() const {
-    return NodeListIterator(this, _numNodes);
+    return NodeListIterator(this);
+}
+
+NodeListReadGuard::NodeListReadGuard() :
+    _nodeList(NodeList::getInstance()),
+    _readEpoch(_nodeList->pinReadEpoch())
+{
+    
+}
+
+NodeListReadGuard::~NodeListReadGuard() {
+    _nodeList->unpinReadEpoch(_readEpoch);
 }
 
 NodeListIterator::NodeListIterator(const NodeList* nodeList, int nodeIndex) :
-    _nodeIndex(nodeIndex) {
-    _nodeList = nodeList;
+    _nodeList(nodeList),
+    _readEpoch(nodeList->pinReadEpoch()),
+    _nodeIndex(nodeIndex)
+{
+    _snapshot = nodeList->_snapshot.loadAcquire();
+    _numNodes = _snapshot->numNodes.loadAcquire();
+}
+
+NodeListIterator::NodeListIterator(const NodeList* nodeList) :
+    _nodeList(nodeList),
+    _snapshot(NULL),
+    _numNodes(0),
+    _readEpoch(-1),
+    _nodeIndex(0)
+{
+    
+}
+
+NodeListIterator::NodeListIterator(const NodeListIterator& otherValue) :
+    _nodeList(otherValue._nodeList),
+    _snapshot(otherValue._snapshot),
+    _numNodes(otherValue._numNodes),
+    _readEpoch(otherValue._readEpoch),
+    _nodeIndex(otherValue._nodeIndex)
+{
+    if (_readEpoch >= 0) {
+        // the other iterator keeps this epoch from draining, so we can count ourselves against it directly
+        _nodeList->_numEpochReaders[_readEpoch].ref();
+    }
+}
+
+NodeListIterator::~NodeListIterator() {
+    if (_readEpoch >= 0) {
+        _nodeList->unpinReadEpoch(_readEpoch);
+    }
 }
 
 NodeListIterator& NodeListIterator::operator=(const NodeListIterator& otherValue) {
+    if (otherValue._readEpoch >= 0) {
+        otherValue._nodeList->_numEpochReaders[otherValue._readEpoch].ref();
+    }
+    
+    if (_readEpoch >= 0) {
+        _nodeList->unpinReadEpoch(_readEpoch);
+    }
+    
     _nodeList = otherValue._nodeList;
+    _snapshot = otherValue._snapshot;
+    _numNodes = otherValue._numNodes;
+    _readEpoch = otherValue._readEpoch;
     _nodeIndex = otherValue._nodeIndex;
     return *this;
 }
 
 bool NodeListIterator::operator==(const NodeListIterator &otherValue) {
-    return _nodeIndex == otherValue._nodeIndex;
+    if (isAtEnd() || otherValue.isAtEnd()) {
+        return isAtEnd() && otherValue.isAtEnd();
+    }
+    
+    return _snapshot == otherValue._snapshot && _nodeIndex == otherValue._nodeIndex;
 }
 
 bool NodeListIterator::operator!=(const NodeListIterator &otherValue) {
@@ -861,13 +1265,11 @@ bool NodeListIterator::operator!=(const NodeListIterator &otherValue) {
 }
 
 Node& NodeListIterator::operator*() {
-    Node** nodeBucket = _nodeList->_nodeBuckets[_nodeIndex / NODES_PER_BUCKET];
-    return *nodeBucket[_nodeIndex % NODES_PER_BUCKET];
+    return *_snapshot->nodeAt(_nodeIndex);
 }
 
 Node* NodeListIterator::operator->() {
-    Node** nodeBucket = _nodeList->_nodeBuckets[_nodeIndex / NODES_PER_BUCKET];
-    return nodeBucket[_nodeIndex % NODES_PER_BUCKET];
+    return _snapshot->nodeAt(_nodeIndex);
 }
 
 NodeListIterator& NodeListIterator::operator++() {
@@ -882,12 +1284,12 @@ NodeList::iterator NodeListIterator::operator++(int) {
 }
 
 void NodeListIterator::skipDeadAndStopIncrement() {
-    while (_nodeIndex != _nodeList->_numNodes) {
+    while (!isAtEnd()) {
         ++_nodeIndex;
         
-        if (_nodeIndex == _nodeList->_numNodes) {
+        if (isAtEnd()) {
             break;
-        } else if ((*(*this)).isAlive()) {
+        } else if (_snapshot->nodeAt(_nodeIndex)->isAlive()) {
             // skip over the dead nodes
             break;
         }
@@ -909,6 +1311,23 @@ void NodeList::removeDomainListener(DomainChangeListener* listener) {
     }
 }
 
+void NodeList::addReliableMessageListener(ReliableMessageListener* listener) {
+    QMutexLocker locker(&_reliableDeliveryMutex);
+    _reliableMessageListeners.push_back(listener);
+}
+
+void NodeList::removeReliableMessageListener(ReliableMessageListener* listener) {
+    // waits out any delivery in flight, after which the listener won't be called again
+    QMutexLocker locker(&_reliableDeliveryMutex);
+    
+    for (int i = 0; i < _reliableMessageListeners.size(); i++) {
+        if (_reliableMessageListeners[i] == listener) {
+            _reliableMessageListeners.erase(_reliableMessageListeners.begin() + i);
+            return;
+        }
+    }
+}
+
 void NodeList::addHook(NodeListHook* hook) {
     _hooks.push_back(hook);
 }
@@ -16,19 +16,26 @@
 
 #include <QtNetwork/QHostAddress>
 #include <QtNetwork/QUdpSocket>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QHash>
+#include <QtCore/QMultiHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
 #include <QtCore/QSettings>
 
+#include "BatchedUdpSocket.h"
 #include "Node.h"
 #include "NodeTypes.h"
+#include "UUID.h"
 
 const int MAX_NUM_NODES = 10000;
 const int NODES_PER_BUCKET = 100;
 
-const int MAX_PACKET_SIZE = 1500;
-
 const uint64_t NODE_SILENCE_THRESHOLD_USECS = 2 * 1000 * 1000;
 const uint64_t DOMAIN_SERVER_CHECK_IN_USECS = 1 * 1000000;
 const uint64_t PING_INACTIVE_NODE_INTERVAL_USECS = 1 * 1000 * 1000;
+const uint64_t RELIABLE_RESEND_INTERVAL_USECS = 50 * 1000;
 
 extern const char SOLO_NODE_TYPES[2];
 
@@ -41,9 +48,45 @@ const char DEFAULT_ASSIGNMENT_SERVER_HOSTNAME[] = "localhost";
 
 const int MAX_SILENT_DOMAIN_SERVER_CHECK_INS = 5;
 
+// A domain-server answers each check-in with either its full list of nodes, or with what changed since the version of the
+// list the node checked in with. The reply is spread over as many PACKET_TYPE_DOMAIN packets as it takes, each of which
+// starts with the flags, the version the changes are from, the version they bring the list to and its index in the reply.
+const unsigned char DOMAIN_LIST_FULL_FLAG = 1;
+const unsigned char DOMAIN_LIST_LAST_PACKET_FLAG = 2;
+const int DOMAIN_LIST_HEADER_BYTES = sizeof(unsigned char) + 2 * sizeof(uint32_t) + sizeof(uint16_t);
+
+// each node in the reply starts with one of these, then its type and UUID, then its sockets unless it was removed
+const unsigned char DOMAIN_LIST_NODE_ADDED_OR_CHANGED = 0;
+const unsigned char DOMAIN_LIST_NODE_REMOVED = 1;
+
+const int DOMAIN_LIST_REMOVED_NODE_BYTES = sizeof(unsigned char) + sizeof(NODE_TYPE) + NUM_BYTES_RFC4122_UUID;
+
+// a node that was added or changed also has its public and local IPv4 sockets
+const int DOMAIN_LIST_NODE_BYTES = DOMAIN_LIST_REMOVED_NODE_BYTES + 2 * (sizeof(quint32) + sizeof(quint16));
+
+// the version a node checks in with until it has received a whole list, which gets it the full list
+const uint32_t NO_DOMAIN_LIST_VERSION = 0;
+
 class Assignment;
 class HifiSockAddr;
 class NodeListIterator;
+class ReliableChannel;
+
+/// An append-only view of the node buckets. Readers walk whichever snapshot was current when they started,
+/// new nodes are appended to the current one, and removing nodes publishes a compacted copy instead of
+/// touching the one readers may be walking.
+class NodeListSnapshot {
+public:
+    NodeListSnapshot();
+    
+    /// deletes the buckets but not the nodes in them
+    ~NodeListSnapshot();
+    
+    Node* nodeAt(int nodeIndex) const { return nodeBuckets[nodeIndex / NODES_PER_BUCKET][nodeIndex % NODES_PER_BUCKET]; }
+    
+    Node** nodeBuckets[MAX_NUM_NODES / NODES_PER_BUCKET];
+    QAtomicInt numNodes;
+};
 
 // Callers who want to hook add/kill callbacks should implement this class
 class NodeListHook {
@@ -57,6 +100,13 @@ public:
     virtual void domainChanged(QString domain) = 0;
 };
 
+/// Callers who want the messages other nodes send with sendReliableMessage should implement this class. Messages
+/// arrive in the order they were sent, on whichever thread passed the wrapping packet to processNodeData.
+class ReliableMessageListener {
+public:
+    virtual void processReliableMessage(const HifiSockAddr& senderSockAddr, unsigned char* packetData, int packetLength) = 0;
+};
+
 class NodeList : public QObject {
     Q_OBJECT
 public:
@@ -77,6 +127,7 @@ public:
     const QHostAddress& getDomainIP() const { return _domainSockAddr.getAddress(); }
     void setDomainIPToLocalhost() { _domainSockAddr.setAddress(QHostAddress(INADDR_LOOPBACK)); }
     
+    const HifiSockAddr& getDomainSockAddr() const { return _domainSockAddr; }
     void setDomainSockAddr(const HifiSockAddr& domainSockAddr) { _domainSockAddr = domainSockAddr; }
     
     unsigned short getDomainPort() const { return _domainSockAddr.getPort(); }
@@ -86,9 +137,12 @@ public:
     
     QUdpSocket& getNodeSocket() { return _nodeSocket; }
     
+    /// the node socket, batching sends and receives - for the paths that send or receive many datagrams at a time
+    BatchedUdpSocket& getBatchedNodeSocket() { return _batchedNodeSocket; }
+    
     void(*linkedDataCreateCallback)(Node *);
     
-    int size() { return _numNodes; }
+    int size() const;
     int getNumAliveNodes() const;
     
     int getNumNoReplyDomainCheckIns() const { return _numNoReplyDomainCheckIns; }
@@ -107,14 +161,22 @@ public:
     
     void sendKillNode(const char* nodeTypes, int numNodeTypes);
     
+    /// sends a complete packet to destinationSockAddr over the reliable channel we keep with it, resending it until it
+    /// is acknowledged - the receiver's ReliableMessageListeners get it once, in order with our other messages to it.
+    /// Apps that send reliable messages need to call resendReliableMessages every RELIABLE_RESEND_INTERVAL_USECS.
+    /// \return false if the packet is too large to be sent reliably
+    bool sendReliableMessage(const HifiSockAddr& destinationSockAddr, const unsigned char* packetData, int packetLength);
+    
+    /// constant time lookup of the alive node whose active socket is senderSockAddr
     Node* nodeWithAddress(const HifiSockAddr& senderSockAddr);
+    
+    /// constant time lookup of the alive node with nodeUUID
     Node* nodeWithUUID(const QUuid& nodeUUID);
     
     Node* addOrUpdateNode(const QUuid& uuid, char nodeType, const HifiSockAddr& publicSocket, const HifiSockAddr& localSocket);
     void killNode(Node* node, bool mustLockNode = true);
     
     void processNodeData(const HifiSockAddr& senderSockAddr, unsigned char *packetData, size_t dataBytes);
-    void processBulkNodeData(const HifiSockAddr& senderSockAddr, unsigned char *packetData, int numTotalBytes);
    
     int updateNodeWithData(Node *node, const HifiSockAddr& senderSockAddr, unsigned char *packetData, int dataBytes);
     
@@ -126,6 +188,7 @@ public:
     void saveData(QSettings* settings);
     
     friend class NodeListIterator;
+    friend class NodeListReadGuard;
     
     void addHook(NodeListHook* hook);
     void removeHook(NodeListHook* hook);
@@ -135,11 +198,22 @@ public:
     void addDomainListener(DomainChangeListener* listener);
     void removeDomainListener(DomainChangeListener* listener);
     
+    void addReliableMessageListener(ReliableMessageListener* listener);
+    void removeReliableMessageListener(ReliableMessageListener* listener);
+    
     const HifiSockAddr* getNodeActiveSocketOrPing(Node* node);
 public slots:
     void sendDomainServerCheckIn();
     void pingInactiveNodes();
     void removeSilentNodes();
+    
+    /// resends unacknowledged reliable messages whose timeout has expired, and discards idle reliable channels
+    void resendReliableMessages();
+    
+    /// rebinds the node socket to its port with SO_REUSEPORT, so that ReusePortSockets can share the port with it - call
+    /// on the thread that owns the NodeList
+    /// \return false, leaving the socket as it was, if ports can't be shared here
+    bool shareNodeSocketPort();
 private:
     static NodeList* _sharedInstance;
     
@@ -150,39 +224,128 @@ private:
     
     void addNodeToList(Node* newNode);
     
+    /// marks the calling thread as a reader, so nothing it can reach is deleted until it calls unpinReadEpoch
+    int pinReadEpoch() const;
+    void unpinReadEpoch(int readEpoch) const { _numEpochReaders[readEpoch].deref(); }
+    
+    /// publishes a copy of the current snapshot without its dead nodes - call with _nodeListWriteMutex held
+    void compactNodeList(bool shouldRemoveAllNodes);
+    
+    /// deletes whatever no reader can still see - call with _nodeListWriteMutex held
+    void reclaimRetiredNodes();
+    
+    struct RetiredNodes {
+        std::vector<NodeListSnapshot*> snapshots;
+        std::vector<Node*> nodes;
+    };
+    
+    void deleteRetiredNodes(RetiredNodes& retiredNodes);
+    
+    void addNodeToIndex(Node* node);
+    void removeNodeFromIndex(Node* node);
+    
+    /// \return the alive node with a public or local socket of sockAddr, preferring one whose active socket it is
+    Node* nodeWithPublicOrLocalSocket(const HifiSockAddr& sockAddr, bool mustBeActive);
+    
     void sendSTUNRequest();
     void processSTUNResponse(unsigned char* packetData, size_t dataBytes);
     
     void processKillNode(unsigned char* packetData, size_t dataBytes);
     
+    void processReliableMessage(const HifiSockAddr& senderSockAddr, unsigned char* packetData, size_t dataBytes);
+    void processReliableAck(const HifiSockAddr& senderSockAddr, unsigned char* packetData, size_t dataBytes);
+    
+    /// the channel with sockAddr, created if we don't have one yet - call with _reliableChannelsMutex held
+    ReliableChannel* reliableChannelWith(const HifiSockAddr& sockAddr);
+    
     QString _domainHostname;
     HifiSockAddr _domainSockAddr;
-    Node** _nodeBuckets[MAX_NUM_NODES / NODES_PER_BUCKET];
-    int _numNodes;
+    
+    // readers load the snapshot without locking, writers serialize on _nodeListWriteMutex
+    QAtomicPointer<NodeListSnapshot> _snapshot;
+    QMutex _nodeListWriteMutex;
+    
+    // readers count themselves against the current epoch, and each flip of the epoch is only made once
+    // the other counter has drained - anything retired before the previous flip is then unreachable
+    mutable QAtomicInt _readEpoch;
+    mutable QAtomicInt _numEpochReaders[2];
+    RetiredNodes _retiredBeforeFlip;
+    RetiredNodes _retiredSinceFlip;
+    
+    // indexes of the alive nodes, so the per-datagram sender lookups don't have to walk the buckets
+    // the socket index holds both sockets of each node, since either can become active without us hearing about it
+    QMutex _nodeIndexMutex;
+    QHash<QUuid, Node*> _nodeHashByUUID;
+    QMultiHash<HifiSockAddr, Node*> _nodeHashBySocket;
     QUdpSocket _nodeSocket;
+    BatchedUdpSocket _batchedNodeSocket;
     char _ownerType;
     char* _nodeTypesOfInterest;
     QUuid _ownerUUID;
     int _numNoReplyDomainCheckIns;
+    
+    // the version of the domain list we have all of, and the reply we're part way through receiving
+    uint32_t _domainListVersion;
+    uint32_t _incomingDomainListFromVersion;
+    uint32_t _incomingDomainListToVersion;
+    QSet<int> _incomingDomainListPackets;
+    int _numIncomingDomainListPackets; // zero until the last packet of the reply arrives
+    
+    // nodes we kill ourselves are still in the domain-server's list, so it won't send them again as changes - we check in
+    // for the full list until we've had all of one that started arriving after the last of those kills
+    QAtomicInt _numLocalNodeKills;
+    QAtomicInt _numLocalNodeKillsBeforeFullList;
+    int _numLocalNodeKillsBeforeIncomingList;
     HifiSockAddr _assignmentServerSocket;
     HifiSockAddr _publicSockAddr;
     bool _hasCompletedInitialSTUNFailure;
     unsigned int _stunRequestsSinceSuccess;
     
+    /// forgets the reply to a check-in we were part way through, or last had all of
+    void resetIncomingDomainList();
+    
     void activateSocketFromNodeCommunication(const HifiSockAddr& nodeSockAddr);
     void timePingReply(const HifiSockAddr& nodeAddress, unsigned char *packetData);
     
     std::vector<NodeListHook*> _hooks;
     std::vector<DomainChangeListener*> _domainListeners;
     
+    // the channels and their listeners are used from every thread that sends or receives reliable messages
+    QMutex _reliableChannelsMutex;
+    QHash<HifiSockAddr, ReliableChannel*> _reliableChannels;
+    
+    // held while messages are delivered, so a listener that removes itself can't be deleted while it is being called -
+    // recursive since a listener may remove itself, or another, from its callback
+    QMutex _reliableDeliveryMutex;
+    std::vector<ReliableMessageListener*> _reliableMessageListeners;
+    
     void resetDomainData(char domainField[], const char* domainData);
     void notifyDomainChanged();
     void domainLookup();
 };
 
+/// Pins the NodeList for as long as it is in scope, so that Node pointers looked up by UUID or address
+/// and their linked data stay valid even if another thread kills and removes those nodes.
+/// NodeListIterators do this for themselves.
+class NodeListReadGuard {
+public:
+    NodeListReadGuard();
+    ~NodeListReadGuard();
+private:
+    NodeListReadGuard(const NodeListReadGuard&);
+    NodeListReadGuard& operator=(const NodeListReadGuard&);
+    
+    const NodeList* _nodeList;
+    int _readEpoch;
+};
+
+/// Walks the snapshot of the list that was current when it was created, skipping dead nodes.
+/// Nodes added afterwards are not visited, and nothing visited is deleted while the iterator lives.
 class NodeListIterator : public std::iterator<std::input_iterator_tag, Node> {
 public:
     NodeListIterator(const NodeList* nodeList, int nodeIndex);
+    NodeListIterator(const NodeListIterator& otherValue);
+    ~NodeListIterator();
     
     int getNodeIndex() { return _nodeIndex; }
     
@@ -197,9 +360,18 @@ public:
 	NodeListIterator& operator++();
     NodeListIterator operator++(int);
 private:
+    friend class NodeList;
+    
+    // builds the end iterator, which never pins the list
+    explicit NodeListIterator(const NodeList* nodeList);
+    
     void skipDeadAndStopIncrement();
+    bool isAtEnd() const { return _nodeIndex >= _numNodes; }
     
     const NodeList* _nodeList;
+    const NodeListSnapshot* _snapshot;
+    int _numNodes;
+    int _readEpoch;
     int _nodeIndex;
 };
 
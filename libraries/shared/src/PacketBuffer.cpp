@@ -0,0 +1,102 @@
+//
+//  PacketBuffer.cpp
+//  shared
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <cstring>
+
+#include <QtCore/QDebug>
+
+#include "PacketBuffer.h"
+
+// buffers beyond this many that come back to the pool are deleted, so a burst doesn't hold on to memory forever
+const int MAX_FREE_PACKET_BUFFERS = 1024;
+
+PacketBuffer::PacketBuffer() :
+    _referenceCount(0),
+    _sockAddr(),
+    _length(0),
+    _queuedUsecs(0)
+{
+    
+}
+
+void PacketBuffer::release() {
+    if (!_referenceCount.deref()) {
+        PacketBufferPool::getInstance()->recycle(this);
+    }
+}
+
+bool PacketBuffer::copyContents(const HifiSockAddr& sockAddr, const unsigned char* packetData, int packetLength) {
+    if (packetLength < 0 || packetLength > MAX_PACKET_SIZE) {
+        qDebug(">>> PacketBuffer::copyContents() unexpected length=%d\n", packetLength);
+        _length = 0;
+        return false;
+    }
+    
+    _sockAddr = sockAddr;
+    _length = packetLength;
+    memcpy(_data, packetData, packetLength);
+    return true;
+}
+
+PacketBufferPool* PacketBufferPool::getInstance() {
+    static PacketBufferPool sharedInstance;
+    return &sharedInstance;
+}
+
+PacketBufferPool::PacketBufferPool() :
+    _mutex(),
+    _freeBuffers(),
+    _numAllocated(0)
+{
+    _freeBuffers.reserve(MAX_FREE_PACKET_BUFFERS);
+}
+
+PacketBufferPool::~PacketBufferPool() {
+    for (std::vector<PacketBuffer*>::iterator buffer = _freeBuffers.begin(); buffer != _freeBuffers.end(); buffer++) {
+        delete *buffer;
+    }
+}
+
+PacketBuffer* PacketBufferPool::acquire() {
+    PacketBuffer* buffer = NULL;
+    
+    _mutex.lock();
+    if (!_freeBuffers.empty()) {
+        buffer = _freeBuffers.back();
+        _freeBuffers.pop_back();
+    }
+    _mutex.unlock();
+    
+    if (!buffer) {
+        buffer = new PacketBuffer();
+        _numAllocated.ref();
+    }
+    
+    buffer->_referenceCount.storeRelease(1);
+    buffer->_length = 0;
+    
+    return buffer;
+}
+
+int PacketBufferPool::getNumFree() {
+    QMutexLocker locker(&_mutex);
+    return _freeBuffers.size();
+}
+
+void PacketBufferPool::recycle(PacketBuffer* buffer) {
+    _mutex.lock();
+    if ((int) _freeBuffers.size() < MAX_FREE_PACKET_BUFFERS) {
+        _freeBuffers.push_back(buffer);
+        buffer = NULL;
+    }
+    _mutex.unlock();
+    
+    if (buffer) {
+        delete buffer;
+        _numAllocated.deref();
+    }
+}
@@ -0,0 +1,88 @@
+//
+//  PacketBuffer.h
+//  shared
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+//  Pooled, reference counted storage for a network packet.
+//
+
+#ifndef __shared__PacketBuffer__
+#define __shared__PacketBuffer__
+
+#include <vector>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+
+#include "BatchedUdpSocket.h" // for MAX_PACKET_SIZE
+#include "HifiSockAddr.h"
+
+/// A network packet taken from the PacketBufferPool. It goes back to the pool when its last reference is released, so a
+/// packet can be read from the socket straight into one and handed between threads without being copied.
+class PacketBuffer {
+public:
+    /// adds a reference - safe from any thread
+    void retain() { _referenceCount.ref(); }
+    
+    /// drops a reference, returning the buffer to the pool if it was the last - safe from any thread
+    void release();
+    
+    const HifiSockAddr& getSockAddr() const { return _sockAddr; }
+    void setSockAddr(const HifiSockAddr& sockAddr) { _sockAddr = sockAddr; }
+    
+    unsigned char* getData() { return _data; }
+    const unsigned char* getData() const { return _data; }
+    
+    int getLength() const { return _length; }
+    void setLength(int length) { _length = length; }
+    
+    /// copies packetLength bytes of packetData in - for callers that didn't read straight into the buffer
+    /// \return false if the packet is larger than MAX_PACKET_SIZE, in which case nothing is copied
+    bool copyContents(const HifiSockAddr& sockAddr, const unsigned char* packetData, int packetLength);
+    
+    /// when the buffer was last queued, stamped by PacketQueue for its latency stats
+    quint64 getQueuedUsecs() const { return _queuedUsecs; }
+    void setQueuedUsecs(quint64 queuedUsecs) { _queuedUsecs = queuedUsecs; }
+private:
+    friend class PacketBufferPool;
+    
+    PacketBuffer();
+    
+    // disallow copying of PacketBuffer objects
+    PacketBuffer(const PacketBuffer&);
+    PacketBuffer& operator= (const PacketBuffer&);
+    
+    QAtomicInt _referenceCount;
+    HifiSockAddr _sockAddr;
+    int _length;
+    quint64 _queuedUsecs;
+    unsigned char _data[MAX_PACKET_SIZE];
+};
+
+/// Recycles PacketBuffers so that packets don't cost an allocation each.
+class PacketBufferPool {
+public:
+    static PacketBufferPool* getInstance();
+    
+    ~PacketBufferPool();
+    
+    /// a buffer with a single reference, held by the caller - safe from any thread
+    PacketBuffer* acquire();
+    
+    /// buffers allocated and not yet deleted, whether in use or waiting in the pool
+    int getNumAllocated() const { return _numAllocated.loadAcquire(); }
+    int getNumFree();
+private:
+    friend class PacketBuffer;
+    
+    PacketBufferPool();
+    
+    void recycle(PacketBuffer* buffer);
+    
+    QMutex _mutex;
+    std::vector<PacketBuffer*> _freeBuffers;
+    QAtomicInt _numAllocated;
+};
+
+#endif /* defined(__shared__PacketBuffer__) */
@@ -17,10 +17,16 @@ PACKET_VERSION versionForPacketType(PACKET_TYPE type) {
 
         case PACKET_TYPE_MICROPHONE_AUDIO_NO_ECHO:
         case PACKET_TYPE_MICROPHONE_AUDIO_WITH_ECHO:
-            return 2;
+            return 3;
+        
+        case PACKET_TYPE_MIXED_AUDIO:
+            return 1;
 
         case PACKET_TYPE_HEAD_DATA:
-            return 12;
+            return 13;
+        
+        case PACKET_TYPE_BULK_AVATAR_DATA:
+            return 2;
         
         case PACKET_TYPE_AVATAR_URLS:
             return 2;
@@ -34,7 +40,7 @@ PACKET_VERSION versionForPacketType(PACKET_TYPE type) {
         case PACKET_TYPE_DOMAIN:
         case PACKET_TYPE_DOMAIN_LIST_REQUEST:
         case PACKET_TYPE_DOMAIN_REPORT_FOR_DUTY:
-            return 2;
+            return 3;
         
         case PACKET_TYPE_VOXEL_QUERY:
             return 2;
@@ -42,6 +48,8 @@ PACKET_VERSION versionForPacketType(PACKET_TYPE type) {
         case PACKET_TYPE_VOXEL_SET:
         case PACKET_TYPE_VOXEL_SET_DESTRUCTIVE:
         case PACKET_TYPE_VOXEL_ERASE:
+        case PACKET_TYPE_VOXEL_FILL:
+        case PACKET_TYPE_VOXEL_SUBTREE:
             return 1;
 
         case PACKET_TYPE_VOXEL_DATA:
@@ -24,6 +24,7 @@ const PACKET_TYPE PACKET_TYPE_INJECT_AUDIO = 'I';
 const PACKET_TYPE PACKET_TYPE_MIXED_AUDIO = 'A';
 const PACKET_TYPE PACKET_TYPE_MICROPHONE_AUDIO_NO_ECHO = 'M';
 const PACKET_TYPE PACKET_TYPE_MICROPHONE_AUDIO_WITH_ECHO = 'm';
+const PACKET_TYPE PACKET_TYPE_AUDIO_MIXER_REGION = 'W';
 const PACKET_TYPE PACKET_TYPE_BULK_AVATAR_DATA = 'X';
 const PACKET_TYPE PACKET_TYPE_AVATAR_URLS = 'U';
 const PACKET_TYPE PACKET_TYPE_AVATAR_FACE_VIDEO = 'F';
@@ -34,6 +35,7 @@ const PACKET_TYPE PACKET_TYPE_DOMAIN_REPORT_FOR_DUTY = 'C';
 const PACKET_TYPE PACKET_TYPE_REQUEST_ASSIGNMENT = 'r';
 const PACKET_TYPE PACKET_TYPE_CREATE_ASSIGNMENT = 's';
 const PACKET_TYPE PACKET_TYPE_DEPLOY_ASSIGNMENT = 'd';
+const PACKET_TYPE PACKET_TYPE_SCRIPT_FRAME_STATS = 'y';
 const PACKET_TYPE PACKET_TYPE_DATA_SERVER_PUT = 'p';
 const PACKET_TYPE PACKET_TYPE_DATA_SERVER_GET = 'g';
 const PACKET_TYPE PACKET_TYPE_DATA_SERVER_SEND = 'u';
@@ -43,6 +45,8 @@ const PACKET_TYPE PACKET_TYPE_VOXEL_DATA = 'V';
 const PACKET_TYPE PACKET_TYPE_VOXEL_SET = 'S';
 const PACKET_TYPE PACKET_TYPE_VOXEL_SET_DESTRUCTIVE = 'O';
 const PACKET_TYPE PACKET_TYPE_VOXEL_ERASE = 'E';
+const PACKET_TYPE PACKET_TYPE_VOXEL_FILL = 'f';
+const PACKET_TYPE PACKET_TYPE_VOXEL_SUBTREE = 'o';
 const PACKET_TYPE PACKET_TYPE_OCTREE_STATS = '#';
 const PACKET_TYPE PACKET_TYPE_JURISDICTION = 'J';
 const PACKET_TYPE PACKET_TYPE_JURISDICTION_REQUEST = 'j';
@@ -51,6 +55,9 @@ const PACKET_TYPE PACKET_TYPE_PARTICLE_DATA = 'v';
 const PACKET_TYPE PACKET_TYPE_PARTICLE_ADD_OR_EDIT = 'a';
 const PACKET_TYPE PACKET_TYPE_PARTICLE_ERASE = 'x';
 const PACKET_TYPE PACKET_TYPE_PARTICLE_ADD_RESPONSE = 'b';
+const PACKET_TYPE PACKET_TYPE_PARTICLE_SNAPSHOT = 'z';
+const PACKET_TYPE PACKET_TYPE_RELIABLE = 'Y';
+const PACKET_TYPE PACKET_TYPE_RELIABLE_ACK = 'k';
 
 typedef char PACKET_VERSION;
 
@@ -0,0 +1,150 @@
+//
+//  PacketQueue.cpp
+//  shared
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+//  The ring follows Dmitry Vyukov's bounded MPMC queue - each cell's sequence number hands it from the producer that
+//  claimed its position to the consumer and back, so neither side ever takes a lock.
+//
+
+#include "SharedUtil.h"
+
+#include "PacketQueue.h"
+
+PacketQueue::PacketQueue(int capacity) :
+    _enqueuePosition(0),
+    _dequeuePosition(0),
+    _numDropped(0),
+    _maxDepth(0)
+{
+    int roundedCapacity = 1;
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1;
+    }
+    
+    _cells = new Cell[roundedCapacity];
+    _mask = roundedCapacity - 1;
+    
+    for (int i = 0; i < roundedCapacity; i++) {
+        _cells[i].sequence.storeRelease(i);
+        _cells[i].packet = NULL;
+    }
+    
+    resetStats();
+}
+
+PacketQueue::~PacketQueue() {
+    PacketBuffer* packet;
+    while ((packet = pop())) {
+        packet->release();
+    }
+    
+    delete[] _cells;
+}
+
+bool PacketQueue::push(PacketBuffer* packet) {
+    // positions wrap, so they are compared as the signed difference of unsigned values
+    unsigned int position = _enqueuePosition.loadAcquire();
+    Cell* cell;
+    
+    while (true) {
+        cell = &_cells[position & _mask];
+        int difference = (int) ((unsigned int) cell->sequence.loadAcquire() - position);
+        
+        if (difference == 0) {
+            // the cell is free for this position - claim the position, unless another producer got there first
+            if (_enqueuePosition.testAndSetOrdered(position, position + 1)) {
+                break;
+            }
+            position = _enqueuePosition.loadAcquire();
+        } else if (difference < 0) {
+            // the cell still holds the packet from a lap ago, so the queue is full
+            _numDropped.ref();
+            return false;
+        } else {
+            position = _enqueuePosition.loadAcquire();
+        }
+    }
+    
+    packet->retain();
+    packet->setQueuedUsecs(usecTimestampNow());
+    
+    cell->packet = packet;
+    cell->sequence.storeRelease(position + 1);
+    
+    int depth = (int) (position + 1 - (unsigned int) _dequeuePosition.loadAcquire());
+    int maxDepth = _maxDepth.loadAcquire();
+    while (depth > maxDepth && !_maxDepth.testAndSetOrdered(maxDepth, depth)) {
+        maxDepth = _maxDepth.loadAcquire();
+    }
+    
+    return true;
+}
+
+PacketBuffer* PacketQueue::pop() {
+    unsigned int position = _dequeuePosition.loadAcquire();
+    Cell* cell = &_cells[position & _mask];
+    
+    if ((int) ((unsigned int) cell->sequence.loadAcquire() - (position + 1)) < 0) {
+        // nothing has been pushed to this position yet
+        return NULL;
+    }
+    
+    PacketBuffer* packet = cell->packet;
+    cell->packet = NULL;
+    
+    _dequeuePosition.storeRelease(position + 1);
+    
+    // hand the cell back to the producers for the next lap
+    cell->sequence.storeRelease(position + _mask + 1);
+    
+    quint64 latency = usecTimestampNow() - packet->getQueuedUsecs();
+    int bucket = 0;
+    while (latency > 1 && bucket < NUM_PACKET_QUEUE_LATENCY_BUCKETS - 1) {
+        latency >>= 1;
+        bucket++;
+    }
+    _latencyBuckets[bucket].ref();
+    
+    return packet;
+}
+
+int PacketQueue::size() const {
+    return (int) ((unsigned int) _enqueuePosition.loadAcquire() - (unsigned int) _dequeuePosition.loadAcquire());
+}
+
+quint64 PacketQueue::getLatencyPercentile(float percentile) const {
+    int bucketCounts[NUM_PACKET_QUEUE_LATENCY_BUCKETS];
+    int totalCount = 0;
+    
+    for (int i = 0; i < NUM_PACKET_QUEUE_LATENCY_BUCKETS; i++) {
+        bucketCounts[i] = _latencyBuckets[i].loadAcquire();
+        totalCount += bucketCounts[i];
+    }
+    
+    if (totalCount == 0) {
+        return 0;
+    }
+    
+    int targetCount = ceilf(totalCount * percentile);
+    int runningCount = 0;
+    
+    for (int i = 0; i < NUM_PACKET_QUEUE_LATENCY_BUCKETS; i++) {
+        runningCount += bucketCounts[i];
+        if (runningCount >= targetCount) {
+            return (quint64) 1 << i;
+        }
+    }
+    
+    return (quint64) 1 << (NUM_PACKET_QUEUE_LATENCY_BUCKETS - 1);
+}
+
+void PacketQueue::resetStats() {
+    _numDropped.storeRelease(0);
+    _maxDepth.storeRelease(size());
+    
+    for (int i = 0; i < NUM_PACKET_QUEUE_LATENCY_BUCKETS; i++) {
+        _latencyBuckets[i].storeRelease(0);
+    }
+}
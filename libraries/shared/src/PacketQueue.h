@@ -0,0 +1,79 @@
+//
+//  PacketQueue.h
+//  shared
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+//  Bounded lock-free queue of PacketBuffers, from any number of threads to one consumer.
+//
+
+#ifndef __shared__PacketQueue__
+#define __shared__PacketQueue__
+
+#include <QtCore/QAtomicInt>
+
+#include "PacketBuffer.h"
+
+// latencies are counted in power of two buckets of usecs, the last catching everything from about 8 seconds up
+const int NUM_PACKET_QUEUE_LATENCY_BUCKETS = 24;
+
+/// A bounded multi-producer single-consumer queue of PacketBuffers. Any thread may push, only one thread may pop. A push
+/// to a full queue drops the packet rather than blocking or growing. Keeps the stats the queue's owner reports - depth,
+/// drops and how long packets waited.
+class PacketQueue {
+public:
+    /// \param capacity the most packets the queue holds, rounded up to a power of two
+    PacketQueue(int capacity);
+    
+    /// releases any packets still queued
+    ~PacketQueue();
+    
+    /// queues packet, taking a reference to it - safe from any thread
+    /// \return false if the queue was full, in which case the packet is counted as dropped and not referenced
+    bool push(PacketBuffer* packet);
+    
+    /// \return the oldest packet, whose reference now belongs to the caller, or NULL if the queue is empty - consumer only
+    PacketBuffer* pop();
+    
+    /// number of packets queued - safe from any thread, though it may be stale by the time it's used
+    int size() const;
+    bool isEmpty() const { return size() == 0; }
+    
+    int getCapacity() const { return _mask + 1; }
+    
+    /// packets dropped because the queue was full, since the stats were last reset
+    int getNumDropped() const { return _numDropped.loadAcquire(); }
+    
+    /// the deepest the queue has been since the stats were last reset
+    int getMaxDepth() const { return _maxDepth.loadAcquire(); }
+    
+    /// the wait in usecs that the given fraction of the packets popped since the stats were last reset waited no longer
+    /// than - accurate to the power of two above it
+    quint64 getLatencyPercentile(float percentile) const;
+    
+    void resetStats();
+private:
+    // disallow copying of PacketQueue objects
+    PacketQueue(const PacketQueue&);
+    PacketQueue& operator= (const PacketQueue&);
+    
+    /// a slot in the ring - its sequence says whether it is free for the push at that position, or holds the packet
+    /// for the pop at that position
+    class Cell {
+    public:
+        QAtomicInt sequence;
+        PacketBuffer* packet;
+    };
+    
+    Cell* _cells;
+    int _mask;
+    
+    QAtomicInt _enqueuePosition;
+    QAtomicInt _dequeuePosition;
+    
+    QAtomicInt _numDropped;
+    QAtomicInt _maxDepth;
+    QAtomicInt _latencyBuckets[NUM_PACKET_QUEUE_LATENCY_BUCKETS];
+};
+
+#endif /* defined(__shared__PacketQueue__) */
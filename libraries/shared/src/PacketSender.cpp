@@ -23,6 +23,7 @@ const int PacketSender::MAX_SLEEP_INTERVAL = PacketSender::USECS_PER_SECOND;
 const int PacketSender::DEFAULT_PACKETS_PER_SECOND = 30;
 const int PacketSender::MINIMUM_PACKETS_PER_SECOND = 1;
 const int PacketSender::MINIMAL_SLEEP_INTERVAL = (USECS_PER_SECOND / TARGET_FPS) / 2;
+const int PacketSender::MAX_PACKETS_TO_SEND = 16384;
 
 const int AVERAGE_CALL_TIME_SAMPLES = 10;
 
@@ -31,6 +32,7 @@ PacketSender::PacketSender(PacketSenderNotify* notify, int packetsPerSecond) :
     _usecsPerProcessCallHint(0),
     _lastProcessCallTime(0),
     _averageProcessCallTime(AVERAGE_CALL_TIME_SAMPLES),
+    _packets(MAX_PACKETS_TO_SEND),
     _lastSendTime(0), // Note: we set this to 0 to indicate we haven't yet sent something
     _notify(notify),
     _lastPPSCheck(0),
@@ -45,12 +47,19 @@ PacketSender::PacketSender(PacketSenderNotify* notify, int packetsPerSecond) :
 
 
 void PacketSender::queuePacketForSending(const HifiSockAddr& address, unsigned char* packetData, ssize_t packetLength) {
-    NetworkPacket packet(address, packetData, packetLength);
-    lock();
-    _packets.push_back(packet);
-    unlock();
-    _totalPacketsQueued++;
-    _totalBytesQueued += packetLength;
+    PacketBuffer* packet = PacketBufferPool::getInstance()->acquire();
+    if (packet->copyContents(address, packetData, packetLength)) {
+        queuePacketForSending(packet);
+    }
+    packet->release();
+}
+
+void PacketSender::queuePacketForSending(PacketBuffer* packet) {
+    // if the queue is full the packet is dropped, and counted in the queue's stats
+    if (_packets.push(packet)) {
+        _totalPacketsQueued++;
+        _totalBytesQueued += packet->getLength();
+    }
 }
 
 bool PacketSender::process() {
@@ -69,7 +78,7 @@ bool PacketSender::threadedProcess() {
     }
     
     // in threaded mode, we keep running and just empty our packet queue sleeping enough to keep our PPS on target
-    while (_packets.size() > 0) {
+    while (!_packets.isEmpty()) {
         // Recalculate our SEND_INTERVAL_USECS each time, in case the caller has changed it on us..
         int packetsPerSecondTarget = (_packetsPerSecond > MINIMUM_PACKETS_PER_SECOND) 
                                             ? _packetsPerSecond : MINIMUM_PACKETS_PER_SECOND;
@@ -136,7 +145,7 @@ bool PacketSender::nonThreadedProcess() {
     
     bool wantDebugging = false;
     if (wantDebugging) {
-        printf("\n\nPacketSender::nonThreadedProcess() _packets.size()=%ld\n",_packets.size());
+        printf("\n\nPacketSender::nonThreadedProcess() _packets.size()=%d\n",_packets.size());
     }
     
     // keep track of our process call times, so we have a reliable account of how often our caller calls us
@@ -166,7 +175,7 @@ bool PacketSender::nonThreadedProcess() {
         printf("elapsedSinceLastCall=%llu averageCallTime=%f\n",elapsedSinceLastCall, averageCallTime);
     }
     
-    if (_packets.size() == 0) {
+    if (_packets.isEmpty()) {
         // in non-threaded mode, if there's nothing to do, just return, keep running till they terminate us
         return isStillRunning(); 
     }
@@ -326,30 +335,34 @@ bool PacketSender::nonThreadedProcess() {
     
     // Now that we know how many packets to send this call to process, just send them.
     while ((packetsSentThisCall < packetsToSendThisCall) && (packetsLeft > 0)) {
-        lock();
-        NetworkPacket& packet = _packets.front();
-        NetworkPacket temporary = packet; // make a copy
-        _packets.erase(_packets.begin());
+        PacketBuffer* packet = _packets.pop();
+        if (!packet) {
+            break;
+        }
         packetsLeft = _packets.size();
-        unlock();
+        int packetLength = packet->getLength();
 
-        // send the packet through the NodeList...
-        NodeList::getInstance()->getNodeSocket().writeDatagram((char*) temporary.getData(), temporary.getLength(),
-                                                               temporary.getSockAddr().getAddress(),
-                                                               temporary.getSockAddr().getPort());
+        // queue the packet on the NodeList's socket, this call's packets go out together below
+        NodeList::getInstance()->getBatchedNodeSocket().queueDatagram((char*) packet->getData(), packetLength,
+                                                                      packet->getSockAddr());
+        packet->release();
+        
         packetsSentThisCall++;
         _packetsOverCheckInterval++;
         _totalPacketsSent++;
-        _totalBytesSent += temporary.getLength();
+        _totalBytesSent += packetLength;
 
         if (wantDebugging) {
             printf("nodeSocket->send()... packetsSentThisCall=%d _packetsOverCheckInterval=%d\n",
                 packetsSentThisCall, _packetsOverCheckInterval);
         }
         if (_notify) {
-            _notify->packetSentNotification(temporary.getLength());
+            _notify->packetSentNotification(packetLength);
         }
         _lastSendTime = now;
     }
+    
+    NodeList::getInstance()->getBatchedNodeSocket().flush();
+    
     return isStillRunning();
 }
\ No newline at end of file
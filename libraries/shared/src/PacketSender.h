@@ -12,7 +12,7 @@
 #define __shared__PacketSender__
 
 #include "GenericThread.h"
-#include "NetworkPacket.h"
+#include "PacketQueue.h"
 #include "SharedUtil.h"
 
 /// Notification Hook for packets being sent by a PacketSender
@@ -34,6 +34,7 @@ public:
     static const int DEFAULT_PACKETS_PER_SECOND;
     static const int MINIMUM_PACKETS_PER_SECOND;
     static const int MINIMAL_SLEEP_INTERVAL;
+    static const int MAX_PACKETS_TO_SEND;
 
     PacketSender(PacketSenderNotify* notify = NULL, int packetsPerSecond = DEFAULT_PACKETS_PER_SECOND);
 
@@ -44,6 +45,11 @@ public:
     /// \thread any thread, typically the application thread
     void queuePacketForSending(const HifiSockAddr& address, unsigned char*  packetData, ssize_t packetLength);
     
+    /// Add a packet that is already in a pooled buffer to the outbound queue, without copying it. Takes a reference to the
+    /// packet, so the caller still releases its own.
+    /// \thread any thread, typically the application thread
+    void queuePacketForSending(PacketBuffer* packet);
+    
     void setPacketsPerSecond(int packetsPerSecond) 
         { _packetsPerSecond = std::max(MINIMUM_PACKETS_PER_SECOND, packetsPerSecond); }
     int getPacketsPerSecond() const { return _packetsPerSecond; }
@@ -54,11 +60,14 @@ public:
     virtual bool process();
 
     /// are there packets waiting in the send queue to be sent
-    bool hasPacketsToSend() const { return _packets.size() > 0; }
+    bool hasPacketsToSend() const { return !_packets.isEmpty(); }
 
     /// how many packets are there in the send queue waiting to be sent
     int packetsToSendCount() const { return _packets.size(); }
 
+    /// the queue of packets waiting to be sent, for its drop and latency stats
+    PacketQueue& getPacketQueue() { return _packets; }
+
     /// If you're running in non-threaded mode, call this to give us a hint as to how frequently you will call process.
     /// This has no effect in threaded mode. This is only considered a hint in non-threaded mode.
     /// \param int usecsPerProcessCall expected number of usecs between calls to process in non-threaded mode.
@@ -105,7 +114,7 @@ protected:
     SimpleMovingAverage _averageProcessCallTime;
     
 private:
-    std::vector<NetworkPacket> _packets;
+    PacketQueue _packets;
     uint64_t _lastSendTime;
     PacketSenderNotify* _notify;
 
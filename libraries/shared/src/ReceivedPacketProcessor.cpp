@@ -12,39 +12,44 @@
 #include "ReceivedPacketProcessor.h"
 #include "SharedUtil.h"
 
-ReceivedPacketProcessor::ReceivedPacketProcessor() {
+ReceivedPacketProcessor::ReceivedPacketProcessor() :
+    _packets(MAX_RECEIVED_PACKETS_TO_PROCESS)
+{
     _dontSleep = false;
 }
 
 void ReceivedPacketProcessor::queueReceivedPacket(const HifiSockAddr& address, unsigned char* packetData, ssize_t packetLength) {
+    PacketBuffer* packet = PacketBufferPool::getInstance()->acquire();
+    if (packet->copyContents(address, packetData, packetLength)) {
+        queueReceivedPacket(packet);
+    }
+    packet->release();
+}
+
+void ReceivedPacketProcessor::queueReceivedPacket(PacketBuffer* packet) {
     // Make sure our Node and NodeList knows we've heard from this node.
-    Node* node = NodeList::getInstance()->nodeWithAddress(address);
+    Node* node = NodeList::getInstance()->nodeWithAddress(packet->getSockAddr());
     if (node) {
         node->setLastHeardMicrostamp(usecTimestampNow());
     }
 
-    NetworkPacket packet(address, packetData, packetLength);
-    lock();
-    _packets.push_back(packet);
-    unlock();
+    // if we've fallen this far behind the packet is dropped, and counted in the queue's stats
+    _packets.push(packet);
 }
 
 bool ReceivedPacketProcessor::process() {
 
     // If a derived class handles process sleeping, like the JurisdiciontListener, then it can set
     // this _dontSleep member and we will honor that request.
-    if (_packets.size() == 0 && !_dontSleep) {
+    if (_packets.isEmpty() && !_dontSleep) {
         const uint64_t RECEIVED_THREAD_SLEEP_INTERVAL = (1000 * 1000)/60; // check at 60fps
         usleep(RECEIVED_THREAD_SLEEP_INTERVAL);
     }
-    while (_packets.size() > 0) {
-
-        lock(); // lock to make sure nothing changes on us
-        NetworkPacket& packet = _packets.front(); // get the oldest packet
-        NetworkPacket temporary = packet; // make a copy of the packet in case the vector is resized on us
-        _packets.erase(_packets.begin()); // remove the oldest packet
-        unlock(); // let others add to the packets
-        processPacket(temporary.getSockAddr(), temporary.getData(), temporary.getLength()); // process our temporary copy
+    PacketBuffer* packet;
+    while ((packet = _packets.pop())) {
+        // this is the only thread that pops, so the packet is ours until we release it
+        processPacket(packet->getSockAddr(), packet->getData(), packet->getLength());
+        packet->release();
     }
     return isStillRunning();  // keep running till they terminate us
 }
@@ -12,7 +12,10 @@
 #define __shared__ReceivedPacketProcessor__
 
 #include "GenericThread.h"
-#include "NetworkPacket.h"
+#include "PacketQueue.h"
+
+// received packets beyond this many waiting to be processed are dropped
+const int MAX_RECEIVED_PACKETS_TO_PROCESS = 4096;
 
 /// Generalized threaded processor for handling received inbound packets. 
 class ReceivedPacketProcessor : public virtual GenericThread {
@@ -26,12 +29,20 @@ public:
     /// \thread network receive thread
     void queueReceivedPacket(const HifiSockAddr& senderSockAddr, unsigned char*  packetData, ssize_t packetLength);
 
+    /// Add a packet that was read straight into a pooled buffer, without copying it. Takes a reference to the packet, so
+    /// the caller still releases its own.
+    /// \thread network receive thread
+    void queueReceivedPacket(PacketBuffer* packet);
+
     /// Are there received packets waiting to be processed
-    bool hasPacketsToProcess() const { return _packets.size() > 0; }
+    bool hasPacketsToProcess() const { return !_packets.isEmpty(); }
 
     /// How many received packets waiting are to be processed
     int packetsToProcessCount() const { return _packets.size(); }
 
+    /// the queue of received packets, for its drop and latency stats
+    PacketQueue& getPacketQueue() { return _packets; }
+
 protected:
     /// Callback for processing of recieved packets. Implement this to process the incoming packets.
     /// \param sockaddr& senderAddress the address of the sender
@@ -47,7 +58,7 @@ protected:
 
 private:
 
-    std::vector<NetworkPacket> _packets;
+    PacketQueue _packets;
 };
 
 #endif // __shared__PacketReceiver__
@@ -0,0 +1,315 @@
+//
+//  ReliableChannel.cpp
+//  shared
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <QtCore/QDebug>
+
+#include "BatchedUdpSocket.h"
+#include "PacketHeaders.h"
+#include "ReliableChannel.h"
+#include "SharedUtil.h"
+
+const int NUM_BYTES_RELIABLE_HEADER = 3 * sizeof(uint16_t);
+const int NUM_BYTES_RELIABLE_ACK = 2 * sizeof(uint16_t) + sizeof(uint32_t);
+
+// sequence numbers wrap, so they're compared by their distance rather than their value
+static bool sequenceLessThan(uint16_t a, uint16_t b) {
+    return (int16_t) (a - b) < 0;
+}
+
+ReliableChannel::ReliableChannel(const HifiSockAddr& peerSockAddr, int initialRttUsecs) :
+    _peerSockAddr(peerSockAddr),
+    _lastActivityUsecs(usecTimestampNow()),
+    _sessionID(randIntInRange(0, 0xFFFF)),
+    _nextSequence(0),
+    _hasRttSample(false),
+    _smoothedRttUsecs(0),
+    _rttVariationUsecs(0),
+    _numRetransmits(0),
+    _numFailedMessages(0),
+    _hasReceivedSession(false),
+    _receivedSessionID(0),
+    _nextExpectedSequence(0)
+{
+    clearReceivedMessages();
+    
+    if (initialRttUsecs > 0) {
+        addRttSample(initialRttUsecs);
+    }
+}
+
+bool ReliableChannel::sendMessage(QUdpSocket& socket, const unsigned char* message, int messageLength) {
+    unsigned char header[MAX_PACKET_HEADER_BYTES];
+    int numBytesPacketHeader = populateTypeAndVersion(header, PACKET_TYPE_RELIABLE);
+    
+    if (numBytesPacketHeader + NUM_BYTES_RELIABLE_HEADER + messageLength > MAX_PACKET_SIZE) {
+        qDebug() << "ReliableChannel dropping a message of" << messageLength << "bytes, too large to send reliably.\n";
+        return false;
+    }
+    
+    SentMessage sentMessage;
+    sentMessage.sequence = _nextSequence++;
+    sentMessage.lastSentUsecs = 0;
+    sentMessage.numTransmits = 0;
+    sentMessage.timeoutUsecs = 0;
+    
+    // the oldest unacknowledged sequence is filled in each time the message is transmitted
+    uint16_t sequenceFields[] = { _sessionID, sentMessage.sequence, 0 };
+    
+    sentMessage.packet.reserve(numBytesPacketHeader + NUM_BYTES_RELIABLE_HEADER + messageLength);
+    sentMessage.packet.append((char*) header, numBytesPacketHeader);
+    sentMessage.packet.append((char*) sequenceFields, NUM_BYTES_RELIABLE_HEADER);
+    sentMessage.packet.append((char*) message, messageLength);
+    
+    _pendingMessages.push_back(sentMessage);
+    transmitPendingMessages(socket);
+    
+    return true;
+}
+
+void ReliableChannel::processMessage(QUdpSocket& socket, const unsigned char* packetData, int packetLength,
+                                     std::vector<QByteArray>& deliveredMessages) {
+    int numBytesPacketHeader = numBytesForPacketHeader(packetData);
+    if (packetLength < numBytesPacketHeader + NUM_BYTES_RELIABLE_HEADER) {
+        return;
+    }
+    
+    uint16_t sequenceFields[3];
+    memcpy(sequenceFields, packetData + numBytesPacketHeader, NUM_BYTES_RELIABLE_HEADER);
+    uint16_t sessionID = sequenceFields[0];
+    uint16_t sequence = sequenceFields[1];
+    uint16_t oldestUnacknowledged = sequenceFields[2];
+    
+    _lastActivityUsecs = usecTimestampNow();
+    
+    if (!_hasReceivedSession || sessionID != _receivedSessionID) {
+        // a new stream, either the first we've heard or the peer has restarted - anything older than what it's
+        // still waiting on has already been delivered to whoever it was talking to before
+        _hasReceivedSession = true;
+        _receivedSessionID = sessionID;
+        _nextExpectedSequence = oldestUnacknowledged;
+        clearReceivedMessages();
+    } else if (sequenceLessThan(_nextExpectedSequence, oldestUnacknowledged)) {
+        // the sender gave up on the messages we were waiting for, so stop waiting for them
+        while (_nextExpectedSequence != oldestUnacknowledged) {
+            int slot = _nextExpectedSequence % RELIABLE_WINDOW_SIZE;
+            
+            if (_hasReceivedMessage[slot]) {
+                deliveredMessages.push_back(_receivedMessages[slot]);
+                _receivedMessages[slot].clear();
+                _hasReceivedMessage[slot] = false;
+            }
+            
+            _nextExpectedSequence++;
+        }
+    }
+    
+    uint16_t offset = sequence - _nextExpectedSequence;
+    if (!sequenceLessThan(sequence, _nextExpectedSequence) && offset < RELIABLE_WINDOW_SIZE) {
+        int slot = sequence % RELIABLE_WINDOW_SIZE;
+        
+        if (!_hasReceivedMessage[slot]) {
+            int numBytesHeader = numBytesPacketHeader + NUM_BYTES_RELIABLE_HEADER;
+            _receivedMessages[slot] = QByteArray((char*) packetData + numBytesHeader, packetLength - numBytesHeader);
+            _hasReceivedMessage[slot] = true;
+        }
+    }
+    
+    deliverReceivedMessages(deliveredMessages);
+    
+    // duplicates are acknowledged too, since it was probably our last ack that was lost
+    sendAck(socket);
+}
+
+void ReliableChannel::processAck(QUdpSocket& socket, const unsigned char* packetData, int packetLength) {
+    int numBytesPacketHeader = numBytesForPacketHeader(packetData);
+    if (packetLength < numBytesPacketHeader + NUM_BYTES_RELIABLE_ACK) {
+        return;
+    }
+    
+    const unsigned char* dataAt = packetData + numBytesPacketHeader;
+    
+    uint16_t sessionID;
+    memcpy(&sessionID, dataAt, sizeof(sessionID));
+    dataAt += sizeof(sessionID);
+    
+    if (sessionID != _sessionID) {
+        // an ack for a stream we no longer have
+        return;
+    }
+    
+    uint16_t nextExpectedSequence;
+    memcpy(&nextExpectedSequence, dataAt, sizeof(nextExpectedSequence));
+    dataAt += sizeof(nextExpectedSequence);
+    
+    uint32_t receivedMask;
+    memcpy(&receivedMask, dataAt, sizeof(receivedMask));
+    
+    uint64_t now = usecTimestampNow();
+    _lastActivityUsecs = now;
+    
+    int rttSampleUsecs = 0;
+    
+    for (std::deque<SentMessage>::iterator message = _messagesInFlight.begin(); message != _messagesInFlight.end(); ) {
+        bool isAcknowledged = sequenceLessThan(message->sequence, nextExpectedSequence);
+        
+        if (!isAcknowledged) {
+            uint16_t offset = message->sequence - nextExpectedSequence;
+            isAcknowledged = offset > 0 && offset < RELIABLE_WINDOW_SIZE && (receivedMask & (1 << (offset - 1)));
+        }
+        
+        if (isAcknowledged) {
+            // only messages sent once give a sample - we can't tell which send of a resent message was acknowledged
+            if (message->numTransmits == 1) {
+                rttSampleUsecs = now - message->lastSentUsecs;
+            }
+            
+            message = _messagesInFlight.erase(message);
+        } else {
+            ++message;
+        }
+    }
+    
+    if (rttSampleUsecs > 0) {
+        addRttSample(rttSampleUsecs);
+    }
+    
+    transmitPendingMessages(socket);
+}
+
+void ReliableChannel::resendTimedOutMessages(QUdpSocket& socket) {
+    uint64_t now = usecTimestampNow();
+    
+    for (std::deque<SentMessage>::iterator message = _messagesInFlight.begin(); message != _messagesInFlight.end(); ) {
+        if (now - message->lastSentUsecs < (uint64_t) message->timeoutUsecs) {
+            ++message;
+            continue;
+        }
+        
+        if (message->numTransmits >= MAX_RELIABLE_TRANSMITS) {
+            qDebug() << "ReliableChannel giving up on message" << message->sequence << "to" << _peerSockAddr.getAddress()
+                << "after" << message->numTransmits << "sends.\n";
+            
+            _numFailedMessages++;
+            message = _messagesInFlight.erase(message);
+            continue;
+        }
+        
+        message->timeoutUsecs = std::min(message->timeoutUsecs * 2, MAX_RELIABLE_RETRANSMIT_USECS);
+        transmit(socket, *message);
+        
+        _numRetransmits++;
+        ++message;
+    }
+    
+    // giving up may have opened the window
+    transmitPendingMessages(socket);
+}
+
+void ReliableChannel::addRttSample(int rttUsecs) {
+    if (!_hasRttSample) {
+        _smoothedRttUsecs = rttUsecs;
+        _rttVariationUsecs = rttUsecs / 2;
+        _hasRttSample = true;
+    } else {
+        // the usual 1/4 and 1/8 gains of the TCP estimator
+        _rttVariationUsecs += (abs(_smoothedRttUsecs - rttUsecs) - _rttVariationUsecs) / 4;
+        _smoothedRttUsecs += (rttUsecs - _smoothedRttUsecs) / 8;
+    }
+}
+
+int ReliableChannel::getRetransmitTimeoutUsecs() const {
+    if (!_hasRttSample) {
+        return INITIAL_RELIABLE_RETRANSMIT_USECS;
+    }
+    
+    int timeoutUsecs = _smoothedRttUsecs + 4 * _rttVariationUsecs;
+    return std::max(MIN_RELIABLE_RETRANSMIT_USECS, std::min(timeoutUsecs, MAX_RELIABLE_RETRANSMIT_USECS));
+}
+
+bool ReliableChannel::isIdle() const {
+    return _messagesInFlight.empty() && _pendingMessages.empty()
+        && usecTimestampNow() - _lastActivityUsecs > RELIABLE_CHANNEL_IDLE_USECS;
+}
+
+void ReliableChannel::transmit(QUdpSocket& socket, SentMessage& message) {
+    // let the receiver know what it can stop waiting for
+    uint16_t oldestUnacknowledged = _messagesInFlight.empty() ? message.sequence : _messagesInFlight.front().sequence;
+    int numBytesPacketHeader = numBytesForPacketHeader((unsigned char*) message.packet.constData());
+    memcpy(message.packet.data() + numBytesPacketHeader + 2 * sizeof(uint16_t), &oldestUnacknowledged,
+           sizeof(oldestUnacknowledged));
+    
+    socket.writeDatagram(message.packet, _peerSockAddr.getAddress(), _peerSockAddr.getPort());
+    
+    message.lastSentUsecs = usecTimestampNow();
+    message.numTransmits++;
+    _lastActivityUsecs = message.lastSentUsecs;
+}
+
+void ReliableChannel::transmitPendingMessages(QUdpSocket& socket) {
+    while (!_pendingMessages.empty()) {
+        SentMessage& message = _pendingMessages.front();
+        
+        // the receiver only buffers a window's worth past the oldest message it's missing
+        if (!_messagesInFlight.empty()
+            && (uint16_t) (message.sequence - _messagesInFlight.front().sequence) >= RELIABLE_WINDOW_SIZE) {
+            return;
+        }
+        
+        message.timeoutUsecs = getRetransmitTimeoutUsecs();
+        transmit(socket, message);
+        
+        _messagesInFlight.push_back(message);
+        _pendingMessages.pop_front();
+    }
+}
+
+void ReliableChannel::sendAck(QUdpSocket& socket) {
+    uint32_t receivedMask = 0;
+    for (int offset = 1; offset < RELIABLE_WINDOW_SIZE; offset++) {
+        if (_hasReceivedMessage[(uint16_t) (_nextExpectedSequence + offset) % RELIABLE_WINDOW_SIZE]) {
+            receivedMask |= 1 << (offset - 1);
+        }
+    }
+    
+    unsigned char ackPacket[MAX_PACKET_HEADER_BYTES + NUM_BYTES_RELIABLE_ACK];
+    unsigned char* dataAt = ackPacket + populateTypeAndVersion(ackPacket, PACKET_TYPE_RELIABLE_ACK);
+    
+    memcpy(dataAt, &_receivedSessionID, sizeof(_receivedSessionID));
+    dataAt += sizeof(_receivedSessionID);
+    
+    memcpy(dataAt, &_nextExpectedSequence, sizeof(_nextExpectedSequence));
+    dataAt += sizeof(_nextExpectedSequence);
+    
+    memcpy(dataAt, &receivedMask, sizeof(receivedMask));
+    dataAt += sizeof(receivedMask);
+    
+    socket.writeDatagram((char*) ackPacket, dataAt - ackPacket, _peerSockAddr.getAddress(), _peerSockAddr.getPort());
+}
+
+void ReliableChannel::clearReceivedMessages() {
+    for (int i = 0; i < RELIABLE_WINDOW_SIZE; i++) {
+        _receivedMessages[i].clear();
+        _hasReceivedMessage[i] = false;
+    }
+}
+
+void ReliableChannel::deliverReceivedMessages(std::vector<QByteArray>& deliveredMessages) {
+    int slot = _nextExpectedSequence % RELIABLE_WINDOW_SIZE;
+    
+    while (_hasReceivedMessage[slot]) {
+        deliveredMessages.push_back(_receivedMessages[slot]);
+        _receivedMessages[slot].clear();
+        _hasReceivedMessage[slot] = false;
+        
+        _nextExpectedSequence++;
+        slot = _nextExpectedSequence % RELIABLE_WINDOW_SIZE;
+    }
+}
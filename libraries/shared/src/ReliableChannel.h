@@ -0,0 +1,112 @@
+//
+//  ReliableChannel.h
+//  shared
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __shared__ReliableChannel__
+#define __shared__ReliableChannel__
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtNetwork/QUdpSocket>
+
+#include "HifiSockAddr.h"
+
+// how many messages may be unacknowledged at once, which is also how far ahead of a gap the receiver will buffer
+const int RELIABLE_WINDOW_SIZE = 32;
+
+const int INITIAL_RELIABLE_RETRANSMIT_USECS = 500 * 1000;
+const int MIN_RELIABLE_RETRANSMIT_USECS = 100 * 1000;
+const int MAX_RELIABLE_RETRANSMIT_USECS = 2 * 1000 * 1000;
+
+// a message that hasn't been acknowledged after this many sends is given up on, and the receiver skips past it
+const int MAX_RELIABLE_TRANSMITS = 10;
+
+// channels with nothing outstanding that haven't heard from or sent to their peer for this long can be discarded
+const uint64_t RELIABLE_CHANNEL_IDLE_USECS = 60 * 1000 * 1000;
+
+/// One end of a reliable, ordered stream of messages between us and a single peer, carried over the node socket.
+/// Each message is wrapped in a PACKET_TYPE_RELIABLE packet:
+///     header | session ID | sequence | oldest unacknowledged sequence | the message, itself a complete packet
+/// and is acknowledged with a PACKET_TYPE_RELIABLE_ACK:
+///     header | session ID | next sequence expected | mask of the sequences after that which have already arrived
+/// Lost messages are resent on a timeout estimated from the round trip time, backing off on each resend.
+/// The session ID is picked at random per channel so that a peer that restarts doesn't look like an old stream.
+/// Not thread safe - NodeList serializes access to its channels.
+class ReliableChannel {
+public:
+    /// \param initialRttUsecs round trip time to start from, for example the peer's ping, or 0 if not known yet
+    ReliableChannel(const HifiSockAddr& peerSockAddr, int initialRttUsecs);
+    
+    const HifiSockAddr& getPeerSockAddr() const { return _peerSockAddr; }
+    
+    /// sends message now if the window allows, otherwise holds it until earlier messages are acknowledged
+    /// \return false if the message is too large to be wrapped in a single packet
+    bool sendMessage(QUdpSocket& socket, const unsigned char* message, int messageLength);
+    
+    /// handles a PACKET_TYPE_RELIABLE from the peer, acknowledging it and appending any messages that are now
+    /// in order to deliveredMessages
+    void processMessage(QUdpSocket& socket, const unsigned char* packetData, int packetLength,
+                        std::vector<QByteArray>& deliveredMessages);
+    
+    /// handles a PACKET_TYPE_RELIABLE_ACK from the peer
+    void processAck(QUdpSocket& socket, const unsigned char* packetData, int packetLength);
+    
+    /// resends the messages whose retransmit timeout has expired, and gives up on those sent too many times
+    void resendTimedOutMessages(QUdpSocket& socket);
+    
+    /// feeds a round trip time measured some other way (a ping) into the retransmit timeout estimate
+    void addRttSample(int rttUsecs);
+    
+    int getRetransmitTimeoutUsecs() const;
+    
+    bool isIdle() const;
+    
+    int getNumMessagesInFlight() const { return _messagesInFlight.size(); }
+    int getNumRetransmits() const { return _numRetransmits; }
+    int getNumFailedMessages() const { return _numFailedMessages; }
+
+private:
+    struct SentMessage {
+        uint16_t sequence;
+        QByteArray packet;
+        uint64_t lastSentUsecs;
+        int numTransmits;
+        int timeoutUsecs;
+    };
+    
+    void transmit(QUdpSocket& socket, SentMessage& message);
+    void transmitPendingMessages(QUdpSocket& socket);
+    void sendAck(QUdpSocket& socket);
+    
+    void clearReceivedMessages();
+    void deliverReceivedMessages(std::vector<QByteArray>& deliveredMessages);
+    
+    HifiSockAddr _peerSockAddr;
+    uint64_t _lastActivityUsecs;
+    
+    // sending side
+    uint16_t _sessionID;
+    uint16_t _nextSequence;
+    std::deque<SentMessage> _messagesInFlight;
+    std::deque<SentMessage> _pendingMessages;
+    bool _hasRttSample;
+    int _smoothedRttUsecs;
+    int _rttVariationUsecs;
+    int _numRetransmits;
+    int _numFailedMessages;
+    
+    // receiving side
+    bool _hasReceivedSession;
+    uint16_t _receivedSessionID;
+    uint16_t _nextExpectedSequence;
+    QByteArray _receivedMessages[RELIABLE_WINDOW_SIZE];
+    bool _hasReceivedMessage[RELIABLE_WINDOW_SIZE];
+};
+
+#endif /* defined(__shared__ReliableChannel__) */
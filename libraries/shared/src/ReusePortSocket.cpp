@@ -0,0 +1,149 @@
+//
+//  ReusePortSocket.cpp
+//  shared
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <QtCore/QDebug>
+
+#include "PacketBuffer.h"
+
+#include "ReusePortSocket.h"
+
+bool ReusePortSocket::isSupported() {
+#if defined(__linux__) && defined(SO_REUSEPORT)
+    return true;
+#else
+    return false;
+#endif
+}
+
+int ReusePortSocket::openDescriptor(quint16 port) {
+#if defined(__linux__) && defined(SO_REUSEPORT)
+    int descriptor = socket(AF_INET, SOCK_DGRAM, 0);
+    if (descriptor == -1) {
+        qDebug("ReusePortSocket could not open a socket, errno=%d\n", errno);
+        return -1;
+    }
+    
+    int enable = 1;
+    if (setsockopt(descriptor, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+        qDebug("ReusePortSocket could not set SO_REUSEPORT, errno=%d\n", errno);
+        close(descriptor);
+        return -1;
+    }
+    
+    sockaddr_in bindSockAddr;
+    memset(&bindSockAddr, 0, sizeof(bindSockAddr));
+    bindSockAddr.sin_family = AF_INET;
+    bindSockAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    bindSockAddr.sin_port = htons(port);
+    
+    if (::bind(descriptor, (sockaddr*) &bindSockAddr, sizeof(bindSockAddr)) == -1) {
+        qDebug("ReusePortSocket could not bind to port %d, errno=%d\n", port, errno);
+        close(descriptor);
+        return -1;
+    }
+    
+    return descriptor;
+#else
+    return -1;
+#endif
+}
+
+ReusePortSocket::ReusePortSocket() :
+    _descriptor(-1)
+{
+    
+}
+
+ReusePortSocket::~ReusePortSocket() {
+#ifdef __linux__
+    if (_descriptor != -1) {
+        close(_descriptor);
+    }
+#endif
+}
+
+bool ReusePortSocket::bind(quint16 port) {
+    if (_descriptor == -1) {
+        _descriptor = openDescriptor(port);
+    }
+    return _descriptor != -1;
+}
+
+bool ReusePortSocket::waitForDatagrams(int timeoutMsecs) {
+#ifdef __linux__
+    if (_descriptor == -1) {
+        return false;
+    }
+    
+    pollfd socketPoll;
+    socketPoll.fd = _descriptor;
+    socketPoll.events = POLLIN;
+    socketPoll.revents = 0;
+    
+    // an interrupted poll just reports nothing pending, the caller will be back
+    return poll(&socketPoll, 1, timeoutMsecs) > 0 && (socketPoll.revents & POLLIN);
+#else
+    return false;
+#endif
+}
+
+int ReusePortSocket::readPendingPackets(PacketBuffer* packets[MAX_DATAGRAMS_PER_BATCH]) {
+    int numPackets = 0;
+    
+#ifdef __linux__
+    if (_descriptor == -1) {
+        return 0;
+    }
+    
+    mmsghdr messages[MAX_DATAGRAMS_PER_BATCH];
+    iovec vectors[MAX_DATAGRAMS_PER_BATCH];
+    sockaddr_in senders[MAX_DATAGRAMS_PER_BATCH];
+    
+    memset(messages, 0, sizeof(messages));
+    
+    for (int i = 0; i < MAX_DATAGRAMS_PER_BATCH; i++) {
+        vectors[i].iov_base = packets[i]->getData();
+        vectors[i].iov_len = MAX_PACKET_SIZE;
+        
+        messages[i].msg_hdr.msg_name = &senders[i];
+        messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    
+    int result = recvmmsg(_descriptor, messages, MAX_DATAGRAMS_PER_BATCH, MSG_DONTWAIT, NULL);
+    
+    for (int i = 0; i < result; i++) {
+        if (messages[i].msg_len > 0) {
+            PacketBuffer* packet = packets[numPackets];
+            
+            if (numPackets != i) {
+                // an empty datagram came before this one, move it up so the filled buffers stay together
+                memcpy(packet->getData(), packets[i]->getData(), messages[i].msg_len);
+            }
+            
+            packet->setLength(messages[i].msg_len);
+            packet->setSockAddr(HifiSockAddr(QHostAddress(ntohl(senders[i].sin_addr.s_addr)),
+                                             ntohs(senders[i].sin_port)));
+            numPackets++;
+        }
+    }
+#endif
+    
+    return numPackets;
+}
@@ -0,0 +1,54 @@
+//
+//  ReusePortSocket.h
+//  shared
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+//  A UDP socket that shares its port with others through SO_REUSEPORT.
+//
+
+#ifndef __shared__ReusePortSocket__
+#define __shared__ReusePortSocket__
+
+#include <QtCore/QtGlobal>
+
+#include "BatchedUdpSocket.h"
+
+class PacketBuffer;
+
+/// A UDP socket bound with SO_REUSEPORT. The kernel spreads a port's datagrams across every socket bound to it this way,
+/// hashing on the sender so that each sender's datagrams land on one socket in order. It lives on a plain descriptor
+/// rather than a QUdpSocket, so it can be read from a thread that has no event loop.
+class ReusePortSocket {
+public:
+    /// true where the kernel spreads datagrams across sockets sharing a port - currently linux only
+    static bool isSupported();
+    
+    /// opens a descriptor bound to port with SO_REUSEPORT set
+    /// \return the descriptor, or -1 if ports can't be shared here or the bind failed
+    static int openDescriptor(quint16 port);
+    
+    ReusePortSocket();
+    ~ReusePortSocket();
+    
+    /// \return false if the socket couldn't be bound, see openDescriptor
+    bool bind(quint16 port);
+    bool isBound() const { return _descriptor != -1; }
+    
+    /// blocks until a datagram is pending or timeoutMsecs have passed - a timeout of 0 only checks
+    /// \return true if there is a datagram to read
+    bool waitForDatagrams(int timeoutMsecs);
+    
+    /// reads up to MAX_DATAGRAMS_PER_BATCH pending datagrams straight into the caller's pooled buffers, setting their
+    /// length and sender - only read from one thread at a time
+    /// \return the number of buffers filled
+    int readPendingPackets(PacketBuffer* packets[MAX_DATAGRAMS_PER_BATCH]);
+private:
+    // disallow copying of ReusePortSocket objects
+    ReusePortSocket(const ReusePortSocket&);
+    ReusePortSocket& operator= (const ReusePortSocket&);
+    
+    int _descriptor;
+};
+
+#endif /* defined(__shared__ReusePortSocket__) */
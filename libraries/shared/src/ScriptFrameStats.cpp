@@ -0,0 +1,120 @@
+//
+//  ScriptFrameStats.cpp
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#include <algorithm>
+#include <string.h>
+
+#include "UUID.h"
+
+#include "ScriptFrameStats.h"
+
+// the uint32_t fields of a ScriptFrameReport, which are packed one after the other
+const int NUM_REPORT_COUNTS = 6;
+
+ScriptFrameStats::ScriptFrameStats() {
+    reset();
+}
+
+void ScriptFrameStats::reset() {
+    _numSamples = 0;
+    _nextSample = 0;
+    _numFrames = 0;
+    _numOverruns = 0;
+    _numShedFrames = 0;
+}
+
+void ScriptFrameStats::addCallback(uint64_t callbackUsecs, uint64_t frameUsecs) {
+    _callbackUsecs[_nextSample] = callbackUsecs;
+    _nextSample = (_nextSample + 1) % SCRIPT_FRAME_STATS_WINDOW;
+    _numSamples = std::min(_numSamples + 1, SCRIPT_FRAME_STATS_WINDOW);
+    
+    _numFrames++;
+    if (callbackUsecs > frameUsecs) {
+        _numOverruns++;
+    }
+}
+
+uint64_t ScriptFrameStats::getPercentileUsecs(float percentile) const {
+    if (_numSamples == 0) {
+        return 0;
+    }
+    
+    // the window isn't kept sorted, so it's partially sorted in a copy
+    uint32_t sortedUsecs[SCRIPT_FRAME_STATS_WINDOW];
+    memcpy(sortedUsecs, _callbackUsecs, _numSamples * sizeof(uint32_t));
+    
+    int index = std::min((int)(percentile * _numSamples), _numSamples - 1);
+    std::nth_element(sortedUsecs, sortedUsecs + index, sortedUsecs + _numSamples);
+    return sortedUsecs[index];
+}
+
+ScriptFrameReport ScriptFrameStats::getReport(float framesPerSecond, bool shedsOverrunFrames) const {
+    ScriptFrameReport report;
+    report.framesPerSecond = framesPerSecond;
+    report.shedsOverrunFrames = shedsOverrunFrames;
+    report.medianCallbackUsecs = getPercentileUsecs(0.5f);
+    report.p99CallbackUsecs = getPercentileUsecs(0.99f);
+    report.maxCallbackUsecs = getPercentileUsecs(1.0f);
+    report.numFrames = _numFrames;
+    report.numOverruns = _numOverruns;
+    report.numShedFrames = _numShedFrames;
+    return report;
+}
+
+int ScriptFrameStats::packReport(unsigned char* destinationBuffer, const QUuid& assignmentUUID,
+                                 const ScriptFrameReport& report) {
+    unsigned char* bufferStart = destinationBuffer;
+    
+    QByteArray rfcUUID = assignmentUUID.toRfc4122();
+    memcpy(destinationBuffer, rfcUUID.constData(), NUM_BYTES_RFC4122_UUID);
+    destinationBuffer += NUM_BYTES_RFC4122_UUID;
+    
+    memcpy(destinationBuffer, &report.framesPerSecond, sizeof(report.framesPerSecond));
+    destinationBuffer += sizeof(report.framesPerSecond);
+    
+    *destinationBuffer++ = report.shedsOverrunFrames;
+    
+    const uint32_t* counts[NUM_REPORT_COUNTS] = { &report.medianCallbackUsecs, &report.p99CallbackUsecs,
+                                                  &report.maxCallbackUsecs, &report.numFrames, &report.numOverruns,
+                                                  &report.numShedFrames };
+    for (int i = 0; i < NUM_REPORT_COUNTS; i++) {
+        memcpy(destinationBuffer, counts[i], sizeof(uint32_t));
+        destinationBuffer += sizeof(uint32_t);
+    }
+    
+    return destinationBuffer - bufferStart;
+}
+
+int ScriptFrameStats::unpackReport(const unsigned char* sourceBuffer, int numBytes, QUuid& assignmentUUID,
+                                   ScriptFrameReport& report) {
+    const int NUM_REPORT_BYTES = NUM_BYTES_RFC4122_UUID + sizeof(report.framesPerSecond) + sizeof(unsigned char) +
+        NUM_REPORT_COUNTS * sizeof(uint32_t);
+    
+    if (numBytes < NUM_REPORT_BYTES) {
+        return 0;
+    }
+    
+    const unsigned char* bufferStart = sourceBuffer;
+    
+    assignmentUUID = QUuid::fromRfc4122(QByteArray((const char*) sourceBuffer, NUM_BYTES_RFC4122_UUID));
+    sourceBuffer += NUM_BYTES_RFC4122_UUID;
+    
+    memcpy(&report.framesPerSecond, sourceBuffer, sizeof(report.framesPerSecond));
+    sourceBuffer += sizeof(report.framesPerSecond);
+    
+    report.shedsOverrunFrames = *sourceBuffer++;
+    
+    uint32_t* counts[NUM_REPORT_COUNTS] = { &report.medianCallbackUsecs, &report.p99CallbackUsecs,
+                                            &report.maxCallbackUsecs, &report.numFrames, &report.numOverruns,
+                                            &report.numShedFrames };
+    for (int i = 0; i < NUM_REPORT_COUNTS; i++) {
+        memcpy(counts[i], sourceBuffer, sizeof(uint32_t));
+        sourceBuffer += sizeof(uint32_t);
+    }
+    
+    return sourceBuffer - bufferStart;
+}
@@ -0,0 +1,73 @@
+//
+//  ScriptFrameStats.h
+//  hifi
+//
+//  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
+//
+
+#ifndef __hifi__ScriptFrameStats__
+#define __hifi__ScriptFrameStats__
+
+#include <stdint.h>
+
+#include <QtCore/QUuid>
+
+// the percentiles are taken over this many of the most recent frame callbacks
+const int SCRIPT_FRAME_STATS_WINDOW = 256;
+
+// how often an agent reports the timing of its script to the domain-server
+const int SCRIPT_FRAME_STATS_REPORT_USECS = 1 * 1000 * 1000;
+
+/// The summary of a script's frame timing that an agent sends to the domain-server.
+struct ScriptFrameReport {
+    float framesPerSecond;
+    bool shedsOverrunFrames;
+    uint32_t medianCallbackUsecs;
+    uint32_t p99CallbackUsecs;
+    uint32_t maxCallbackUsecs;
+    uint32_t numFrames;
+    uint32_t numOverruns;
+    uint32_t numShedFrames;
+};
+
+/// Times the frame callbacks of a script, to spot scripts that take longer than the frames they run in.
+class ScriptFrameStats {
+public:
+    ScriptFrameStats();
+    
+    void reset();
+    
+    /// records how long one frame callback took, and whether that was longer than the frame it ran in
+    void addCallback(uint64_t callbackUsecs, uint64_t frameUsecs);
+    
+    /// records frames that were skipped because the script had fallen behind
+    void addShedFrames(int numShedFrames) { _numShedFrames += numShedFrames; }
+    
+    /// \param percentile between 0 and 1
+    /// \return the callback time that this fraction of the recent callbacks took no longer than
+    uint64_t getPercentileUsecs(float percentile) const;
+    
+    int getNumFrames() const { return _numFrames; }
+    int getNumOverruns() const { return _numOverruns; }
+    int getNumShedFrames() const { return _numShedFrames; }
+    
+    ScriptFrameReport getReport(float framesPerSecond, bool shedsOverrunFrames) const;
+    
+    /// packs the report for the script of an assignment into a buffer, after its packet header
+    static int packReport(unsigned char* destinationBuffer, const QUuid& assignmentUUID, const ScriptFrameReport& report);
+    
+    /// \return the number of bytes read, or 0 if the buffer was too short to hold a report
+    static int unpackReport(const unsigned char* sourceBuffer, int numBytes, QUuid& assignmentUUID,
+                            ScriptFrameReport& report);
+
+private:
+    uint32_t _callbackUsecs[SCRIPT_FRAME_STATS_WINDOW];
+    int _numSamples;
+    int _nextSample;
+    
+    int _numFrames;
+    int _numOverruns;
+    int _numShedFrames;
+};
+
+#endif /* defined(__hifi__ScriptFrameStats__) */
@@ -610,6 +610,62 @@ int unpackOrientationQuatFromBytes(unsigned char* buffer, glm::quat& quatOutput)
     return sizeof(quatParts);
 }
 
+const float SMALLEST_THREE_RANGE = 0.70710678f;
+const int SMALLEST_THREE_COMPONENT_BITS = 10;
+const uint32_t SMALLEST_THREE_COMPONENT_MASK = (1 << SMALLEST_THREE_COMPONENT_BITS) - 1;
+
+int packOrientationQuatToSmallestThree(unsigned char* buffer, const glm::quat& quatInput) {
+    glm::quat quatNormalized = glm::normalize(quatInput);
+    float quatParts[4] = { quatNormalized.x, quatNormalized.y, quatNormalized.z, quatNormalized.w };
+    
+    int largestIndex = 0;
+    for (int i = 1; i < 4; i++) {
+        if (fabsf(quatParts[i]) > fabsf(quatParts[largestIndex])) {
+            largestIndex = i;
+        }
+    }
+    
+    // q and -q are the same orientation, so flip the quat if need be to leave the dropped component positive
+    float sign = (quatParts[largestIndex] < 0.0f) ? -1.0f : 1.0f;
+    
+    uint32_t packedQuat = largestIndex;
+    for (int i = 0; i < 4; i++) {
+        if (i != largestIndex) {
+            float quatPart = glm::clamp(quatParts[i] * sign, -SMALLEST_THREE_RANGE, SMALLEST_THREE_RANGE);
+            uint32_t quantizedPart = roundf((quatPart + SMALLEST_THREE_RANGE) / (2.0f * SMALLEST_THREE_RANGE)
+                                            * SMALLEST_THREE_COMPONENT_MASK);
+            packedQuat = (packedQuat << SMALLEST_THREE_COMPONENT_BITS) | quantizedPart;
+        }
+    }
+    
+    memcpy(buffer, &packedQuat, sizeof(packedQuat));
+    return sizeof(packedQuat);
+}
+
+int unpackOrientationQuatFromSmallestThree(unsigned char* buffer, glm::quat& quatOutput) {
+    uint32_t packedQuat;
+    memcpy(&packedQuat, buffer, sizeof(packedQuat));
+    
+    int largestIndex = packedQuat >> (3 * SMALLEST_THREE_COMPONENT_BITS);
+    float quatParts[4];
+    float sumOfSquares = 0.0f;
+    
+    // the parts were packed in order, so the last one is in the lowest bits
+    for (int i = 3; i >= 0; i--) {
+        if (i != largestIndex) {
+            quatParts[i] = (packedQuat & SMALLEST_THREE_COMPONENT_MASK) / (float) SMALLEST_THREE_COMPONENT_MASK
+                * 2.0f * SMALLEST_THREE_RANGE - SMALLEST_THREE_RANGE;
+            sumOfSquares += quatParts[i] * quatParts[i];
+            packedQuat >>= SMALLEST_THREE_COMPONENT_BITS;
+        }
+    }
+    
+    quatParts[largestIndex] = sqrtf(std::max(0.0f, 1.0f - sumOfSquares));
+    quatOutput = glm::quat(quatParts[3], quatParts[0], quatParts[1], quatParts[2]);
+    
+    return sizeof(packedQuat);
+}
+
 float SMALL_LIMIT = 10.0;
 float LARGE_LIMIT = 1000.0;
 
@@ -706,3 +762,32 @@ void debug::checkDeadBeef(void* memoryVoid, int size) {
     assert(memcmp(memoryAt, DEADBEEF, std::min(size, DEADBEEF_SIZE)) != 0);
 }
 
+const float PI_OVER_TWO = 1.57079633f;
+
+//  Safe version of glm::eulerAngles; uses the factorization method described in David Eberly's
+//  http://www.geometrictools.com/Documentation/EulerAngles.pdf (via Clyde,
+// https://github.com/threerings/clyde/blob/master/src/main/java/com/threerings/math/Quaternion.java)
+glm::vec3 safeEulerAngles(const glm::quat& q) {
+    float sy = 2.0f * (q.y * q.w - q.x * q.z);
+    if (sy < 1.0f - EPSILON) {
+        if (sy > -1.0f + EPSILON) {
+            return glm::degrees(glm::vec3(
+                atan2f(q.y * q.z + q.x * q.w, 0.5f - (q.x * q.x + q.y * q.y)),
+                asinf(sy),
+                atan2f(q.x * q.y + q.z * q.w, 0.5f - (q.y * q.y + q.z * q.z))));
+                
+        } else {
+            // not a unique solution; x + z = atan2(-m21, m11)
+            return glm::degrees(glm::vec3(
+                0.0f,
+                -PI_OVER_TWO,
+                atan2f(q.x * q.w - q.y * q.z, 0.5f - (q.x * q.x + q.z * q.z))));
+        }
+    } else {
+        // not a unique solution; x - z = atan2(-m21, m11)
+        return glm::degrees(glm::vec3(
+            0.0f,
+            PI_OVER_TWO,
+            -atan2f(q.x * q.w - q.y * q.z, 0.5f - (q.x * q.x + q.z * q.z))));
+    }
+}
@@ -147,6 +147,11 @@ int unpackFloatAngleFromTwoByte(uint16_t* byteAnglePointer, float* destinationPo
 int packOrientationQuatToBytes(unsigned char* buffer, const glm::quat& quatInput);
 int unpackOrientationQuatFromBytes(unsigned char* buffer, glm::quat& quatOutput);
 
+// Orientation Quats can also drop their largest component, which is recovered from the other three since the quat is
+// normalized - those three are then within +/- 1/sqrt(2), so 10 bits each and the index of the dropped one fit in 32 bits
+int packOrientationQuatToSmallestThree(unsigned char* buffer, const glm::quat& quatInput);
+int unpackOrientationQuatFromSmallestThree(unsigned char* buffer, glm::quat& quatOutput);
+
 // Ratios need the be highly accurate when less than 10, but not very accurate above 10, and they
 // are never greater than 1000 to 1, this allows us to encode each component in 16bits
 int packFloatRatioToTwoByte(unsigned char* buffer, float ratio);
@@ -169,4 +174,7 @@ int unpackFloatScalarFromSignedTwoByteFixed(int16_t* byteFixedPointer, float* de
 int packFloatVec3ToSignedTwoByteFixed(unsigned char* destBuffer, const glm::vec3& srcVector, int radix);
 int unpackFloatVec3FromSignedTwoByteFixed(unsigned char* sourceBuffer, glm::vec3& destination, int radix);
 
+// Euler angles in degrees (pitch, yaw, roll) for a quat, without the singularities of glm::eulerAngles
+glm::vec3 safeEulerAngles(const glm::quat& q);
+
 #endif /* defined(__hifi__SharedUtil__) */
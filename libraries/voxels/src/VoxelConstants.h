@@ -45,4 +45,7 @@ const uint64_t CLIENT_TO_SERVER_VOXEL_SEND_INTERVAL_USECS = 1000 * 5; // 1 packe
 
 const int DEFAULT_MAX_VOXEL_PPS = 600; // the default maximum PPS we think a voxel server should send to a client
 
+// a box fill is sent as one edit per cube of this many voxels on a side, which the server won't exceed in a single edit
+const int VOXEL_FILL_CHUNK_VOXELS = 32;
+
 #endif
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include <PerfStat.h>
 #include <OctalCode.h>
 #include <PacketHeaders.h>
+#include "VoxelConstants.h"
+#include "VoxelTree.h"
 #include "VoxelEditPacketSender.h"
 
 
@@ -55,3 +57,104 @@ void VoxelEditPacketSender::queueVoxelEditMessages(PACKET_TYPE type, int numberO
     }    
 }
 
+void VoxelEditPacketSender::queueVoxelBoxFill(const glm::vec3& corner, const glm::vec3& dimensions, float voxelScale,
+                                              const rgbColor color, bool destructive) {
+    if (!_shouldSend || voxelScale <= 0.0f) {
+        return; // bail early
+    }
+    
+    // the fill happens at the size of voxel pointToVoxel() would pick for this scale
+    float snappedScale = 1.0f;
+    while (snappedScale > voxelScale) {
+        snappedScale /= 2.0f;
+    }
+    float chunkScale = std::min(1.0f, snappedScale * VOXEL_FILL_CHUNK_VOXELS);
+    
+    glm::vec3 farCorner = glm::min(corner + dimensions, glm::vec3(1.0f, 1.0f, 1.0f));
+    glm::vec3 nearCorner = glm::max(corner, glm::vec3(0.0f, 0.0f, 0.0f));
+    
+    glm::vec3 firstChunk = glm::floor(nearCorner / chunkScale);
+    glm::vec3 lastChunk = glm::ceil(farCorner / chunkScale) - glm::vec3(1.0f, 1.0f, 1.0f);
+    
+    for (float x = firstChunk.x; x <= lastChunk.x; x++) {
+        for (float y = firstChunk.y; y <= lastChunk.y; y++) {
+            for (float z = firstChunk.z; z <= lastChunk.z; z++) {
+                glm::vec3 chunkCorner = glm::vec3(x, y, z) * chunkScale;
+                
+                // the part of the box inside this chunk
+                glm::vec3 fillCorner = glm::max(nearCorner, chunkCorner);
+                glm::vec3 fillDimensions = glm::min(farCorner, chunkCorner + glm::vec3(chunkScale, chunkScale, chunkScale))
+                    - fillCorner;
+                
+                if (fillDimensions.x <= 0.0f || fillDimensions.y <= 0.0f || fillDimensions.z <= 0.0f) {
+                    continue;
+                }
+                
+                static unsigned char bufferOut[MAX_PACKET_SIZE];
+                
+                // the chunk's octal code goes first, so the edit is sent to the server that holds the chunk
+                unsigned char* chunkCode = pointToOctalCode(chunkCorner.x, chunkCorner.y, chunkCorner.z, chunkScale);
+                int sizeOut = bytesRequiredForCodeLength(*chunkCode);
+                memcpy(bufferOut, chunkCode, sizeOut);
+                delete[] chunkCode;
+                
+                memcpy(bufferOut + sizeOut, &fillCorner, sizeof(fillCorner));
+                sizeOut += sizeof(fillCorner);
+                memcpy(bufferOut + sizeOut, &fillDimensions, sizeof(fillDimensions));
+                sizeOut += sizeof(fillDimensions);
+                memcpy(bufferOut + sizeOut, &voxelScale, sizeof(voxelScale));
+                sizeOut += sizeof(voxelScale);
+                memcpy(bufferOut + sizeOut, color, sizeof(rgbColor));
+                sizeOut += sizeof(rgbColor);
+                bufferOut[sizeOut++] = destructive;
+                
+                queueOctreeEditMessage(PACKET_TYPE_VOXEL_FILL, bufferOut, sizeOut);
+            }
+        }
+    }
+}
+
+void VoxelEditPacketSender::queueVoxelSubtree(VoxelTree& sourceTree, float x, float y, float z, float s) {
+    if (!_shouldSend) {
+        return; // bail early
+    }
+    
+    unsigned char* destinationCode = pointToOctalCode(x, y, z, s);
+    int destinationCodeBytes = bytesRequiredForCodeLength(*destinationCode);
+    
+    // every piece of the bitstream has to fit in an edit packet along with the packet's header, sequence and timestamp
+    const int EDIT_PACKET_OVERHEAD = MAX_PACKET_HEADER_BYTES + sizeof(unsigned short int) + sizeof(uint64_t);
+    int maxBitstreamBytes = _maxPacketSize - EDIT_PACKET_OVERHEAD - destinationCodeBytes - sizeof(uint16_t) - 1;
+    
+    OctreeElementBag elementBag;
+    elementBag.insert(sourceTree.getRoot());
+    
+    OctreePacketData packetData(false, maxBitstreamBytes);
+    
+    while (!elementBag.isEmpty()) {
+        OctreeElement* subTree = elementBag.extract();
+        packetData.reset();
+        
+        EncodeBitstreamParams params(INT_MAX, IGNORE_VIEW_FRUSTUM, WANT_COLOR, NO_EXISTS_BITS);
+        sourceTree.encodeTreeBitstream(subTree, &packetData, elementBag, params);
+        
+        uint16_t bitstreamBytes = packetData.getUncompressedSize();
+        if (bitstreamBytes == 0) {
+            continue;
+        }
+        
+        static unsigned char bufferOut[MAX_PACKET_SIZE];
+        int sizeOut = 0;
+        
+        memcpy(bufferOut, destinationCode, destinationCodeBytes);
+        sizeOut += destinationCodeBytes;
+        memcpy(bufferOut + sizeOut, &bitstreamBytes, sizeof(bitstreamBytes));
+        sizeOut += sizeof(bitstreamBytes);
+        memcpy(bufferOut + sizeOut, packetData.getUncompressedData(), bitstreamBytes);
+        sizeOut += bitstreamBytes;
+        
+        queueOctreeEditMessage(PACKET_TYPE_VOXEL_SUBTREE, bufferOut, sizeOut);
+    }
+    
+    delete[] destinationCode;
+}
@@ -13,6 +13,8 @@
 
 #include <OctreeEditPacketSender.h>
 
+class VoxelTree;
+
 /// Utility for processing, packing, queueing and sending of outbound edit voxel messages.
 class VoxelEditPacketSender :  public virtual OctreeEditPacketSender {
 public:
@@ -33,6 +35,16 @@ public:
     /// which voxel-server node or nodes the packet should be sent to. Can be called even before voxel servers are known, in 
     /// which case up to MaxPendingMessages will be buffered and processed when voxel servers are known.
     void queueVoxelEditMessages(PACKET_TYPE type, int numberOfDetails, VoxelDetail* details);
+    
+    /// Queues the filling of a box with voxels of size voxelScale as PACKET_TYPE_VOXEL_FILL edits, one for each cube of
+    /// VOXEL_FILL_CHUNK_VOXELS voxels on a side that the box touches, so each can go to the server whose jurisdiction
+    /// holds it. The server fills them in with VoxelTree::fillBox().
+    void queueVoxelBoxFill(const glm::vec3& corner, const glm::vec3& dimensions, float voxelScale, const rgbColor color,
+                           bool destructive);
+    
+    /// Queues the contents of sourceTree to be pasted into the voxel at x, y, z of size s, scaling the whole tree to fit,
+    /// as PACKET_TYPE_VOXEL_SUBTREE edits that each carry a piece of its bitstream
+    void queueVoxelSubtree(VoxelTree& sourceTree, float x, float y, float z, float s);
 
     /// call this to inform the VoxelEditPacketSender of the voxel server jurisdictions. This is required for normal operation.
     /// The internal contents of the jurisdiction map may change throughout the lifetime of the VoxelEditPacketSender. This map
@@ -6,15 +6,36 @@
 //  Copyright (c) 2013 HighFidelity, Inc. All rights reserved.
 //
 
+#include <vector>
+
+#include "VoxelTree.h"
 #include "VoxelScriptingInterface.h"
 
-VoxelScriptingInterface::VoxelScriptingInterface() {
-    _jurisdictionListener.initialize(true);
-    _voxelPacketSender.setVoxelServerJurisdictions(_jurisdictionListener.getJurisdictions());
+VoxelScriptingInterface::VoxelScriptingInterface() :
+    _voxelPacketSender(new VoxelEditPacketSender()),
+    _jurisdictionListener(new JurisdictionListener()),
+    _ownsPacketSender(true)
+{
+    _jurisdictionListener->initialize(true);
+    _voxelPacketSender->setVoxelServerJurisdictions(_jurisdictionListener->getJurisdictions());
+}
+
+VoxelScriptingInterface::VoxelScriptingInterface(VoxelEditPacketSender* sharedPacketSender) :
+    _voxelPacketSender(sharedPacketSender),
+    _jurisdictionListener(NULL),
+    _ownsPacketSender(false)
+{
+}
+
+VoxelScriptingInterface::~VoxelScriptingInterface() {
+    if (_ownsPacketSender) {
+        delete _jurisdictionListener;
+        delete _voxelPacketSender;
+    }
 }
 
 void VoxelScriptingInterface::queueVoxelAdd(PACKET_TYPE addPacketType, VoxelDetail& addVoxelDetails) {
-    _voxelPacketSender.queueVoxelEditMessages(addPacketType, 1, &addVoxelDetails);
+    _voxelPacketSender->queueVoxelEditMessages(addPacketType, 1, &addVoxelDetails);
 }
 
 void VoxelScriptingInterface::queueVoxelAdd(float x, float y, float z, float scale, uchar red, uchar green, uchar blue) {
@@ -39,6 +60,62 @@ void VoxelScriptingInterface::queueVoxelDelete(float x, float y, float z, float
     // setup a VoxelDetail struct with data
     VoxelDetail deleteVoxelDetail = {x, y, z, scale, 0, 0, 0};
     
-    _voxelPacketSender.queueVoxelEditMessages(PACKET_TYPE_VOXEL_ERASE, 1, &deleteVoxelDetail);
+    _voxelPacketSender->queueVoxelEditMessages(PACKET_TYPE_VOXEL_ERASE, 1, &deleteVoxelDetail);
+}
+
+void VoxelScriptingInterface::queueVoxelEdits(PACKET_TYPE editPacketType, const QVariantList& voxels, bool includesColor) {
+    const int NUMBERS_PER_VOXEL = includesColor ? 7 : 4;
+    
+    int numVoxels = voxels.size() / NUMBERS_PER_VOXEL;
+    
+    std::vector<VoxelDetail> details(numVoxels);
+    for (int i = 0; i < numVoxels; i++) {
+        const QVariant* voxel = &voxels[i * NUMBERS_PER_VOXEL];
+        
+        VoxelDetail detail = { voxel[0].toFloat(), voxel[1].toFloat(), voxel[2].toFloat(), voxel[3].toFloat(), 0, 0, 0 };
+        if (includesColor) {
+            detail.red = voxel[4].toInt();
+            detail.green = voxel[5].toInt();
+            detail.blue = voxel[6].toInt();
+        }
+        details[i] = detail;
+    }
+    
+    if (numVoxels > 0) {
+        _voxelPacketSender->queueVoxelEditMessages(editPacketType, numVoxels, &details[0]);
+    }
+}
+
+void VoxelScriptingInterface::queueVoxelAdds(const QVariantList& voxels) {
+    queueVoxelEdits(PACKET_TYPE_VOXEL_SET, voxels, true);
+}
+
+void VoxelScriptingInterface::queueDestructiveVoxelAdds(const QVariantList& voxels) {
+    queueVoxelEdits(PACKET_TYPE_VOXEL_SET_DESTRUCTIVE, voxels, true);
 }
 
+void VoxelScriptingInterface::queueVoxelDeletes(const QVariantList& voxels) {
+    queueVoxelEdits(PACKET_TYPE_VOXEL_ERASE, voxels, false);
+}
+
+void VoxelScriptingInterface::queueVoxelBoxFill(float x, float y, float z, float width, float height, float depth,
+                                                float scale, uchar red, uchar green, uchar blue) {
+    rgbColor color = { red, green, blue };
+    _voxelPacketSender->queueVoxelBoxFill(glm::vec3(x, y, z), glm::vec3(width, height, depth), scale, color, false);
+}
+
+void VoxelScriptingInterface::queueDestructiveVoxelBoxFill(float x, float y, float z, float width, float height, float depth,
+                                                           float scale, uchar red, uchar green, uchar blue) {
+    rgbColor color = { red, green, blue };
+    _voxelPacketSender->queueVoxelBoxFill(glm::vec3(x, y, z), glm::vec3(width, height, depth), scale, color, true);
+}
+
+bool VoxelScriptingInterface::queueSVOPaste(const QString& fileName, float x, float y, float z, float scale) {
+    VoxelTree sourceTree;
+    if (!sourceTree.readFromSVOFile(fileName.toLocal8Bit().constData())) {
+        return false;
+    }
+    
+    _voxelPacketSender->queueVoxelSubtree(sourceTree, x, y, z, scale);
+    return true;
+}
@@ -10,6 +10,7 @@
 #define __hifi__VoxelScriptingInterface__
 
 #include <QtCore/QObject>
+#include <QtCore/QVariant>
 
 #include <JurisdictionListener.h>
 #include "VoxelEditPacketSender.h"
@@ -18,10 +19,18 @@
 class VoxelScriptingInterface : public QObject {
     Q_OBJECT
 public:
+    /// sends with a packet sender and jurisdiction listener of its own
     VoxelScriptingInterface();
     
-    VoxelEditPacketSender* getVoxelPacketSender() { return &_voxelPacketSender; }
-    JurisdictionListener* getJurisdictionListener() { return &_jurisdictionListener; }
+    /// queues edits with a packet sender shared by several scripts, whose owner keeps its jurisdictions and processes it
+    VoxelScriptingInterface(VoxelEditPacketSender* sharedPacketSender);
+    
+    ~VoxelScriptingInterface();
+    
+    VoxelEditPacketSender* getVoxelPacketSender() { return _voxelPacketSender; }
+    
+    /// NULL if the packet sender is shared
+    JurisdictionListener* getJurisdictionListener() { return _jurisdictionListener; }
 public slots:
     /// queues the creation of a voxel which will be sent by calling process on the PacketSender
     /// \param x the x-coordinate of the voxel (in VS space)
@@ -49,64 +58,118 @@ public slots:
     /// \param z the z-coordinate of the voxel (in VS space)
     /// \param scale the scale of the voxel (in VS space)
     void queueVoxelDelete(float x, float y, float z, float scale);
+    
+    /// queues the creation of many voxels at once, sent by calling process on the PacketSender
+    /// \param voxels an array of seven numbers for each voxel - x, y, z, scale, red, green and blue (in VS space)
+    void queueVoxelAdds(const QVariantList& voxels);
+    
+    /// queues the destructive creation of many voxels at once, sent by calling process on the PacketSender
+    /// \param voxels an array of seven numbers for each voxel - x, y, z, scale, red, green and blue (in VS space)
+    void queueDestructiveVoxelAdds(const QVariantList& voxels);
+    
+    /// queues the deletion of many voxels at once, sent by calling process on the PacketSender
+    /// \param voxels an array of four numbers for each voxel - x, y, z and scale (in VS space)
+    void queueVoxelDeletes(const QVariantList& voxels);
+    
+    /// queues the filling of a box with voxels, which the voxel server does in one edit per chunk of the box
+    /// \param x the x-coordinate of the box's corner (in VS space)
+    /// \param y the y-coordinate of the box's corner (in VS space)
+    /// \param z the z-coordinate of the box's corner (in VS space)
+    /// \param width the size of the box along x (in VS space)
+    /// \param height the size of the box along y (in VS space)
+    /// \param depth the size of the box along z (in VS space)
+    /// \param scale the scale of the voxels to fill the box with (in VS space)
+    /// \param red the R value for RGB color of the voxels
+    /// \param green the G value for RGB color of the voxels
+    /// \param blue the B value for RGB color of the voxels
+    void queueVoxelBoxFill(float x, float y, float z, float width, float height, float depth, float scale,
+                           uchar red, uchar green, uchar blue);
+    
+    /// queues the destructive filling of a box with voxels, replacing whatever was inside it
+    void queueDestructiveVoxelBoxFill(float x, float y, float z, float width, float height, float depth, float scale,
+                                      uchar red, uchar green, uchar blue);
+    
+    /// queues the contents of an SVO file to be pasted into a voxel, scaled to fit it
+    /// \param fileName the SVO file, on the machine running the script
+    /// \param x the x-coordinate of the voxel (in VS space)
+    /// \param y the y-coordinate of the voxel (in VS space)
+    /// \param z the z-coordinate of the voxel (in VS space)
+    /// \param scale the scale of the voxel (in VS space)
+    /// \return false if the file couldn't be read
+    bool queueSVOPaste(const QString& fileName, float x, float y, float z, float scale);
 
-    /// Set the desired max packet size in bytes that should be created
-    void setMaxPacketSize(int maxPacketSize) { return _voxelPacketSender.setMaxPacketSize(maxPacketSize); }
+    /// Set the desired max packet size in bytes that should be created - ignored when the packet sender is shared with
+    /// the other scripts hosted by this worker, so one script can't change the limits of the rest
+    void setMaxPacketSize(int maxPacketSize) {
+        if (_ownsPacketSender) {
+            _voxelPacketSender->setMaxPacketSize(maxPacketSize);
+        }
+    }
 
     /// returns the current desired max packet size in bytes that will be created
-    int getMaxPacketSize() const { return _voxelPacketSender.getMaxPacketSize(); }
+    int getMaxPacketSize() const { return _voxelPacketSender->getMaxPacketSize(); }
 
-    /// set the max packets per second send rate
-    void setPacketsPerSecond(int packetsPerSecond) { return _voxelPacketSender.setPacketsPerSecond(packetsPerSecond); }
+    /// set the max packets per second send rate - ignored when the packet sender is shared with the other scripts
+    /// hosted by this worker
+    void setPacketsPerSecond(int packetsPerSecond) {
+        if (_ownsPacketSender) {
+            _voxelPacketSender->setPacketsPerSecond(packetsPerSecond);
+        }
+    }
 
     /// get the max packets per second send rate
-    int getPacketsPerSecond() const  { return _voxelPacketSender.getPacketsPerSecond(); }
+    int getPacketsPerSecond() const  { return _voxelPacketSender->getPacketsPerSecond(); }
 
     /// does a voxel server exist to send to
-    bool voxelServersExist() const { return _voxelPacketSender.voxelServersExist(); }
+    bool voxelServersExist() const { return _voxelPacketSender->voxelServersExist(); }
 
     /// are there packets waiting in the send queue to be sent
-    bool hasPacketsToSend() const { return _voxelPacketSender.hasPacketsToSend(); }
+    bool hasPacketsToSend() const { return _voxelPacketSender->hasPacketsToSend(); }
 
     /// how many packets are there in the send queue waiting to be sent
-    int packetsToSendCount() const { return _voxelPacketSender.packetsToSendCount(); }
+    int packetsToSendCount() const { return _voxelPacketSender->packetsToSendCount(); }
 
     /// returns the packets per second send rate of this object over its lifetime
-    float getLifetimePPS() const { return _voxelPacketSender.getLifetimePPS(); }
+    float getLifetimePPS() const { return _voxelPacketSender->getLifetimePPS(); }
 
     /// returns the bytes per second send rate of this object over its lifetime
-    float getLifetimeBPS() const { return _voxelPacketSender.getLifetimeBPS(); }
+    float getLifetimeBPS() const { return _voxelPacketSender->getLifetimeBPS(); }
     
     /// returns the packets per second queued rate of this object over its lifetime
-    float getLifetimePPSQueued() const  { return _voxelPacketSender.getLifetimePPSQueued(); }
+    float getLifetimePPSQueued() const  { return _voxelPacketSender->getLifetimePPSQueued(); }
 
     /// returns the bytes per second queued rate of this object over its lifetime
-    float getLifetimeBPSQueued() const { return _voxelPacketSender.getLifetimeBPSQueued(); }
+    float getLifetimeBPSQueued() const { return _voxelPacketSender->getLifetimeBPSQueued(); }
 
     /// returns lifetime of this object from first packet sent to now in usecs
-    long long unsigned int getLifetimeInUsecs() const { return _voxelPacketSender.getLifetimeInUsecs(); }
+    long long unsigned int getLifetimeInUsecs() const { return _voxelPacketSender->getLifetimeInUsecs(); }
 
     /// returns lifetime of this object from first packet sent to now in usecs
-    float getLifetimeInSeconds() const { return _voxelPacketSender.getLifetimeInSeconds(); }
+    float getLifetimeInSeconds() const { return _voxelPacketSender->getLifetimeInSeconds(); }
 
     /// returns the total packets sent by this object over its lifetime
-    long long unsigned int getLifetimePacketsSent() const { return _voxelPacketSender.getLifetimePacketsSent(); }
+    long long unsigned int getLifetimePacketsSent() const { return _voxelPacketSender->getLifetimePacketsSent(); }
 
     /// returns the total bytes sent by this object over its lifetime
-    long long unsigned int getLifetimeBytesSent() const { return _voxelPacketSender.getLifetimeBytesSent(); }
+    long long unsigned int getLifetimeBytesSent() const { return _voxelPacketSender->getLifetimeBytesSent(); }
 
     /// returns the total packets queued by this object over its lifetime
-    long long unsigned int getLifetimePacketsQueued() const { return _voxelPacketSender.getLifetimePacketsQueued(); }
+    long long unsigned int getLifetimePacketsQueued() const { return _voxelPacketSender->getLifetimePacketsQueued(); }
 
     /// returns the total bytes queued by this object over its lifetime
-    long long unsigned int getLifetimeBytesQueued() const { return _voxelPacketSender.getLifetimeBytesQueued(); }
+    long long unsigned int getLifetimeBytesQueued() const { return _voxelPacketSender->getLifetimeBytesQueued(); }
 
 private:
+    VoxelScriptingInterface(const VoxelScriptingInterface&);
+    VoxelScriptingInterface& operator=(const VoxelScriptingInterface&);
+    
     /// attached VoxelEditPacketSender that handles queuing and sending of packets to VS
-    VoxelEditPacketSender _voxelPacketSender;
-    JurisdictionListener _jurisdictionListener;
+    VoxelEditPacketSender* _voxelPacketSender;
+    JurisdictionListener* _jurisdictionListener;
+    bool _ownsPacketSender;
     
     void queueVoxelAdd(PACKET_TYPE addPacketType, VoxelDetail& addVoxelDetails);
+    void queueVoxelEdits(PACKET_TYPE editPacketType, const QVariantList& voxels, bool includesColor);
 };
 
 #endif /* defined(__hifi__VoxelScriptingInterface__) */
@@ -639,12 +639,139 @@ void VoxelTree::readCodeColorBufferToTreeRecursion(VoxelTreeElement* node, ReadC
     }
 }
 
+class FillBoxArgs {
+public:
+    glm::vec3 corner;
+    glm::vec3 farCorner;
+    float voxelScale;
+    nodeColor color;
+    bool destructive;
+};
+
+void VoxelTree::fillBox(const glm::vec3& corner, const glm::vec3& dimensions, float voxelScale, const rgbColor color,
+                        bool destructive) {
+    if (voxelScale <= 0.0f) {
+        return;
+    }
+    
+    FillBoxArgs args;
+    args.corner = corner;
+    args.farCorner = corner + dimensions;
+    args.voxelScale = voxelScale;
+    memcpy(args.color, color, sizeof(rgbColor));
+    args.color[3] = 1;
+    args.destructive = destructive;
+    
+    if (fillBoxRecursion(getRoot(), args)) {
+        _isDirty = true;
+    }
+}
+
+bool VoxelTree::fillBoxRecursion(VoxelTreeElement* element, const FillBoxArgs& args) {
+    const glm::vec3& corner = element->getCorner();
+    float scale = element->getScale();
+    glm::vec3 farCorner = corner + glm::vec3(scale, scale, scale);
+    
+    if (scale <= args.voxelScale) {
+        // this is the size of the voxels being filled, which are filled if their centers are in the box
+        glm::vec3 center = corner + glm::vec3(scale, scale, scale) * 0.5f;
+        bool centerInBox = glm::all(glm::greaterThanEqual(center, args.corner)) &&
+                           glm::all(glm::lessThan(center, args.farCorner));
+        return centerInBox && fillElement(element, args);
+    }
+    
+    // a bigger cube that's all inside the box is filled as one voxel, unless there's something in it to keep
+    bool inBox = glm::all(glm::greaterThanEqual(corner, args.corner)) &&
+                 glm::all(glm::lessThanEqual(farCorner, args.farCorner));
+    if (inBox && (args.destructive || element->isLeaf())) {
+        return fillElement(element, args);
+    }
+    
+    float halfScale = scale / 2.0f;
+    bool subtreeChanged = false;
+    
+    for (int i = 0; i < NUMBER_OF_CHILDREN; i++) {
+        // the bits of the child index say which half of the element the child is in along x, y and z
+        glm::vec3 childCorner = corner + halfScale * glm::vec3((i >> 2) & 1, (i >> 1) & 1, i & 1);
+        glm::vec3 childFarCorner = childCorner + glm::vec3(halfScale, halfScale, halfScale);
+        
+        if (glm::any(glm::greaterThanEqual(childCorner, args.farCorner)) ||
+            glm::any(glm::lessThanEqual(childFarCorner, args.corner))) {
+            continue;
+        }
+        
+        VoxelTreeElement* child = element->getChildAtIndex(i);
+        bool isNewChild = false;
+        if (!child) {
+            child = element->addChildAtIndex(i);
+            isNewChild = true;
+        }
+        
+        if (fillBoxRecursion(child, args)) {
+            subtreeChanged = true;
+        } else if (isNewChild) {
+            // the box only grazed it, so don't leave an empty voxel behind
+            element->deleteChildAtIndex(i);
+        }
+    }
+    
+    if (subtreeChanged) {
+        element->handleSubtreeChanged(this);
+    }
+    return subtreeChanged;
+}
+
+bool VoxelTree::fillElement(VoxelTreeElement* element, const FillBoxArgs& args) {
+    if (!element->isLeaf()) {
+        if (!args.destructive) {
+            // as with adding a voxel, only a destructive fill replaces what's inside
+            return false;
+        }
+        for (int i = 0; i < NUMBER_OF_CHILDREN; i++) {
+            element->deleteChildAtIndex(i);
+        }
+    }
+    element->setColor(args.color);
+    return true;
+}
+
+void VoxelTree::readSubtreeBitstream(const unsigned char* destinationCode, const unsigned char* bitstream,
+                                     int bitstreamBytes) {
+    // find the destination, creating it on the way down if need be, and keep the path for the unwinding
+    std::vector<VoxelTreeElement*> path;
+    VoxelTreeElement* element = getRoot();
+    int destinationLength = numberOfThreeBitSectionsInCode(destinationCode);
+    
+    while (numberOfThreeBitSectionsInCode(element->getOctalCode()) < destinationLength) {
+        path.push_back(element);
+        
+        int childIndex = branchIndexWithDescendant(element->getOctalCode(), destinationCode);
+        VoxelTreeElement* child = element->getChildAtIndex(childIndex);
+        if (!child) {
+            child = element->addChildAtIndex(childIndex);
+        }
+        element = child;
+    }
+    
+    ReadBitstreamToTreeParams args(WANT_COLOR, NO_EXISTS_BITS, element);
+    readBitstreamToTree(bitstream, bitstreamBytes, args);
+    
+    // let the destination and everything above it re-average and know they've changed
+    element->handleSubtreeChanged(this);
+    for (int i = path.size() - 1; i >= 0; i--) {
+        path[i]->handleSubtreeChanged(this);
+    }
+    _isDirty = true;
+}
+
 bool VoxelTree::handlesEditPacketType(PACKET_TYPE packetType) const {
     // we handle these types of "edit" packets
     switch (packetType) {
         case PACKET_TYPE_VOXEL_SET:
         case PACKET_TYPE_VOXEL_SET_DESTRUCTIVE:
         case PACKET_TYPE_VOXEL_ERASE:
+        case PACKET_TYPE_VOXEL_FILL:
+        case PACKET_TYPE_VOXEL_SUBTREE:
             return true;
     }
     return false;
@@ -685,7 +812,81 @@ int VoxelTree::processEditPacketData(PACKET_TYPE packetType, unsigned char* pack
         case PACKET_TYPE_VOXEL_ERASE:
             processRemoveOctreeElementsBitstream((unsigned char*)packetData, packetLength);
             return maxLength;
+            
+        case PACKET_TYPE_VOXEL_FILL:
+            return processFillEditData(editData, maxLength);
+            
+        case PACKET_TYPE_VOXEL_SUBTREE:
+            return processSubtreeEditData(editData, maxLength);
     }
     return processedBytes;
 }
 
+// A fill edit is the octal code of the cube the fill is confined to, which the sender routed it by, then the box's corner
+// and dimensions, the voxel scale, the color and whether it's destructive. A bad edit ends the packet.
+int VoxelTree::processFillEditData(unsigned char* editData, int maxLength) {
+    int octets = numberOfThreeBitSectionsInCode(editData, maxLength);
+    
+    const int FILL_DATA_BYTES = 2 * sizeof(glm::vec3) + sizeof(float) + sizeof(rgbColor) + sizeof(unsigned char);
+    
+    if (octets == OVERFLOWED_OCTCODE_BUFFER || bytesRequiredForCodeLength(octets) + FILL_DATA_BYTES > maxLength) {
+        printf("WARNING! Got voxel fill record that would overflow buffer, bailing processing of packet!\n");
+        return maxLength;
+    }
+    
+    const unsigned char* dataAt = editData + bytesRequiredForCodeLength(octets);
+    
+    glm::vec3 corner;
+    memcpy(&corner, dataAt, sizeof(corner));
+    dataAt += sizeof(corner);
+    
+    glm::vec3 dimensions;
+    memcpy(&dimensions, dataAt, sizeof(dimensions));
+    dataAt += sizeof(dimensions);
+    
+    float voxelScale;
+    memcpy(&voxelScale, dataAt, sizeof(voxelScale));
+    dataAt += sizeof(voxelScale);
+    
+    rgbColor color;
+    memcpy(color, dataAt, sizeof(color));
+    dataAt += sizeof(color);
+    
+    bool destructive = *dataAt;
+    
+    // senders split fills into chunks, so one edit can't make the server create voxels without bound
+    float maxDimension = voxelScale * VOXEL_FILL_CHUNK_VOXELS;
+    if (!(voxelScale > 0.0f) || dimensions.x > maxDimension || dimensions.y > maxDimension || dimensions.z > maxDimension) {
+        printf("WARNING! Got voxel fill record larger than a chunk, ignoring it!\n");
+    } else {
+        fillBox(corner, dimensions, voxelScale, color, destructive);
+    }
+    
+    return bytesRequiredForCodeLength(octets) + FILL_DATA_BYTES;
+}
+
+// A subtree edit is the octal code of the voxel to read into, the size of the bitstream, and the bitstream.
+int VoxelTree::processSubtreeEditData(unsigned char* editData, int maxLength) {
+    int octets = numberOfThreeBitSectionsInCode(editData, maxLength);
+    
+    if (octets == OVERFLOWED_OCTCODE_BUFFER || bytesRequiredForCodeLength(octets) + (int)sizeof(uint16_t) > maxLength) {
+        printf("WARNING! Got voxel subtree record that would overflow buffer, bailing processing of packet!\n");
+        return maxLength;
+    }
+    
+    int codeBytes = bytesRequiredForCodeLength(octets);
+    
+    uint16_t bitstreamBytes;
+    memcpy(&bitstreamBytes, editData + codeBytes, sizeof(bitstreamBytes));
+    
+    int recordBytes = codeBytes + sizeof(bitstreamBytes) + bitstreamBytes;
+    if (recordBytes > maxLength) {
+        printf("WARNING! Got voxel subtree record that would overflow buffer, bailing processing of packet!\n");
+        return maxLength;
+    }
+    
+    readSubtreeBitstream(editData, editData + codeBytes + sizeof(bitstreamBytes), bitstreamBytes);
+    
+    return recordBytes;
+}
+
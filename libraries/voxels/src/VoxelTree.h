@@ -22,6 +22,7 @@
 #include "VoxelSceneStats.h"
 #include "VoxelEditPacketSender.h"
 
+class FillBoxArgs;
 class ReadCodeColorBufferToTreeArgs;
 
 class VoxelTree : public Octree {
@@ -41,6 +42,15 @@ public:
     void createLine(glm::vec3 point1, glm::vec3 point2, float unitSize, rgbColor color, bool destructive = false);
     void createSphere(float radius, float xc, float yc, float zc, float voxelSize,
                              bool solid, creationMode mode, bool destructive = false, bool debug = false);
+    
+    /// Colors every voxel of size voxelScale whose center is inside the box. Where the box covers a larger cube completely
+    /// that cube is made one voxel instead of being split up. Like createVoxel(), a fill that isn't destructive leaves
+    /// alone the voxels that already have children at the size it would color.
+    void fillBox(const glm::vec3& corner, const glm::vec3& dimensions, float voxelScale, const rgbColor color,
+                 bool destructive = false);
+    
+    /// reads a bitstream whose octal codes are relative to the voxel with destinationCode, creating it if need be
+    void readSubtreeBitstream(const unsigned char* destinationCode, const unsigned char* bitstream, int bitstreamBytes);
 
     void nudgeSubTree(VoxelTreeElement* elementToNudge, const glm::vec3& nudgeAmount, VoxelEditPacketSender& voxelEditSender);
 
@@ -74,6 +84,12 @@ private:
     void nudgeLeaf(VoxelTreeElement* element, void* extraData);
     void chunkifyLeaf(VoxelTreeElement* element);
     void readCodeColorBufferToTreeRecursion(VoxelTreeElement* node, ReadCodeColorBufferToTreeArgs& args);
+    
+    bool fillBoxRecursion(VoxelTreeElement* element, const FillBoxArgs& args);
+    bool fillElement(VoxelTreeElement* element, const FillBoxArgs& args);
+    
+    int processFillEditData(unsigned char* editData, int maxLength);
+    int processSubtreeEditData(unsigned char* editData, int maxLength);
 };
 
 #endif /* defined(__hifi__VoxelTree__) */